@@ -12,6 +12,8 @@
 #include <optional>
 #include <set>
 
+#include "llvm/ADT/DenseMapInfo.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Function.h"
@@ -55,8 +57,32 @@ public:
   const llvm::Value &getValue() const { return *V; }
 
   bool isEmpty() const { return (V == nullptr); }
+
+  friend struct llvm::DenseMapInfo<LayoutTypePtr>;
 }; // end class LayoutTypePtr
 
 using LayoutTypePtrVect = std::vector<LayoutTypePtr>;
 
 } // end namespace dla
+
+template<>
+struct llvm::DenseMapInfo<dla::LayoutTypePtr> {
+  using ValueInfo = llvm::DenseMapInfo<const llvm::Value *>;
+
+  static dla::LayoutTypePtr getEmptyKey() {
+    return dla::LayoutTypePtr(ValueInfo::getEmptyKey());
+  }
+
+  static dla::LayoutTypePtr getTombstoneKey() {
+    return dla::LayoutTypePtr(ValueInfo::getTombstoneKey());
+  }
+
+  static unsigned getHashValue(const dla::LayoutTypePtr &P) {
+    return llvm::hash_combine(P.V, P.FieldIdx);
+  }
+
+  static bool isEqual(const dla::LayoutTypePtr &LHS,
+                      const dla::LayoutTypePtr &RHS) {
+    return LHS == RHS;
+  }
+};
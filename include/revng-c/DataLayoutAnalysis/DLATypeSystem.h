@@ -4,8 +4,10 @@
 // This file is distributed under the MIT License. See LICENSE.mit for details.
 //
 
+#include <algorithm>
 #include <compare>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <limits>
 #include <map>
@@ -13,14 +15,19 @@
 #include <optional>
 #include <set>
 #include <type_traits>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/GraphTraits.h"
-#include "llvm/ADT/IntEqClasses.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/SmallSet.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
 #include "llvm/Support/Allocator.h"
+#include "llvm/Support/Error.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "revng/ADT/FilteredGraphTraits.h"
@@ -151,6 +158,21 @@ public:
 
   std::strong_ordering operator<=>(const TypeLinkTag &Other) const = default;
 
+  /// Hash functor, used to unique the TypeLinkTags in a LayoutTypeSystem
+  struct Hash {
+    size_t operator()(const TypeLinkTag &Tag) const {
+      const OffsetExpression &OE = Tag.OE;
+      llvm::hash_code Result = llvm::hash_combine(Tag.Kind, OE.Offset);
+      for (const auto &[Stride, TC] : llvm::zip(OE.Strides, OE.TripCounts)) {
+        Result = llvm::hash_combine(Result,
+                                    Stride,
+                                    TC.has_value(),
+                                    TC.value_or(0));
+      }
+      return Result;
+    }
+  };
+
   friend void
   writeToLog(Logger<true> &L, const dla::TypeLinkTag &T, int /* Ignore */);
 
@@ -188,6 +210,11 @@ struct LayoutTypeSystemNode {
         if (auto Cmp = ID <=> Other.ID; Cmp != 0)
           return Cmp < 0;
 
+        // TypeLinkTags are uniqued by the LayoutTypeSystem, so equal pointers
+        // mean equal tags, and we can avoid comparing the OffsetExpressions.
+        if (TagPointer == Other.TagPointer)
+          return false;
+
         if (nullptr == TagPointer or nullptr == Other.TagPointer)
           return TagPointer < Other.TagPointer;
 
@@ -200,7 +227,109 @@ struct LayoutTypeSystemNode {
     }
   };
 
-  using NeighborsSet = std::set<Link, NeighborLinkComparison>;
+  /// The neighbors of a node, in a vector sorted by NeighborLinkComparison.
+  //
+  // Nodes have few neighbors, that are visited much more often than they are
+  // changed, so a sorted vector is both smaller and faster than a tree.
+  // As with any vector, inserting or erasing neighbors invalidates the
+  // iterators, so code that changes the neighbors of a node while iterating on
+  // them must look them up again by key.
+  class NeighborsSet {
+  public:
+    using value_type = Link;
+    using key_type = Link;
+    using Storage = llvm::SmallVector<Link, 2>;
+    using iterator = Storage::const_iterator;
+    using const_iterator = Storage::const_iterator;
+    using size_type = size_t;
+
+    /// Key of the links to a neighbor, with a nullptr tag to look up all of
+    /// them with lower_bound and upper_bound.
+    using IDBasedKey = std::pair<uint64_t, const TypeLinkTag *>;
+
+  private:
+    using Helper = NeighborLinkComparison::Helper;
+
+    Storage Links;
+
+  private:
+    static bool less(const Link &LHS, const Link &RHS) {
+      return Helper(LHS) < Helper(RHS);
+    }
+
+    static bool equal(const Link &LHS, const Link &RHS) {
+      return not less(LHS, RHS) and not less(RHS, LHS);
+    }
+
+  public:
+    iterator begin() const { return Links.begin(); }
+    iterator end() const { return Links.end(); }
+    size_t size() const { return Links.size(); }
+    bool empty() const { return Links.empty(); }
+    void clear() { Links.clear(); }
+
+    /// Release the memory of the neighbors, leaving the set empty
+    void release() { Storage().swap(Links); }
+
+    template<typename KeyT>
+    iterator lower_bound(const KeyT &Key) const {
+      Helper K(Key);
+      return std::lower_bound(begin(), end(), K, [](const Link &L, Helper K) {
+        return Helper(L) < K;
+      });
+    }
+
+    template<typename KeyT>
+    iterator upper_bound(const KeyT &Key) const {
+      Helper K(Key);
+      return std::upper_bound(begin(), end(), K, [](Helper K, const Link &L) {
+        return K < Helper(L);
+      });
+    }
+
+    iterator find(const Link &L) const {
+      auto It = lower_bound(L);
+      if (It != end() and equal(*It, L))
+        return It;
+      return end();
+    }
+
+    bool contains(const Link &L) const { return find(L) != end(); }
+
+    size_t count(const Link &L) const { return contains(L); }
+
+    std::pair<iterator, bool> insert(const Link &L) {
+      auto It = lower_bound(L);
+      if (It != end() and equal(*It, L))
+        return std::make_pair(It, false);
+
+      auto Position = Links.begin() + std::distance(begin(), It);
+      return std::make_pair(Links.insert(Position, L), true);
+    }
+
+    /// Insert all the links in a range, keeping the ones already present
+    template<typename IteratorT>
+    void insert(IteratorT Begin, IteratorT End) {
+      Links.append(Begin, End);
+      std::stable_sort(Links.begin(), Links.end(), less);
+      Links.erase(std::unique(Links.begin(), Links.end(), equal), Links.end());
+    }
+
+    iterator erase(iterator It) { return Links.erase(It); }
+
+    iterator erase(iterator Begin, iterator End) {
+      return Links.erase(Begin, End);
+    }
+
+    size_t erase(const Link &L) {
+      auto It = find(L);
+      if (It == end())
+        return 0;
+      Links.erase(It);
+      return 1;
+    }
+  };
+
   using NeighborIterator = NeighborsSet::iterator;
   NeighborsSet Successors{};
   NeighborsSet Predecessors{};
@@ -226,22 +355,39 @@ public:
 };
 
 /// This class handles equivalence classes between indexes of vectors
-class VectEqClasses : public llvm::IntEqClasses {
+//
+// It's a union-find with union by rank and path halving, so that queries can be
+// answered at any time. The elements of each class are also kept in a circular
+// list, so that a class can be enumerated in time proportional to its size.
+// Calling compress assigns a dense ID to each class, and freezes the classes.
+class VectEqClasses {
 private:
+  // Parent of each element in the union-find forest. Mutable because findLeader
+  // shortens the paths it walks.
+  mutable std::vector<unsigned> Parent;
+  // Upper bound of the height of the tree of each leader
+  std::vector<uint8_t> Rank;
+  // Next element in the circular list of the elements of the same class
+  std::vector<unsigned> Next;
+
   // ID of the first removed ID
   std::optional<unsigned> RemovedID = {};
-  unsigned NElems = 0;
 
-private:
-  /// Used internally, operator[] is removed for this class
-  unsigned lookupEqClass(unsigned ID) const {
-    return llvm::IntEqClasses::operator[](ID);
-  }
+  // Dense ID of the class of each element, filled by compress
+  std::vector<unsigned> ClassIDs;
+  unsigned NumClasses = 0;
 
 public:
   /// Add 1 element with its own equivalence class
   unsigned growBy1();
 
+  /// Merge the equivalence classes of \a A and \a B
+  ///\return the leader of the merged class
+  unsigned join(unsigned A, unsigned B);
+
+  /// Get the leader of the equivalence class of \a ID
+  unsigned findLeader(unsigned ID) const;
+
   /// Remove the whole equivalence class of \a ID
   void remove(const unsigned ID);
 
@@ -249,18 +395,24 @@ public:
   bool isRemoved(const unsigned ID) const;
 
   /// Get the total number of elements added
-  unsigned getNumElements() const { return NElems; }
+  unsigned getNumElements() const { return Parent.size(); }
 
-public:
-  /// You can't access the Eq Classes directly, some might be deleted
-  unsigned operator[](unsigned) const = delete;
+  /// Assign a dense ID to each class, in order of their smallest element.
+  //
+  // After this, the classes can't change anymore.
+  void compress();
 
+  /// Get the number of classes, including the removed one, or 0 if the classes
+  /// are not compressed
+  unsigned getNumClasses() const { return NumClasses; }
+
+public:
   /// Get the Equivalence class ID of an element (must be compressed)
   ///\return empty if the element is out-of-bounds or has been removed
   std::optional<unsigned> getEqClassID(const unsigned ID) const;
 
-  /// Get all the elements that are in the same equivalence class of \a ID
-  ///\note Expensive: performs a linear scan of all the elements
+  /// Get all the elements that are in the same equivalence class of \a ID,
+  /// sorted
   std::vector<unsigned> computeEqClass(const unsigned ID) const;
 
   /// Check if \a ID1 and \a ID2 have the same equivalence class
@@ -278,17 +430,71 @@ struct TSDebugPrinter {
   virtual ~TSDebugPrinter() {}
 };
 
+/// Iterator over the nodes of a LayoutTypeSystem, skipping the removed ones.
+///
+/// The iterator refers to the nodes by index, so it is not invalidated when new
+/// nodes are created or when other nodes are removed. The nodes created after
+/// the iterator are not visited.
+class LayoutTypeSystemNodeIterator {
+public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = LayoutTypeSystemNode *;
+  using difference_type = std::ptrdiff_t;
+  using pointer = LayoutTypeSystemNode *const *;
+  using reference = LayoutTypeSystemNode *;
+
+private:
+  const std::vector<LayoutTypeSystemNode *> *Nodes = nullptr;
+  size_t Index = 0;
+  size_t End = 0;
+
+public:
+  LayoutTypeSystemNodeIterator() = default;
+  LayoutTypeSystemNodeIterator(const std::vector<LayoutTypeSystemNode *> &N,
+                               size_t I) :
+    Nodes(&N), Index(I), End(N.size()) {
+    skipRemoved();
+  }
+
+  reference operator*() const { return (*Nodes)[Index]; }
+
+  LayoutTypeSystemNodeIterator &operator++() {
+    ++Index;
+    skipRemoved();
+    return *this;
+  }
+
+  LayoutTypeSystemNodeIterator operator++(int) {
+    auto Old = *this;
+    ++*this;
+    return Old;
+  }
+
+  bool operator==(const LayoutTypeSystemNodeIterator &Other) const {
+    return Nodes == Other.Nodes and Index == Other.Index;
+  }
+
+private:
+  void skipRemoved() {
+    while (Index < End and (*Nodes)[Index] == nullptr)
+      ++Index;
+  }
+};
+
 class LayoutTypeSystem {
 public:
   using Node = LayoutTypeSystemNode;
   using NodePtr = LayoutTypeSystemNode *;
   using NodeUniquePtr = std::unique_ptr<LayoutTypeSystemNode>;
   using NeighborIterator = LayoutTypeSystemNode::NeighborIterator;
+  using NodesIterator = LayoutTypeSystemNodeIterator;
 
   LayoutTypeSystem() : DebugPrinter(new TSDebugPrinter) {}
 
   ~LayoutTypeSystem() {
     for (auto *Layout : Layouts) {
+      if (not Layout)
+        continue;
       Layout->~LayoutTypeSystemNode();
       NodeAllocator.Deallocate(Layout);
     }
@@ -308,13 +514,17 @@ protected:
   addLink(LayoutTypeSystemNode *Src, LayoutTypeSystemNode *Tgt, TagT &&Tag) {
     if (Src == nullptr or Tgt == nullptr or Src == Tgt)
       return std::make_pair(nullptr, false);
-    revng_assert(Layouts.contains(Src));
-    revng_assert(Layouts.contains(Tgt));
+    revng_assert(hasLayout(Src));
+    revng_assert(hasLayout(Tgt));
     auto It = LinkTags.insert(std::forward<TagT>(Tag)).first;
     revng_assert(It != LinkTags.end());
     const TypeLinkTag *T = &*It;
     bool New = Src->Successors.insert(std::make_pair(Tgt, T)).second;
     New |= Tgt->Predecessors.insert(std::make_pair(Src, T)).second;
+    if (New) {
+      markModified(Src);
+      markModified(Tgt);
+    }
     return std::make_pair(T, New);
   }
 
@@ -360,10 +570,59 @@ public:
     dumpDotOnFile(FName.c_str(), ShowCollapsed);
   }
 
-  auto getNumLayouts() const { return Layouts.size(); }
+  auto getNumLayouts() const { return NumLayouts; }
+
+  /// Get the number of nodes that have been merged into other nodes so far
+  uint64_t getNumMergedNodes() const { return NumMergedNodes; }
+
+  /// Get the number of nodes that have been removed so far
+  uint64_t getNumRemovedNodes() const { return NumRemovedNodes; }
+
+  /// Get the number of bytes allocated for the nodes so far
+  //
+  // The memory of the nodes that are removed is never reused, so this is also
+  // the high-water mark of the memory used for nodes.
+  size_t getNodeMemory() const { return NodeAllocator.getTotalMemory(); }
 
   auto getLayoutsRange() const {
-    return llvm::make_range(Layouts.begin(), Layouts.end());
+    return llvm::make_range(NodesIterator(Layouts, 0),
+                            NodesIterator(Layouts, Layouts.size()));
+  }
+
+  /// Check if \a N is a node of this LayoutTypeSystem that was not removed
+  //
+  // Removed and merged nodes are never destroyed before the LayoutTypeSystem,
+  // so this can be safely called on them too.
+  bool hasLayout(const LayoutTypeSystemNode *N) const {
+    return N->ID < Layouts.size() and Layouts[N->ID] == N;
+  }
+
+  /// Get the current generation of the LayoutTypeSystem.
+  //
+  // The generation is bumped every time a node is created, or its edges or
+  // size are changed. It can be used to tell which nodes have been modified
+  // after a given point in time.
+  uint64_t getGeneration() const { return Generation; }
+
+  /// Check if the Steps transforming this LayoutTypeSystem can report their
+  /// progress through llvm::Task
+  //
+  // Tasks can only be created on the main thread, so this is disabled on the
+  // LayoutTypeSystems transformed on a thread pool.
+  bool reportsProgress() const { return ReportProgress; }
+
+  void setReportProgress(bool Value) { ReportProgress = Value; }
+
+  /// Record that \a N has been modified
+  void markModified(const LayoutTypeSystemNode *N) {
+    revng_assert(hasLayout(N));
+    NodeGenerations[N->ID] = ++Generation;
+  }
+
+  /// Check if \a N has been modified after generation \a G
+  bool isModifiedSince(const LayoutTypeSystemNode *N, uint64_t G) const {
+    revng_assert(hasLayout(N));
+    return NodeGenerations[N->ID] > G;
   }
 
 public:
@@ -386,16 +645,70 @@ public:
 
   void dropOutgoingEdges(LayoutTypeSystemNode *N);
 
+  /// Erase the edge from \a Src described by \a Edge, that must exist
+  void eraseEdge(LayoutTypeSystemNode *Src,
+                 const LayoutTypeSystemNode::Link &Edge) {
+    auto EdgeIt = Src->Successors.find(Edge);
+    revng_assert(EdgeIt != Src->Successors.end());
+    eraseEdge(Src, EdgeIt);
+  }
+
+  /// Copy \a Nodes and all their edges into a new LayoutTypeSystem, in which
+  /// the copy of Nodes[I] has ID I.
+  //
+  // Nodes must be sorted by ID, and must not have edges to other nodes.
+  std::unique_ptr<LayoutTypeSystem>
+  extractNodes(llvm::ArrayRef<LayoutTypeSystemNode *> Nodes) const;
+
+  /// Replace \a Nodes with the content of \a Extracted, that must have been
+  /// obtained from extractNodes(Nodes).
+  //
+  // The nodes that are still alive in Extracted keep their original ID, the
+  // new nodes get new IDs in the order in which they were created, and the
+  // equivalence classes of merged and removed nodes are updated accordingly.
+  void replaceNodes(llvm::ArrayRef<LayoutTypeSystemNode *> Nodes,
+                    const LayoutTypeSystem &Extracted);
+
+  /// Write a compact binary checkpoint of this LayoutTypeSystem on \a OS.
+  //
+  // The checkpoint holds the nodes with their IDs, sizes and attributes, the
+  // links with their tags, and the equivalence classes, that must not have
+  // been compressed yet.
+  void serialize(llvm::raw_ostream &OS) const;
+
+  /// Load a LayoutTypeSystem from a checkpoint written by serialize.
+  static llvm::Expected<std::unique_ptr<LayoutTypeSystem>>
+  deserialize(llvm::StringRef Buffer);
+
+private:
+  /// Drop \a N, that must have no edges left, from the nodes
+  //
+  // The node is not destroyed, its memory is just left in the allocator, that
+  // never reuses it, so that pointers to it can still be checked with
+  // hasLayout. Its neighbor sets are released, since they will never be used
+  // again.
+  void dropNode(LayoutTypeSystemNode *N);
+
 private:
   uint64_t NID = 0ULL;
 
-  // Holds all the LayoutTypeSystemNode
+  // Holds all the LayoutTypeSystemNode, indexed by ID. The nodes that have
+  // been removed or merged into other nodes are left as nullptr tombstones.
   llvm::BumpPtrAllocator NodeAllocator = {};
-  std::set<LayoutTypeSystemNode *> Layouts = {};
+  std::vector<LayoutTypeSystemNode *> Layouts = {};
+  uint64_t NumLayouts = 0ULL;
+  uint64_t NumMergedNodes = 0ULL;
+  uint64_t NumRemovedNodes = 0ULL;
+
+  // The generation at which each node was last modified, indexed by ID.
+  std::vector<uint64_t> NodeGenerations = {};
+  uint64_t Generation = 0ULL;
+
+  bool ReportProgress = true;
 
   // Holds the link tags, so that they can be deduplicated and referred to using
   // TypeLinkTag * in the links inside LayoutTypeSystemNode
-  std::set<TypeLinkTag> LinkTags = {};
+  std::unordered_set<TypeLinkTag, TypeLinkTag::Hash> LinkTags = {};
 
 public:
   // Checks that is valid, and returns true if it is, false otherwise
@@ -432,6 +745,18 @@ public:
   }
 }; // end class LayoutTypeSystem
 
+/// Registers a Logger used while transforming LayoutTypeSystems.
+//
+// Loggers are not thread-safe, so different LayoutTypeSystems are only
+// transformed in parallel if none of the registered Loggers is enabled.
+struct RegisterTypeSystemLogger {
+  RegisterTypeSystemLogger(const Logger<> &L);
+};
+
+/// Check if any of the Loggers registered with RegisterTypeSystemLogger is
+/// enabled.
+bool isTypeSystemLoggingEnabled();
+
 } // end namespace dla
 
 template<>
@@ -571,7 +896,7 @@ struct llvm::GraphTraits<const dla::LayoutTypeSystem *>
   : public llvm::GraphTraits<const dla::LayoutTypeSystemNode *> {
 
 public:
-  using nodes_iterator = std::set<dla::LayoutTypeSystemNode *>::iterator;
+  using nodes_iterator = dla::LayoutTypeSystem::NodesIterator;
 
   static NodeRef getEntryNode(const dla::LayoutTypeSystem *) { return nullptr; }
 
@@ -593,7 +918,7 @@ struct llvm::GraphTraits<dla::LayoutTypeSystem *>
   : public llvm::GraphTraits<dla::LayoutTypeSystemNode *> {
 
 public:
-  using nodes_iterator = std::set<dla::LayoutTypeSystemNode *>::iterator;
+  using nodes_iterator = dla::LayoutTypeSystem::NodesIterator;
 
   static NodeRef getEntryNode(const dla::LayoutTypeSystem *) { return nullptr; }
 
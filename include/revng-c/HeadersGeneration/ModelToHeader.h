@@ -4,6 +4,7 @@
 // This file is distributed under the MIT License. See LICENSE.mit for details.
 //
 
+#include <cstdint>
 #include <set>
 
 #include "llvm/ADT/SmallPtrSet.h"
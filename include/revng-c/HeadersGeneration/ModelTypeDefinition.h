@@ -8,3 +8,7 @@
 
 std::string dumpModelTypeDefinition(const model::Binary &Model,
                                     model::Type::Key Key);
+
+/// Whether dumpModelTypeDefinition logs, in which case it must not be called
+/// from multiple threads at once
+bool isModelTypeDefinitionLogEnabled();
@@ -5,8 +5,11 @@
 //
 
 #include <cstdlib>
+#include <tuple>
 #include <type_traits>
 
+#include "llvm/ADT/DenseMap.h"
+
 #include "revng-c/RestructureCFG/ASTNode.h"
 
 // Forward declarations.
@@ -42,6 +45,10 @@ public:
                                                  &ExprNode::deleteExprNode>;
   using expr_unique_ptr = std::unique_ptr<ExprNode, expr_destructor>;
 
+  /// Key used to hash-cons `ExprNode`s: the node kind (together with the
+  /// comparison kind for `CompareNode`s), the operands and the constant
+  using expr_key = std::tuple<unsigned, const void *, const void *, size_t>;
+
   using links_container_expr = std::vector<expr_unique_ptr>;
   using links_iterator_expr = typename links_container_expr::iterator;
   using links_range_expr = llvm::iterator_range<links_iterator_expr>;
@@ -67,6 +74,7 @@ private:
   ASTNode *RootNode = nullptr;
   unsigned IDCounter = 0;
   links_container_expr CondExprList = {};
+  llvm::DenseMap<expr_key, ExprNode *> UniquedCondExprs;
 
 public:
   ASTTree() = default;
@@ -126,5 +134,12 @@ public:
                                     const std::string &FolderName,
                                     const std::string &FileName) const;
 
+  /// Add \a Expr to the conditional expressions of this AST.
+  ///
+  /// \note `ExprNode`s are hash-consed: if a structurally identical expression
+  ///       is already present, \a Expr is destroyed and the existing node is
+  ///       returned. The children of \a Expr must have been obtained from
+  ///       this same method, so that structural equality boils down to
+  ///       pointer equality.
   ExprNode *addCondExpr(expr_unique_ptr &&Expr);
 };
@@ -5,6 +5,7 @@
 //
 
 #include <cstdlib>
+#include <utility>
 
 #include "llvm/Support/Casting.h"
 
@@ -20,6 +21,14 @@ class BasicBlock;
 class Value;
 } // namespace llvm
 
+/// Base class of the conditional expressions associated to the `IfNode`s.
+///
+/// `ExprNode`s are hash-consed by the `ASTTree` owning them (see
+/// `ASTTree::addCondExpr`): two structurally identical expressions in the
+/// same `ASTTree` are always represented by the same node, hence they can be
+/// compared and hashed by pointer. For this reason, `ExprNode`s are immutable
+/// after their creation, and transformations must build new expressions
+/// instead of changing existing ones in place.
 class ExprNode {
 public:
   enum NodeKind {
@@ -94,23 +103,18 @@ public:
 
   size_t getConstant() const { return Constant; }
 
-  void flipComparison() {
+  /// Returns the comparison kind and the constant of the negated comparison
+  std::pair<ComparisonKind, size_t> getFlippedComparison() const {
     if (Comparison == Comparison_Equal) {
-      Comparison = Comparison_NotEqual;
+      return { Comparison_NotEqual, Constant };
     } else if (Comparison == Comparison_NotEqual) {
-      Comparison = Comparison_Equal;
+      return { Comparison_Equal, Constant };
     } else if (Comparison == Comparison_NotPresent) {
-      Comparison = Comparison_Equal;
-      Constant = 0;
+      return { Comparison_Equal, 0 };
     } else {
       revng_abort();
     }
   }
-
-  void setNotPresentKind() {
-    revng_assert(Comparison != Comparison_NotPresent);
-    Comparison = Comparison_NotPresent;
-  }
 };
 
 class ValueCompareNode : public CompareNode {
@@ -208,10 +212,6 @@ protected:
 
 public:
   ExprNode *getNegatedNode() const { return Child; }
-
-  ExprNode **getNegatedNodeAddress() { return &Child; }
-
-  void setNegatedNode(ExprNode *NewNegatedNode) { Child = NewNegatedNode; }
 };
 
 class BinaryNode : public ExprNode {
@@ -243,15 +243,6 @@ public:
   std::pair<const ExprNode *, const ExprNode *> getInternalNodes() const {
     return std::make_pair(LeftChild, RightChild);
   }
-
-  std::pair<ExprNode **, ExprNode **> getInternalNodesAddress() {
-    return std::make_pair(&LeftChild, &RightChild);
-  }
-
-  void setInternalNodes(std::pair<ExprNode *, ExprNode *> NewInternalNodes) {
-    LeftChild = NewInternalNodes.first;
-    RightChild = NewInternalNodes.second;
-  }
 };
 
 class AndNode : public BinaryNode {
@@ -50,8 +50,6 @@ inline Tag StackAccessesSegregated("stack-accesses-segregated",
 
 inline Tag Decompiled("decompiled", StackPointerPromoted);
 
-inline Tag StackOffsetMarker("stack-offset-marker");
-
 inline Tag BinaryOperationOverflows("binary-operation-overflow");
 
 } // namespace FunctionTags
@@ -6,6 +6,8 @@
 
 #include <unordered_map>
 
+#include "llvm/ADT/SmallVector.h"
+
 #include "revng/ADT/GenericGraph.h"
 #include "revng/Model/Binary.h"
 #include "revng/Model/Type.h"
@@ -32,11 +34,17 @@ public:
     std::map<const model::Type *, Node *> TypeToNode;
   };
 
+private:
+  using TypeVector = llvm::SmallVector<const model::Type *, 2>;
+
 private:
   GraphInfo TypeGraph;
   std::unordered_map<const model::Type *, unsigned> TypeToNumOfRefs;
   std::set<const model::Type *> TypesToInline;
 
+  // For each type, the inlinable types whose only user is that type.
+  std::unordered_map<const model::Type *, TypeVector> InlinedInto;
+
 public:
   TypeInlineHelper(const model::Binary &Model);
 
@@ -58,8 +66,7 @@ public:
 
   // Find all nested types of the `RootType` that should be inlined into it.
   std::set<const model::Type *>
-  getTypesToInlineInTypeTy(const model::Binary &Model,
-                           const model::Type *RootType) const;
+  getTypesToInlineInTypeTy(const model::Type *RootType) const;
 
 private:
   std::set<const model::Type *> findTypesToInline(const model::Binary &Model,
@@ -70,15 +77,8 @@ private:
   std::unordered_map<const model::Type *, unsigned>
   calculateNumOfOccurences(const model::Binary &Model);
 
-  bool isReachableFromRootType(const model::Type *Type,
-                               const model::Type *RootType,
-                               const GraphInfo &TypeGraph);
-
-  // Helper function used for finding all nested (into `RootType`) inlinable
-  // types.
-  std::set<const model::Type *>
-  getNestedTypesToInline(const model::Type *RootType,
-                         const UpcastablePointer<model::Type> &NestedTy) const;
+  // Record, for each type to inline, the only type using it.
+  void buildInlinedInto();
 };
 
 extern bool declarationIsDefinition(const model::Type *T);
@@ -98,6 +98,10 @@ public:
                               uint64_t Size,
                               llvm::ArrayRef<FieldAttr> fields);
 
+  /// Verify the body of a definition. Since the body cannot change once set,
+  /// the result is cached in the storage and later calls are free.
+  LogicalResult verifyBody(function_ref<InFlightDiagnostic()> emitError);
+
   void walkImmediateSubElements(function_ref<void(Attribute)> walkAttrsFn,
                                 function_ref<void(Type)> walkTypesFn) const;
   Attribute replaceImmediateSubElements(ArrayRef<Attribute> replAttrs,
@@ -180,6 +184,11 @@ public:
                               llvm::StringRef Name,
                               uint64_t Size,
                               llvm::ArrayRef<FieldAttr> fields);
+
+  /// Verify the body of a definition, caching the result like
+  /// StructType::verifyBody does
+  LogicalResult verifyBody(function_ref<InFlightDiagnostic()> emitError);
+
   std::string getAlias() const { return getName().str(); }
 
   // since mlir types and attributes are immutable, the infrastructure must
@@ -4,6 +4,8 @@
 // This file is distributed under the MIT License. See LICENSE.mit for details.
 //
 
+#include <atomic>
+
 #include "mlir/IR/AttributeSupport.h"
 #include "mlir/IR/Attributes.h"
 #include "mlir/IR/TypeSupport.h"
@@ -23,7 +25,9 @@ public:
     uint64_t ID;
     uint64_t Size;
     llvm::StringRef name;
-    Optional<llvm::SmallVector<FieldAttr, 2>> fields;
+    // Once the body is set, this points to fields owned by the allocator of
+    // the context. Keys used for lookups only carry the ID.
+    Optional<llvm::ArrayRef<FieldAttr>> fields;
 
     // struct storages are never exposed to the user, they are only used
     // internally to figure out how to create unique objects. only operator== is
@@ -68,16 +72,15 @@ public:
                              llvm::StringRef name,
                              uint64_t Size,
                              llvm::ArrayRef<FieldAttr> body) {
-    if (TheKey.fields.has_value() and body == *TheKey.fields
-        and TheKey.name == name and TheKey.Size == Size)
-      return mlir::success();
-
-    if (TheKey.fields.has_value())
-      return mlir::failure();
+    // Setting the same body again is allowed. Check the cheap parts first,
+    // fields are only compared one by one if they're not the very same array.
+    if (TheKey.fields.has_value()) {
+      return mlir::success(TheKey.Size == Size and TheKey.name == name
+                           and (TheKey.fields->data() == body.data()
+                                or *TheKey.fields == body));
+    }
 
-    TheKey.fields = llvm::SmallVector<FieldAttr, 2>();
-    for (auto field : body)
-      TheKey.fields->push_back(field);
+    TheKey.fields = alloc.copyInto(body);
     TheKey.name = alloc.copyInto(name);
     TheKey.Size = Size;
     return mlir::success();
@@ -96,8 +99,13 @@ public:
 
   uint64_t getID() const { return TheKey.ID; }
 
+  // The body cannot change once set, so it needs to be verified only once
+  bool isBodyVerified() const { return BodyVerified.load(); }
+  void setBodyVerified() { BodyVerified.store(true); }
+
 private:
   Key TheKey;
+  std::atomic<bool> BodyVerified = false;
 };
 
 struct UnionTypeStorage : public mlir::AttributeStorage {
@@ -106,7 +114,7 @@ public:
 
     uint64_t ID;
     llvm::StringRef name;
-    Optional<llvm::SmallVector<FieldAttr, 2>> fields;
+    Optional<llvm::ArrayRef<FieldAttr>> fields;
 
     bool operator==(const Key &Other) const { return Other.ID == ID; }
 
@@ -145,16 +153,13 @@ public:
   mlir::LogicalResult mutate(mlir::StorageUniquer::StorageAllocator &alloc,
                              llvm::StringRef name,
                              llvm::ArrayRef<FieldAttr> body) {
-    if (TheKey.fields.has_value() and body == *TheKey.fields
-        and TheKey.name == name)
-      return mlir::success();
-
-    if (TheKey.fields.has_value())
-      return mlir::failure();
+    if (TheKey.fields.has_value()) {
+      return mlir::success(TheKey.name == name
+                           and (TheKey.fields->data() == body.data()
+                                or *TheKey.fields == body));
+    }
 
-    TheKey.fields = llvm::SmallVector<FieldAttr, 2>();
-    for (auto field : body)
-      TheKey.fields->push_back(field);
+    TheKey.fields = alloc.copyInto(body);
     TheKey.name = alloc.copyInto(name);
     return mlir::success();
   }
@@ -171,7 +176,11 @@ public:
 
   uint64_t getID() const { return TheKey.ID; }
 
+  bool isBodyVerified() const { return BodyVerified.load(); }
+  void setBodyVerified() { BodyVerified.store(true); }
+
 private:
   Key TheKey;
+  std::atomic<bool> BodyVerified = false;
 };
 } // namespace mlir::clift
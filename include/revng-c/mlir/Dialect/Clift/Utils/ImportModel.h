@@ -0,0 +1,68 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.mit for details.
+//
+
+#include <cstdint>
+#include <unordered_set>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+
+#include "mlir/IR/BuiltinTypes.h"
+#include "mlir/IR/MLIRContext.h"
+
+#include "revng/Model/Binary.h"
+#include "revng/Model/QualifiedType.h"
+#include "revng/Model/Type.h"
+
+#include "revng-c/mlir/Dialect/Clift/IR/CliftAttributes.h"
+#include "revng-c/mlir/Dialect/Clift/IR/CliftTypes.h"
+
+namespace mlir::clift {
+
+/// Imports the types of a model as Clift types
+///
+/// Each model type is imported once, the first time it's requested, and the
+/// resulting Clift type is shared by everything that uses it afterwards.
+/// Clift type definitions have the same ID as the model types they come from.
+class ModelTypeImporter {
+private:
+  mlir::MLIRContext &Context;
+
+  llvm::DenseMap<const model::Type *, mlir::clift::ValueType> Imported;
+
+  /// Types whose import is in progress, to detect cycles that do not go
+  /// through a struct or a union
+  llvm::SmallPtrSet<const model::Type *, 4> InProgress;
+
+  /// IDs of the model types, and of the artificial types created so far
+  std::unordered_set<uint64_t> UsedIDs;
+
+  /// Candidate ID for the next type that has no counterpart in the model, such
+  /// as the struct returned by a RawFunctionType with multiple return values
+  uint64_t NextArtificialID = 0;
+
+public:
+  ModelTypeImporter(mlir::MLIRContext &Context, const model::Binary &Model);
+
+public:
+  mlir::clift::ValueType get(const model::QualifiedType &QT);
+  mlir::clift::ValueType get(const model::Type &T);
+
+  /// Get the type of a function whose prototype is \p Prototype, suitable for
+  /// a clift::FunctionOp
+  mlir::FunctionType getFunctionType(const model::Type &Prototype);
+
+private:
+  mlir::clift::ValueType import(const model::Type &T);
+  mlir::clift::FunctionAttr importPrototype(const model::Type &T);
+  mlir::clift::ValueType getRawReturnType(const model::RawFunctionType &RF);
+  mlir::BoolAttr getConst(bool IsConst);
+
+  /// Get an ID not used by any model type, nor by another artificial type
+  uint64_t allocateArtificialID();
+};
+
+} // namespace mlir::clift
@@ -7,16 +7,16 @@
 // This file is distributed under the MIT License. See LICENSE.mit for details.
 //
 
+#include <limits>
 #include <list>
 #include <type_traits>
 
-#include "llvm/ADT/PostOrderIterator.h"
-#include "llvm/ADT/SmallSet.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Instructions.h"
-#include "llvm/Support/GenericDomTreeConstruction.h"
+#include "llvm/Support/MathExtras.h"
 
-#include "revng/ADT/GenericGraph.h"
 #include "revng/ADT/RecursiveCoroutine.h"
 
 #include "revng-c/RestructureCFG/ASTNode.h"
@@ -167,95 +167,183 @@ public:
   }
 };
 
-struct ASTForwardNode {
-  ASTForwardNode(const ASTNode *Node) : Node(Node) {}
-  const ASTNode *Node;
-  const ASTNode *getASTNode() { return Node; }
-};
+/// The scope tree is a view over the GHAST representing the visibility between
+/// `ASTNode`s. In this tree no `SequenceNode` has more than one child, but
+/// instead each sibling in a `SequenceNode` has, as child, its immediate
+/// successor. In this way, each `ASTNode` is an ancestor of all the `ASTNode`s
+/// that can see a variable declared in it, and the ALAP declaration point of a
+/// variable is the lowest common ancestor of all its uses.
+///
+/// The tree is linearized with an Euler tour, on which we build a sparse table
+/// answering minimum depth queries in constant time. This gives us a constant
+/// time lowest common ancestor query.
+class ScopeTree {
+private:
+  /// The `ASTNode` corresponding to each node of the tree
+  std::vector<const ASTNode *> Nodes;
 
-using Node = ForwardNode<ASTForwardNode>;
-using ScopeReachabilityGenericGraphTy = GenericGraph<Node>;
-using ASTToNodeMapType = std::map<const ASTNode *, Node *>;
+  /// The children of each node of the tree
+  std::vector<llvm::SmallVector<unsigned, 2>> Children;
 
-// In this struct we compact both the underlying `GenericGraph` that we use to
-// materialize the graph, and the mapping between the original `ASTNode` and the
-// corresponding `Node` in the `GenericGraph`
-struct ScopeReachabilityGraphTy {
-  ScopeReachabilityGenericGraphTy Graph;
-  ASTToNodeMapType ASTToNodeMap;
-};
+  /// Map from an `ASTNode` to the index of the corresponding node
+  llvm::DenseMap<const ASTNode *, unsigned> NodeIndex;
 
-static RecursiveCoroutine<Node *>
-buildNode(ScopeReachabilityGraphTy &ScopeReachabilityGraph,
-          const ASTNode *ASTN) {
-  // Create a new node in the `GenericGraph`
-  Node *GNode = ScopeReachabilityGraph.Graph.addNode(ASTN);
-  ScopeReachabilityGraph.ASTToNodeMap[ASTN] = GNode;
+  /// The depth of each node of the tree
+  std::vector<unsigned> Depth;
 
-  switch (ASTN->getKind()) {
-  case ASTNode::NK_List: {
-    auto *Seq = llvm::cast<SequenceNode>(ASTN);
+  /// The position of the first occurrence of each node in the Euler tour
+  std::vector<unsigned> FirstOccurrence;
 
-    Node *PreviousGChild = GNode;
-    for (ASTNode *Child : Seq->nodes()) {
-      Node *GChild = rc_recur buildNode(ScopeReachabilityGraph, Child);
+  /// `SparseTable[K][I]` is the node with the minimum depth among the ones in
+  /// the positions `[I, I + 2^K)` of the Euler tour
+  std::vector<std::vector<unsigned>> SparseTable;
 
-      // Create the sibling-to-sibling edge
-      if (PreviousGChild)
-        PreviousGChild->addSuccessor(GChild);
+public:
+  ScopeTree(const ASTTree &GHAST) {
+    buildNode(GHAST.getRoot());
+    computeEulerTour();
+  }
 
-      // Prepare for the next iteration
-      PreviousGChild = GChild;
-    }
-  } break;
-  case ASTNode::NK_Scs: {
-    auto *Scs = llvm::cast<ScsNode>(ASTN);
+public:
+  /// Returns the position of \a ASTN in the Euler tour, i.e., the value used
+  /// to order the nodes for the `lowestCommonAncestor` queries
+  unsigned getTourPosition(const ASTNode *ASTN) const {
+    auto It = NodeIndex.find(ASTN);
+    revng_assert(It != NodeIndex.end());
+    return FirstOccurrence[It->second];
+  }
 
-    if (Scs->hasBody()) {
-      Node *Body = rc_recur buildNode(ScopeReachabilityGraph, Scs->getBody());
-      GNode->addSuccessor(Body);
-    }
-  } break;
-  case ASTNode::NK_If: {
-    auto *If = llvm::cast<IfNode>(ASTN);
+  /// Returns the lowest common ancestor of the nodes that appear in the Euler
+  /// tour between positions \a First and \a Last (both included)
+  const ASTNode *lowestCommonAncestor(unsigned First, unsigned Last) const {
+    revng_assert(First <= Last);
+    unsigned Level = llvm::Log2_32(Last - First + 1);
+    unsigned LHS = SparseTable[Level][First];
+    unsigned RHS = SparseTable[Level][Last + 1 - (1U << Level)];
+    return Nodes[Depth[LHS] <= Depth[RHS] ? LHS : RHS];
+  }
+
+private:
+  unsigned addNode(const ASTNode *ASTN) {
+    unsigned Index = Nodes.size();
+    Nodes.push_back(ASTN);
+    Children.emplace_back();
+    bool New = NodeIndex.insert({ ASTN, Index }).second;
+    revng_assert(New);
+    return Index;
+  }
+
+  RecursiveCoroutine<unsigned> buildNode(const ASTNode *ASTN) {
+    unsigned Index = addNode(ASTN);
 
-    if (If->hasThen()) {
-      Node *Then = rc_recur buildNode(ScopeReachabilityGraph, If->getThen());
-      GNode->addSuccessor(Then);
+    switch (ASTN->getKind()) {
+    case ASTNode::NK_List: {
+      auto *Seq = llvm::cast<SequenceNode>(ASTN);
+
+      unsigned Previous = Index;
+      for (ASTNode *Child : Seq->nodes()) {
+        unsigned ChildIndex = rc_recur buildNode(Child);
+
+        // Create the sibling-to-sibling edge
+        Children[Previous].push_back(ChildIndex);
+
+        // Prepare for the next iteration
+        Previous = ChildIndex;
+      }
+    } break;
+    case ASTNode::NK_Scs: {
+      auto *Scs = llvm::cast<ScsNode>(ASTN);
+
+      if (Scs->hasBody()) {
+        unsigned Body = rc_recur buildNode(Scs->getBody());
+        Children[Index].push_back(Body);
+      }
+    } break;
+    case ASTNode::NK_If: {
+      auto *If = llvm::cast<IfNode>(ASTN);
+
+      if (If->hasThen()) {
+        unsigned Then = rc_recur buildNode(If->getThen());
+        Children[Index].push_back(Then);
+      }
+      if (If->hasElse()) {
+        unsigned Else = rc_recur buildNode(If->getElse());
+        Children[Index].push_back(Else);
+      }
+    } break;
+    case ASTNode::NK_Switch: {
+      auto *Switch = llvm::cast<SwitchNode>(ASTN);
+
+      for (auto &LabelCasePair : Switch->cases_const_range()) {
+        unsigned Case = rc_recur buildNode(LabelCasePair.second);
+        Children[Index].push_back(Case);
+      }
+    } break;
+    case ASTNode::NK_Code:
+    case ASTNode::NK_Continue:
+    case ASTNode::NK_Set:
+    case ASTNode::NK_SwitchBreak:
+    case ASTNode::NK_Break:
+      break;
+    default:
+      revng_unreachable();
     }
-    if (If->hasElse()) {
-      Node *Else = rc_recur buildNode(ScopeReachabilityGraph, If->getElse());
-      GNode->addSuccessor(Else);
+
+    rc_return Index;
+  }
+
+  void computeEulerTour() {
+    // The chains of siblings make the tree as deep as the longest
+    // `SequenceNode`, so we visit it with an explicit stack
+    Depth.assign(Nodes.size(), 0);
+    FirstOccurrence.assign(Nodes.size(), 0);
+    std::vector<unsigned> Tour;
+    Tour.reserve(2 * Nodes.size());
+
+    // Each entry holds a node and the index of the next child to visit
+    llvm::SmallVector<std::pair<unsigned, unsigned>> Stack;
+    Stack.push_back({ 0, 0 });
+    FirstOccurrence[0] = 0;
+    Tour.push_back(0);
+    while (not Stack.empty()) {
+      auto &[Current, NextChild] = Stack.back();
+      if (NextChild == Children[Current].size()) {
+        Stack.pop_back();
+        if (not Stack.empty())
+          Tour.push_back(Stack.back().first);
+        continue;
+      }
+
+      unsigned Child = Children[Current][NextChild++];
+      Depth[Child] = Depth[Current] + 1;
+      FirstOccurrence[Child] = Tour.size();
+      Tour.push_back(Child);
+      Stack.push_back({ Child, 0 });
     }
-  } break;
-  case ASTNode::NK_Switch: {
-    auto *Switch = llvm::cast<SwitchNode>(ASTN);
 
-    for (auto &LabelCasePair : Switch->cases_const_range()) {
-      Node *Case = rc_recur buildNode(ScopeReachabilityGraph,
-                                      LabelCasePair.second);
-      GNode->addSuccessor(Case);
+    // Build the sparse table for the minimum depth queries
+    SparseTable.push_back(std::move(Tour));
+    for (unsigned Level = 1; (1U << Level) <= SparseTable[0].size(); ++Level) {
+      const std::vector<unsigned> &Previous = SparseTable[Level - 1];
+      unsigned Half = 1U << (Level - 1);
+      std::vector<unsigned> Current(SparseTable[0].size() + 1 - (1U << Level));
+      for (unsigned I = 0; I < Current.size(); ++I) {
+        unsigned LHS = Previous[I];
+        unsigned RHS = Previous[I + Half];
+        Current[I] = Depth[LHS] <= Depth[RHS] ? LHS : RHS;
+      }
+      SparseTable.push_back(std::move(Current));
     }
-  } break;
-  case ASTNode::NK_Code:
-  case ASTNode::NK_Continue:
-  case ASTNode::NK_Set:
-  case ASTNode::NK_SwitchBreak:
-  case ASTNode::NK_Break:
-    break;
-  default:
-    revng_unreachable();
   }
+};
 
-  rc_return GNode;
-}
+using InstructionSet = llvm::SmallPtrSet<const llvm::Instruction *, 4>;
 
 /// This helper function can be used to collect all the transitive `User`s
 /// starting from an `llvm::Instruction` and stopping at either: a `CallInst`,
 /// an `Assign` or a terminator
 static RecursiveCoroutine<void>
-collectTransitiveUsers(const llvm::Instruction *I,
-                       llvm::SmallSet<const llvm::Instruction *, 4> &Users) {
+collectTransitiveUsers(const llvm::Instruction *I, InstructionSet &Users) {
 
   // This dataflow visit will stop at certain collection points
   if (isAssignment(I) or isCallToIsolatedFunction(I) or I->isTerminator()) {
@@ -275,11 +363,13 @@ collectTransitiveUsers(const llvm::Instruction *I,
   rc_return;
 }
 
-static llvm::SmallSet<const ASTNode *, 4>
-collectUsageASTNodes(const llvm::Instruction *Variable,
-                     const BBGHASTNodeMap &BBToASTNode) {
+/// Compute the `ASTNode` where \a Variable should be declared, i.e., the lowest
+/// common ancestor in \a Tree of all the `ASTNode`s using it
+static const ASTNode *computeDeclarationNode(const llvm::Instruction *Variable,
+                                             const BBGHASTNodeMap &BBToASTNode,
+                                             const ScopeTree &Tree) {
   // Collect the immediate `User`s of the `Variable`
-  llvm::SmallSet<const llvm::Instruction *, 4> UsageInstructions;
+  InstructionSet UsageInstructions;
   for (const llvm::User *VariableUser : Variable->users()) {
     const llvm::Instruction
       *UserInst = llvm::cast<llvm::Instruction>(VariableUser);
@@ -294,7 +384,7 @@ collectUsageASTNodes(const llvm::Instruction *Variable,
   }
 
   // Collect the transitive `User`s of the already collected `User`s
-  llvm::SmallSet<const llvm::Instruction *, 4> AdditionalUsers;
+  InstructionSet AdditionalUsers;
   for (const llvm::Instruction *UserInst : UsageInstructions) {
     collectTransitiveUsers(UserInst, AdditionalUsers);
   }
@@ -302,9 +392,11 @@ collectUsageASTNodes(const llvm::Instruction *Variable,
   // Merge the obtained results from the transitive `User`s collection
   UsageInstructions.insert(AdditionalUsers.begin(), AdditionalUsers.end());
 
-  // We collect all the AST nodes that are users of the pending variable
-  // we are analyzing
-  llvm::SmallSet<const ASTNode *, 4> UsageASTNodes;
+  // The lowest common ancestor of a set of nodes is the lowest common ancestor
+  // of the first and the last of them in the Euler tour, so we just need to
+  // keep track of those while visiting the `ASTNode`s using the variable
+  unsigned First = std::numeric_limits<unsigned>::max();
+  unsigned Last = 0;
   for (const llvm::Instruction *UserInst : UsageInstructions) {
     const llvm::BasicBlock *UserBB = UserInst->getParent();
 
@@ -312,113 +404,44 @@ collectUsageASTNodes(const llvm::Instruction *Variable,
     // above
     auto Range = BBToASTNode.equal_range(UserBB);
     for (auto RangeIt = Range.first; RangeIt != Range.second; ++RangeIt) {
-      UsageASTNodes.insert(RangeIt->second);
+      unsigned Position = Tree.getTourPosition(RangeIt->second);
+      First = std::min(First, Position);
+      Last = std::max(Last, Position);
     }
   }
 
   // Ensure that we find usages for each `Variable` that we need to assign
-  revng_assert(not UsageASTNodes.empty());
+  revng_assert(First <= Last);
 
-  return UsageASTNodes;
+  return Tree.lowestCommonAncestor(First, Last);
 }
 
-static ScopeReachabilityGraphTy
-makeGHASTReachabilityGraph(const ASTTree &GHAST) {
-  ScopeReachabilityGraphTy ScopeReachabilityGraph;
-  const ASTNode *RootNode = GHAST.getRoot();
-  Node *RootGNode = buildNode(ScopeReachabilityGraph, RootNode);
-  ScopeReachabilityGraph.Graph.setEntryNode(RootGNode);
-
-  return ScopeReachabilityGraph;
-}
+ASTVarDeclMap computeVarDeclMap(const ASTTree &GHAST,
+                                PendingVariableListType &PendingVariables) {
 
-static std::map<const llvm::CallInst *, llvm::SmallSet<const ASTNode *, 4>>
-computeVariableUsages(const ASTTree &GHAST,
-                      PendingVariableListType &PendingVariables) {
+  // 1: build the `ScopeTree` over the GHAST, representing the visibility
+  // between `ASTNode`s.
+  ScopeTree Tree(GHAST);
 
-  // Compute a `BasicBlock * -> GHASTNode *` multimap representing which
+  // 2: compute a `BasicBlock * -> GHASTNode *` multimap representing which
   // `GHASTNode`s covers the usage of a certain `BasicBlock`
   BBToASTNodeMapping Mapping(GHAST);
   const BBGHASTNodeMap &BBToASTNode = Mapping.compute();
 
-  std::map<const llvm::CallInst *, llvm::SmallSet<const ASTNode *, 4>>
-    VariableUsages;
-  for (auto *Variable : PendingVariables) {
-    VariableUsages[Variable] = collectUsageASTNodes(Variable, BBToASTNode);
-  }
-
-  return VariableUsages;
-}
-
-ASTVarDeclMap computeVarDeclMap(const ASTTree &GHAST,
-                                PendingVariableListType &PendingVariables) {
-
-  // 1: build a `GenericGraph` over the GHAST, representing the visibility
-  // graph between `ASTNode`s. In this `GenericGraph`, no `SequenceNode` is
-  // present, but instead each sibling in a `SequenceNode` has, as child, its
-  // immediate successor. This type of view is useful for our analysis.
-  ScopeReachabilityGraphTy
-    ScopeReachabilityGraph = makeGHASTReachabilityGraph(GHAST);
-
-  // 2: we instantiate the dominator tree over the `ScopeReachabilityGraph`. We
-  // will make use of dominance queries as an alternative to performing
-  // reachability queries over the same graph. Indeed, we postulate that they
-  // are equivalent given the AST like structure of `ScopeReachabilityGraph`,
-  // and the fact that the direct successor of each `ASTNode` is a child of it
-  // in this representation.
-  llvm::DominatorTreeBase<Node, false> DT;
-  DT.recalculate(ScopeReachabilityGraph.Graph);
-
-  // 3: pre-compute, for each variable, all the `ASTNode`s that contain an use
-  // of the variable
-  auto VariableUsages = computeVariableUsages(GHAST, PendingVariables);
-
-  // 4: perform the `Variable` assignment operation.
-  // We want to iterate over the nodes of the newly created `GenericGraph`in
-  // post order.
+  // 3: perform the `Variable` assignment operation. A node of the
+  // `ScopeTree` is visible from all of its descendants, so the ALAP position
+  // for the declaration is the lowest common ancestor of all the uses.
   ASTVarDeclMap Result;
-  for (auto *TheNode : llvm::post_order(&ScopeReachabilityGraph.Graph)) {
-
-    // At each iteration, iterate over the list of variables that are still to
-    // assign
-    for (const llvm::CallInst *&Pending : PendingVariables) {
-
-      // We use a `nullptr` in `PendingVariables` as a tombstone to mark the
-      // fact that the variable has already been assigned
-      if (not Pending) {
-        continue;
-      }
-
-      const llvm::SmallSet<const ASTNode *, 4> &UsageASTNodes = VariableUsages
-                                                                  .at(Pending);
-
-      // If, from the current node, we dominate all the `ASTNode`s in
-      // `UsageASTNodes`, we can mark the variable to be emitted in the current
-      // `ASTNode`
-      const auto TheNodeDominatesASTUse = [&](const ASTNode *UsageASTNode) {
-        Node *UsageGraphNode = ScopeReachabilityGraph.ASTToNodeMap
-                                 .at(UsageASTNode);
-        return DT.dominates(TheNode, UsageGraphNode);
-      };
-      bool AllUsesDominated = llvm::all_of(UsageASTNodes,
-                                           TheNodeDominatesASTUse);
-
-      // If we the current TheNode dominates all the uses of the `Variable`,
-      // we mark the current node as the place where to emit the variable
-      // declaration
-      if (AllUsesDominated) {
-        Result[TheNode->getASTNode()].insert(Pending);
-        Pending = nullptr;
-      }
-    }
+  for (const llvm::CallInst *&Pending : PendingVariables) {
+    const ASTNode *DeclNode = computeDeclarationNode(Pending,
+                                                     BBToASTNode,
+                                                     Tree);
+    Result[DeclNode].insert(Pending);
+
+    // We use a `nullptr` in `PendingVariables` as a tombstone to mark the
+    // fact that the variable has already been assigned
+    Pending = nullptr;
   }
 
-  // At the end of the processing, we should have assigned all the pending
-  // variables
-  const auto IsNullPtr = [](const llvm::CallInst *Variable) {
-    return not Variable;
-  };
-  revng_assert(llvm::all_of(PendingVariables, IsNullPtr));
-
   return Result;
 }
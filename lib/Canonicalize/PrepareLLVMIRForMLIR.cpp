@@ -224,8 +224,7 @@ static void tagFunction(Function &F) {
     &FunctionTags::Root,
     &FunctionTags::IsolatedRoot,
     &FunctionTags::Marker,
-    &FunctionTags::FunctionDispatcher,
-    &FunctionTags::StackOffsetMarker
+    &FunctionTags::FunctionDispatcher
   };
 
   static const FunctionTags::TagsSet IgnoredTags = {
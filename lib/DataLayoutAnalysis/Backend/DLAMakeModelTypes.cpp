@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <cstdint>
 #include <limits>
+#include <utility>
 #include <variant>
 
 #include "llvm/ADT/PostOrderIterator.h"
@@ -16,6 +17,7 @@
 #include "revng/ADT/FilteredGraphTraits.h"
 #include "revng/Model/Binary.h"
 #include "revng/Model/Type.h"
+#include "revng/Model/VerifyHelper.h"
 #include "revng/Support/Assert.h"
 #include "revng/Support/Debug.h"
 
@@ -34,7 +36,16 @@ using LTSN = LayoutTypeSystemNode;
 using ConstNonPointerFilterT = EdgeFilteredGraph<const LTSN *,
                                                  isNotPointerEdge>;
 
-using TypeVect = std::vector<std::optional<model::QualifiedType>>;
+/// A model type generated for the DLA, along with its size.
+// The size is tracked separately because new types are staged in a
+// NewTypesBuffer until the end of makeModelTypes, so they cannot be looked up
+// in the model to compute it.
+struct NodeType {
+  QualifiedType Type;
+  uint64_t Size;
+};
+
+using TypeVect = std::vector<std::optional<NodeType>>;
 
 using model::Qualifier;
 using model::PrimitiveTypeKind::Generic;
@@ -46,25 +57,72 @@ using model::QualifierKind::Pointer;
 using PtrFieldsMap = std::map<const LTSN *,
                               llvm::SmallPtrSet<QualifiedType *, 8>>;
 
+/// Holds the types created by makeModelTypes until they are all inserted in
+/// the model at once.
+// Recording each type in the model as soon as it's created costs a shift of
+// the sorted Model->Types() for each of them. Types are heap-allocated, so
+// pointers to them and to their fields stay valid across the commit.
+class NewTypesBuffer {
+private:
+  TupleTree<model::Binary> &Model;
+  std::vector<UpcastablePointer<model::Type>> Types;
+
+public:
+  NewTypesBuffer(TupleTree<model::Binary> &Model) : Model(Model) {}
+
+  ~NewTypesBuffer() { revng_assert(Types.empty()); }
+
+public:
+  /// Create a new type, and the path it will have once committed.
+  template<typename T>
+  std::pair<T *, TypePath> make() {
+    auto &NewType = Types.emplace_back(makeType<T>());
+    auto *Result = llvm::cast<T>(NewType.get());
+    return { Result, Model->getTypePath(Result) };
+  }
+
+  /// Insert all the new types in the model, and record them in \a Changes.
+  void commit(ModelChanges &Changes) {
+    revng_log(Log, "Committing " << Types.size() << " new types");
+    {
+      auto Inserter = Model->Types().batch_insert();
+      for (UpcastablePointer<model::Type> &NewType : Types) {
+        Changes.Types.insert(NewType.get());
+        Inserter.insert(std::move(NewType));
+      }
+    }
+    Types.clear();
+  }
+};
+
+/// Whether \a T is a pointer, looking only at its qualifiers.
+// Unlike QualifiedType::isPointer this never resolves the unqualified type,
+// which might still be staged. The types built here have no const qualifiers
+// and no typedefs, so the outermost qualifier is all that matters.
+static bool hasPointerQualifier(const QualifiedType &T) {
+  return not T.Qualifiers().empty()
+         and Qualifier::isPointer(T.Qualifiers().front());
+}
+
 /// Create a single-field struct to wrap a given type
-static QualifiedType createStructWrapper(const LTSN *N,
-                                         const QualifiedType &T,
-                                         PtrFieldsMap &PointerFieldsToUpdate,
-                                         TupleTree<model::Binary> &Model,
-                                         uint64_t Offset = 0ULL,
-                                         uint64_t WrapperSize = 0ULL) {
+static std::pair<model::StructType *, NodeType>
+createStructWrapper(const LTSN *N,
+                    const NodeType &T,
+                    PtrFieldsMap &PointerFieldsToUpdate,
+                    NewTypesBuffer &NewTypes,
+                    uint64_t Offset = 0ULL,
+                    uint64_t WrapperSize = 0ULL) {
   // Create struct
-  TypePath StructPath = Model->recordNewType(makeType<model::StructType>());
-  auto *Struct = llvm::cast<model::StructType>(StructPath.get());
+  auto [Struct, StructPath] = NewTypes.make<model::StructType>();
 
   // Create and insert field in struct
-  StructField Field{ Offset, {}, {}, {}, T };
+  StructField Field{ Offset, {}, {}, {}, T.Type };
   const auto &[FieldIt, Inserted] = Struct->Fields().insert(Field);
   revng_assert(Inserted);
 
   // If the field has pointer type, save the corresponding qualified type for
   // updating it later
-  if (T.isPointer()) {
+  if (hasPointerQualifier(T.Type)) {
     bool New = PointerFieldsToUpdate[N].insert(&FieldIt->Type()).second;
     revng_assert(New);
     revng_log(Log,
@@ -83,18 +141,18 @@ static QualifiedType createStructWrapper(const LTSN *N,
   // If WrapperSize == 0ULL we use the size of T to set the size of the
   // generated wrapper struct, otherwise we take WrapperSize, but in that case
   // it must be larger or equal than T.size() + Offset;
-  Struct->Size() = WrapperSize ? WrapperSize : (Offset + *T.size());
+  Struct->Size() = WrapperSize ? WrapperSize : (Offset + T.Size);
 
-  revng_assert(Struct->Size() and T.size().has_value()
-               and Struct->Size() >= (T.size().value() + Offset));
-  return QualifiedType{ StructPath, {} };
+  revng_assert(Struct->Size() and T.Size
+               and Struct->Size() >= (T.Size + Offset));
+  NodeType Result{ QualifiedType{ StructPath, {} }, Struct->Size() };
+  return { Struct, std::move(Result) };
 }
 
 /// Retrieve the model type associated to TypeSystem \a Node, if any
-static const QualifiedType &getNodeType(TupleTree<model::Binary> &Model,
-                                        const LTSN *Node,
-                                        const TypeVect &Types,
-                                        const VectEqClasses &EqClasses) {
+static const NodeType &getNodeType(const LTSN *Node,
+                                   const TypeVect &Types,
+                                   const VectEqClasses &EqClasses) {
   auto TypeIndex = EqClasses.getEqClassID(Node->ID);
   revng_assert(TypeIndex.has_value());
   auto &MaybeResult = Types[TypeIndex.value()];
@@ -104,13 +162,13 @@ static const QualifiedType &getNodeType(TupleTree<model::Binary> &Model,
 
 /// Generate a qualified type from an offset expression, generating also
 /// intermediate array wrappers if needed
-static QualifiedType
+static NodeType
 makeInstanceQualifiedType(const LTSN *N,
-                          const QualifiedType &Inner,
+                          const NodeType &Inner,
                           const OffsetExpression &OE,
                           PtrFieldsMap &PointerFieldsToUpdate,
-                          TupleTree<model::Binary> &Model) {
-  QualifiedType Result = Inner;
+                          NewTypesBuffer &NewTypes) {
+  NodeType Result = Inner;
   revng_assert(OE.Strides.size() == OE.TripCounts.size());
   if (OE.Strides.empty())
     return Result;
@@ -122,7 +180,7 @@ makeInstanceQualifiedType(const LTSN *N,
   uint64_t PrevStride = 0ULL;
   for (const auto &[TC, Stride] : NestedArrayLevels) {
     revng_log(Log, "Stride " << Stride << "  Trip Count " << (TC ? *TC : 0U));
-    auto InnerSize = Result.size().value();
+    auto InnerSize = Result.Size;
     revng_assert(not PrevStride or PrevStride < Stride);
     revng_assert(Stride >= 0);
     uint64_t UStride = static_cast<uint64_t>(Stride);
@@ -140,36 +198,36 @@ makeInstanceQualifiedType(const LTSN *N,
       revng_log(Log, "Creating wrapper");
       // Create a wrapper to hold each element (a part from the last one)
       // together with its trailing padding
-      QualifiedType ElemWrapper = createStructWrapper(N,
-                                                      Result,
-                                                      PointerFieldsToUpdate,
-                                                      Model,
-                                                      /*offset*/ 0,
-                                                      /*size*/ UStride);
+      NodeType ElemWrapper = createStructWrapper(N,
+                                                 Result,
+                                                 PointerFieldsToUpdate,
+                                                 NewTypes,
+                                                 /*offset*/ 0,
+                                                 /*size*/ UStride)
+                               .second;
       // Now make this an array.
-      revng_assert(ElemWrapper.Qualifiers().empty());
-      ElemWrapper.Qualifiers().push_back({ Array, (NumElems - 1) });
+      revng_assert(ElemWrapper.Type.Qualifiers().empty());
+      ElemWrapper.Type.Qualifiers().push_back({ Array, (NumElems - 1) });
+      ElemWrapper.Size = UStride * (NumElems - 1);
 
       const uint64_t LastElemOffset = UStride * (NumElems - 1);
       const uint64_t ArrayWrapperSize = LastElemOffset + InnerSize;
 
       // Create a wrapper to hold the array + the last element, which does not
       // need trailing padding.
-      QualifiedType
-        ArrayWrapper = createStructWrapper(N,
-                                           ElemWrapper,
-                                           PointerFieldsToUpdate,
-                                           Model,
-                                           /*offset*/ 0,
-                                           /*size*/ ArrayWrapperSize);
+      auto [WrapperStruct,
+            ArrayWrapper] = createStructWrapper(N,
+                                                ElemWrapper,
+                                                PointerFieldsToUpdate,
+                                                NewTypes,
+                                                /*offset*/ 0,
+                                                /*size*/ ArrayWrapperSize);
 
       // Insert the last element
-      revng_assert(ArrayWrapper.Qualifiers().empty());
-      auto *UnqualifiedWrapper = ArrayWrapper.UnqualifiedType().get();
-      auto *WrapperStruct = llvm::cast<model::StructType>(UnqualifiedWrapper);
+      revng_assert(ArrayWrapper.Type.Qualifiers().empty());
 
       // Insert the rest of the array
-      StructField TrailingElem{ LastElemOffset, {}, {}, {}, Result };
+      StructField TrailingElem{ LastElemOffset, {}, {}, {}, Result.Type };
       WrapperStruct->Fields().insert(TrailingElem);
       WrapperStruct->Size() = ArrayWrapperSize;
 
@@ -177,7 +235,8 @@ makeInstanceQualifiedType(const LTSN *N,
     } else {
       revng_log(Log, "Adding array qualifier with no wrappers");
 
-      Result.Qualifiers().push_back({ Array, NumElems });
+      Result.Type.Qualifiers().push_back({ Array, NumElems });
+      Result.Size = InnerSize * NumElems;
     }
   }
 
@@ -186,16 +245,15 @@ makeInstanceQualifiedType(const LTSN *N,
 
 /// Create a struct type from a TypeSystem node. For pointer members,
 /// only populate the field's qualifiers and omit the type for now.
-static QualifiedType makeStructFromNode(const LTSN *N,
-                                        TypeVect &Types,
-                                        PtrFieldsMap &PointerFieldsToUpdate,
-                                        TupleTree<model::Binary> &Model,
-                                        const VectEqClasses &EqClasses) {
+static NodeType makeStructFromNode(const LTSN *N,
+                                   TypeVect &Types,
+                                   PtrFieldsMap &PointerFieldsToUpdate,
+                                   NewTypesBuffer &NewTypes,
+                                   const VectEqClasses &EqClasses) {
   // Create struct
   revng_log(Log, "Creating struct type for node " << N->ID);
   LoggerIndent StructIndent{ Log };
-  TypePath StructPath = Model->recordNewType(makeType<model::StructType>());
-  auto *Struct = llvm::cast<model::StructType>(StructPath.get());
+  auto [Struct, StructPath] = NewTypes.make<model::StructType>();
   Struct->Size() = N->Size;
 
   // This holds the struct fields in the same order as in the model, so we can
@@ -208,19 +266,19 @@ static QualifiedType makeStructFromNode(const LTSN *N,
   for (auto &[SuccNode, SuccEdge] : N->Successors) {
     revng_log(Log, "Child " << SuccNode->ID);
 
-    QualifiedType FieldType = getNodeType(Model, SuccNode, Types, EqClasses);
+    const NodeType &SuccType = getNodeType(SuccNode, Types, EqClasses);
 
     revng_assert(TypeLinkTag::LK_Instance == SuccEdge->getKind());
     const OffsetExpression &OE = SuccEdge->getOffsetExpr();
     revng_assert(OE.Offset >= 0U);
     uint64_t FieldOffset = OE.Offset;
-    FieldType = makeInstanceQualifiedType(SuccNode,
-                                          FieldType,
-                                          OE,
-                                          PointerFieldsToUpdate,
-                                          Model);
+    NodeType FieldType = makeInstanceQualifiedType(SuccNode,
+                                                   SuccType,
+                                                   OE,
+                                                   PointerFieldsToUpdate,
+                                                   NewTypes);
 
-    StructField Field{ FieldOffset, {}, {}, {}, FieldType };
+    StructField Field{ FieldOffset, {}, {}, {}, FieldType.Type };
     bool Inserted = Fields.insert({ std::move(Field), SuccNode }).second;
     revng_assert(Inserted);
   }
@@ -234,7 +292,7 @@ static QualifiedType makeStructFromNode(const LTSN *N,
     revng_assert(Inserted);
 
     // If the field is a pointer, save the corresponding qualified type
-    if (FieldIt->Type().isPointer()) {
+    if (hasPointerQualifier(FieldIt->Type())) {
       bool
         New = PointerFieldsToUpdate[SuccNode].insert(&FieldIt->Type()).second;
       revng_assert(New);
@@ -252,22 +310,24 @@ static QualifiedType makeStructFromNode(const LTSN *N,
     }
   }
 
-  return QualifiedType{ StructPath, {} };
+  return NodeType{ QualifiedType{ StructPath, {} }, N->Size };
 }
 
 /// Create a union type from a TypeSystem node. For pointer members,
 /// only populate the field's qualifiers.
-static QualifiedType makeUnionFromNode(const LTSN *N,
-                                       TypeVect &Types,
-                                       PtrFieldsMap &PointerFieldsToUpdate,
-                                       TupleTree<model::Binary> &Model,
-                                       const VectEqClasses &EqClasses) {
+static NodeType makeUnionFromNode(const LTSN *N,
+                                  TypeVect &Types,
+                                  PtrFieldsMap &PointerFieldsToUpdate,
+                                  NewTypesBuffer &NewTypes,
+                                  const VectEqClasses &EqClasses) {
   // Create union
   revng_log(Log, "Creating union type for node " << N->ID);
-  TypePath UnionPath = Model->recordNewType(makeType<model::UnionType>());
-  auto *Union = llvm::cast<model::UnionType>(UnionPath.get());
+  auto [Union, UnionPath] = NewTypes.make<model::UnionType>();
   LoggerIndent StructIndent{ Log };
 
+  // The size of a union is the size of its largest field.
+  uint64_t UnionSize = 0ULL;
+
   // This holds the union fields in the same order as in the model, so we can
   // later insert them in the model already in order, without invalidating
   // iterators, so we can take their address in case they are pointers that need
@@ -278,27 +338,30 @@ static QualifiedType makeUnionFromNode(const LTSN *N,
     auto &[SuccNode, SuccEdge] = Group.value();
     revng_log(Log, "Child " << SuccNode->ID);
 
-    QualifiedType FieldType = getNodeType(Model, SuccNode, Types, EqClasses);
+    const NodeType &SuccType = getNodeType(SuccNode, Types, EqClasses);
 
     revng_assert(TypeLinkTag::LK_Instance == SuccEdge->getKind());
     const OffsetExpression &OE = SuccEdge->getOffsetExpr();
     revng_assert(OE.Offset >= 0U);
     uint64_t FieldOffset = OE.Offset;
-    FieldType = makeInstanceQualifiedType(SuccNode,
-                                          FieldType,
-                                          OE,
-                                          PointerFieldsToUpdate,
-                                          Model);
+    NodeType FieldType = makeInstanceQualifiedType(SuccNode,
+                                                   SuccType,
+                                                   OE,
+                                                   PointerFieldsToUpdate,
+                                                   NewTypes);
 
     if (FieldOffset)
       FieldType = createStructWrapper(SuccNode,
                                       FieldType,
                                       PointerFieldsToUpdate,
-                                      Model,
-                                      FieldOffset);
+                                      NewTypes,
+                                      FieldOffset)
+                    .second;
+
+    UnionSize = std::max(UnionSize, FieldType.Size);
 
     auto FieldIndex = Group.index();
-    UnionField Field{ FieldIndex, {}, {}, {}, FieldType };
+    UnionField Field{ FieldIndex, {}, {}, {}, FieldType.Type };
     bool Inserted = Fields.insert({ std::move(Field), SuccNode }).second;
     revng_assert(Inserted);
   }
@@ -313,7 +376,7 @@ static QualifiedType makeUnionFromNode(const LTSN *N,
     revng_assert(Inserted);
 
     // If the field is a pointer, save the corresponding qualified type
-    if (FieldIt->Type().isPointer()) {
+    if (hasPointerQualifier(FieldIt->Type())) {
       bool
         New = PointerFieldsToUpdate[SuccNode].insert(&FieldIt->Type()).second;
       revng_assert(New);
@@ -331,14 +394,15 @@ static QualifiedType makeUnionFromNode(const LTSN *N,
     }
   }
 
-  return QualifiedType{ UnionPath, {} };
+  return NodeType{ QualifiedType{ UnionPath, {} }, UnionSize };
 }
 
-static QualifiedType &createNodeType(TupleTree<model::Binary> &Model,
-                                     const LTSN *Node,
-                                     TypeVect &Types,
-                                     const VectEqClasses &EqClasses,
-                                     PtrFieldsMap &PointerFieldsToUpdate) {
+static NodeType &createNodeType(TupleTree<model::Binary> &Model,
+                                NewTypesBuffer &NewTypes,
+                                const LTSN *Node,
+                                TypeVect &Types,
+                                const VectEqClasses &EqClasses,
+                                PtrFieldsMap &PointerFieldsToUpdate) {
 
   auto TypeIndex = EqClasses.getEqClassID(Node->ID);
   revng_assert(TypeIndex.has_value());
@@ -351,16 +415,18 @@ static QualifiedType &createNodeType(TupleTree<model::Binary> &Model,
     // later, to point to the correct type instead of void.
     // This dance is necessary since there's no way to guarantee that the
     // pointee have been visited when we're looking at the pointer.
-    MaybeResult = QualifiedType{
-      Model->getPrimitiveType(model::PrimitiveTypeKind::Void, 0),
-      { Qualifier::createPointer(Model->Architecture()) }
+    auto Architecture = Model->Architecture();
+    MaybeResult = NodeType{
+      QualifiedType{ Model->getPrimitiveType(model::PrimitiveTypeKind::Void, 0),
+                     { Qualifier::createPointer(Architecture) } },
+      model::Architecture::getPointerSize(Architecture)
     };
 
-    if (MaybeResult.value().isPointer()) {
-      PointerFieldsToUpdate[Node].insert(&MaybeResult.value());
+    if (hasPointerQualifier(MaybeResult.value().Type)) {
+      PointerFieldsToUpdate[Node].insert(&MaybeResult.value().Type);
       revng_log(Log,
                 "Found root pointer node " << Node->ID << " at address "
-                                           << &MaybeResult.value());
+                                           << &MaybeResult.value().Type);
     }
 
   } else if (isLeaf(Node)) {
@@ -369,7 +435,7 @@ static QualifiedType &createNodeType(TupleTree<model::Binary> &Model,
       MaybeResult = makeStructFromNode(Node,
                                        Types,
                                        PointerFieldsToUpdate,
-                                       Model,
+                                       NewTypes,
                                        EqClasses);
     } else {
       const auto &IsValidPrimitiveSize = [](uint64_t Size) {
@@ -380,14 +446,15 @@ static QualifiedType &createNodeType(TupleTree<model::Binary> &Model,
       };
 
       if (IsValidPrimitiveSize(Node->Size)) {
-        MaybeResult = QualifiedType{
-          Model->getPrimitiveType(Generic, Node->Size), {}
+        MaybeResult = NodeType{
+          QualifiedType{ Model->getPrimitiveType(Generic, Node->Size), {} },
+          Node->Size
         };
       } else {
         MaybeResult = makeStructFromNode(Node,
                                          Types,
                                          PointerFieldsToUpdate,
-                                         Model,
+                                         NewTypes,
                                          EqClasses);
       }
     }
@@ -395,13 +462,13 @@ static QualifiedType &createNodeType(TupleTree<model::Binary> &Model,
     MaybeResult = makeStructFromNode(Node,
                                      Types,
                                      PointerFieldsToUpdate,
-                                     Model,
+                                     NewTypes,
                                      EqClasses);
   } else if (isUnionNode(Node)) {
     MaybeResult = makeUnionFromNode(Node,
                                     Types,
                                     PointerFieldsToUpdate,
-                                    Model,
+                                    NewTypes,
                                     EqClasses);
   } else {
     revng_abort("Illegal DLA node encountered when generating model "
@@ -481,7 +548,7 @@ static TypeMapT mapLLVMValuesToModelTypes(const LayoutTypeSystem &TS,
     auto TypeIdx = EqClasses.getEqClassID(ValueIdx);
     revng_assert(TypeIdx.has_value());
 
-    auto &T = Types[TypeIdx.value()].value();
+    auto &T = Types[TypeIdx.value()].value().Type;
     if (TypeMapLog.isEnabled()) {
       std::string S;
       llvm::raw_string_ostream OS{ S };
@@ -499,13 +566,15 @@ static TypeMapT mapLLVMValuesToModelTypes(const LayoutTypeSystem &TS,
 
 TypeMapT dla::makeModelTypes(const LayoutTypeSystem &TS,
                              const LayoutTypePtrVect &Values,
-                             TupleTree<model::Binary> &Model) {
+                             TupleTree<model::Binary> &Model,
+                             ModelChanges &Changes) {
   logEntry(TS, Model);
 
   const dla::VectEqClasses &EqClasses = TS.getEqClasses();
   TypeVect Types;
   Types.resize(EqClasses.getNumClasses());
   PtrFieldsMap PointerFieldsToUpdate;
+  NewTypesBuffer NewTypes(Model);
 
   // Create nodes for anything that is not a pointer
   llvm::SmallPtrSet<const LTSN *, 16> Visited;
@@ -519,16 +588,17 @@ TypeMapT dla::makeModelTypes(const LayoutTypeSystem &TS,
       if (bool New = Visited.insert(N).second; not New)
         continue;
 
-      QualifiedType &T = createNodeType(Model,
-                                        N,
-                                        Types,
-                                        EqClasses,
-                                        PointerFieldsToUpdate);
+      NodeType &T = createNodeType(Model,
+                                   NewTypes,
+                                   N,
+                                   Types,
+                                   EqClasses,
+                                   PointerFieldsToUpdate);
 
       if (Log.isEnabled()) {
         std::string S;
         llvm::raw_string_ostream OS{ S };
-        serialize(OS, T);
+        serialize(OS, T.Type);
         OS.flush();
         revng_log(Log,
                   "Assigned type " << S << " to index "
@@ -554,7 +624,8 @@ TypeMapT dla::makeModelTypes(const LayoutTypeSystem &TS,
                 PointeeNode] = getNumPointersAndPointee(PointerNode);
     revng_log(Log, "NumPointers: " << NumPointers);
 
-    auto FinalPointeeType = getNodeType(Model, PointeeNode, Types, EqClasses);
+    const auto &FinalPointeeType = getNodeType(PointeeNode, Types, EqClasses)
+                                     .Type;
     revng_assert(FinalPointeeType.Qualifiers().empty());
 
     if (Log.isEnabled()) {
@@ -598,7 +669,26 @@ TypeMapT dla::makeModelTypes(const LayoutTypeSystem &TS,
     }
   }
 
+  // All the pointers have been fixed up, the new types can go in the model.
+  NewTypes.commit(Changes);
+
   logExit(TS, Model);
 
   return mapLLVMValuesToModelTypes(TS, Values, Types);
 }
+
+bool dla::ModelChanges::verify(bool Assert) const {
+  // Share a single VerifyHelper, so that types reachable from more than one of
+  // the changed entities are verified only once.
+  model::VerifyHelper VH(Assert);
+
+  for (const model::Type *T : Types)
+    if (not T->verify(VH))
+      return false;
+
+  for (const model::Function *F : Functions)
+    if (not F->verify(VH))
+      return false;
+
+  return true;
+}
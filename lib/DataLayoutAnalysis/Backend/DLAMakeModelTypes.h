@@ -4,6 +4,8 @@
 // This file is distributed under the MIT License. See LICENSE.mit for details.
 //
 
+#include "llvm/ADT/DenseSet.h"
+
 #include "revng/EarlyFunctionAnalysis/FunctionMetadataCache.h"
 #include "revng/Model/Binary.h"
 #include "revng/Model/Type.h"
@@ -15,23 +17,40 @@ using TypeMapT = std::map<dla::LayoutTypePtr, model::QualifiedType>;
 
 namespace dla {
 
+/// The types and functions of the model that the DLA backend has created or
+/// modified.
+// These are the only parts of the model that can be broken by the backend, so
+// they are all we need to verify after it has run.
+struct ModelChanges {
+  llvm::DenseSet<const model::Type *> Types;
+  llvm::DenseSet<const model::Function *> Functions;
+
+  /// Verify the changed types and functions, and everything they reference.
+  bool verify(bool Assert = false) const;
+};
+
 /// Generate model types from a LayoutTypeSystem graph.
 ///\return A vector of model Types where each position corresponds to the
 /// equivalence class of the LayoutTypeSystemNode that generated the type.
+// All the new types are inserted in the model in a single batch, and recorded
+// in \a Changes.
 TypeMapT makeModelTypes(const LayoutTypeSystem &TS,
                         const LayoutTypePtrVect &Values,
-                        TupleTree<model::Binary> &Model);
+                        TupleTree<model::Binary> &Model,
+                        ModelChanges &Changes);
 
 /// Attach model types to function arguments and return values.
 /// Whether there was anything to update in the model.
 bool updateFuncSignatures(const llvm::Module &M,
                           TupleTree<model::Binary> &Model,
                           const TypeMapT &TypeMap,
-                          FunctionMetadataCache &Cache);
+                          FunctionMetadataCache &Cache,
+                          ModelChanges &Changes);
 
 /// Attach model types to segments and update the model.
 bool updateSegmentsTypes(const llvm::Module &M,
                          TupleTree<model::Binary> &Model,
-                         const TypeMapT &TypeMap);
+                         const TypeMapT &TypeMap,
+                         ModelChanges &Changes);
 
 } // end namespace dla
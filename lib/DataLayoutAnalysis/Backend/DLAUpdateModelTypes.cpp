@@ -498,7 +498,6 @@ fillStructWithRecoveredDLATypeAtOffset(model::Binary &Model,
 
     revng_log(Log, "Updated field StructType: " << TargetFieldStruct->ID());
     revng_assert(*TargetFieldStruct->size() == OldFieldSize);
-    revng_assert(TargetFieldStruct->verify());
 
     rc_return;
   }
@@ -584,7 +583,6 @@ fillStructWithRecoveredDLATypeAtOffset(model::Binary &Model,
 
           revng_log(Log, "Updated field StructType: " << OldFieldStruct->ID());
           revng_assert(*OldFieldStruct->size() == OldFieldSize);
-          revng_assert(OldFieldStruct->verify());
         }
       }
       ++NewFieldsIt;
@@ -613,8 +611,6 @@ fillStructWithRecoveredDLATypeAtOffset(model::Binary &Model,
       auto It = NewU->Fields().begin();
       auto End = NewU->Fields().end();
       for (; It != End; ++It) {
-        revng_assert(It->verify());
-        revng_assert(It->Type().verify());
         if (IsTooLarge(*It))
           FieldsToDrop.insert(It->Index());
       }
@@ -639,7 +635,6 @@ fillStructWithRecoveredDLATypeAtOffset(model::Binary &Model,
           Group.value().Index() = Group.index();
 
         revng_assert(NewU->Fields().size() == FieldsRemaining);
-        revng_assert(NewU->verify());
       }
     }
 
@@ -657,7 +652,8 @@ fillStructWithRecoveredDLATypeAtOffset(model::Binary &Model,
 static bool updateStackFrameType(model::Function &ModelFunc,
                                  const llvm::Function &LLVMFunc,
                                  const TypeMapT &DLATypes,
-                                 model::Binary &Model) {
+                                 model::Binary &Model,
+                                 ModelChanges &Changes) {
   bool Updated = false;
 
   if (ModelFunc.StackFrameType().empty())
@@ -701,7 +697,7 @@ static bool updateStackFrameType(model::Function &ModelFunc,
                   << ModelFunc.StackFrameType().get()->ID());
       revng_assert(isa<model::StructType>(ModelFunc.StackFrameType().get()));
       revng_assert(*ModelFunc.StackFrameType().get()->size() == OldStackSize);
-      revng_assert(ModelFunc.StackFrameType().get()->verify());
+      Changes.Types.insert(OldStackFrameStruct);
 
       Updated = true;
     }
@@ -713,7 +709,8 @@ static bool updateStackFrameType(model::Function &ModelFunc,
 bool dla::updateFuncSignatures(const llvm::Module &M,
                                TupleTree<model::Binary> &Model,
                                const TypeMapT &TypeMap,
-                               FunctionMetadataCache &Cache) {
+                               FunctionMetadataCache &Cache,
+                               ModelChanges &Changes) {
   if (ModelLog.isEnabled())
     writeToFile(Model->toString(), "model-before-func-update.yaml");
   if (VerifyLog.isEnabled())
@@ -734,8 +731,20 @@ bool dla::updateFuncSignatures(const llvm::Module &M,
     revng_log(Log,
               "Updating prototype of function "
                 << LLVMFunc.getNameOrAsOperand());
-    Updated |= updatePrototype(*Model, ModelPrototype, &LLVMFunc, TypeMap);
-    Updated |= updateStackFrameType(*ModelFunc, LLVMFunc, TypeMap, *Model);
+    bool FunctionUpdated = false;
+    if (updatePrototype(*Model, ModelPrototype, &LLVMFunc, TypeMap)) {
+      Changes.Types.insert(ModelPrototype);
+      FunctionUpdated = true;
+    }
+    FunctionUpdated |= updateStackFrameType(*ModelFunc,
+                                            LLVMFunc,
+                                            TypeMap,
+                                            *Model,
+                                            Changes);
+    if (FunctionUpdated) {
+      Changes.Functions.insert(ModelFunc);
+      Updated = true;
+    }
 
     // Update prototypes associated to indirect calls, if any are found
     for (const auto &Inst : LLVMFunc)
@@ -745,7 +754,10 @@ bool dla::updateFuncSignatures(const llvm::Module &M,
           revng_log(Log,
                     "Updating prototype of indirect call "
                       << I->getNameOrAsOperand());
-          Updated |= updatePrototype(*Model, Prototype.get(), I, TypeMap);
+          if (updatePrototype(*Model, Prototype.get(), I, TypeMap)) {
+            Changes.Types.insert(Prototype.get());
+            Updated = true;
+          }
         }
       }
   }
@@ -760,12 +772,13 @@ bool dla::updateFuncSignatures(const llvm::Module &M,
 
 bool dla::updateSegmentsTypes(const llvm::Module &M,
                               TupleTree<model::Binary> &Model,
-                              const TypeMapT &TypeMap) {
+                              const TypeMapT &TypeMap,
+                              ModelChanges &Changes) {
   bool Updated = false;
 
   for (const auto &F : FunctionTags::SegmentRef.functions(&M)) {
     const auto &[StartAddress, VirtualSize] = extractSegmentKeyFromMetadata(F);
-    auto Segment = Model->Segments().at({ StartAddress, VirtualSize });
+    auto &Segment = Model->Segments().at({ StartAddress, VirtualSize });
 
     // If the Segment type is missing, we have nothing to update.
     if (Segment.Type().empty())
@@ -789,7 +802,7 @@ bool dla::updateSegmentsTypes(const llvm::Module &M,
       revng_log(Log, "Updated segment StructType: " << NewSegmentType->ID());
       revng_assert(isa<model::StructType>(NewSegmentType));
       revng_assert(*NewSegmentType->size() == SegmentStructSize);
-      revng_assert(NewSegmentType->verify());
+      Changes.Types.insert(NewSegmentType);
 
       Updated = true;
     }
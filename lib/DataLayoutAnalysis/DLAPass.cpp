@@ -2,6 +2,10 @@
 // This file is distributed under the MIT License. See LICENSE.mit for details.
 //
 
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Threading.h"
+
 #include "revng/Model/LoadModelPass.h"
 #include "revng/Model/VerifyHelper.h"
 #include "revng/Pipeline/Context.h"
@@ -22,6 +26,23 @@ char DLAPass::ID = 0;
 
 static Logger<> BuilderLog("dla-builder-log");
 
+using namespace llvm::cl;
+
+static opt<unsigned> MiddleendThreads("dla-threads",
+                                      desc("Number of threads used to run the "
+                                           "DLA middle-end on independent "
+                                           "components of the type system. 0 "
+                                           "means one per hardware thread."),
+                                      Hidden,
+                                      init(0));
+
+static opt<std::string> StatisticsPath("dla-statistics",
+                                       desc("Write statistics about each Step "
+                                            "of the DLA middle-end to this "
+                                            "file, in JSON"),
+                                       value_desc("filename"),
+                                       Hidden);
+
 using Register = llvm::RegisterPass<DLAPass>;
 static ::Register X("dla", "Data Layout Analysis Pass", false, false);
 
@@ -54,57 +75,14 @@ bool DLAPass::runOnModule(llvm::Module &M) {
   // Middle-end Steps: manipulate nodes and edges of the DLATypeSystem graph
   T.advance("DLA Middleend");
   dla::StepManager SM;
-  size_t PtrSize = getPointerSize(Model.Architecture());
-
-  //
-  // Graph normalization phase
-  //
-  revng_check(SM.addStep<dla::RemoveInvalidPointers>(PtrSize));
-  revng_check(SM.addStep<dla::CollapseEqualitySCC>());
-  revng_check(SM.addStep<dla::CollapseInstanceAtOffset0SCC>());
-  revng_check(SM.addStep<dla::SimplifyInstanceAtOffset0>());
-  revng_check(SM.addStep<dla::PruneLayoutNodesWithoutLayout>());
-  revng_check(SM.addStep<dla::ComputeUpperMemberAccesses>());
-  revng_check(SM.addStep<dla::RemoveInvalidStrideEdges>());
-  revng_check(SM.addStep<dla::PruneLayoutNodesWithoutLayout>());
-  revng_check(SM.addStep<dla::ComputeUpperMemberAccesses>());
-  revng_check(SM.addStep<dla::DecomposeStridedEdges>());
-
-  //
-  // Graph optimization phase
-  //
-  revng_check(SM.addStep<dla::CollapseSingleChild>());
-  revng_check(SM.addStep<dla::DeduplicateFields>());
-  revng_check(SM.addStep<dla::MergePointeesOfPointerUnion>(PtrSize));
-  revng_check(SM.addStep<dla::MergePointerNodes>());
-  revng_check(SM.addStep<dla::CollapseInstanceAtOffset0SCC>());
-  revng_check(SM.addStep<dla::SimplifyInstanceAtOffset0>());
-  revng_check(SM.addStep<dla::PruneLayoutNodesWithoutLayout>());
-  revng_check(SM.addStep<dla::ComputeUpperMemberAccesses>());
-  revng_check(SM.addStep<dla::RemoveInvalidStrideEdges>());
-  revng_check(SM.addStep<dla::PruneLayoutNodesWithoutLayout>());
-  revng_check(SM.addStep<dla::ComputeUpperMemberAccesses>());
-
-  revng_check(SM.addStep<dla::MergePointerNodes>());
-  // CollapseSingleChild and DeduplicateFields run before
-  // CompactCompatibleArrays and ArrangeAccessesHierarchically, to allow them to
-  // produce better results
-  revng_check(SM.addStep<dla::CollapseSingleChild>());
-  revng_check(SM.addStep<dla::DeduplicateFields>());
-  revng_check(SM.addStep<dla::ArrangeAccessesHierarchically>());
-  revng_check(SM.addStep<dla::CompactCompatibleArrays>());
-  revng_check(SM.addStep<dla::PushDownPointers>());
-  // ArrangeAccessesHierarchically can move pointer edges around in some cases,
-  // so we want to run MergePointerNodes again afterwards.
-  revng_check(SM.addStep<dla::MergePointerNodes>());
-  // CollapseSingleChild and DeduplicateFields run again after
-  // CompactCompatibleArrays and ArrangeAccessesHierarchically, to allow them to
-  // improve the results even further.
-  revng_check(SM.addStep<dla::ResolveLeafUnions>());
-  revng_check(SM.addStep<dla::CollapseSingleChild>());
-  revng_check(SM.addStep<dla::DeduplicateFields>());
-  revng_check(SM.addStep<dla::ComputeNonInterferingComponents>());
-  SM.run(TS);
+  SM.addDefaultSteps(getPointerSize(Model.Architecture()));
+  if (not StatisticsPath.empty())
+    SM.enableStatistics();
+
+  unsigned NumThreads = MiddleendThreads;
+  if (NumThreads == 0)
+    NumThreads = llvm::hardware_concurrency().compute_thread_count();
+  SM.run(TS, NumThreads);
 
   // Compress the equivalence classes obtained after graph manipulation
   dla::VectEqClasses &EqClasses = TS.getEqClasses();
@@ -118,12 +96,34 @@ bool DLAPass::runOnModule(llvm::Module &M) {
 
   // Generate model types
   auto &WritableModel = ModelWrapper.getWriteableModel();
-  auto ValueToTypeMap = dla::makeModelTypes(TS, Values, WritableModel);
+  dla::ModelChanges Changes;
+  auto ValueToTypeMap = dla::makeModelTypes(TS, Values, WritableModel, Changes);
   bool Changed = false;
 
-  Changed |= dla::updateFuncSignatures(M, WritableModel, ValueToTypeMap, Cache);
-  Changed |= dla::updateSegmentsTypes(M, WritableModel, ValueToTypeMap);
-  revng_assert(WritableModel->verify(true));
+  Changed |= dla::updateFuncSignatures(M,
+                                       WritableModel,
+                                       ValueToTypeMap,
+                                       Cache,
+                                       Changes);
+  Changed |= dla::updateSegmentsTypes(M,
+                                      WritableModel,
+                                      ValueToTypeMap,
+                                      Changes);
+
+  // The rest of the model has not been touched by the backend, so only verify
+  // what has changed, unless asked to verify everything.
+  revng_assert(Changes.verify(true));
+  if (VerifyLog.isEnabled())
+    revng_assert(WritableModel->verify(true));
+
+  if (not StatisticsPath.empty()) {
+    std::error_code EC;
+    llvm::raw_fd_ostream File(StatisticsPath, EC, llvm::sys::fs::OF_Text);
+    if (EC)
+      revng_abort(("Cannot open " + StatisticsPath + ": " + EC.message())
+                    .c_str());
+    SM.printStatistics(File);
+  }
 
   return Changed;
 }
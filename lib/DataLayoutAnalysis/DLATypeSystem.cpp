@@ -3,15 +3,19 @@
 //
 
 #include <algorithm>
+#include <memory>
+#include <vector>
 #include <string>
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SCCIterator.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/FormattedStream.h"
+#include "llvm/Support/LEB128.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "revng/ADT/FilteredGraphTraits.h"
@@ -35,6 +39,22 @@ void *operator new(size_t, NodeAllocatorT &NodeAllocator) {
 
 namespace dla {
 
+static std::vector<const Logger<> *> &getTypeSystemLoggers() {
+  static std::vector<const Logger<> *> Loggers;
+  return Loggers;
+}
+
+RegisterTypeSystemLogger::RegisterTypeSystemLogger(const Logger<> &L) {
+  getTypeSystemLoggers().push_back(&L);
+}
+
+bool isTypeSystemLoggingEnabled() {
+  return llvm::any_of(getTypeSystemLoggers(),
+                      [](const Logger<> *L) { return L->isEnabled(); });
+}
+
+static RegisterTypeSystemLogger RegisterCollapsedPrinter(CollapsedNodePrinter);
+
 void OffsetExpression::print(llvm::raw_ostream &OS) const {
   OS << "Off: " << Offset;
   auto NStrides = Strides.size();
@@ -212,8 +232,11 @@ LayoutTypeSystemNode *LayoutTypeSystem::createArtificialLayoutType() {
   revng_assert(New);
   ++NID;
   EqClasses.growBy1();
-  bool Success = Layouts.insert(New).second;
-  revng_assert(Success);
+  revng_assert(New->ID == Layouts.size());
+  Layouts.push_back(New);
+  NodeGenerations.push_back(0ULL);
+  ++NumLayouts;
+  markModified(New);
   return New;
 }
 
@@ -231,39 +254,30 @@ static void fixPredSucc(LayoutTypeSystemNode *From,
   revng_assert(From != Into);
 
   uint64_t FromID = From->ID;
-  using IDBasedKey = std::pair<uint64_t, const TypeLinkTag *>;
+  using NeighborsSet = LayoutTypeSystemNode::NeighborsSet;
+  using IDBasedKey = NeighborsSet::IDBasedKey;
+
+  // Replace From with Into in all the links to From in Neighbors
+  const auto Redirect = [FromID, Into](NeighborsSet &Neighbors) {
+    auto It = Neighbors.lower_bound(IDBasedKey{ FromID, nullptr });
+    auto End = Neighbors.upper_bound(IDBasedKey{ FromID + 1, nullptr });
+    llvm::SmallVector<const TypeLinkTag *, 2> Tags;
+    for (const auto &[Neighbor, Tag] : llvm::make_range(It, End))
+      Tags.push_back(Tag);
+    Neighbors.erase(It, End);
+    for (const TypeLinkTag *Tag : Tags)
+      Neighbors.insert({ Into, Tag });
+  };
 
   // All the predecessors of all the successors of From are updated so that they
   // point to Into
-  for (auto &[Successor, Tag] : From->Successors) {
-    auto It = Successor->Predecessors.lower_bound(IDBasedKey{ FromID,
-                                                              nullptr });
-    auto End = Successor->Predecessors.upper_bound(IDBasedKey{ FromID + 1,
-                                                               nullptr });
-    while (It != End) {
-      auto Next = std::next(It);
-      auto Extracted = Successor->Predecessors.extract(It);
-      revng_assert(Extracted);
-      Successor->Predecessors.insert({ Into, Extracted.value().second });
-      It = Next;
-    }
-  }
+  for (auto &[Successor, Tag] : From->Successors)
+    Redirect(Successor->Predecessors);
 
   // All the successors of all the predecessors of From are updated so that they
   // point to Into
-  for (auto &[Predecessor, Tag] : From->Predecessors) {
-    auto It = Predecessor->Successors.lower_bound(IDBasedKey{ FromID,
-                                                              nullptr });
-    auto End = Predecessor->Successors.upper_bound(IDBasedKey{ FromID + 1,
-                                                               nullptr });
-    while (It != End) {
-      auto Next = std::next(It);
-      auto Extracted = Predecessor->Successors.extract(It);
-      revng_assert(Extracted);
-      Predecessor->Successors.insert({ Into, Extracted.value().second });
-      It = Next;
-    }
-  }
+  for (auto &[Predecessor, Tag] : From->Predecessors)
+    Redirect(Predecessor->Successors);
 
   // Merge all the predecessors and successors.
   {
@@ -291,6 +305,7 @@ static void fixPredSucc(LayoutTypeSystemNode *From,
 }
 
 static Logger<> MergeLog("dla-merge-nodes");
+static RegisterTypeSystemLogger RegisterMergeLog(MergeLog);
 
 void LayoutTypeSystem::mergeNodes(llvm::ArrayRef<LayoutTypeSystemNode *>
                                     ToMerge) {
@@ -299,6 +314,10 @@ void LayoutTypeSystem::mergeNodes(llvm::ArrayRef<LayoutTypeSystemNode *>
   if (ToMerge.size() <= 1ULL)
     return;
 
+  // Check all the nodes before any of them is dropped
+  for (LayoutTypeSystemNode *N : ToMerge)
+    revng_assert(hasLayout(N));
+
   LayoutTypeSystemNode *Into = ToMerge[0];
   const unsigned IntoID = Into->ID;
 
@@ -322,29 +341,36 @@ void LayoutTypeSystem::mergeNodes(llvm::ArrayRef<LayoutTypeSystemNode *>
 
     EqClasses.join(IntoID, From->ID);
 
+    // All the neighbors of From are going to have their edges moved to Into
+    for (auto &[Neighbor, Tag] : From->Successors)
+      markModified(Neighbor);
+    for (auto &[Neighbor, Tag] : From->Predecessors)
+      markModified(Neighbor);
+    markModified(Into);
+
     fixPredSucc(From, Into);
 
-    // Remove From from Layouts
-    bool Erased = Layouts.erase(From);
-    revng_assert(Erased);
-    From->~LayoutTypeSystemNode();
-    NodeAllocator.Deallocate(From);
+    dropNode(From);
+    ++NumMergedNodes;
   }
 }
 
 void LayoutTypeSystem::removeNode(LayoutTypeSystemNode *ToRemove) {
+  revng_assert(hasLayout(ToRemove));
+
   // Join the node's eq class with the removed class
   uint64_t TheID = ToRemove->ID;
   EqClasses.remove(TheID);
   revng_log(MergeLog, "Removing " << ToRemove->ID << "\n");
 
-  using IDBasedKey = std::pair<uint64_t, const TypeLinkTag *>;
+  using IDBasedKey = LayoutTypeSystemNode::NeighborsSet::IDBasedKey;
 
   for (auto &[Neighbor, Tag] : ToRemove->Successors) {
     auto &PredOfSucc = Neighbor->Predecessors;
     auto It = PredOfSucc.lower_bound(IDBasedKey{ TheID, nullptr });
     auto End = PredOfSucc.upper_bound(IDBasedKey{ TheID + 1, nullptr });
     PredOfSucc.erase(It, End);
+    markModified(Neighbor);
   }
 
   for (auto &[Neighbor, Tag] : ToRemove->Predecessors) {
@@ -352,12 +378,19 @@ void LayoutTypeSystem::removeNode(LayoutTypeSystemNode *ToRemove) {
     auto It = SuccOfPred.lower_bound(IDBasedKey{ TheID, nullptr });
     auto End = SuccOfPred.upper_bound(IDBasedKey{ TheID + 1, nullptr });
     SuccOfPred.erase(It, End);
+    markModified(Neighbor);
   }
 
-  bool Erased = Layouts.erase(ToRemove);
-  revng_assert(Erased);
-  ToRemove->~LayoutTypeSystemNode();
-  NodeAllocator.Deallocate(ToRemove);
+  dropNode(ToRemove);
+  ++NumRemovedNodes;
+}
+
+void LayoutTypeSystem::dropNode(LayoutTypeSystemNode *N) {
+  revng_assert(hasLayout(N));
+  Layouts[N->ID] = nullptr;
+  --NumLayouts;
+  N->Successors.release();
+  N->Predecessors.release();
 }
 
 using NeighborIterator = LayoutTypeSystem::NeighborIterator;
@@ -366,33 +399,31 @@ static void moveEdgeTargetWithoutSumming(LayoutTypeSystemNode *OldTgt,
                                          LayoutTypeSystemNode *NewTgt,
                                          NeighborIterator InverseEdgeIt) {
 
+  const auto [Src, Tag] = *InverseEdgeIt;
+
   // First, move the successor from OldTgt to NewTgt
-  LayoutTypeSystemNode *Src = InverseEdgeIt->first;
-  auto SuccHandle = Src->Successors.extract({ OldTgt, InverseEdgeIt->second });
-  revng_assert(not SuccHandle.empty());
-  SuccHandle.value().first = NewTgt;
-  Src->Successors.insert(std::move(SuccHandle));
+  bool Erased = Src->Successors.erase({ OldTgt, Tag });
+  revng_assert(Erased);
+  Src->Successors.insert({ NewTgt, Tag });
 
   // Then, move the predecessor edge from OldTgt to NewTgt
-  auto PredHandle = OldTgt->Predecessors.extract(InverseEdgeIt);
-  revng_assert(not PredHandle.empty());
-  NewTgt->Predecessors.insert(std::move(PredHandle));
+  OldTgt->Predecessors.erase(InverseEdgeIt);
+  NewTgt->Predecessors.insert({ Src, Tag });
 }
 
 static void moveEdgeSourceWithoutSumming(LayoutTypeSystemNode *OldSrc,
                                          LayoutTypeSystemNode *NewSrc,
                                          NeighborIterator EdgeIt) {
+  const auto [Tgt, Tag] = *EdgeIt;
+
   // First, move the predecessor edge from OldSrc to NewSrc.
-  LayoutTypeSystemNode *Tgt = EdgeIt->first;
-  auto PredHandle = Tgt->Predecessors.extract({ OldSrc, EdgeIt->second });
-  revng_assert(not PredHandle.empty());
-  PredHandle.value().first = NewSrc;
-  Tgt->Predecessors.insert(std::move(PredHandle));
+  bool Erased = Tgt->Predecessors.erase({ OldSrc, Tag });
+  revng_assert(Erased);
+  Tgt->Predecessors.insert({ NewSrc, Tag });
 
   // Then, move the successor edge from OldSrc to NewSrc
-  auto SuccHandle = OldSrc->Successors.extract(EdgeIt);
-  revng_assert(not SuccHandle.empty());
-  NewSrc->Successors.insert(std::move(SuccHandle));
+  OldSrc->Successors.erase(EdgeIt);
+  NewSrc->Successors.insert({ Tgt, Tag });
 }
 
 void LayoutTypeSystem::moveEdgeTarget(LayoutTypeSystemNode *OldTgt,
@@ -403,21 +434,23 @@ void LayoutTypeSystem::moveEdgeTarget(LayoutTypeSystemNode *OldTgt,
   if (not OldTgt or not NewTgt)
     return;
 
+  markModified(InverseEdgeIt->first);
+  markModified(OldTgt);
+  markModified(NewTgt);
+
   if (not OffsetToSum)
     return moveEdgeTargetWithoutSumming(OldTgt, NewTgt, InverseEdgeIt);
 
-  LayoutTypeSystemNode *Src = InverseEdgeIt->first;
+  const auto [Src, EdgeTag] = *InverseEdgeIt;
 
   // Erase info in Src that represent the fact that OldTgt was a successor.
-  bool Erased = Src->Successors.erase({ OldTgt, InverseEdgeIt->second });
+  bool Erased = Src->Successors.erase({ OldTgt, EdgeTag });
   revng_assert(Erased);
 
-  // Extract the predecessor edge to be moved from OldTgt to NewTgt
-  auto OldPredHandle = OldTgt->Predecessors.extract(InverseEdgeIt);
-  revng_assert(not OldPredHandle.empty());
+  // Erase the predecessor edge to be moved from OldTgt to NewTgt
+  OldTgt->Predecessors.erase(InverseEdgeIt);
 
   // Add new instance links with adjusted offsets from Src to NewTgt.
-  const TypeLinkTag *EdgeTag = OldPredHandle.value().second;
   switch (EdgeTag->getKind()) {
 
   case TypeLinkTag::LK_Instance: {
@@ -441,21 +474,23 @@ void LayoutTypeSystem::moveEdgeSource(LayoutTypeSystemNode *OldSrc,
   if (not OldSrc or not NewSrc)
     return;
 
+  markModified(EdgeIt->first);
+  markModified(OldSrc);
+  markModified(NewSrc);
+
   if (not OffsetToSum)
     return moveEdgeSourceWithoutSumming(OldSrc, NewSrc, EdgeIt);
 
-  LayoutTypeSystemNode *Tgt = EdgeIt->first;
+  const auto [Tgt, EdgeTag] = *EdgeIt;
 
   // Erase info in Tgt that represent the fact that OldSrc was a predecessor.
-  bool Erased = Tgt->Predecessors.erase({ OldSrc, EdgeIt->second });
+  bool Erased = Tgt->Predecessors.erase({ OldSrc, EdgeTag });
   revng_assert(Erased);
 
-  // Extract the successor edge to be moved from OldSrc to NewSrc
-  auto OldSuccHandle = OldSrc->Successors.extract(EdgeIt);
-  revng_assert(not OldSuccHandle.empty());
+  // Erase the successor edge to be moved from OldSrc to NewSrc
+  OldSrc->Successors.erase(EdgeIt);
 
   // Add new instance links with adjusted offsets from NewSrc to Tgt.
-  const TypeLinkTag *EdgeTag = OldSuccHandle.value().second;
   switch (EdgeTag->getKind()) {
 
   case TypeLinkTag::LK_Instance: {
@@ -474,6 +509,8 @@ void LayoutTypeSystem::moveEdgeSource(LayoutTypeSystemNode *OldSrc,
 NeighborIterator LayoutTypeSystem::eraseEdge(LayoutTypeSystemNode *Src,
                                              NeighborIterator EdgeIt) {
   LayoutTypeSystemNode *Tgt = EdgeIt->first;
+  markModified(Src);
+  markModified(Tgt);
 
   // Erase the inverse edge from Tgt to Src
   bool Erased = Tgt->Predecessors.erase({ Src, EdgeIt->second });
@@ -484,16 +521,328 @@ NeighborIterator LayoutTypeSystem::eraseEdge(LayoutTypeSystemNode *Src,
 }
 
 void LayoutTypeSystem::dropOutgoingEdges(LayoutTypeSystemNode *N) {
-  auto It = N->Successors.begin();
-  auto End = N->Successors.end();
-  while (It != End)
-    It = eraseEdge(N, It);
+  while (not N->Successors.empty())
+    eraseEdge(N, std::prev(N->Successors.end()));
+}
+
+std::unique_ptr<LayoutTypeSystem>
+LayoutTypeSystem::extractNodes(ArrayRef<LayoutTypeSystemNode *> Nodes) const {
+  auto Result = std::make_unique<LayoutTypeSystem>();
+
+  // Map the ID of each node in Nodes to the ID of its copy
+  DenseMap<uint64_t, uint64_t> NewIDs;
+  for (size_t Index = 0; Index < Nodes.size(); ++Index) {
+    const LayoutTypeSystemNode *N = Nodes[Index];
+    revng_assert(hasLayout(N));
+    revng_assert(Index == 0 or Nodes[Index - 1]->ID < N->ID);
+    LayoutTypeSystemNode *Copy = Result->createArtificialLayoutType();
+    Copy->Size = N->Size;
+    Copy->InterferingInfo = N->InterferingInfo;
+    Copy->NonScalar = N->NonScalar;
+    NewIDs[N->ID] = Copy->ID;
+  }
+
+  for (size_t Index = 0; Index < Nodes.size(); ++Index) {
+    LayoutTypeSystemNode *Src = Result->Layouts[Index];
+    for (const auto &[Succ, Tag] : Nodes[Index]->Successors) {
+      auto It = NewIDs.find(Succ->ID);
+      revng_assert(It != NewIDs.end());
+      Result->addLink(Src, Result->Layouts[It->second], *Tag);
+    }
+  }
+
+  return Result;
+}
+
+void LayoutTypeSystem::replaceNodes(ArrayRef<LayoutTypeSystemNode *> Nodes,
+                                    const LayoutTypeSystem &Extracted) {
+  revng_assert(Extracted.Layouts.size() >= Nodes.size());
+
+  // All the edges of Nodes are among Nodes, and they will be rebuilt from
+  // Extracted.
+  for (LayoutTypeSystemNode *N : Nodes) {
+    revng_assert(hasLayout(N));
+    N->Successors.clear();
+    N->Predecessors.clear();
+  }
+
+  // Map each node alive in Extracted to a node in this LayoutTypeSystem,
+  // creating the nodes that didn't exist.
+  const auto &ExtractedNodes = Extracted.Layouts;
+  std::vector<LayoutTypeSystemNode *> Mapped(ExtractedNodes.size(), nullptr);
+  for (size_t Index = 0; Index < ExtractedNodes.size(); ++Index) {
+    if (not ExtractedNodes[Index])
+      continue;
+    if (Index < Nodes.size())
+      Mapped[Index] = Nodes[Index];
+    else
+      Mapped[Index] = createArtificialLayoutType();
+  }
+
+  // Nodes that were merged or removed in Extracted must be merged or removed
+  // here too. Nodes that were created and then dropped in Extracted are not
+  // interesting, since they never existed here.
+  const VectEqClasses &ExtractedClasses = Extracted.EqClasses;
+  DenseMap<unsigned, LayoutTypeSystemNode *> LeaderToAlive;
+  for (size_t Index = 0; Index < Mapped.size(); ++Index)
+    if (Mapped[Index])
+      LeaderToAlive[ExtractedClasses.findLeader(Index)] = Mapped[Index];
+
+  for (size_t Index = 0; Index < Nodes.size(); ++Index) {
+    if (Mapped[Index])
+      continue;
+
+    LayoutTypeSystemNode *N = Nodes[Index];
+    if (ExtractedClasses.isRemoved(Index)) {
+      EqClasses.remove(N->ID);
+    } else {
+      auto *Into = LeaderToAlive.lookup(ExtractedClasses.findLeader(Index));
+      revng_assert(Into);
+      EqClasses.join(Into->ID, N->ID);
+    }
+
+    dropNode(N);
+  }
+
+  // Copy the content and the edges of the alive nodes.
+  for (size_t Index = 0; Index < Mapped.size(); ++Index) {
+    LayoutTypeSystemNode *N = Mapped[Index];
+    if (not N)
+      continue;
+
+    const LayoutTypeSystemNode *ExtractedN = ExtractedNodes[Index];
+    N->Size = ExtractedN->Size;
+    N->InterferingInfo = ExtractedN->InterferingInfo;
+    N->NonScalar = ExtractedN->NonScalar;
+    markModified(N);
+    for (const auto &[Succ, Tag] : ExtractedN->Successors)
+      addLink(N, Mapped[Succ->ID], *Tag);
+  }
+}
+
+// Checkpoints are a sequence of ULEB128 integers, preceded by a magic string:
+//
+//   Version NID
+//   for each ID < NID: IsAlive [Size InterferingInfo NonScalar]
+//   NumTags
+//   for each tag: Kind, and if it's an instance tag:
+//     Offset NumStrides [Stride HasTripCount [TripCount]]*
+//   NumLinks
+//   for each link: SourceID TargetID TagIndex
+//   for each ID < NID: Leader IsRemoved
+static constexpr llvm::StringLiteral CheckpointMagic = "DLATS";
+static constexpr uint64_t CheckpointVersion = 1;
+
+void LayoutTypeSystem::serialize(llvm::raw_ostream &OS) const {
+  revng_assert(EqClasses.getNumClasses() == 0);
+  revng_assert(EqClasses.getNumElements() == NID);
+
+  auto Write = [&OS](uint64_t Value) { encodeULEB128(Value, OS); };
+
+  OS << CheckpointMagic;
+  Write(CheckpointVersion);
+  Write(NID);
+  for (const LayoutTypeSystemNode *N : Layouts) {
+    Write(N != nullptr);
+    if (not N)
+      continue;
+    Write(N->Size);
+    Write(N->InterferingInfo);
+    Write(N->NonScalar);
+  }
+
+  // Only write the tags that are actually used, numbering them in the order in
+  // which they are first found.
+  DenseMap<const TypeLinkTag *, uint64_t> TagIndexes;
+  std::vector<const TypeLinkTag *> Tags;
+  uint64_t NumLinks = 0;
+  for (const LayoutTypeSystemNode *N : getLayoutsRange()) {
+    NumLinks += N->Successors.size();
+    for (const auto &[Succ, Tag] : N->Successors)
+      if (TagIndexes.try_emplace(Tag, Tags.size()).second)
+        Tags.push_back(Tag);
+  }
+
+  Write(Tags.size());
+  for (const TypeLinkTag *Tag : Tags) {
+    Write(Tag->getKind());
+    if (Tag->getKind() != TypeLinkTag::LK_Instance)
+      continue;
+
+    const OffsetExpression &OE = Tag->getOffsetExpr();
+    Write(OE.Offset);
+    Write(OE.Strides.size());
+    for (const auto &[Stride, TC] : llvm::zip(OE.Strides, OE.TripCounts)) {
+      Write(Stride);
+      Write(TC.has_value());
+      if (TC.has_value())
+        Write(*TC);
+    }
+  }
+
+  Write(NumLinks);
+  for (const LayoutTypeSystemNode *N : getLayoutsRange()) {
+    for (const auto &[Succ, Tag] : N->Successors) {
+      Write(N->ID);
+      Write(Succ->ID);
+      Write(TagIndexes.lookup(Tag));
+    }
+  }
+
+  for (unsigned ID = 0; ID < NID; ++ID) {
+    Write(EqClasses.findLeader(ID));
+    Write(EqClasses.isRemoved(ID));
+  }
+}
+
+namespace {
+
+/// Reads the ULEB128 integers of a checkpoint, remembering the first error
+class CheckpointReader {
+private:
+  const uint8_t *Cursor;
+  const uint8_t *End;
+  const char *Error = nullptr;
+
+public:
+  CheckpointReader(llvm::StringRef Buffer) :
+    Cursor(Buffer.bytes_begin()), End(Buffer.bytes_end()) {}
+
+  uint64_t read() {
+    if (Error)
+      return 0;
+
+    unsigned Length = 0;
+    uint64_t Result = decodeULEB128(Cursor, &Length, End, &Error);
+    Cursor += Length;
+    return Result;
+  }
+
+  /// Read a value, failing if it's not smaller than \a Bound
+  uint64_t readBelow(uint64_t Bound) {
+    uint64_t Result = read();
+    if (not Error and Result >= Bound)
+      Error = "value out of range";
+    return Result;
+  }
+
+  void fail(const char *Message) {
+    if (not Error)
+      Error = Message;
+  }
+
+  bool atEnd() const { return Cursor == End; }
+
+  const char *getError() const { return Error; }
+};
+
+} // end anonymous namespace
+
+llvm::Expected<std::unique_ptr<LayoutTypeSystem>>
+LayoutTypeSystem::deserialize(llvm::StringRef Buffer) {
+  auto MakeError = [](const llvm::Twine &Message) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Invalid DLA checkpoint: " + Message);
+  };
+
+  if (not Buffer.consume_front(CheckpointMagic))
+    return MakeError("bad magic");
+
+  CheckpointReader Reader(Buffer);
+  if (uint64_t Version = Reader.read(); Version != CheckpointVersion)
+    return MakeError("unsupported version " + llvm::Twine(Version));
+
+  auto Result = std::make_unique<LayoutTypeSystem>();
+  LayoutTypeSystem &TS = *Result;
+
+  // Each ID takes at least one byte, so this also bounds the memory we allocate
+  // for corrupted checkpoints.
+  uint64_t NumIDs = Reader.readBelow(Buffer.size() + 1);
+  for (uint64_t ID = 0; ID < NumIDs and not Reader.getError(); ++ID) {
+    LayoutTypeSystemNode *N = TS.createArtificialLayoutType();
+    if (not Reader.readBelow(2)) {
+      // Leave a tombstone, like removeNode does
+      TS.dropNode(N);
+      continue;
+    }
+    N->Size = Reader.read();
+    auto Info = Reader.readBelow(AllChildrenAreNonInterfering + 1);
+    N->InterferingInfo = static_cast<InterferingChildrenInfo>(Info);
+    N->NonScalar = Reader.readBelow(2);
+  }
+
+  uint64_t NumTags = Reader.readBelow(Buffer.size() + 1);
+  std::vector<TypeLinkTag> Tags;
+  for (uint64_t I = 0; I < NumTags and not Reader.getError(); ++I) {
+    auto Kind = Reader.readBelow(TypeLinkTag::LK_All);
+    if (Kind == TypeLinkTag::LK_Equality) {
+      Tags.push_back(TypeLinkTag::equalityTag());
+      continue;
+    }
+    if (Kind == TypeLinkTag::LK_Pointer) {
+      Tags.push_back(TypeLinkTag::pointerTag());
+      continue;
+    }
+
+    OffsetExpression OE(Reader.read());
+    uint64_t NumStrides = Reader.readBelow(Buffer.size() + 1);
+    for (uint64_t S = 0; S < NumStrides and not Reader.getError(); ++S) {
+      OE.Strides.push_back(Reader.read());
+      std::optional<uint64_t> TripCount;
+      if (Reader.readBelow(2))
+        TripCount = Reader.read();
+      OE.TripCounts.push_back(TripCount);
+    }
+
+    if (not OE.verify())
+      Reader.fail("invalid offset expression");
+    Tags.push_back(TypeLinkTag::instanceTag(std::move(OE)));
+  }
+
+  uint64_t NumLinks = Reader.read();
+  for (uint64_t I = 0; I < NumLinks and not Reader.getError(); ++I) {
+    uint64_t Src = Reader.readBelow(NumIDs);
+    uint64_t Tgt = Reader.readBelow(NumIDs);
+    uint64_t TagIndex = Reader.readBelow(Tags.size());
+    if (Reader.getError())
+      break;
+
+    if (not TS.Layouts[Src] or not TS.Layouts[Tgt] or Src == Tgt) {
+      Reader.fail("link to a removed node");
+      break;
+    }
+
+    TS.addLink(TS.Layouts[Src], TS.Layouts[Tgt], Tags[TagIndex]);
+  }
+
+  // Rebuild the equivalence classes, joining each element with its leader and
+  // then removing the removed ones
+  llvm::SmallVector<unsigned, 8> Removed;
+  for (unsigned ID = 0; ID < NumIDs and not Reader.getError(); ++ID) {
+    unsigned Leader = Reader.readBelow(NumIDs);
+    if (Reader.readBelow(2))
+      Removed.push_back(ID);
+    if (not Reader.getError() and Leader != ID)
+      TS.EqClasses.join(ID, Leader);
+  }
+
+  for (unsigned ID : Removed)
+    TS.EqClasses.remove(ID);
+
+  if (not Reader.getError() and not Reader.atEnd())
+    Reader.fail("trailing data");
+
+  if (const char *Error = Reader.getError())
+    return MakeError(Error);
+
+  return Result;
 }
 
 static Logger<> VerifyDLALog("dla-verify-strict");
+static RegisterTypeSystemLogger RegisterVerifyDLALog(VerifyDLALog);
 
 bool LayoutTypeSystem::verifyConsistency() const {
-  for (LayoutTypeSystemNode *NodePtr : Layouts) {
+  for (LayoutTypeSystemNode *NodePtr : getLayoutsRange()) {
     if (not NodePtr) {
       if (VerifyDLALog.isEnabled())
         revng_check(false);
@@ -735,9 +1084,40 @@ bool LayoutTypeSystem::verifyUnions() const {
 }
 
 unsigned VectEqClasses::growBy1() {
-  ++NElems;
-  grow(NElems);
-  return NElems;
+  revng_assert(NumClasses == 0);
+  unsigned ID = Parent.size();
+  Parent.push_back(ID);
+  Rank.push_back(0);
+  Next.push_back(ID);
+  return Parent.size();
+}
+
+unsigned VectEqClasses::findLeader(unsigned ID) const {
+  revng_assert(ID < Parent.size());
+  while (Parent[ID] != ID) {
+    // Path halving: make every other node on the path point to its grandparent
+    Parent[ID] = Parent[Parent[ID]];
+    ID = Parent[ID];
+  }
+  return ID;
+}
+
+unsigned VectEqClasses::join(unsigned A, unsigned B) {
+  revng_assert(NumClasses == 0);
+  A = findLeader(A);
+  B = findLeader(B);
+  if (A == B)
+    return A;
+
+  if (Rank[A] < Rank[B])
+    std::swap(A, B);
+  Parent[B] = A;
+  if (Rank[A] == Rank[B])
+    ++Rank[A];
+
+  // Splice the two circular lists of elements
+  std::swap(Next[A], Next[B]);
+  return A;
 }
 
 void VectEqClasses::remove(const unsigned A) {
@@ -752,49 +1132,50 @@ bool VectEqClasses::isRemoved(const unsigned ID) const {
   if (not RemovedID)
     return false;
 
-  // Uncompressed map
-  if (getNumClasses() == 0)
-    return (findLeader(ID) == findLeader(*RemovedID));
+  return haveSameEqClass(ID, *RemovedID);
+}
 
-  // Compressed map
-  unsigned ElementEqClass = lookupEqClass(ID);
-  unsigned RemovedEqClass = lookupEqClass(*RemovedID);
-  return (ElementEqClass == RemovedEqClass);
+void VectEqClasses::compress() {
+  revng_assert(NumClasses == 0);
+  constexpr unsigned None = std::numeric_limits<unsigned>::max();
+  ClassIDs.assign(Parent.size(), None);
+  for (unsigned ID = 0; ID < Parent.size(); ++ID) {
+    unsigned &LeaderClass = ClassIDs[findLeader(ID)];
+    if (LeaderClass == None)
+      LeaderClass = NumClasses++;
+    ClassIDs[ID] = LeaderClass;
+  }
 }
 
 std::optional<unsigned> VectEqClasses::getEqClassID(const unsigned ID) const {
-  unsigned EqID = lookupEqClass(ID);
-  bool IsRemoved = (RemovedID) ? lookupEqClass(*RemovedID) == EqID : false;
-
-  if (IsRemoved)
+  revng_assert(NumClasses > 0);
+  if (ID >= ClassIDs.size() or isRemoved(ID))
     return {};
-  return EqID;
+  return ClassIDs[ID];
 }
 
 std::vector<unsigned>
 VectEqClasses::computeEqClass(const unsigned ElemID) const {
   std::vector<unsigned> EqClass;
 
-  for (unsigned OtherID = 0; OtherID < NElems; OtherID++)
-    if (haveSameEqClass(ElemID, OtherID))
-      EqClass.push_back(OtherID);
+  unsigned ID = ElemID;
+  do {
+    EqClass.push_back(ID);
+    ID = Next[ID];
+  } while (ID != ElemID);
 
+  llvm::sort(EqClass);
   return EqClass;
 }
 
 bool VectEqClasses::haveSameEqClass(unsigned ID1, unsigned ID2) const {
-  // Uncompressed map
-  if (getNumClasses() == 0)
-    return findLeader(ID1) == findLeader(ID2);
-
-  // Compressed map
-  return lookupEqClass(ID1) == lookupEqClass(ID2);
+  return findLeader(ID1) == findLeader(ID2);
 }
 
 void TSDebugPrinter::printNodeContent(const LayoutTypeSystem &TS,
                                       const LayoutTypeSystemNode *N,
                                       llvm::raw_fd_ostream &File) const {
-  auto EqClasses = TS.getEqClasses();
+  const VectEqClasses &EqClasses = TS.getEqClasses();
 
   File << DoRet;
   if (EqClasses.isRemoved(N->ID))
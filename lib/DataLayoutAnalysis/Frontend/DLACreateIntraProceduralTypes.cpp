@@ -54,12 +54,30 @@ private:
   const model::Binary &Model;
   Function *F;
   ScalarEvolution *SE;
-  llvm::DominatorTree DT;
-  llvm::PostDominatorTree PDT;
+
+  // Only needed to compute the trip count of strided accesses in loops, so
+  // they are computed lazily.
+  std::optional<llvm::DominatorTree> DT;
+  std::optional<llvm::PostDominatorTree> PDT;
 
   SCEVTypeMap SCEVToLayoutType;
   FunctionMetadataCache *Cache;
 
+  // Caches the base addresses of the SCEVs of the current function
+  SCEVBaseAddressExplorer Explorer;
+
+  const llvm::DominatorTree &getDT() {
+    if (not DT)
+      DT.emplace(*F);
+    return *DT;
+  }
+
+  const llvm::PostDominatorTree &getPDT() {
+    if (not PDT)
+      PDT.emplace(*F);
+    return *PDT;
+  }
+
 protected:
   bool addInstanceLink(DLATypeSystemLLVMBuilder &Builder,
                        Value *PointerVal,
@@ -173,7 +191,7 @@ protected:
         if (Count != nullptr and not Count->isZero()) {
           SmallVector<BasicBlock *, 4> ExitBlocks;
           L->getUniqueExitBlocks(ExitBlocks);
-          const auto IsDominatedByB = [&DT = this->DT,
+          const auto IsDominatedByB = [&DT = getDT(),
                                        &B](const BasicBlock *OtherB) {
             return DT.dominates(&B, OtherB);
           };
@@ -187,7 +205,7 @@ protected:
             // loop-simplified form is SCEVBackedgeCount + 1, because in
             // loop-simplified form we only have one back edge.
             TripCount = Count->getAPInt().getSExtValue() + 1;
-          } else if (PDT.dominates(L->getHeader(), &B)) {
+          } else if (getPDT().dominates(L->getHeader(), &B)) {
             // If the loop header postdominates B, B is executed the same
             // number of times as the only backedge
             TripCount = Count->getAPInt().getSExtValue();
@@ -242,9 +260,10 @@ public:
   void setupForProcessingFunction(ModulePass *MP, Function *TheF) {
     SE = &MP->getAnalysis<llvm::ScalarEvolutionWrapperPass>(*TheF).getSE();
     F = TheF;
-    DT.recalculate(*F);
-    PDT.recalculate(*F);
+    DT.reset();
+    PDT.reset();
     SCEVToLayoutType.clear();
+    Explorer.clear();
   }
 
   bool getOrCreateSCEVTypes(DLATypeSystemLLVMBuilder &Builder) {
@@ -626,11 +645,13 @@ public:
     if (isa<UndefValue>(PointerVal))
       return AddedSomething;
 
+    // SCEVToLayoutType is complete at this point, except for SCEVUnknowns
+    // added by addInstanceLink, that are never traversed anyway, so the bases
+    // cached by Explorer are still valid.
     const SCEV *PtrSCEV = SE->getSCEV(PointerVal);
-    using Explorer = SCEVBaseAddressExplorer;
-    auto PossibleBaseAddresses = Explorer().findBases(SE,
-                                                      PtrSCEV,
-                                                      SCEVToLayoutType);
+    auto PossibleBaseAddresses = Explorer.findBases(SE,
+                                                    PtrSCEV,
+                                                    SCEVToLayoutType);
     for (const SCEV *BaseAddrSCEV : PossibleBaseAddresses)
       AddedSomething |= addInstanceLink(Builder, PointerVal, BaseAddrSCEV, B);
 
@@ -698,6 +719,11 @@ bool Builder::createIntraproceduralTypes(llvm::Module &M,
   bool Changed = false;
   InstanceLinkAdder ILA(Model, *Cache);
 
+  // Functions are visited one at a time. They cannot be visited in parallel,
+  // since ScalarEvolution and InstanceLinkAdder create constants and types in
+  // the LLVMContext of M, the ScalarEvolution of each function is obtained
+  // from the legacy pass manager running MP, and FunctionMetadataCache is not
+  // synchronized.
   for (Function &F : M.functions()) {
     auto FTags = FunctionTags::TagsSet::from(&F);
     if (F.isIntrinsic() or not FTags.contains(FunctionTags::Isolated))
@@ -25,7 +25,7 @@ static constexpr const char DoRet[] = "\\l";
 void LLVMTSDebugPrinter::printNodeContent(const LayoutTypeSystem &TS,
                                           const LayoutTypeSystemNode *N,
                                           raw_fd_ostream &File) const {
-  auto EqClasses = TS.getEqClasses();
+  const dla::VectEqClasses &EqClasses = TS.getEqClasses();
   revng_assert(not EqClasses.isRemoved(N->ID));
 
   File << DoRet;
@@ -74,8 +74,9 @@ LayoutTypeSystemNode *DLATypeSystemLLVMBuilder::getLayoutType(const Value *V,
   // Check pre-conditions
   assertGetLayoutTypePreConditions(V, Id);
 
-  LayoutTypePtr Key(V, Id);
-  return VisitedValues.at(Key);
+  auto It = VisitedValues.find(LayoutTypePtr(V, Id));
+  revng_assert(It != VisitedValues.end());
+  return It->second;
 }
 
 std::pair<LayoutTypeSystemNode *, bool>
@@ -87,17 +88,11 @@ DLATypeSystemLLVMBuilder::getOrCreateLayoutType(const Value *V, unsigned Id) {
   // Check pre-conditions
   assertGetLayoutTypePreConditions(V, Id);
 
-  LayoutTypePtr Key(V, Id);
-  auto HintIt = VisitedValues.lower_bound(Key);
-  if (HintIt != VisitedValues.end()
-      and not VisitedValues.key_comp()(Key, HintIt->first)) {
-    return std::make_pair(HintIt->second, false);
-  }
-
-  LayoutTypeSystemNode *Res = TS.createArtificialLayoutType();
+  auto [It, New] = VisitedValues.try_emplace(LayoutTypePtr(V, Id), nullptr);
+  if (New)
+    It->second = TS.createArtificialLayoutType();
 
-  VisitedValues.emplace_hint(HintIt, Key, Res);
-  return std::make_pair(Res, true);
+  return std::make_pair(It->second, New);
 }
 
 static void assertGetLayoutTypePreConditions(const Value &V) {
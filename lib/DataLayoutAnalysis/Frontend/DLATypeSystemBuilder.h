@@ -4,6 +4,7 @@
 // This file is distributed under the MIT License. See LICENSE.mit for details.
 //
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/Pass.h"
 
 #include "revng/EarlyFunctionAnalysis/FunctionMetadataCache.h"
@@ -50,7 +51,7 @@ public:
 /// This class builds a DLA type system from an LLVM module
 class DLATypeSystemLLVMBuilder {
 public:
-  using VisitedMapT = std::map<LayoutTypePtr, LayoutTypeSystemNode *>;
+  using VisitedMapT = llvm::DenseMap<LayoutTypePtr, LayoutTypeSystemNode *>;
   using PrototypesMapT = std::map<const model::Type *, FuncOrCallInst>;
 
 private:
@@ -34,93 +34,137 @@ static bool isAlwaysAddress(const llvm::Value *V) {
   return false;
 }
 
-std::set<const llvm::SCEV *>
+// Returns true if \p S, that looks like an address, is actually an address that
+// can point to a type.
+static bool isTypedAddress(const llvm::SCEV *S) {
+  // Despite the fact that S looks like an address, there are some cases of
+  // stuff that looks like an address that should be ignored.
+  auto *U = dyn_cast<llvm::SCEVUnknown>(S);
+  if (not U)
+    return true;
+
+  auto *UVal = U->getValue();
+  if (isAlwaysAddress(UVal))
+    return true;
+
+  // If it's a call there are cases where we know we are never able to say
+  // anything meaningful about the type they point to, for now.
+  auto *Call = dyn_cast<llvm::CallInst>(UVal);
+  if (not Call)
+    return true;
+
+  // For OpaqueExtractValue, if they have an aggregate operand that is not a
+  // call to an isolated function, we are never able to say anything meaningful
+  // about the type they point to, for now.
+  // So we just treat them if they are never never addresses that point to a
+  // type.
+  if (isCallToTagged(Call, FunctionTags::OpaqueExtractValue))
+    return isCallToIsolatedFunction(Call->getOperand(0));
+
+  // If UVal is a call to a function that was not isolated by revng, the data
+  // layout analysis skips it, and we are never able to say something
+  // meaningful about the type it points to.
+  // So we just treat them if they are never never addresses that point to a
+  // type.
+  return isCallToIsolatedFunction(Call);
+}
+
+SCEVBaseAddressExplorer::BaseSet
 SCEVBaseAddressExplorer::findBases(llvm::ScalarEvolution *SE,
                                    const llvm::SCEV *Root,
                                    const SCEVTypeMap &M) {
-  std::set<const llvm::SCEV *> Result;
-  Worklist.clear();
-  Worklist.push_back(Root);
+  // A traversable Root is traversed even if it's in M, so in that case its
+  // bases are different from the cached ones, that are computed for it as a
+  // sub-expression.
+  SCEVVector RootOperands;
+  if (not isa<llvm::SCEVConstant>(Root) and M.contains(Root)
+      and checkAddressOrTraverse(SE, Root, RootOperands)) {
+    BaseSet Result;
+    for (const llvm::SCEV *Op : RootOperands) {
+      computeBases(SE, Op, M);
+      llvm::append_range(Result, Cache.find(Op)->second);
+    }
+    llvm::sort(Result);
+    Result.erase(std::unique(Result.begin(), Result.end()), Result.end());
+    return Result;
+  }
+
+  computeBases(SE, Root, M);
+  return Cache.find(Root)->second;
+}
 
+void SCEVBaseAddressExplorer::computeBases(llvm::ScalarEvolution *SE,
+                                           const llvm::SCEV *S,
+                                           const SCEVTypeMap &M) {
+  // Visit the SCEV DAG in post-order, so that the bases of the operands of each
+  // SCEV are known when its own bases are computed.
+  Worklist.clear();
+  Worklist.push_back({ S, false });
   while (not Worklist.empty()) {
-    const llvm::SCEV *AddressCandidate = Worklist.pop_back_val();
-    const llvm::SCEV *AddrSCEV = nullptr;
+    auto [AddressCandidate, OperandsDone] = Worklist.back();
+    if (Cache.count(AddressCandidate)) {
+      Worklist.pop_back();
+      continue;
+    }
+
     if (const auto *C = dyn_cast<llvm::SCEVConstant>(AddressCandidate)) {
       // Constants are considered addresses only in case they point to some
       // segment. They are never traversed.
-      auto *ConstantVal = C->getValue();
-      if (isConstantAddress(ConstantVal))
-        AddrSCEV = AddressCandidate;
-    } else {
-      auto NTraversed = checkAddressOrTraverse(SE, AddressCandidate);
-      if (NTraversed) {
-        // If we have traversed AddressCandidate, it means that it doesn't
-        // look like an address SCEV, so we want to keep looking in is
-        // operands to find a base address.
-        // However, it might be a typed SCEVs, so we also have to check if
-        // AddressCandidate is in M. If it is, we consider it to be an address
-        // in any case. In this case, given that we have traversed
-        // AddressCandidate, checkAddressOrTraverse has pushed something on
-        // the Worlist, and we have to clear it to prevent the SCEV
-        // exploration to continue past the address.
-        if (AddressCandidate != Root and M.contains(AddressCandidate)) {
-          // We have to stop the search in this direction. Pop back all the
-          // nodes that have been pushed by checkAddressOrTraverse.
-          for (decltype(NTraversed) I = 0ULL; I < NTraversed; ++I)
-            Worklist.pop_back();
-          AddrSCEV = AddressCandidate;
-        }
+      BaseSet &Bases = Cache[AddressCandidate];
+      if (isConstantAddress(C->getValue()))
+        Bases.push_back(AddressCandidate);
+      Worklist.pop_back();
+      continue;
+    }
 
-      } else {
+    Operands.clear();
+    auto NTraversed = checkAddressOrTraverse(SE, AddressCandidate, Operands);
+    if (not NTraversed) {
+      // If we have not traversed AddressCandidate, it means that it looks like
+      // an address SCEV.
+      BaseSet &Bases = Cache[AddressCandidate];
+      if (isTypedAddress(AddressCandidate))
+        Bases.push_back(AddressCandidate);
+      Worklist.pop_back();
+      continue;
+    }
 
-        // If we have not traversed AddressCandidate, but IsAddr is true. This
-        // means that AddressCandidate looks like an address SCEV.
-        AddrSCEV = AddressCandidate;
+    // If we could traverse AddressCandidate, it means that it doesn't look like
+    // an address SCEV, so we want to keep looking in its operands to find a
+    // base address.
+    // However, it might be a typed SCEV, so we also have to check if
+    // AddressCandidate is in M. If it is, we consider it to be an address in
+    // any case, and we stop the search in this direction.
+    if (M.contains(AddressCandidate)) {
+      Cache[AddressCandidate].push_back(AddressCandidate);
+      Worklist.pop_back();
+      continue;
+    }
 
-        // Despite the fact that AddressCandidate looks like an address, there
-        // are some cases of stuff that looks like an address that should be
-        // ignored.
-        if (auto *U = dyn_cast<llvm::SCEVUnknown>(AddressCandidate)) {
-          auto *UVal = U->getValue();
-          if (not isAlwaysAddress(UVal)) {
-            // If it's a call there are cases where we know we are never able to
-            // say anything meaningful about the type they point to, for now.
-            if (auto *Call = dyn_cast<llvm::CallInst>(UVal)) {
-              // For OpaqueExtractValue, if they have an aggregate operand that
-              // is not a call to an isolated function, we are never able to say
-              // anything meaningful about the type they point to, for now.
-              // So we just treat them if they are never never addresses that
-              // point to a type.
-              if (isCallToTagged(Call, FunctionTags::OpaqueExtractValue)) {
-                if (not isCallToIsolatedFunction(Call->getOperand(0)))
-                  AddrSCEV = nullptr;
-              } else {
-                // If UVal is a call to a function that was not isolated by
-                // revng, the data layout analysis skips it, and we are never
-                // able to say something meaningful about the type it points to.
-                // So we just treat them if they are never never addresses that
-                // point to a type.
-                if (not isCallToIsolatedFunction(Call))
-                  AddrSCEV = nullptr;
-              }
-            }
-          }
-        }
-      }
+    if (not OperandsDone) {
+      Worklist.back().second = true;
+      for (const llvm::SCEV *Op : Operands)
+        if (not Cache.count(Op))
+          Worklist.push_back({ Op, false });
+      continue;
     }
 
-    // Add AddrSCEV to the results if we have found one.
-    if (AddrSCEV != nullptr)
-      Result.insert(AddrSCEV);
+    // All the operands have been explored, merge their bases
+    Worklist.pop_back();
+    BaseSet Bases;
+    for (const llvm::SCEV *Op : Operands)
+      llvm::append_range(Bases, Cache.find(Op)->second);
+    llvm::sort(Bases);
+    Bases.erase(std::unique(Bases.begin(), Bases.end()), Bases.end());
+    Cache[AddressCandidate] = std::move(Bases);
   }
-
-  return Result;
 }
 
 size_t
 SCEVBaseAddressExplorer::checkAddressOrTraverse(llvm::ScalarEvolution *SE,
-                                                const llvm::SCEV *S) {
-  auto OldSize = Worklist.size();
+                                                const llvm::SCEV *S,
+                                                SCEVVector &ToTraverse) {
+  auto OldSize = ToTraverse.size();
   switch (S->getSCEVType()) {
 
   case llvm::scConstant: {
@@ -141,7 +185,7 @@ SCEVBaseAddressExplorer::checkAddressOrTraverse(llvm::ScalarEvolution *SE,
     // Zero extension never changes the value of pointers, so we can safely
     // traverse it.
     const llvm::SCEVZeroExtendExpr *ZE = cast<llvm::SCEVZeroExtendExpr>(S);
-    Worklist.push_back(ZE->getOperand());
+    ToTraverse.push_back(ZE->getOperand());
   } break;
 
   case llvm::scPtrToInt:
@@ -172,7 +216,7 @@ SCEVBaseAddressExplorer::checkAddressOrTraverse(llvm::ScalarEvolution *SE,
         if (not isConstantAddress(C->getValue()))
           continue;
       }
-      Worklist.push_back(Op);
+      ToTraverse.push_back(Op);
     }
   } break;
 
@@ -189,7 +233,7 @@ SCEVBaseAddressExplorer::checkAddressOrTraverse(llvm::ScalarEvolution *SE,
     }
     // The AddRec is never an address, but we traverse its start expression
     // because it could be an address.
-    Worklist.push_back(Start);
+    ToTraverse.push_back(Start);
   } break;
 
   case llvm::scMulExpr: {
@@ -235,7 +279,7 @@ SCEVBaseAddressExplorer::checkAddressOrTraverse(llvm::ScalarEvolution *SE,
           // traverse the composite expression A = B & 0xff00 and keep
           // exploring B, without marking A as address.
           const llvm::SCEV *UDivLHS = UDiv->getLHS();
-          Worklist.push_back(UDivLHS);
+          ToTraverse.push_back(UDivLHS);
           break;
         }
       }
@@ -260,7 +304,7 @@ SCEVBaseAddressExplorer::checkAddressOrTraverse(llvm::ScalarEvolution *SE,
     revng_unreachable("Unknown SCEV kind!");
   }
 
-  auto NewSize = Worklist.size();
+  auto NewSize = ToTraverse.size();
   revng_assert(NewSize >= OldSize);
   return NewSize - OldSize;
 }
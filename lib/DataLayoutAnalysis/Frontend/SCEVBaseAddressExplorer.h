@@ -5,8 +5,8 @@
 //
 
 #include <map>
-#include <set>
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallVector.h"
 
 namespace llvm {
@@ -20,28 +20,51 @@ struct LayoutTypeSystemNode;
 
 /// Class useful to explore an llvm::SCEV expression to find its base
 /// addresses.
+//
+// SCEVs are uniqued, so the expressions of different values often share
+// sub-expressions. The base addresses of each explored sub-expression are
+// cached, so that each of them is explored only once, until clear is called.
 class SCEVBaseAddressExplorer {
 public:
   using SCEVTypeMap = std::map<const llvm::SCEV *, dla::LayoutTypeSystemNode *>;
 
+  /// The base addresses of a SCEV, sorted and without duplicates
+  using BaseSet = llvm::SmallVector<const llvm::SCEV *, 2>;
+
 private:
-  llvm::SmallVector<const llvm::SCEV *, 4> Worklist;
+  using SCEVVector = llvm::SmallVector<const llvm::SCEV *, 4>;
+
+  llvm::SmallVector<std::pair<const llvm::SCEV *, bool>, 8> Worklist;
+  SCEVVector Operands;
+  llvm::DenseMap<const llvm::SCEV *, BaseSet> Cache;
 
 public:
   SCEVBaseAddressExplorer() = default;
   ~SCEVBaseAddressExplorer() = default;
 
-  /// Returns a set containing the SCEVs of \Root 's base addresses.
+  /// Returns the SCEVs of \Root 's base addresses.
   //
   // The function works exploring the AST of the SCEV, going from the \Root
   // towards its operands.
   // If \M is not empty, all the SCEVs with an entry in \M are considered as
   // addresses, and the exploration of the operands does not traverse them, even
   // if the SCEV potentially has the expressive power to do it.
-  std::set<const llvm::SCEV *> findBases(llvm::ScalarEvolution *SE,
-                                         const llvm::SCEV *Root,
-                                         const SCEVTypeMap &M);
+  //
+  // The results are cached, so \SE and \M must not change until clear is
+  // called, except for adding to \M SCEVs that are never traversed.
+  BaseSet findBases(llvm::ScalarEvolution *SE,
+                    const llvm::SCEV *Root,
+                    const SCEVTypeMap &M);
+
+  /// Drops the cached results
+  void clear() { Cache.clear(); }
 
 private:
-  size_t checkAddressOrTraverse(llvm::ScalarEvolution *SE, const llvm::SCEV *S);
+  void computeBases(llvm::ScalarEvolution *SE,
+                    const llvm::SCEV *S,
+                    const SCEVTypeMap &M);
+
+  size_t checkAddressOrTraverse(llvm::ScalarEvolution *SE,
+                                const llvm::SCEV *S,
+                                SCEVVector &ToTraverse);
 };
@@ -23,6 +23,7 @@
 #include "FieldSizeComputation.h"
 
 static Logger<> Log{ "sort-accesses-hierarchically" };
+static dla::RegisterTypeSystemLogger RegisterLog(Log);
 
 namespace dla {
 
@@ -274,21 +275,6 @@ canPushThrough(const NeighborIterator &AIt, const NeighborIterator &BIt) {
   };
 }
 
-// Helper ordering for NeighborIterators. We need it here because we need to use
-// such iterators and keys in associative containers.
-// Notice that this might have undefined behaviour if dereferencing either LHS
-// or RHS is undefined behaviour itself.
-// The bottom line is that we should never insert invalid iterators into
-// associative containers.
-static std::weak_ordering operator<=>(const NeighborIterator &LHS,
-                                      const NeighborIterator &RHS) {
-  const auto &[LHSSucc, LHSTag] = *LHS;
-  const auto &[RHSSucc, RHSTag] = *RHS;
-  if (auto Cmp = LHSSucc <=> RHSSucc; Cmp != 0)
-    return Cmp;
-  return LHSTag <=> RHSTag;
-}
-
 static llvm::SmallPtrSet<LayoutTypeSystemNode *, 8>
 absorbVolatileChildren(LayoutTypeSystem &TS, LayoutTypeSystemNode *Parent) {
 
@@ -367,7 +353,8 @@ static void absorbVolatileChildren(LayoutTypeSystem &TS) {
   }
 }
 
-bool ArrangeAccessesHierarchically::runOnTypeSystem(LayoutTypeSystem &TS) {
+bool ArrangeAccessesHierarchically::runOnTypeSystem(LayoutTypeSystem &TS)
+  const {
   if (VerifyLog.isEnabled())
     revng_assert(TS.verifyDAG());
 
@@ -560,7 +547,10 @@ bool ArrangeAccessesHierarchically::runOnTypeSystem(LayoutTypeSystem &TS) {
         }
       }
 
-      llvm::SmallSet<NeighborIterator, 4> EdgesToErase;
+      // Parent's successors are not touched until all the edges are pushed
+      // down, so the iterators in ChildrenHierarchy are valid until then.
+      // Pushed edges are then erased by value, since erasing invalidates them.
+      llvm::SmallSet<LayoutTypeSystemNode::Link, 4> EdgesToErase;
       for (auto &[EdgeToPushThrough, EdgesToPush] : ChildrenHierarchy) {
 
         if (EdgesToPush.empty())
@@ -570,7 +560,7 @@ bool ArrangeAccessesHierarchically::runOnTypeSystem(LayoutTypeSystem &TS) {
         ToAnalyze.insert(ToPushThrough);
 
         for (auto &[PushedEdgeIt, FinalOE] : EdgesToPush) {
-          EdgesToErase.insert(PushedEdgeIt);
+          EdgesToErase.insert(*PushedEdgeIt);
           auto *ToPushDown = PushedEdgeIt->first;
 
           revng_assert(not isLeaf(ToPushThrough));
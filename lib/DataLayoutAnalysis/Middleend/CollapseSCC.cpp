@@ -2,6 +2,7 @@
 // This file is distributed under the MIT License. See LICENSE.mit for details.
 //
 
+#include <optional>
 #include <set>
 #include <type_traits>
 #include <vector>
@@ -23,6 +24,7 @@
 using namespace llvm;
 
 static Logger<> LogVerbose("dla-collapse-verbose");
+static dla::RegisterTypeSystemLogger RegisterLogVerbose(LogVerbose);
 
 namespace dla {
 
@@ -136,10 +138,9 @@ static bool collapseSCCs(LayoutTypeSystem &TS) {
       auto *Leader = *LeaderIt;
       using DLAGraph = llvm::GraphTraits<LayoutTypeSystemNode *>;
       auto EdgeIt = DLAGraph::child_edge_begin(Leader);
-      auto EdgeEnd = DLAGraph::child_edge_end(Leader);
       auto EdgeNext = DLAGraph::child_edge_end(Leader);
 
-      for (; EdgeIt != EdgeEnd; EdgeIt = EdgeNext) {
+      for (; EdgeIt != DLAGraph::child_edge_end(Leader); EdgeIt = EdgeNext) {
 
         EdgeNext = std::next(EdgeIt);
         auto &Edge = *EdgeIt;
@@ -154,7 +155,7 @@ static bool collapseSCCs(LayoutTypeSystem &TS) {
         if (not Leaders.contains(Child))
           continue;
 
-        TS.eraseEdge(Leader, EdgeIt);
+        EdgeNext = TS.eraseEdge(Leader, EdgeIt);
       }
 
       // Then, for each leader, we add an instance-at-offset-0 edge to the next
@@ -175,7 +176,7 @@ static bool collapseInstanceAtOffset0SCC(LayoutTypeSystem &TS) {
   return collapseSCCs<InstanceOffset0EdgeT>(TS);
 }
 
-bool CollapseEqualitySCC::runOnTypeSystem(LayoutTypeSystem &TS) {
+bool CollapseEqualitySCC::runOnTypeSystem(LayoutTypeSystem &TS) const {
 
   if (VerifyLog.isEnabled())
     revng_assert(TS.verifyConsistency());
@@ -192,13 +193,16 @@ bool CollapseEqualitySCC::runOnTypeSystem(LayoutTypeSystem &TS) {
   return Changed;
 }
 
-bool CollapseInstanceAtOffset0SCC::runOnTypeSystem(LayoutTypeSystem &TS) {
-  Task T(2, "runOnTypeSystem");
+bool CollapseInstanceAtOffset0SCC::runOnTypeSystem(LayoutTypeSystem &TS) const {
+  std::optional<Task> T;
+  if (TS.reportsProgress())
+    T.emplace(2, "runOnTypeSystem");
 
   if (VerifyLog.isEnabled())
     revng_assert(TS.verifyConsistency());
 
-  T.advance("collapseInstanceAtOffset0SCC");
+  if (T)
+    T->advance("collapseInstanceAtOffset0SCC");
   revng_log(LogVerbose, "#### Collapsing Instance-at-offset-0 SCC: ... ");
   bool Changed = collapseInstanceAtOffset0SCC(TS);
   revng_log(LogVerbose, "#### Collapsing Instance-at-offset-0 SCC: Done!");
@@ -208,7 +212,8 @@ bool CollapseInstanceAtOffset0SCC::runOnTypeSystem(LayoutTypeSystem &TS) {
     revng_assert(TS.verifyInstanceAtOffset0DAG());
   }
 
-  T.advance("removeInstanceBackedgesFromInstanceAtOffset0Loops");
+  if (T)
+    T->advance("removeInstanceBackedgesFromInstanceAtOffset0Loops");
   Changed |= removeInstanceBackedgesFromInstanceAtOffset0Loops(TS);
 
   if (VerifyLog.isEnabled()) {
@@ -26,22 +26,6 @@ namespace dla {
 
 using NeighborIterator = LayoutTypeSystem::NeighborIterator;
 
-// Helper ordering for NeighborIterators. We need it here because we need to use
-// such iterators and keys in associative containers, and we want neighbors with
-// lower offset to come first.
-// Notice that this might have undefined behavior if dereferencing either LHS
-// or RHS is undefined behavior itself.
-// The bottom line is that we should never insert invalid iterators into
-// associative containers.
-static std::weak_ordering operator<=>(const NeighborIterator &LHS,
-                                      const NeighborIterator &RHS) {
-  const auto &[LHSSucc, LHSTag] = *LHS;
-  const auto &[RHSSucc, RHSTag] = *RHS;
-  if (auto Cmp = LHSTag <=> RHSTag; Cmp != 0)
-    return Cmp;
-  return LHSSucc <=> RHSSucc;
-}
-
 struct InstanceEdge {
   OffsetExpression OE;
   LayoutTypeSystemNode *Target;
@@ -385,7 +369,7 @@ getEdgeToCompactWithCurrent(LayoutTypeSystemNode *Parent,
   return Current;
 }
 
-bool CompactCompatibleArrays::runOnTypeSystem(LayoutTypeSystem &TS) {
+bool CompactCompatibleArrays::runOnTypeSystem(LayoutTypeSystem &TS) const {
   bool Changed = false;
 
   if (VerifyLog.isEnabled())
@@ -406,10 +390,12 @@ bool CompactCompatibleArrays::runOnTypeSystem(LayoutTypeSystem &TS) {
       if (isLeaf(Parent))
         continue;
 
+      // Compacting edges changes the successors of Parent, invalidating all
+      // the iterators on them, so the end is recomputed at each iteration.
       auto ChildEdgeIt = GT::child_edge_begin(Parent);
       auto ChildEdgeNext = ChildEdgeIt;
-      auto ChildEdgeEnd = GT::child_edge_end(Parent);
-      for (; ChildEdgeIt != ChildEdgeEnd; ChildEdgeIt = ChildEdgeNext) {
+      for (; ChildEdgeIt != GT::child_edge_end(Parent);
+           ChildEdgeIt = ChildEdgeNext) {
 
         ChildEdgeNext = std::next(ChildEdgeIt);
 
@@ -458,8 +444,8 @@ bool CompactCompatibleArrays::runOnTypeSystem(LayoutTypeSystem &TS) {
 
           // Helper lambda to compact the various components into the compacted
           // array.
-          auto Compact = [&](const NeighborIterator &ToCompactIt) {
-            auto &[TargetNode, EdgeTag] = *ToCompactIt;
+          auto Compact = [&](const LayoutTypeSystemNode::Link &ToCompact) {
+            auto &[TargetNode, EdgeTag] = ToCompact;
             uint64_t OldOffset = EdgeTag->getOffsetExpr().Offset;
             revng_assert(OldOffset >= Current.StartOffset);
             uint64_t OffsetInArray = (OldOffset - Current.StartOffset)
@@ -467,19 +453,19 @@ bool CompactCompatibleArrays::runOnTypeSystem(LayoutTypeSystem &TS) {
             TS.addInstanceLink(New,
                                TargetNode,
                                OffsetExpression{ OffsetInArray });
-            return TS.eraseEdge(Parent, ToCompactIt);
+            TS.eraseEdge(Parent, ToCompact);
           };
 
-          // Compact all the array components.
-          const auto VectorToCompact = CompactedWithCurrent.takeVector();
-          revng_assert(VectorToCompact.front() == ChildEdgeIt);
-          for (const NeighborIterator &ToCompact :
-               llvm::drop_begin(VectorToCompact))
-            Compact(ToCompact);
-
-          // We compact ChildEdgeIt as last, so that it updates ChildEdgeNext
-          // properly to continue the outer iteration.
-          ChildEdgeNext = Compact(ChildEdgeIt);
+          // Compact all the array components. Erasing edges invalidates the
+          // iterators, so copy the edges first.
+          revng_assert(CompactedWithCurrent.front() == ChildEdgeIt);
+          SmallVector<LayoutTypeSystemNode::Link, 8> ToCompact;
+          for (const NeighborIterator &EdgeIt : CompactedWithCurrent)
+            ToCompact.push_back(*EdgeIt);
+          CompactedWithCurrent.clear();
+          const LayoutTypeSystemNode::Link CurrentEdge = ToCompact.front();
+          for (const LayoutTypeSystemNode::Link &Edge : ToCompact)
+            Compact(Edge);
 
           OffsetExpression NewStridedOffset{ Current.StartOffset };
           NewStridedOffset.Strides.push_back(Current.Stride);
@@ -488,6 +474,10 @@ bool CompactCompatibleArrays::runOnTypeSystem(LayoutTypeSystem &TS) {
                                     Current.EndOffset,
                                     Current.Stride));
           TS.addInstanceLink(Parent, New, std::move(NewStridedOffset));
+
+          // Continue the outer iteration from the first edge following the
+          // one we started from.
+          ChildEdgeNext = Parent->Successors.upper_bound(CurrentEdge);
         } else {
           revng_assert(CompactedWithCurrent.size() == 1);
           revng_assert(CompactedWithCurrent.front() == ChildEdgeIt);
@@ -18,6 +18,7 @@ using PointerFilterT = EdgeFilteredGraph<LTSN *, dla::isPointerEdge>;
 using namespace llvm;
 
 static Logger<> Log("dla-collapse-single-child");
+static dla::RegisterTypeSystemLogger RegisterLog(Log);
 
 namespace dla {
 bool CollapseSingleChild::collapseSingle(LayoutTypeSystem &TS,
@@ -93,13 +94,8 @@ bool CollapseSingleChild::collapseSingle(LayoutTypeSystem &TS,
       }
 
       // Move Node's predecessor edges to Child, adding Off.
-      auto PredIt = Node->Predecessors.begin();
-      auto PredEnd = Node->Predecessors.end();
-      while (PredIt != PredEnd) {
-        auto Next = std::next(PredIt);
-        TS.moveEdgeTarget(Node, Child, PredIt, Off);
-        PredIt = Next;
-      }
+      while (not Node->Predecessors.empty())
+        TS.moveEdgeTarget(Node, Child, Node->Predecessors.begin(), Off);
 
       TS.mergeNodes({ /*Into=*/Node, /*From=*/Child });
       Node->Size = ChildSize;
@@ -112,7 +108,7 @@ bool CollapseSingleChild::collapseSingle(LayoutTypeSystem &TS,
   return Changed;
 }
 
-bool CollapseSingleChild::runOnTypeSystem(LayoutTypeSystem &TS) {
+bool CollapseSingleChild::runOnTypeSystem(LayoutTypeSystem &TS) const {
   bool Changed = false;
   if (VerifyLog.isEnabled())
     revng_assert(TS.verifyDAG());
@@ -25,7 +25,20 @@ using LTSN = LayoutTypeSystemNode;
 using GraphNodeT = LTSN *;
 using NonPointerFilterT = EdgeFilteredGraph<GraphNodeT, isNotPointerEdge>;
 
-bool ComputeNonInterferingComponents::runOnTypeSystem(LayoutTypeSystem &TS) {
+/// Set the InterferingInfo of \a N, marking it as modified if it changes.
+static bool setInterferingInfo(LayoutTypeSystem &TS,
+                               LTSN *N,
+                               InterferingChildrenInfo Info) {
+  if (N->InterferingInfo == Info)
+    return false;
+
+  N->InterferingInfo = Info;
+  TS.markModified(N);
+  return true;
+}
+
+bool ComputeNonInterferingComponents::runOnTypeSystem(LayoutTypeSystem &TS)
+  const {
   if (VerifyLog.isEnabled())
     revng_assert(TS.verifyDAG());
 
@@ -43,13 +56,14 @@ bool ComputeNonInterferingComponents::runOnTypeSystem(LayoutTypeSystem &TS) {
       revng_assert(N->Size);
 
       struct OrderedChild {
-        dla::LayoutTypeSystemNode::NeighborsSet::iterator ChildIt;
+        // The edge itself, since moving edges invalidates the iterators
+        dla::LayoutTypeSystemNode::Link Child;
         size_t FieldSize;
 
         // Make it sortable with a different order
         std::strong_ordering operator<=>(const OrderedChild &Other) const {
-          auto &ThisEdgeTag = *ChildIt->second;
-          auto &OtherEdgeTag = *Other.ChildIt->second;
+          auto &ThisEdgeTag = *Child.second;
+          auto &OtherEdgeTag = *Other.Child.second;
 
           // Stuff that starts earlier goes first
           if (auto Cmp = ThisEdgeTag <=> OtherEdgeTag; 0 != Cmp)
@@ -60,11 +74,11 @@ bool ComputeNonInterferingComponents::runOnTypeSystem(LayoutTypeSystem &TS) {
             return Cmp;
 
           // Finally sort by address
-          return ChildIt->first <=> Other.ChildIt->first;
+          return Child.first <=> Other.Child.first;
         }
 
         auto getBeginEndByte() const {
-          auto ChildBeginByte = ChildIt->second->getOffsetExpr().Offset;
+          auto ChildBeginByte = Child.second->getOffsetExpr().Offset;
           auto ChildEndByte = ChildBeginByte + FieldSize;
           return std::make_pair(ChildBeginByte, ChildEndByte);
         }
@@ -83,7 +97,7 @@ bool ComputeNonInterferingComponents::runOnTypeSystem(LayoutTypeSystem &TS) {
           continue;
 
         Children.push_back(OrderedChild{
-          .ChildIt = NChildIt,
+          .Child = *NChildIt,
           .FieldSize = getFieldSize(NChildIt->first, NChildIt->second),
         });
       }
@@ -94,7 +108,7 @@ bool ComputeNonInterferingComponents::runOnTypeSystem(LayoutTypeSystem &TS) {
       // constitute a single non-interfering component and we can leave them
       // alone.
       if (Children.empty()) {
-        N->InterferingInfo = AllChildrenAreNonInterfering;
+        Changed |= setInterferingInfo(TS, N, AllChildrenAreNonInterfering);
         continue;
       }
 
@@ -102,7 +116,7 @@ bool ComputeNonInterferingComponents::runOnTypeSystem(LayoutTypeSystem &TS) {
       // nothing to do, because the only children cannot interfere with anything
       // else, and it is already a component on its own.
       if (Children.size() == 1ULL) {
-        N->InterferingInfo = AllChildrenAreNonInterfering;
+        Changed |= setInterferingInfo(TS, N, AllChildrenAreNonInterfering);
         continue;
       }
 
@@ -188,9 +202,9 @@ bool ComputeNonInterferingComponents::runOnTypeSystem(LayoutTypeSystem &TS) {
       if (Components.size() < 2) {
         revng_assert(not Components.empty());
         if (Components.back().NumChildren > 1)
-          N->InterferingInfo = AllChildrenAreInterfering;
+          Changed |= setInterferingInfo(TS, N, AllChildrenAreInterfering);
         else
-          N->InterferingInfo = AllChildrenAreNonInterfering;
+          Changed |= setInterferingInfo(TS, N, AllChildrenAreNonInterfering);
         continue;
       }
 
@@ -223,15 +237,18 @@ bool ComputeNonInterferingComponents::runOnTypeSystem(LayoutTypeSystem &TS) {
         // While moving the edges, the offset on the edge is updated.
         using llvm::iterator_range;
         auto OrderedChildRange = iterator_range(C.StartChildIt, C.EndChildIt);
-        for (auto &OrderedChild : OrderedChildRange)
-          TS.moveEdgeSource(N, New, OrderedChild.ChildIt, -C.StartByte);
+        for (auto &OrderedChild : OrderedChildRange) {
+          auto ChildIt = N->Successors.find(OrderedChild.Child);
+          revng_assert(ChildIt != N->Successors.end());
+          TS.moveEdgeSource(N, New, ChildIt, -C.StartByte);
+        }
 
         // Add a link between N and the New node representing the component.
         // The component is at offset C.StartByte inside N.
         TS.addInstanceLink(N, New, OffsetExpression(C.StartByte));
       }
 
-      N->InterferingInfo = AllChildrenAreNonInterfering;
+      Changed |= setInterferingInfo(TS, N, AllChildrenAreNonInterfering);
     }
   }
 
@@ -3,10 +3,14 @@
 //
 
 #include <memory>
+#include <set>
 #include <type_traits>
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/iterator_range.h"
 #include "llvm/Support/Debug.h"
 
@@ -22,6 +26,7 @@
 using namespace llvm;
 
 static Logger<> Log("dla-compute-upper-member-access");
+static dla::RegisterTypeSystemLogger RegisterLog(Log);
 
 namespace dla {
 
@@ -31,12 +36,39 @@ using NonPointerFilterT = EdgeFilteredGraph<GraphNodeT, isNotPointerEdge>;
 using ConstNonPointerFilterT = EdgeFilteredGraph<const LTSN *,
                                                  isNotPointerEdge>;
 
-bool ComputeUpperMemberAccesses::runOnTypeSystem(LayoutTypeSystem &TS) {
-  if (VerifyLog.isEnabled())
-    revng_assert(TS.verifyDAG());
+static uint64_t computeUpperMember(const LTSN *N) {
+  revng_log(Log, "N->ID: " << N->ID);
+  revng_assert(not isLeaf(N) or N->Size);
+  uint64_t FinalSize = N->Size;
+
+  // Look at all the instance-of edges and inheritance edges all together.
+  revng_log(Log, "N's children");
+  LoggerIndent Indent{ Log };
+  for (auto &[Child, EdgeTag] : children_edges<ConstNonPointerFilterT>(N)) {
+    revng_log(Log, "Child->ID: " << Child->ID);
+    revng_log(Log,
+              "EdgeTag->Kind: "
+                << dla::TypeLinkTag::toString(EdgeTag->getKind()));
+    FinalSize = std::max(FinalSize, getFieldUpperMember(Child, EdgeTag));
+  }
+
+  revng_assert(FinalSize);
+  return FinalSize;
+}
+
+static bool updateUpperMember(LayoutTypeSystem &TS, LTSN *N) {
+  uint64_t FinalSize = computeUpperMember(N);
+  if (FinalSize == N->Size)
+    return false;
+
+  N->Size = FinalSize;
+  TS.markModified(N);
+  return true;
+}
+
+static bool computeAllUpperMembers(LayoutTypeSystem &TS) {
   bool Changed = false;
 
-  using LTSN = LayoutTypeSystemNode;
   std::set<const LTSN *> Visited;
   for (LTSN *Root : llvm::nodes(&TS)) {
     revng_log(Log, "Root ID: " << Root->ID);
@@ -52,31 +84,81 @@ bool ComputeUpperMemberAccesses::runOnTypeSystem(LayoutTypeSystem &TS) {
     revng_log(Log, "post_order_ext from Root");
     LoggerIndent MoreIndent{ Log };
 
-    for (LTSN *N : post_order_ext(NonPointerFilterT(Root), Visited)) {
-      revng_log(Log, "N->ID: " << N->ID);
-      revng_assert(not isLeaf(N) or N->Size);
-      uint64_t FinalSize = N->Size;
-
-      // Look at all the instance-of edges and inheritance edges all together.
-      revng_log(Log, "N's children");
-      LoggerIndent MoreMoreIndent{ Log };
-      for (auto &[Child, EdgeTag] : children_edges<ConstNonPointerFilterT>(N)) {
-        revng_log(Log, "Child->ID: " << Child->ID);
-        revng_log(Log,
-                  "EdgeTag->Kind: "
-                    << dla::TypeLinkTag::toString(EdgeTag->getKind()));
-        FinalSize = std::max(FinalSize, getFieldUpperMember(Child, EdgeTag));
-      }
-
-      if (FinalSize != N->Size)
-        Changed = true;
-
-      N->Size = FinalSize;
-      revng_assert(FinalSize);
-    }
+    for (LTSN *N : post_order_ext(NonPointerFilterT(Root), Visited))
+      Changed |= updateUpperMember(TS, N);
   }
 
   return Changed;
 }
 
+static bool computeDirtyUpperMembers(LayoutTypeSystem &TS, uint64_t Since) {
+  bool Changed = false;
+
+  // The upper member of a node only depends on its non-pointer children, so
+  // the nodes that need to be recomputed are the ones modified since the last
+  // run, along with all their non-pointer ancestors. Nodes can be modified in
+  // many ways (merged, collapsed, with new edges, with a different size), so
+  // we don't try to tell which modifications affect the ancestors.
+  llvm::SmallVector<LTSN *, 16> Dirty;
+  llvm::SmallPtrSet<LTSN *, 16> IsDirty;
+  for (LTSN *N : llvm::nodes(&TS))
+    if (TS.isModifiedSince(N, Since) and IsDirty.insert(N).second)
+      Dirty.push_back(N);
+
+  revng_log(Log, "Modified nodes: " << Dirty.size());
+
+  for (size_t I = 0; I < Dirty.size(); ++I)
+    for (auto &Edge : Dirty[I]->Predecessors)
+      if (isNotPointerEdge(Edge) and IsDirty.insert(Edge.first).second)
+        Dirty.push_back(Edge.first);
+
+  revng_log(Log, "Nodes to recompute: " << Dirty.size());
+
+  // Recompute the dirty nodes children first, like computeAllUpperMembers
+  // does. The non-pointer edges form a DAG, so this visits all of them.
+  llvm::DenseMap<const LTSN *, size_t> PendingChildren;
+  llvm::SmallVector<LTSN *, 16> Ready;
+  for (LTSN *N : Dirty) {
+    size_t &Pending = PendingChildren[N];
+    for (auto &Edge : N->Successors)
+      if (isNotPointerEdge(Edge) and IsDirty.contains(Edge.first))
+        ++Pending;
+    if (not Pending)
+      Ready.push_back(N);
+  }
+
+  size_t NumVisited = 0;
+  while (not Ready.empty()) {
+    LTSN *N = Ready.pop_back_val();
+    ++NumVisited;
+
+    Changed |= updateUpperMember(TS, N);
+
+    for (auto &Edge : N->Predecessors)
+      if (isNotPointerEdge(Edge) and not --PendingChildren[Edge.first])
+        Ready.push_back(Edge.first);
+  }
+  revng_assert(NumVisited == Dirty.size());
+
+  return Changed;
+}
+
+bool ComputeUpperMemberAccesses::runOnTypeSystem(LayoutTypeSystem &TS) const {
+  if (VerifyLog.isEnabled())
+    revng_assert(TS.verifyDAG());
+
+  return computeAllUpperMembers(TS);
+}
+
+bool ComputeUpperMemberAccesses::runOnModifiedNodes(LayoutTypeSystem &TS,
+                                                    uint64_t DirtySince) const {
+  if (not DirtySince)
+    return runOnTypeSystem(TS);
+
+  if (VerifyLog.isEnabled())
+    revng_assert(TS.verifyDAG());
+
+  return computeDirtyUpperMembers(TS, DirtySince);
+}
+
 } // end namespace dla
@@ -17,6 +17,7 @@
 using namespace llvm;
 
 static Logger<> Log("dla-prune");
+static dla::RegisterTypeSystemLogger RegisterLog(Log);
 
 namespace dla {
 
@@ -24,7 +25,8 @@ using LTSN = LayoutTypeSystemNode;
 using GraphNodeT = LTSN *;
 using NonPointerFilterT = EdgeFilteredGraph<GraphNodeT, isNotPointerEdge>;
 
-bool PruneLayoutNodesWithoutLayout::runOnTypeSystem(LayoutTypeSystem &TS) {
+bool PruneLayoutNodesWithoutLayout::runOnTypeSystem(LayoutTypeSystem &TS)
+  const {
   bool Changed = false;
 
   if (VerifyLog.isEnabled())
@@ -2,7 +2,23 @@
 // This file is distributed under the MIT License. See LICENSE.mit for details.
 //
 
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
 #include "llvm/Support/Progress.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include "revng/Support/Assert.h"
 #include "revng/Support/Debug.h"
@@ -29,7 +45,7 @@ const char RemoveInvalidPointers::ID = 0;
 const char ResolveLeafUnions::ID = 0;
 const char SimplifyInstanceAtOffset0::ID = 0;
 
-static std::string getStepNameFromID(const void *ID) {
+std::string getStepNameFromID(const void *ID) {
   if (ID == ArrangeAccessesHierarchically::getID())
     return "ArrangeAccessesHierarchically";
   else if (ID == CollapseEqualitySCC::getID())
@@ -69,8 +85,56 @@ static std::string getStepNameFromID(const void *ID) {
 }
 
 static Logger<> DLAStepManagerLog("dla-step-manager");
+static RegisterTypeSystemLogger RegisterDLAStepManagerLog(DLAStepManagerLog);
 static Logger<> DLADumpDot("dla-step-dump-dot");
 
+using namespace llvm::cl;
+
+static opt<std::string> CheckpointPrefix("dla-checkpoint",
+                                         desc("Write checkpoints of the DLA "
+                                              "type system to "
+                                              "<prefix>-<index>.dlats, "
+                                              "where index 0 is the output "
+                                              "of the frontend and index N "
+                                              "is the output of the N-th "
+                                              "middle-end step. The "
+                                              "intermediate steps run on "
+                                              "groups of independent nodes, "
+                                              "written to "
+                                              "<prefix>-<index>-<group>"
+                                              ".dlats"),
+                                         value_desc("prefix"),
+                                         Hidden);
+
+static list<unsigned> CheckpointAfter("dla-checkpoint-after",
+                                      desc("Indices of the DLA checkpoints "
+                                           "to write. All of them if "
+                                           "empty."),
+                                      CommaSeparated,
+                                      Hidden);
+
+static bool isCheckpointEnabled() {
+  return not CheckpointPrefix.empty();
+}
+
+static void writeCheckpoint(const LayoutTypeSystem &TS,
+                            unsigned Index,
+                            std::optional<size_t> Group = std::nullopt) {
+  if (not CheckpointAfter.empty()
+      and not llvm::is_contained(CheckpointAfter, Index))
+    return;
+
+  std::string FileName = CheckpointPrefix + "-" + std::to_string(Index);
+  if (Group)
+    FileName += "-" + std::to_string(*Group);
+  FileName += ".dlats";
+  std::error_code EC;
+  llvm::raw_fd_ostream File(FileName, EC, llvm::sys::fs::OF_None);
+  if (EC)
+    revng_abort(("Cannot open " + FileName + ": " + EC.message()).c_str());
+  TS.serialize(File);
+}
+
 [[nodiscard]] bool StepManager::addStep(std::unique_ptr<Step> S) {
   const void *StepID = S->getStepID();
 
@@ -117,26 +181,371 @@ static Logger<> DLADumpDot("dla-step-dump-dot");
   return true;
 }
 
-void StepManager::run(LayoutTypeSystem &TS) {
-  if (not hasValidSchedule())
-    revng_abort("Cannot run a on LayoutTypeSystem: invalid schedule");
+void StepManager::addDefaultSteps(size_t PtrSize) {
+  //
+  // Graph normalization phase
+  //
+  revng_check(addStep<RemoveInvalidPointers>(PtrSize));
+  revng_check(addStep<CollapseEqualitySCC>());
+  revng_check(addStep<CollapseInstanceAtOffset0SCC>());
+  revng_check(addStep<SimplifyInstanceAtOffset0>());
+  revng_check(addStep<PruneLayoutNodesWithoutLayout>());
+  revng_check(addStep<ComputeUpperMemberAccesses>());
+  revng_check(addStep<RemoveInvalidStrideEdges>());
+  revng_check(addStep<PruneLayoutNodesWithoutLayout>());
+  revng_check(addStep<ComputeUpperMemberAccesses>());
+  revng_check(addStep<DecomposeStridedEdges>());
+
+  //
+  // Graph optimization phase
+  //
+  revng_check(addStep<CollapseSingleChild>());
+  revng_check(addStep<DeduplicateFields>());
+  revng_check(addStep<MergePointeesOfPointerUnion>(PtrSize));
+  revng_check(addStep<MergePointerNodes>());
+  revng_check(addStep<CollapseInstanceAtOffset0SCC>());
+  revng_check(addStep<SimplifyInstanceAtOffset0>());
+  revng_check(addStep<PruneLayoutNodesWithoutLayout>());
+  revng_check(addStep<ComputeUpperMemberAccesses>());
+  revng_check(addStep<RemoveInvalidStrideEdges>());
+  revng_check(addStep<PruneLayoutNodesWithoutLayout>());
+  revng_check(addStep<ComputeUpperMemberAccesses>());
+
+  revng_check(addStep<MergePointerNodes>());
+  // CollapseSingleChild and DeduplicateFields run before
+  // CompactCompatibleArrays and ArrangeAccessesHierarchically, to allow them to
+  // produce better results
+  revng_check(addStep<CollapseSingleChild>());
+  revng_check(addStep<DeduplicateFields>());
+  revng_check(addStep<ArrangeAccessesHierarchically>());
+  revng_check(addStep<CompactCompatibleArrays>());
+  revng_check(addStep<PushDownPointers>());
+  // ArrangeAccessesHierarchically can move pointer edges around in some cases,
+  // so we want to run MergePointerNodes again afterwards.
+  revng_check(addStep<MergePointerNodes>());
+  // CollapseSingleChild and DeduplicateFields run again after
+  // CompactCompatibleArrays and ArrangeAccessesHierarchically, to allow them to
+  // improve the results even further.
+  revng_check(addStep<ResolveLeafUnions>());
+  revng_check(addStep<CollapseSingleChild>());
+  revng_check(addStep<DeduplicateFields>());
+  revng_check(addStep<ComputeNonInterferingComponents>());
+}
+
+StepStatistics &StepStatistics::operator+=(const StepStatistics &Other) {
+  NumRuns += Other.NumRuns;
+  Seconds += Other.Seconds;
+  NumNodes += Other.NumNodes;
+  NumInstanceLinks += Other.NumInstanceLinks;
+  NumPointerLinks += Other.NumPointerLinks;
+  NumEqualityLinks += Other.NumEqualityLinks;
+  NumCreatedNodes += Other.NumCreatedNodes;
+  NumMergedNodes += Other.NumMergedNodes;
+  NumRemovedNodes += Other.NumRemovedNodes;
+  NodeMemory += Other.NodeMemory;
+  return *this;
+}
+
+/// Fill the fields of \a Stats that describe the current state of \a TS
+static void collectSizes(const LayoutTypeSystem &TS, StepStatistics &Stats) {
+  Stats.NumNodes = TS.getNumLayouts();
+  Stats.NodeMemory = TS.getNodeMemory();
+  for (const LayoutTypeSystemNode *N : TS.getLayoutsRange()) {
+    for (const auto &[Succ, Tag] : N->Successors) {
+      switch (Tag->getKind()) {
+      case TypeLinkTag::LK_Instance:
+        ++Stats.NumInstanceLinks;
+        break;
+      case TypeLinkTag::LK_Pointer:
+        ++Stats.NumPointerLinks;
+        break;
+      case TypeLinkTag::LK_Equality:
+        ++Stats.NumEqualityLinks;
+        break;
+      default:
+        revng_abort("Unexpected link kind");
+      }
+    }
+  }
+}
+
+std::vector<StepStatistics>
+StepManager::runSchedule(LayoutTypeSystem &TS, size_t Group) const {
+  // For each Step ID, the generation of TS at the end of its last run.
+  llvm::DenseMap<const void *, uint64_t> LastRunGeneration;
+
+  // For each Step ID, the value of NumChanges the last time a Step with that ID
+  // ran without changing anything. If no other Step changed TS in the
+  // meantime, running it again is useless.
+  llvm::DenseMap<const void *, uint64_t> ConvergedAt;
+  uint64_t NumChanges = 0ULL;
+
   int x = 0;
-  if (DLADumpDot.isEnabled())
-    TS.dumpDotOnFile("type-system-0.dot", true);
+  bool ReportProgress = TS.reportsProgress();
+  bool DumpDot = ReportProgress and DLADumpDot.isEnabled();
+  bool Checkpoint = ReportProgress and isCheckpointEnabled();
+
+  // Timers are not thread-safe, so only time the Steps on the main thread
+  bool TimeSteps = ReportProgress and llvm::TimePassesIsEnabled;
+
+  std::optional<llvm::Task> T;
+  if (ReportProgress)
+    T.emplace(Schedule.size(), "StepManager::runSchedule");
+
+  std::vector<StepStatistics> Statistics;
+  if (CollectStatistics)
+    Statistics.resize(Schedule.size());
 
-  llvm::Task T{ Schedule.size(), "StepManager::run" };
   for (auto &S : Schedule) {
-    T.advance(getStepNameFromID(S->getStepID()));
-    S->runOnTypeSystem(TS);
+    const void *ID = S->getStepID();
+    if (T)
+      T->advance(getStepNameFromID(ID));
     ++x;
-    if (DLADumpDot.isEnabled()) {
+
+    auto ConvergedIt = ConvergedAt.find(ID);
+    if (ConvergedIt != ConvergedAt.end()
+        and ConvergedIt->second == NumChanges) {
+      revng_log(DLAStepManagerLog,
+                "Skipping Step " << getStepNameFromID(ID)
+                                 << ": nothing changed since its last run");
+      if (CollectStatistics)
+        collectSizes(TS, Statistics[x - 1]);
+      if (Checkpoint)
+        writeCheckpoint(TS, x, Group);
+      continue;
+    }
+
+    uint64_t InitialGeneration = TS.getGeneration();
+    uint64_t InitialNID = TS.getNID();
+    uint64_t InitialMerged = TS.getNumMergedNodes();
+    uint64_t InitialRemoved = TS.getNumRemovedNodes();
+    auto Start = std::chrono::steady_clock::now();
+    bool Changed = false;
+    {
+      std::string Name = getStepNameFromID(ID);
+      llvm::NamedRegionTimer Timer(Name,
+                                   Name,
+                                   "dla-steps",
+                                   "DLA middle-end Steps",
+                                   TimeSteps);
+      Changed = S->runOnModifiedNodes(TS, LastRunGeneration.lookup(ID));
+    }
+    std::chrono::duration<double> Elapsed = std::chrono::steady_clock::now()
+                                            - Start;
+    Changed |= TS.getGeneration() != InitialGeneration;
+    LastRunGeneration[ID] = TS.getGeneration();
+
+    if (CollectStatistics) {
+      StepStatistics &Stats = Statistics[x - 1];
+      Stats.NumRuns = 1;
+      Stats.Seconds = Elapsed.count();
+      Stats.NumCreatedNodes = TS.getNID() - InitialNID;
+      Stats.NumMergedNodes = TS.getNumMergedNodes() - InitialMerged;
+      Stats.NumRemovedNodes = TS.getNumRemovedNodes() - InitialRemoved;
+      collectSizes(TS, Stats);
+    }
+
+    if (Changed)
+      ++NumChanges;
+    else
+      ConvergedAt[ID] = NumChanges;
+
+    if (DumpDot) {
       revng_log(DLADumpDot,
                 "Step " << getStepNameFromID(S->getStepID())
-                        << " Index: " << x);
-      std::string DotName = "type-system-" + std::to_string(x) + ".dot";
+                        << " Index: " << x << " Group: " << Group);
+      std::string DotName = "type-system-" + std::to_string(x) + "-"
+                            + std::to_string(Group) + ".dot";
       TS.dumpDotOnFile(DotName.c_str(), true);
     }
+
+    if (Checkpoint)
+      writeCheckpoint(TS, x, Group);
   }
+
+  return Statistics;
+}
+
+using LTSN = LayoutTypeSystemNode;
+using NodeVector = std::vector<LTSN *>;
+
+/// Maximum number of groups in which the components are processed.
+//
+// This doesn't depend on the number of threads, so that the groups, and hence
+// the IDs of the new nodes, are the same on all machines. It's larger than the
+// number of threads of most machines, so that a thread that finishes early can
+// pick up more work.
+static constexpr size_t MaxComponentGroups = 64;
+
+/// Partition the nodes of \a TS into at most \a MaxGroups groups, so that no
+/// edge connects nodes in different groups.
+//
+// The weakly connected components are assigned to the groups largest first,
+// each to the group with the fewest nodes so far, to balance the work.
+// The nodes in each group are sorted by ID, and the groups are sorted by the ID
+// of their first node, so the partition only depends on TS and MaxGroups.
+static std::vector<NodeVector>
+partitionComponents(const LayoutTypeSystem &TS, size_t MaxGroups) {
+  std::vector<NodeVector> Components;
+  std::vector<bool> Visited(TS.getNID(), false);
+  for (LTSN *Root : llvm::nodes(&TS)) {
+    if (Visited[Root->ID])
+      continue;
+
+    NodeVector &Component = Components.emplace_back();
+    Visited[Root->ID] = true;
+    Component.push_back(Root);
+    for (size_t I = 0; I < Component.size(); ++I) {
+      LTSN *N = Component[I];
+      for (auto *Neighbors : { &N->Successors, &N->Predecessors }) {
+        for (auto &[Neighbor, Tag] : *Neighbors) {
+          if (not Visited[Neighbor->ID]) {
+            Visited[Neighbor->ID] = true;
+            Component.push_back(Neighbor);
+          }
+        }
+      }
+    }
+  }
+
+  revng_log(DLAStepManagerLog, "Components: " << Components.size());
+
+  llvm::stable_sort(Components, [](const NodeVector &A, const NodeVector &B) {
+    return A.size() > B.size();
+  });
+
+  std::vector<NodeVector> Groups(std::min(MaxGroups, Components.size()));
+  if (Groups.empty())
+    return Groups;
+
+  using Load = std::pair<size_t, size_t>;
+  std::priority_queue<Load, std::vector<Load>, std::greater<Load>> Loads;
+  for (size_t I = 0; I < Groups.size(); ++I)
+    Loads.push({ 0, I });
+
+  for (NodeVector &Component : Components) {
+    auto [Size, Index] = Loads.top();
+    Loads.pop();
+    llvm::append_range(Groups[Index], Component);
+    Loads.push({ Size + Component.size(), Index });
+  }
+
+  for (NodeVector &Group : Groups)
+    llvm::sort(Group, [](const LTSN *A, const LTSN *B) {
+      return A->ID < B->ID;
+    });
+
+  // Each group has at least a component, since there are no more groups than
+  // components.
+  llvm::sort(Groups, [](const NodeVector &A, const NodeVector &B) {
+    return A.front()->ID < B.front()->ID;
+  });
+
+  return Groups;
+}
+
+std::vector<StepStatistics>
+StepManager::runOnComponents(LayoutTypeSystem &TS, unsigned NumThreads) const {
+  llvm::Task T{ 2, "StepManager::run" };
+  T.advance("Run on components");
+
+  // Steps can create nodes out of nothing, so an empty TS is a single group
+  std::vector<NodeVector> Groups = partitionComponents(TS, MaxComponentGroups);
+  if (Groups.empty())
+    Groups.emplace_back();
+
+  std::vector<std::unique_ptr<LayoutTypeSystem>> GroupTS(Groups.size());
+  std::vector<std::vector<StepStatistics>> GroupStatistics(Groups.size());
+
+  auto RunOnGroup = [&](size_t I, bool Serial) {
+    GroupTS[I] = TS.extractNodes(Groups[I]);
+    GroupTS[I]->setReportProgress(Serial);
+    GroupStatistics[I] = runSchedule(*GroupTS[I], I);
+  };
+
+  // Dumping the graph after each step and Loggers are not thread-safe, so the
+  // groups are processed one at a time. They are the same groups, and they are
+  // merged in the same order, so the result doesn't change.
+  bool DumpAfterSteps = DLADumpDot.isEnabled() or isCheckpointEnabled();
+  if (NumThreads <= 1 or DumpAfterSteps or isTypeSystemLoggingEnabled()) {
+    llvm::Task GroupsTask(Groups.size(), "Run on component groups");
+    for (size_t I = 0; I < Groups.size(); ++I) {
+      GroupsTask.advance("Group " + std::to_string(I));
+      RunOnGroup(I, /* Serial */ true);
+    }
+  } else {
+    llvm::ThreadPool Pool(llvm::hardware_concurrency(NumThreads));
+    for (size_t I = 0; I < Groups.size(); ++I)
+      Pool.async([&RunOnGroup, I] { RunOnGroup(I, /* Serial */ false); });
+    Pool.wait();
+  }
+
+  std::vector<StepStatistics> Statistics;
+  if (CollectStatistics) {
+    Statistics.resize(Schedule.size());
+    for (const std::vector<StepStatistics> &Group : GroupStatistics)
+      for (size_t I = 0; I < Group.size(); ++I)
+        Statistics[I] += Group[I];
+  }
+
+  // Merge back in a fixed order, so that new nodes get deterministic IDs.
+  T.advance("Merge components");
+  for (size_t I = 0; I < Groups.size(); ++I) {
+    TS.replaceNodes(Groups[I], *GroupTS[I]);
+    GroupTS[I].reset();
+  }
+
+  return Statistics;
+}
+
+void StepManager::run(LayoutTypeSystem &TS, unsigned NumThreads) {
+  if (not hasValidSchedule())
+    revng_abort("Cannot run a on LayoutTypeSystem: invalid schedule");
+
+  if (DLADumpDot.isEnabled())
+    TS.dumpDotOnFile("type-system-0.dot", true);
+  if (isCheckpointEnabled())
+    writeCheckpoint(TS, 0);
+
+  Statistics = runOnComponents(TS, NumThreads);
+
+  unsigned Last = Schedule.size();
+  if (DLADumpDot.isEnabled())
+    TS.dumpDotOnFile("type-system-" + std::to_string(Last) + ".dot", true);
+  if (isCheckpointEnabled())
+    writeCheckpoint(TS, Last);
+}
+
+void StepManager::printStatistics(llvm::raw_ostream &OS) const {
+  llvm::json::OStream JSON(OS, /* IndentSize */ 2);
+  JSON.array([&] {
+    for (size_t I = 0; I < Statistics.size(); ++I) {
+      const StepStatistics &Stats = Statistics[I];
+      JSON.object([&] {
+        JSON.attribute("Index", static_cast<int64_t>(I + 1));
+        JSON.attribute("Step", getStepNameFromID(Schedule[I]->getStepID()));
+        JSON.attribute("Runs", static_cast<int64_t>(Stats.NumRuns));
+        JSON.attribute("Seconds", Stats.Seconds);
+        JSON.attribute("Nodes", static_cast<int64_t>(Stats.NumNodes));
+        JSON.attributeObject("Links", [&] {
+          JSON.attribute("Instance",
+                         static_cast<int64_t>(Stats.NumInstanceLinks));
+          JSON.attribute("Pointer",
+                         static_cast<int64_t>(Stats.NumPointerLinks));
+          JSON.attribute("Equality",
+                         static_cast<int64_t>(Stats.NumEqualityLinks));
+        });
+        JSON.attribute("CreatedNodes",
+                       static_cast<int64_t>(Stats.NumCreatedNodes));
+        JSON.attribute("MergedNodes",
+                       static_cast<int64_t>(Stats.NumMergedNodes));
+        JSON.attribute("RemovedNodes",
+                       static_cast<int64_t>(Stats.NumRemovedNodes));
+        JSON.attribute("NodeMemory", static_cast<int64_t>(Stats.NodeMemory));
+      });
+    }
+  });
+  OS << "\n";
 }
 
 } // end namespace dla
@@ -6,11 +6,14 @@
 
 #include <algorithm>
 #include <memory>
+#include <string>
 #include <type_traits>
+#include <vector>
 
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include "revng-c/DataLayoutAnalysis/DLATypeSystem.h"
 
@@ -23,6 +26,9 @@ namespace dla {
 // are really just empty.
 class LayoutTypeSystem;
 
+/// Get the name of the Step class with ID \a ID
+std::string getStepNameFromID(const void *ID);
+
 class Step {
 public:
   using IDSet = llvm::SmallPtrSet<const void *, 2>;
@@ -48,7 +54,20 @@ public:
   virtual ~Step() = default;
 
   /// Runs the Step on TS, returns true if it has applied changes to TS.
-  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) = 0;
+  //
+  // Steps are run concurrently on different LayoutTypeSystems, so they are
+  // const and must not have mutable state.
+  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) const = 0;
+
+  /// Runs the Step on TS, knowing that only the nodes modified after
+  /// generation \a DirtySince can have changed since the last run of a Step
+  /// with the same ID. Zero means that all the nodes must be considered.
+  //
+  // Steps that don't support incremental runs just look at all the nodes.
+  virtual bool
+  runOnModifiedNodes(LayoutTypeSystem &TS, uint64_t DirtySince) const {
+    return runOnTypeSystem(TS);
+  }
 
   IDSetConstRef getDependencies() const { return Dependencies; }
   IDSetConstRef getInvalidated() const { return Invalidated; }
@@ -70,7 +89,7 @@ public:
 
   virtual ~CollapseEqualitySCC() override = default;
 
-  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) const override;
 };
 
 /// Collapses strongly connected components in the type system made of
@@ -85,7 +104,7 @@ public:
 
   virtual ~CollapseInstanceAtOffset0SCC() override = default;
 
-  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) const override;
 };
 
 /// dla::Step that simplifies instance-at-offset-0 edges, to reduce the
@@ -105,7 +124,7 @@ public:
 
   virtual ~SimplifyInstanceAtOffset0() override = default;
 
-  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) const override;
 };
 
 /// dla::Step that removes leaf nodes without valid layout information
@@ -123,7 +142,7 @@ public:
 
   virtual ~PruneLayoutNodesWithoutLayout() override = default;
 
-  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) const override;
 };
 
 /// dla::Step that merge pointer nodes pointing to the same layout
@@ -137,7 +156,7 @@ public:
 
   virtual ~MergePointerNodes() override = default;
 
-  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) const override;
 };
 
 /// dla::Step that takes all strided edges and decompose in edges with only one
@@ -152,7 +171,7 @@ public:
 
   virtual ~DecomposeStridedEdges() override = default;
 
-  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) const override;
 };
 
 /// dla::Step that computes and propagates information on accesses and type
@@ -177,7 +196,10 @@ public:
 
   virtual ~ComputeUpperMemberAccesses() override = default;
 
-  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) const override;
+
+  virtual bool runOnModifiedNodes(LayoutTypeSystem &TS,
+                                  uint64_t DirtySince) const override;
 };
 
 /// dla::Step that removes invalid stride edges
@@ -197,7 +219,7 @@ public:
 
   virtual ~RemoveInvalidStrideEdges() override = default;
 
-  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) const override;
 };
 
 /// dla::Step that merge pointee nodes of union of pointers
@@ -221,7 +243,7 @@ public:
 
   virtual ~MergePointeesOfPointerUnion() override = default;
 
-  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) const override;
 };
 
 /// dla::Step that collapses nodes that have a single child at offset 0
@@ -241,7 +263,7 @@ public:
 
   virtual ~CollapseSingleChild() override = default;
 
-  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) const override;
 };
 
 /// dla::Step that decompose the LayoutTypeSystem into components, each of which
@@ -261,7 +283,7 @@ public:
 
   virtual ~ComputeNonInterferingComponents() override = default;
 
-  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) const override;
 };
 
 /// dla::Step that removes invalid pointer edges
@@ -277,7 +299,7 @@ public:
 
   virtual ~RemoveInvalidPointers() override = default;
 
-  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) const override;
 };
 
 /// dla::Step that tries to compact partly overlapping compatible arrays
@@ -297,7 +319,7 @@ public:
 
   virtual ~CompactCompatibleArrays() override = default;
 
-  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) const override;
 };
 
 /// dla::Step that tries to pushes down instance edges that are actually part of
@@ -318,7 +340,7 @@ public:
 
   virtual ~ArrangeAccessesHierarchically() override = default;
 
-  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) const override;
 };
 
 /// dla::Step that tries to move pointer edges to push further down in the type
@@ -333,7 +355,7 @@ public:
 
   virtual ~PushDownPointers() override = default;
 
-  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) const override;
 };
 
 /// dla::Step that resolves unions of primitive and pointer types
@@ -347,7 +369,7 @@ public:
 
   virtual ~ResolveLeafUnions() override = default;
 
-  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) const override;
 };
 
 /// dla::Step that merges structurally identical subtrees of an interfering
@@ -362,7 +384,7 @@ public:
 
   virtual ~DeduplicateFields() override = default;
 
-  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override;
+  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) const override;
 };
 
 inline DecomposeStridedEdges::DecomposeStridedEdges() :
@@ -391,6 +413,34 @@ bool intersect(const RangeT &R1, const RangeT &R2) {
   return intersect(R1.begin(), R1.end(), R2.begin(), R2.end());
 }
 
+/// Statistics about the execution of a Step of the schedule
+//
+// When the schedule runs on independent components, the statistics of the
+// components are summed, so Seconds is the total time spent by all threads.
+struct StepStatistics {
+  /// Number of times the Step actually ran instead of being skipped
+  uint64_t NumRuns = 0;
+  /// Wall time spent running the Step
+  double Seconds = 0.0;
+
+  /// Number of nodes after the Step
+  uint64_t NumNodes = 0;
+  /// Number of links of each kind after the Step
+  uint64_t NumInstanceLinks = 0;
+  uint64_t NumPointerLinks = 0;
+  uint64_t NumEqualityLinks = 0;
+
+  /// Number of nodes created, merged into other nodes, and removed by the Step
+  uint64_t NumCreatedNodes = 0;
+  uint64_t NumMergedNodes = 0;
+  uint64_t NumRemovedNodes = 0;
+
+  /// Number of bytes allocated for nodes after the Step
+  uint64_t NodeMemory = 0;
+
+  StepStatistics &operator+=(const StepStatistics &Other);
+};
+
 class StepManager {
 
 public:
@@ -408,6 +458,10 @@ public:
   using sched_const_iterator = decltype(Schedule)::const_iterator;
   using sched_const_range = llvm::iterator_range<sched_const_iterator>;
 
+private:
+  bool CollectStatistics = false;
+  std::vector<StepStatistics> Statistics;
+
 public:
   StepManager() : Schedule(), InsertedSteps(), InvalidatedSteps() {}
 
@@ -419,16 +473,40 @@ public:
     return addStep(std::make_unique<StepT>(std::forward<ArgsT &&>(Args)...));
   }
 
+  /// Adds all the Steps of the DLA middle-end, in the order in which they run
+  void addDefaultSteps(size_t PointerSize);
+
   /// Runs the added steps
-  void run(LayoutTypeSystem &TS);
+  //
+  // Steps are assumed to be deterministic, so a Step is skipped if the last run
+  // of a Step with the same ID did not change anything, and no other Step has
+  // changed the LayoutTypeSystem since then.
+  //
+  // TS is split in its weakly connected components, that are processed
+  // independently and then merged back into TS. If \a NumThreads is greater
+  // than 1, they are processed on a pool of \a NumThreads threads. The
+  // components are grouped and merged in the same way regardless of
+  // \a NumThreads, so the result doesn't depend on it. Steps are run on a
+  // single thread if any of their Loggers is enabled.
+  void run(LayoutTypeSystem &TS, unsigned NumThreads = 1);
 
   /// Drops all the scheduled steps
   void reset() {
     Schedule.clear();
     InsertedSteps.clear();
     InvalidatedSteps.clear();
+    Statistics.clear();
   }
 
+  /// Collect StepStatistics in the following runs
+  void enableStatistics() { CollectStatistics = true; }
+
+  /// Get the statistics of the last run, one for each Step in the Schedule
+  llvm::ArrayRef<StepStatistics> getStatistics() const { return Statistics; }
+
+  /// Print the statistics of the last run on \a OS as a JSON array
+  void printStatistics(llvm::raw_ostream &OS) const;
+
   bool hasValidSchedule() const {
     return not intersect(InsertedSteps, InvalidatedSteps);
   }
@@ -442,6 +520,13 @@ public:
   sched_const_range sched() const {
     return llvm::make_range(sched_begin(), sched_end());
   }
+
+private:
+  std::vector<StepStatistics> runSchedule(LayoutTypeSystem &TS,
+                                          size_t Group) const;
+
+  std::vector<StepStatistics> runOnComponents(LayoutTypeSystem &TS,
+                                              unsigned NumThreads) const;
 };
 
 } // end namespace dla
@@ -7,7 +7,7 @@
 
 namespace dla {
 
-bool DecomposeStridedEdges::runOnTypeSystem(LayoutTypeSystem &TS) {
+bool DecomposeStridedEdges::runOnTypeSystem(LayoutTypeSystem &TS) const {
   if (VerifyLog.isEnabled())
     revng_assert(TS.verifyDAG());
 
@@ -17,13 +17,14 @@ bool DecomposeStridedEdges::runOnTypeSystem(LayoutTypeSystem &TS) {
 
     using DLAGraph = llvm::GraphTraits<LayoutTypeSystemNode *>;
     auto EdgeIt = DLAGraph::child_edge_begin(Parent);
-    auto EdgeEnd = DLAGraph::child_edge_end(Parent);
     auto EdgeNext = DLAGraph::child_edge_end(Parent);
 
-    for (; EdgeIt != EdgeEnd; EdgeIt = EdgeNext) {
+    // Adding and erasing edges invalidates the iterators on the successors of
+    // Parent, so the end is recomputed at each iteration.
+    for (; EdgeIt != DLAGraph::child_edge_end(Parent); EdgeIt = EdgeNext) {
       EdgeNext = std::next(EdgeIt);
 
-      auto &Edge = *EdgeIt;
+      const auto Edge = *EdgeIt;
       if (not isInstanceEdge(Edge))
         continue;
 
@@ -82,7 +83,7 @@ bool DecomposeStridedEdges::runOnTypeSystem(LayoutTypeSystem &TS) {
       }
 
       // Remove the old strided edge
-      TS.eraseEdge(Parent, EdgeIt);
+      EdgeNext = TS.eraseEdge(Parent, Parent->Successors.find(Edge));
     }
   }
 
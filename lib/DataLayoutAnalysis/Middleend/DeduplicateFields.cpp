@@ -7,11 +7,14 @@
 #include <cstdint>
 #include <iterator>
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/GraphTraits.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SetOperations.h"
 #include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/Debug.h"
 
 #include "revng/Support/Assert.h"
@@ -32,6 +35,8 @@ using namespace llvm;
 
 static Logger<> Log("dla-deduplicate-union-fields");
 static Logger<> CmpLog("dla-duf-comparisons");
+static dla::RegisterTypeSystemLogger RegisterLog(Log);
+static dla::RegisterTypeSystemLogger RegisterCmpLog(CmpLog);
 
 namespace dla {
 
@@ -252,8 +257,10 @@ areEquivSubtrees(const Link &Child1, const Link &Child2) {
 ///           equivalent to the subtree of \a Child1
 static std::tuple<bool, std::set<LTSN *>, std::set<LTSN *>>
 mergeIfTopologicallyEq(LayoutTypeSystem &TS,
-                       const Link &Child1,
-                       const Link &Child2) {
+                       const Link Child1,
+                       const Link Child2) {
+  // Child1 and Child2 are copies, since merging changes the neighbors that they
+  // might be referencing.
   if (Child1.first == Child2.first) {
     revng_log(CmpLog, "Same Node!");
     return { false, {}, {} };
@@ -331,6 +338,71 @@ mergeIfTopologicallyEq(LayoutTypeSystem &TS,
   return { true, Preserved, ErasedNodes };
 }
 
+/// Computes structural hashes of the subtrees of the type system, so that
+/// subtrees that cannot be equivalent can be told apart without exploring them.
+///
+/// The hashes are consistent with exploreAndCompare: equivalent subtrees always
+/// have the same hash. exploreAndCompare considers equal two links to the same
+/// node regardless of their tags, and it follows pointer edges, which can form
+/// cycles. For this reason the hash of a node only looks at the size and
+/// number of successors of the nodes up to a fixed depth below it, ignoring
+/// the tags and the kind of the edges.
+class SubtreeHasher {
+  static constexpr unsigned MaxDepth = 4;
+
+  llvm::DenseMap<std::pair<const LTSN *, unsigned>, size_t> Hashes;
+
+  size_t getNodeHash(const LTSN *N, unsigned Depth) {
+    if (auto It = Hashes.find({ N, Depth }); It != Hashes.end())
+      return It->second;
+
+    llvm::hash_code Result = llvm::hash_combine(N->Size, N->Successors.size());
+    if (Depth > 0) {
+      llvm::SmallVector<size_t, 8> ChildHashes;
+      for (const Link &L : N->Successors)
+        ChildHashes.push_back(getNodeHash(L.first, Depth - 1));
+      llvm::sort(ChildHashes);
+      Result = llvm::hash_combine(Result,
+                                  llvm::hash_combine_range(ChildHashes.begin(),
+                                                           ChildHashes.end()));
+    }
+
+    Hashes[{ N, Depth }] = Result;
+    return Result;
+  }
+
+public:
+  /// Get a hash of \a L that is equal for all the links that
+  /// exploreAndCompare considers equivalent.
+  size_t getLinkHash(const Link &L) {
+    return llvm::hash_combine(TypeLinkTag::Hash()(*L.second),
+                              getNodeHash(L.first, MaxDepth));
+  }
+
+  /// Drop the hashes that might have been affected by changes to the
+  /// successors of \a N, i.e. the hashes of N and of its ancestors up to
+  /// MaxDepth levels above it.
+  void invalidate(const LTSN *N) {
+    llvm::SmallPtrSet<const LTSN *, 16> Visited;
+    llvm::SmallVector<std::pair<const LTSN *, unsigned>, 16> Worklist;
+    Worklist.push_back({ N, 0 });
+    Visited.insert(N);
+    // Visit breadth-first, so that each node is reached at its minimum distance
+    for (size_t I = 0; I < Worklist.size(); ++I) {
+      auto [Current, Distance] = Worklist[I];
+      for (unsigned Depth = Distance; Depth <= MaxDepth; ++Depth)
+        Hashes.erase({ Current, Depth });
+
+      if (Distance == MaxDepth)
+        continue;
+
+      for (const Link &L : Current->Predecessors)
+        if (Visited.insert(L.first).second)
+          Worklist.push_back({ L.first, Distance + 1 });
+    }
+  }
+};
+
 static auto getSuccEdgesToChild(LTSN *Parent, LTSN *Child) {
   auto &Succ = Parent->Successors;
   using IDBasedKey = std::pair<uint64_t, const TypeLinkTag *>;
@@ -340,12 +412,13 @@ static auto getSuccEdgesToChild(LTSN *Parent, LTSN *Child) {
                                                            nullptr }));
 }
 
-bool DeduplicateFields::runOnTypeSystem(LayoutTypeSystem &TS) {
+bool DeduplicateFields::runOnTypeSystem(LayoutTypeSystem &TS) const {
   bool TypeSystemChanged = false;
   if (VerifyLog.isEnabled())
     revng_assert(TS.verifyDAG());
 
   llvm::SmallPtrSet<LTSN *, 16> VisitedNodes;
+  SubtreeHasher Hasher;
 
   for (LTSN *Root : llvm::nodes(&TS)) {
     revng_assert(Root != nullptr);
@@ -380,6 +453,14 @@ bool DeduplicateFields::runOnTypeSystem(LayoutTypeSystem &TS) {
       llvm::SmallSet<LTSN *, 8> OriginalFields;
       llvm::SmallSetVector<LTSN *, 8> AnalyzedNodesNotMerged;
 
+      // Number of edges towards AnalyzedNodesNotMerged with each hash. Links
+      // whose hash is not here cannot be merged with any of them.
+      llvm::DenseMap<size_t, unsigned> NotMergedHashes;
+      auto CountNotMergedHashes = [&](LTSN *NotMerged) {
+        for (const Link &L : getSuccEdgesToChild(NodeWithFields, NotMerged))
+          ++NotMergedHashes[Hasher.getLinkHash(L)];
+      };
+
       // We keep a separate list of successors since we might need to re-enqueue
       // some of them.
       revng_log(Log, "Children are:");
@@ -417,6 +498,12 @@ bool DeduplicateFields::runOnTypeSystem(LayoutTypeSystem &TS) {
             continue;
           }
 
+          size_t CurHash = Hasher.getLinkHash(CurLink);
+          if (not NotMergedHashes.count(CurHash)) {
+            revng_log(Log, "no candidate with the same hash");
+            continue;
+          }
+
           // We want to compare CurChild with all the other nodes that we have
           // looked at in previous iterations, and try to merge it with one of
           // them.
@@ -436,7 +523,8 @@ bool DeduplicateFields::runOnTypeSystem(LayoutTypeSystem &TS) {
 
             bool AnalyzedNotMergedInvalidated = false;
             for (const Link &NotMergedLink : NotMergedEdges) {
-              const auto &[NotMergedNode, NotMergedTag] = NotMergedLink;
+              // Copy the link, merging invalidates the references to it
+              const auto [NotMergedNode, NotMergedTag] = NotMergedLink;
 
               LoggerIndent MoreMoreIndent{ Log };
               revng_log(Log, "Edge to merge with: " << *NotMergedTag);
@@ -445,6 +533,11 @@ bool DeduplicateFields::runOnTypeSystem(LayoutTypeSystem &TS) {
                 revng_log(Log, "skip pointer edge");
               }
 
+              if (Hasher.getLinkHash(NotMergedLink) != CurHash) {
+                revng_log(Log, "Different hash!");
+                continue;
+              }
+
               auto [IsMerged,
                     Preserved,
                     Erased] = mergeIfTopologicallyEq(TS,
@@ -469,13 +562,20 @@ bool DeduplicateFields::runOnTypeSystem(LayoutTypeSystem &TS) {
               TypeSystemChanged = true;
               NodeWithFieldsChanged = true;
 
+              // All the nodes that were merged away have been merged into
+              // preserved nodes, so invalidating the hashes above the preserved
+              // nodes covers all the changes.
+              for (LTSN *PreservedNode : Preserved)
+                Hasher.invalidate(PreservedNode);
+
               // Collapse new single children that could emerge while merging
               {
                 // Copy the post_order into a SmallVector, since collapseSingle
                 // might mutate the graph and screw up the po_iterator.
                 for (auto &N : llvm::SmallVector<LTSN *>{
                        post_order(NonPointerFilterT(NotMergedNode)) })
-                  CollapseSingleChild::collapseSingle(TS, N);
+                  if (CollapseSingleChild::collapseSingle(TS, N))
+                    Hasher.invalidate(N);
 
                 // Notice that collapseSingle can actually remove more nodes.
                 // In principle we should add them to Erased and remove them
@@ -529,6 +629,12 @@ bool DeduplicateFields::runOnTypeSystem(LayoutTypeSystem &TS) {
               // changed by the merge.
               revng_assert(AnalyzedNotMergedInvalidated);
 
+              // The merge might have changed the hashes of the remaining
+              // AnalyzedNodesNotMerged, so recompute them.
+              NotMergedHashes.clear();
+              for (LTSN *NotMerged : AnalyzedNodesNotMerged)
+                CountNotMergedHashes(NotMerged);
+
               // We have merged the CurChild into NotMergedNode, we have to
               // brake out of all the loops looking at CurChild and at
               // AnalyzedNodesNotMerged, since both of these might have
@@ -557,6 +663,7 @@ bool DeduplicateFields::runOnTypeSystem(LayoutTypeSystem &TS) {
         // analyzed and not merged.
         if (not FieldsMerged) {
           AnalyzedNodesNotMerged.insert(CurChild);
+          CountNotMergedHashes(CurChild);
           revng_log(Log, "CurChild " << CurChild->ID << " not merged");
         }
       }
@@ -564,6 +671,8 @@ bool DeduplicateFields::runOnTypeSystem(LayoutTypeSystem &TS) {
       // Collapse the union node if we are left with only one member
       if (NodeWithFieldsChanged) {
         bool Changed = CollapseSingleChild::collapseSingle(TS, NodeWithFields);
+        if (Changed)
+          Hasher.invalidate(NodeWithFields);
         TypeSystemChanged |= Changed;
       }
     }
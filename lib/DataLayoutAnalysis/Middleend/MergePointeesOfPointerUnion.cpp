@@ -22,6 +22,7 @@
 using namespace llvm;
 
 static Logger<> Log("dla-merge-pointees-of-ptr-union");
+static dla::RegisterTypeSystemLogger RegisterLog(Log);
 
 namespace dla {
 
@@ -46,7 +47,7 @@ static LTSN *getPointee(LTSN *Pointer) {
   return Pointer->Successors.begin()->first;
 }
 
-bool MergePointeesOfPointerUnion::runOnTypeSystem(LayoutTypeSystem &TS) {
+bool MergePointeesOfPointerUnion::runOnTypeSystem(LayoutTypeSystem &TS) const {
   bool Changed = false;
 
   revng_log(Log, "MergePointeesOfPointerUnion");
@@ -220,13 +221,13 @@ bool MergePointeesOfPointerUnion::runOnTypeSystem(LayoutTypeSystem &TS) {
           // Check if we merged more than one scalar that also was a pointer.
           // In that case we have to create a new union of their pointees,
           // enqueue it for further analysis
-          llvm::SmallVector<LTSN::NeighborIterator> PointerEdges;
+          // Moving an edge invalidates the iterators on the successors of
+          // MergedScalar, so we record the edges themselves.
+          llvm::SmallVector<LTSN::Link> PointerEdges;
           {
-            LTSN::NeighborIterator ChildIt = MergedScalar->Successors.begin();
-            LTSN::NeighborIterator ChildEnd = MergedScalar->Successors.end();
-            for (; ChildIt != ChildEnd; ++ChildIt)
-              if (isPointerEdge(*ChildIt))
-                PointerEdges.push_back(ChildIt);
+            for (const LTSN::Link &Child : MergedScalar->Successors)
+              if (isPointerEdge(Child))
+                PointerEdges.push_back(Child);
 
             revng_assert(PointerEdges.empty()
                          or MergedScalar->Size == PointerSize);
@@ -236,9 +237,11 @@ bool MergePointeesOfPointerUnion::runOnTypeSystem(LayoutTypeSystem &TS) {
             revng_log(Log,
                       "Merged scalar is a union of pointers: "
                         << MergedScalar->ID);
-            for (LTSN::NeighborIterator &PointerEdgeIt : PointerEdges) {
+            for (const LTSN::Link &PointerEdge : PointerEdges) {
               LTSN *NewPointer = TS.createArtificialLayoutType();
               NewPointer->Size = PointerSize;
+              auto PointerEdgeIt = MergedScalar->Successors.find(PointerEdge);
+              revng_assert(PointerEdgeIt != MergedScalar->Successors.end());
               TS.moveEdgeSource(MergedScalar, NewPointer, PointerEdgeIt, 0);
               TS.addInstanceLink(MergedScalar,
                                  NewPointer,
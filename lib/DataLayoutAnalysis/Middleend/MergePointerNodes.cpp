@@ -11,6 +11,7 @@
 using namespace llvm;
 
 static Logger<> Log("dla-merge-pointer-nodes");
+static dla::RegisterTypeSystemLogger RegisterLog(Log);
 
 namespace dla {
 
@@ -19,7 +20,7 @@ using GraphNodeT = LTSN *;
 using PointerGraphNodeT = EdgeFilteredGraph<GraphNodeT, isPointerEdge>;
 using InversePointerGraphNodeT = llvm::Inverse<PointerGraphNodeT>;
 
-bool MergePointerNodes::runOnTypeSystem(LayoutTypeSystem &TS) {
+bool MergePointerNodes::runOnTypeSystem(LayoutTypeSystem &TS) const {
   bool Changed = false;
 
   for (LTSN *Node : llvm::nodes(&TS)) {
@@ -52,10 +53,9 @@ bool MergePointerNodes::runOnTypeSystem(LayoutTypeSystem &TS) {
 
       Changed = true;
 
-      // This does note invalidate our iteration on llvm::nodes, since the
-      // underlying container for nodes is a std::set, and the iterator that is
-      // being held on it points to Node, not to any of the nodes in ToMerge,
-      // so erasing the nodes in ToMerge never invalidats the iterator to Node
+      // This does not invalidate our iteration on llvm::nodes, since nodes are
+      // iterated by ID, and merging only leaves tombstones in place of the
+      // nodes in ToMerge, without moving any other node.
       TS.mergeNodes(ToMerge);
     }
   }
@@ -59,7 +59,7 @@ static uint64_t getNumChildrenAtOffset0(const LayoutTypeSystemNode *Parent) {
   return getChildrenAtOffset0(Parent).size();
 }
 
-bool PushDownPointers::runOnTypeSystem(LayoutTypeSystem &TS) {
+bool PushDownPointers::runOnTypeSystem(LayoutTypeSystem &TS) const {
 
   bool Changed = false;
 
@@ -4,6 +4,7 @@
 
 #include <compare>
 #include <limits>
+#include <optional>
 #include <vector>
 
 #include "llvm/ADT/DepthFirstIterator.h"
@@ -22,6 +23,7 @@
 #include "RemoveBackedges.h"
 
 static Logger<> Log("dla-remove-backedges");
+static dla::RegisterTypeSystemLogger RegisterLog(Log);
 
 namespace dla {
 
@@ -86,8 +88,11 @@ static bool removeBackedgesFromSCC(LayoutTypeSystem &TS) {
 
   revng_log(Log, "Removing Backedges From Loops");
 
-  llvm::Task T(2, "removeBackedgesFromSCC");
-  T.advance("Detect SCC Node View Components");
+  std::optional<llvm::Task> T;
+  if (TS.reportsProgress()) {
+    T.emplace(2, "removeBackedgesFromSCC");
+    T->advance("Detect SCC Node View Components");
+  }
   // Assign each node to a Component, except for those that have no incoming nor
   // outgoing SCCNodeView edges. The goal is to identify the subsets of nodes
   // that are connected by means of SCCNodeView edges. In this way we divide the
@@ -140,7 +145,8 @@ static bool removeBackedgesFromSCC(LayoutTypeSystem &TS) {
 
   using MixedNodeT = EdgeFilteredGraph<LTSN *, isMixedEdge<SCC>>;
 
-  T.advance("Remove Backedges");
+  if (T)
+    T->advance("Remove Backedges");
   for (const auto &Root : llvm::nodes(&TS)) {
     revng_assert(Root != nullptr);
     // We start from SCCNodeView roots and look if we find an SCC with mixed
@@ -315,12 +321,9 @@ static bool removeBackedgesFromSCC(LayoutTypeSystem &TS) {
       revng_log(Log,
                 "# Removing backedge: " << Pred->ID << " -> " << Child->ID);
       revng_assert(SCC::BackedgeNodeView::filter()({ Pred, T }));
-      Edge ChildToPred = std::make_pair(Pred, T);
-      bool Erased = Child->Predecessors.erase(ChildToPred);
-      revng_assert(Erased);
-      Edge PredToChild = std::make_pair(Child, T);
-      Erased = Pred->Successors.erase(PredToChild);
-      revng_assert(Erased);
+      auto EdgeIt = Pred->Successors.find(Edge{ Child, T });
+      revng_assert(EdgeIt != Pred->Successors.end());
+      TS.eraseEdge(Pred, EdgeIt);
       Changed = true;
     }
   }
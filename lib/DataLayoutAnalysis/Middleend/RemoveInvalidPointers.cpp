@@ -4,7 +4,7 @@
 
 #include "DLAStep.h"
 
-bool dla::RemoveInvalidPointers::runOnTypeSystem(LayoutTypeSystem &TS) {
+bool dla::RemoveInvalidPointers::runOnTypeSystem(LayoutTypeSystem &TS) const {
   bool Changed = false;
 
   for (LayoutTypeSystemNode *PtrNode : llvm::nodes(&TS)) {
@@ -15,9 +15,8 @@ bool dla::RemoveInvalidPointers::runOnTypeSystem(LayoutTypeSystem &TS) {
       continue;
 
     auto It = PtrNode->Successors.begin();
-    auto End = PtrNode->Successors.end();
-    auto Next = End;
-    for (; It != End; It = Next) {
+    auto Next = It;
+    for (; It != PtrNode->Successors.end(); It = Next) {
 
       Next = std::next(It);
 
@@ -29,11 +28,7 @@ bool dla::RemoveInvalidPointers::runOnTypeSystem(LayoutTypeSystem &TS) {
       // and It points to a pointer edge that is outgoing from PtrNode.
       // That edge is invalid, because according to PtrNode->Size PtrNode cannot
       // be a pointer, so we remove the wrong edge.
-      LayoutTypeSystemNode *Pointee = It->first;
-      auto PredIt = Pointee->Predecessors.find({ PtrNode, It->second });
-      revng_assert(PredIt != Pointee->Predecessors.end());
-      Pointee->Predecessors.erase(PredIt);
-      PtrNode->Successors.erase(It);
+      Next = TS.eraseEdge(PtrNode, It);
       Changed = true;
     }
   }
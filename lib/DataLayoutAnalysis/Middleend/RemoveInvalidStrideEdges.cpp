@@ -10,6 +10,7 @@
 #include "FieldSizeComputation.h"
 
 static Logger<> Log{ "dla-remove-stride-edges" };
+static dla::RegisterTypeSystemLogger RegisterLog(Log);
 
 namespace dla {
 
@@ -49,7 +50,7 @@ static bool hasValidStrides(const LayoutTypeSystemNode::Link &Edge) {
   return true;
 }
 
-bool RemoveInvalidStrideEdges::runOnTypeSystem(LayoutTypeSystem &TS) {
+bool RemoveInvalidStrideEdges::runOnTypeSystem(LayoutTypeSystem &TS) const {
   bool Changed = false;
 
   if (VerifyLog.isEnabled())
@@ -73,10 +74,9 @@ bool RemoveInvalidStrideEdges::runOnTypeSystem(LayoutTypeSystem &TS) {
          llvm::post_order_ext(InstanceNodeT(Root), Visited)) {
 
       auto It = N->Successors.begin();
-      auto End = N->Successors.end();
-      auto Next = End;
+      auto Next = It;
       bool RemovedChild = false;
-      for (; It != End; It = Next) {
+      for (; It != N->Successors.end(); It = Next) {
 
         Next = std::next(It);
 
@@ -87,12 +87,8 @@ bool RemoveInvalidStrideEdges::runOnTypeSystem(LayoutTypeSystem &TS) {
           continue;
 
         // If we reach this point the edges has invalid strides, so we need to
-        // remove it, taking care of the fact that it's bidirectional.
-        LayoutTypeSystemNode *Succ = It->first;
-        auto PredIt = Succ->Predecessors.find({ N, It->second });
-        revng_assert(PredIt != Succ->Predecessors.end());
-        Succ->Predecessors.erase(PredIt);
-        N->Successors.erase(It);
+        // remove it.
+        Next = TS.eraseEdge(N, It);
         RemovedChild = true;
         Changed = true;
       }
@@ -121,6 +117,7 @@ bool RemoveInvalidStrideEdges::runOnTypeSystem(LayoutTypeSystem &TS) {
         }
 
         N->Size = NewSize;
+        TS.markModified(N);
       }
     }
   }
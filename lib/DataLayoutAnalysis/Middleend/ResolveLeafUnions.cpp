@@ -28,19 +28,20 @@ struct ChildrenKey {
 
 using NodePredicate = const std::function<bool(const LayoutTypeSystemNode *)>;
 
-using NeighborIterator = LayoutTypeSystemNode::NeighborIterator;
+using Link = LayoutTypeSystemNode::Link;
 
-static bool neighborLess(const NeighborIterator &AIt,
-                         const NeighborIterator &BIt) {
-  const auto &[AChild, ATag] = *AIt;
-  const auto &[BChild, BTag] = *BIt;
+static bool neighborLess(const Link &A, const Link &B) {
+  const auto &[AChild, ATag] = A;
+  const auto &[BChild, BTag] = B;
   return (AChild < BChild) or (ATag < BTag);
 }
 
 using NeighborLess = std::integral_constant<decltype(&neighborLess),
                                             neighborLess>;
 
-using NeighborSet = std::set<NeighborIterator, NeighborLess>;
+// Edges are erased while iterating on these sets, and that invalidates the
+// iterators on the neighbors, so the sets hold the edges themselves.
+using NeighborSet = std::set<Link, NeighborLess>;
 
 static SmallMap<ChildrenKey, NeighborSet, 8>
 getOverlappingLeafChildren(LayoutTypeSystemNode *N) {
@@ -55,7 +56,7 @@ getOverlappingLeafChildren(LayoutTypeSystemNode *N) {
     auto &[Child, Tag] = *ChildIt;
     if (not isLeaf(Child))
       continue;
-    Result[ChildrenKey{ getFieldSize(Child, Tag), Tag }].insert(ChildIt);
+    Result[ChildrenKey{ getFieldSize(Child, Tag), Tag }].insert(*ChildIt);
   }
 
   return Result;
@@ -192,16 +193,16 @@ static bool resolveUnion(LayoutTypeSystem &TS,
   for (; AIt != End; AIt = ANext) {
     ANext = std::next(AIt);
 
-    auto AChildIt = *AIt;
-    LayoutTypeSystemNode *AChild = AChildIt->first;
+    const Link AChildEdge = *AIt;
+    LayoutTypeSystemNode *AChild = AChildEdge.first;
 
     auto BIt = ANext;
     auto BNext = BIt;
     for (; BIt != End; BIt = BNext) {
       BNext = std::next(BIt);
 
-      auto BChildIt = *BIt;
-      LayoutTypeSystemNode *BChild = BChildIt->first;
+      const Link BChildEdge = *BIt;
+      LayoutTypeSystemNode *BChild = BChildEdge.first;
 
       auto Cmp = compareLeafTypes(AChild, BChild);
       // A can reach more types on the DLA graph than B.
@@ -210,7 +211,7 @@ static bool resolveUnion(LayoutTypeSystem &TS,
         BNext = ChildrenSet.erase(BIt);
         if (ANext == BIt)
           ANext = std::next(AIt);
-        TS.eraseEdge(Parent, BChildIt);
+        TS.eraseEdge(Parent, BChildEdge);
         Changed = true;
       }
 
@@ -218,7 +219,7 @@ static bool resolveUnion(LayoutTypeSystem &TS,
       // Remove A.
       if (Cmp < 0) {
         ANext = ChildrenSet.erase(AIt);
-        TS.eraseEdge(Parent, AChildIt);
+        TS.eraseEdge(Parent, AChildEdge);
         Changed = true;
         break;
       }
@@ -229,7 +230,7 @@ static bool resolveUnion(LayoutTypeSystem &TS,
   return Changed;
 }
 
-bool ResolveLeafUnions::runOnTypeSystem(LayoutTypeSystem &TS) {
+bool ResolveLeafUnions::runOnTypeSystem(LayoutTypeSystem &TS) const {
   bool Changed = false;
 
   for (LayoutTypeSystemNode *Node : llvm::nodes(&TS)) {
@@ -33,6 +33,7 @@ using CPointerT = EdgeFilteredGraph<const dla::LayoutTypeSystemNode *,
                                     dla::isPointerEdge>;
 
 static Logger<> Log{ "dla-simplify-instance-off0" };
+static dla::RegisterTypeSystemLogger RegisterLog(Log);
 
 namespace dla {
 
@@ -194,7 +195,7 @@ getPostOrder(LayoutTypeSystemNode *Root) {
   return PostOrder;
 }
 
-bool SimplifyInstanceAtOffset0::runOnTypeSystem(LayoutTypeSystem &TS) {
+bool SimplifyInstanceAtOffset0::runOnTypeSystem(LayoutTypeSystem &TS) const {
 
   if (Log.isEnabled())
     TS.dumpDotOnFile("before-SimplifyInstanceAtOffset0.dot", true);
@@ -221,10 +222,24 @@ bool SimplifyInstanceAtOffset0::runOnTypeSystem(LayoutTypeSystem &TS) {
 
     ReachabilityCache RC;
 
+    // Collapsing a child merges its successors into Node, invalidating the
+    // iterators on them, so each child is looked up again after the previous
+    // one, by its key.
+    using NeighborsSet = LayoutTypeSystemNode::NeighborsSet;
+    const auto NextInstanceZero = [Node](NeighborsSet::iterator It) {
+      return std::find_if(It, Node->Successors.end(), [](const auto &Edge) {
+        return isInstanceOff0(Edge);
+      });
+    };
+
     // For each instance children of Node at offset 0, compute if it can be
     // collapsed into Node, and if it's possible collapse it.
-    for (LayoutTypeSystemNode *Child :
-         llvm::make_early_inc_range(llvm::children<InstanceZeroT>(Node))) {
+    NeighborsSet::IDBasedKey ChildKey;
+    for (auto ChildIt = NextInstanceZero(Node->Successors.begin());
+         ChildIt != Node->Successors.end();
+         ChildIt = NextInstanceZero(Node->Successors.upper_bound(ChildKey))) {
+      LayoutTypeSystemNode *Child = ChildIt->first;
+      ChildKey = { Child->ID, ChildIt->second };
 
       revng_log(Log, "Child: " << Child->ID);
       LoggerIndent ChildIndent(Log);
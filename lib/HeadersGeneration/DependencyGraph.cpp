@@ -36,14 +36,17 @@ static llvm::StringRef toString(TypeNode::Kind K) {
 }
 
 void DependencyGraph::addNode(const model::Type *T) {
+  auto [It, New] = TypeToIndex.try_emplace(T, TypeToIndex.size());
+  revng_assert(New);
+  revng_assert(Nodes.size() == 2 * It->second);
 
   constexpr auto TypeName = TypeNode::Kind::TypeName;
-  auto *NameNode = GenericGraph::addNode(TypeNode{ T, TypeName });
-  TypeToNode[TypeKindPair{ T, TypeName }] = NameNode;
+  auto *NameNode = GenericGraph::addNode(TypeNode{ T, TypeName, Nodes.size() });
+  Nodes.push_back(NameNode);
 
   constexpr auto FullType = TypeNode::Kind::FullType;
-  auto *FullNode = GenericGraph::addNode(TypeNode{ T, FullType });
-  TypeToNode[TypeKindPair{ T, FullType }] = FullNode;
+  auto *FullNode = GenericGraph::addNode(TypeNode{ T, FullType, Nodes.size() });
+  Nodes.push_back(FullNode);
 }
 
 std::string getNodeLabel(const TypeDependencyNode *N) {
@@ -60,9 +63,8 @@ std::string llvm::DOTGraphTraits<DepGraph *>::getNodeLabel(const DepNode *N,
 }
 
 template<TypeNode::Kind K>
-static TypeDependencyNode *
-getDependencyFor(const model::QualifiedType &QT,
-                 const TypeToDependencyNodeMap &TypeToNode) {
+static TypeDependencyNode *getDependencyFor(const model::QualifiedType &QT,
+                                            const DependencyGraph &Graph) {
 
   // TODO: Unfortunately, here we have to deal with some quirks of the C
   // language concerning pointers to arrays of struct/union.
@@ -114,20 +116,20 @@ getDependencyFor(const model::QualifiedType &QT,
   // C standard mentioned above, we have to depend on the FullType of the
   // element type of the array.
   if (LastIsArray)
-    return TypeToNode.at({ Unqualified, TypeNode::Kind::FullType });
+    return Graph.getNode(Unqualified, TypeNode::Kind::FullType);
 
   // Otherwise, if we've found at least a pointer, we only depend on the name of
   // the UnqualifiedType.
   if (PointerFound)
-    return TypeToNode.at({ Unqualified, TypeNode::Kind::TypeName });
+    return Graph.getNode(Unqualified, TypeNode::Kind::TypeName);
 
   // In all the other cases we depend on the UnqualifiedType with the kind
   // indicated by K.
-  return TypeToNode.at({ Unqualified, K });
+  return Graph.getNode(Unqualified, K);
 }
 
 static void registerDependencies(const model::Type *T,
-                                 const TypeToDependencyNodeMap &TypeToNode) {
+                                 const DependencyGraph &Graph) {
 
   using Edge = std::pair<TypeDependencyNode *, TypeDependencyNode *>;
   llvm::SmallVector<Edge, 2> Deps;
@@ -163,9 +165,9 @@ static void registerDependencies(const model::Type *T,
                  and UnderlyingQT.Qualifiers().empty());
 
     auto *U = cast<model::PrimitiveType>(UnderlyingQT.UnqualifiedType().get());
-    auto *EnumName = TypeToNode.at({ E, TypeNode::Kind::TypeName });
-    auto *EnumFull = TypeToNode.at({ E, TypeNode::Kind::FullType });
-    auto *UnderFull = TypeToNode.at({ U, TypeNode::Kind::FullType });
+    auto *EnumName = Graph.getNode(E, TypeNode::Kind::TypeName);
+    auto *EnumFull = Graph.getNode(E, TypeNode::Kind::FullType);
+    auto *UnderFull = Graph.getNode(U, TypeNode::Kind::FullType);
     Deps.push_back({ EnumName, UnderFull });
     Deps.push_back({ EnumFull, UnderFull });
     revng_log(Log,
@@ -181,10 +183,9 @@ static void registerDependencies(const model::Type *T,
     // Struct and Union names can always be conjured out of thin air thanks to
     // typedefs. So we only need to add dependencies between their full
     // definition and the full definition of their fields.
-    auto *Full = TypeToNode.at({ T, TypeNode::Kind::FullType });
+    auto *Full = Graph.getNode(T, TypeNode::Kind::FullType);
     for (const model::QualifiedType &QT : T->edges()) {
-      TypeDependencyNode
-        *Dep = getDependencyFor<TypeNode::FullType>(QT, TypeToNode);
+      TypeDependencyNode *Dep = getDependencyFor<TypeNode::FullType>(QT, Graph);
       Deps.push_back({ Full, Dep });
       revng_log(Log, getNodeLabel(Full) << " depends on " << getNodeLabel(Dep));
     }
@@ -195,16 +196,16 @@ static void registerDependencies(const model::Type *T,
     auto *TD = cast<model::TypedefType>(T);
     const model::QualifiedType &Underlying = TD->UnderlyingType();
 
-    auto *TDName = TypeToNode.at({ TD, TypeNode::Kind::TypeName });
+    auto *TDName = Graph.getNode(TD, TypeNode::Kind::TypeName);
     TypeDependencyNode
-      *NameDep = getDependencyFor<TypeNode::TypeName>(Underlying, TypeToNode);
+      *NameDep = getDependencyFor<TypeNode::TypeName>(Underlying, Graph);
     Deps.push_back({ TDName, NameDep });
     revng_log(Log,
               getNodeLabel(TDName) << " depends on " << getNodeLabel(NameDep));
 
-    auto *TDFull = TypeToNode.at({ TD, TypeNode::Kind::FullType });
+    auto *TDFull = Graph.getNode(TD, TypeNode::Kind::FullType);
     TypeDependencyNode
-      *FullDep = getDependencyFor<TypeNode::FullType>(Underlying, TypeToNode);
+      *FullDep = getDependencyFor<TypeNode::FullType>(Underlying, Graph);
     Deps.push_back({ TDFull, FullDep });
     revng_log(Log,
               getNodeLabel(TDFull) << " depends on " << getNodeLabel(FullDep));
@@ -215,8 +216,8 @@ static void registerDependencies(const model::Type *T,
     // For function types we can print a valid typedef definition as long as
     // we have visibility on all the names of all the argument types and all
     // return types.
-    auto *FullNode = TypeToNode.at({ T, TypeNode::Kind::FullType });
-    auto *NameNode = TypeToNode.at({ T, TypeNode::Kind::TypeName });
+    auto *FullNode = Graph.getNode(T, TypeNode::Kind::FullType);
+    auto *NameNode = Graph.getNode(T, TypeNode::Kind::TypeName);
     for (const model::QualifiedType &QT : T->edges()) {
 
       // The two dependencies added here below are actually stricter than
@@ -235,14 +236,14 @@ static void registerDependencies(const model::Type *T,
       // this point is always guaranteed to be in a form that can be emitted.
 
       TypeDependencyNode
-        *FullDep = getDependencyFor<TypeNode::FullType>(QT, TypeToNode);
+        *FullDep = getDependencyFor<TypeNode::FullType>(QT, Graph);
       Deps.push_back({ FullNode, FullDep });
       revng_log(Log,
                 getNodeLabel(FullNode)
                   << " depends on " << getNodeLabel(FullDep));
 
       TypeDependencyNode
-        *NameDep = getDependencyFor<TypeNode::TypeName>(QT, TypeToNode);
+        *NameDep = getDependencyFor<TypeNode::TypeName>(QT, Graph);
       Deps.push_back({ NameNode, NameDep });
       revng_log(Log,
                 getNodeLabel(NameNode)
@@ -272,7 +273,7 @@ DependencyGraph buildDependencyGraph(const TypeVector &Types) {
 
   // Compute dependencies and add them to the graph
   for (const UpcastablePointer<model::Type> &MT : Types)
-    registerDependencies(MT.get(), Dependencies.TypeNodes());
+    registerDependencies(MT.get(), Dependencies);
 
   if (Log.isEnabled())
     llvm::ViewGraph(&Dependencies, "type-deps.dot");
@@ -4,11 +4,18 @@
 // This file is distributed under the MIT License. See LICENSE.mit for details.
 //
 
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/Support/DOTGraphTraits.h"
 #include "llvm/Support/GraphWriter.h"
 
 #include "revng/ADT/GenericGraph.h"
 #include "revng/Model/Type.h"
+#include "revng/Support/Assert.h"
 
 /// Represents a model::Type in the DependencyGraph
 struct TypeNode {
@@ -22,11 +29,13 @@ struct TypeNode {
     TypeName,
     FullType
   } K;
+
+  /// Dense index of the node in the DependencyGraph.
+  /// The two nodes of the i-th type have ID 2 * i + K.
+  size_t ID;
 };
 
 using TypeDependencyNode = BidirectionalNode<TypeNode>;
-using TypeKindPair = std::pair<const model::Type *, TypeNode::Kind>;
-using TypeToDependencyNodeMap = std::map<TypeKindPair, TypeDependencyNode *>;
 using TypeVector = TrackingSortedVector<UpcastablePointer<model::Type>>;
 
 /// Represents the graph of dependencies among types
@@ -34,10 +43,49 @@ struct DependencyGraph : public GenericGraph<TypeDependencyNode> {
 
   void addNode(const model::Type *T);
 
-  const TypeToDependencyNodeMap &TypeNodes() const { return TypeToNode; }
+  /// Get the node of kind \p K of \p T
+  TypeDependencyNode *getNode(const model::Type *T, TypeNode::Kind K) const {
+    auto It = TypeToIndex.find(T);
+    revng_assert(It != TypeToIndex.end());
+    return Nodes[2 * It->second + K];
+  }
+
+  /// Get the node of kind \p K of the type of \p N
+  TypeDependencyNode *getNode(const TypeDependencyNode *N,
+                              TypeNode::Kind K) const {
+    return Nodes[N->ID - N->K + K];
+  }
+
+  /// The number of nodes, all the IDs are smaller than this
+  size_t getNodeCount() const { return Nodes.size(); }
 
 private:
-  TypeToDependencyNodeMap TypeToNode;
+  /// Position of each type in the order in which they have been added
+  llvm::DenseMap<const model::Type *, size_t> TypeToIndex;
+
+  /// The nodes, indexed by their ID
+  std::vector<TypeDependencyNode *> Nodes;
+};
+
+/// A set of nodes of a DependencyGraph, represented by a bit vector indexed by
+/// node ID. It can be used as the external set of llvm::post_order_ext.
+class TypeDependencyNodeSet {
+private:
+  llvm::BitVector Bits;
+
+public:
+  explicit TypeDependencyNodeSet(const DependencyGraph &Graph) :
+    Bits(Graph.getNodeCount()) {}
+
+public:
+  std::pair<const TypeDependencyNode *, bool>
+  insert(const TypeDependencyNode *N) {
+    bool New = not Bits.test(N->ID);
+    Bits.set(N->ID);
+    return { N, New };
+  }
+
+  bool contains(const TypeDependencyNode *N) const { return Bits.test(N->ID); }
 };
 
 std::string getNodeLabel(const TypeDependencyNode *N);
@@ -0,0 +1,277 @@
+//
+// This file is distributed under the MIT License. See LICENSE.mit for details.
+//
+
+#include <utility>
+
+#include "llvm/ADT/STLExtras.h"
+
+#include "HeaderFragmentCache.h"
+
+/// Number of runs an entry survives without being used
+static constexpr uint64_t MaxAge = 8;
+
+/// Number of entries past which only those used by the last run are kept
+static constexpr size_t MaxEntries = 1 << 16;
+
+template<typename T>
+static void dropOldEntries(llvm::StringMap<T> &Entries, uint64_t Generation) {
+  uint64_t Age = Entries.size() > MaxEntries ? 1 : MaxAge;
+  for (auto It = Entries.begin(); It != Entries.end();) {
+    auto Current = It++;
+    if (Current->second.LastUse + Age < Generation)
+      Entries.erase(Current);
+  }
+}
+
+HeaderFragmentCache &HeaderFragmentCache::get() {
+  static HeaderFragmentCache Cache;
+  return Cache;
+}
+
+std::optional<std::string>
+HeaderFragmentCache::getFragment(llvm::StringRef Key) {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  auto It = Fragments.find(Key);
+  if (It == Fragments.end()) {
+    ++FragmentStatistics.Misses;
+    return std::nullopt;
+  }
+
+  ++FragmentStatistics.Hits;
+  It->second.LastUse = Generation;
+  return It->second.Value;
+}
+
+void HeaderFragmentCache::setFragment(llvm::StringRef Key, std::string Text) {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  Fragments.insert_or_assign(Key,
+                             Entry<std::string>{ std::move(Text),
+                                                 Generation });
+}
+
+std::optional<HeaderPlan> HeaderFragmentCache::getPlan(llvm::StringRef Key) {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  auto It = Plans.find(Key);
+  if (It == Plans.end())
+    return std::nullopt;
+
+  It->second.LastUse = Generation;
+  return It->second.Value;
+}
+
+void HeaderFragmentCache::setPlan(llvm::StringRef Key, HeaderPlan Plan) {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  Plans.insert_or_assign(Key, Entry<HeaderPlan>{ std::move(Plan), Generation });
+}
+
+void HeaderFragmentCache::endRun() {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  ++Generation;
+  dropOldEntries(Fragments, Generation);
+  dropOldEntries(Plans, Generation);
+}
+
+void HeaderFragmentCache::clear() {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  Fragments.clear();
+  Plans.clear();
+  FragmentStatistics = {};
+}
+
+HeaderFragmentCache::Statistics HeaderFragmentCache::getFragmentStatistics() {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  return FragmentStatistics;
+}
+
+std::string getTypeGraphKey(const model::Binary &Model,
+                            const ModelToHeaderOptions &Options) {
+  // Tags tell apart the different kinds of elements in the sequence
+  enum : uint8_t {
+    TypeTag,
+    EdgeTag,
+    QualifierTag,
+    StackFrameTag
+  };
+
+  CacheKeyBuilder Key;
+  Key.add(Options.DisableTypeInlining);
+  for (const UpcastablePointer<model::Type> &T : Model.Types()) {
+    Key.add(TypeTag)
+      .add(T->ID())
+      .add(T->Kind())
+      .add(Options.TypesToOmit.contains(T.get()));
+
+    for (const model::QualifiedType &QT : T->edges()) {
+      const model::Type *Used = QT.UnqualifiedType().get();
+      Key.add(EdgeTag).add(Used->ID()).add(Used->Kind());
+      for (const model::Qualifier &Q : QT.Qualifiers())
+        Key.add(QualifierTag).add(Q.Kind());
+    }
+  }
+
+  // Stack frame types are not emitted in the header, and neither are the
+  // types inlined into them.
+  for (const model::Function &F : Model.Functions()) {
+    if (not F.StackFrameType().empty()) {
+      const model::Type *StackT = F.StackFrameType().getConst();
+      Key.add(StackFrameTag).add(StackT->ID()).add(StackT->Kind());
+    }
+  }
+
+  return Key.take();
+}
+
+/// Add the names and the comment of \p Element, if it has them
+template<typename T>
+static void addNames(CacheKeyBuilder &Key, const T &Element) {
+  Key.add(Element.CustomName());
+  if constexpr (requires { Element.OriginalName(); })
+    Key.add(Element.OriginalName());
+  if constexpr (requires { Element.Comment(); })
+    Key.add(Element.Comment());
+}
+
+static void addReference(CacheKeyBuilder &Key, const model::TypePath &Path) {
+  const model::Type *T = Path.empty() ? nullptr : Path.getConst();
+  if (T == nullptr)
+    Key.add(false);
+  else
+    Key.add(true).add(T->ID()).add(T->Kind());
+}
+
+static void addQualifiedType(CacheKeyBuilder &Key,
+                             const model::QualifiedType &QT) {
+  addReference(Key, QT.UnqualifiedType());
+  Key.add(QT.Qualifiers().size());
+  for (const model::Qualifier &Q : QT.Qualifiers())
+    Key.add(Q.Kind()).add(Q.Size());
+}
+
+template<typename T>
+static void addReturnValueComment(CacheKeyBuilder &Key, const T &F) {
+  if constexpr (requires { F.ReturnValueComment(); })
+    Key.add(F.ReturnValueComment());
+}
+
+/// Add all the fields of \p T that can show up in the header
+///
+/// Whenever the model grows a new field, it has to be added here, or changes
+/// to it won't be reflected in the cached header fragments.
+static void addTypeContent(CacheKeyBuilder &Key, const model::Type &T) {
+  Key.add(T.ID()).add(T.Kind()).add(T.name());
+  addNames(Key, T);
+
+  switch (T.Kind()) {
+  case model::TypeKind::PrimitiveType: {
+    const auto &P = llvm::cast<model::PrimitiveType>(T);
+    Key.add(P.PrimitiveKind()).add(P.Size());
+  } break;
+
+  case model::TypeKind::EnumType: {
+    const auto &E = llvm::cast<model::EnumType>(T);
+    addQualifiedType(Key, E.UnderlyingType());
+    Key.add(E.Entries().size());
+    for (const model::EnumEntry &Entry : E.Entries()) {
+      Key.add(Entry.Value());
+      addNames(Key, Entry);
+    }
+  } break;
+
+  case model::TypeKind::TypedefType: {
+    const auto &TD = llvm::cast<model::TypedefType>(T);
+    addQualifiedType(Key, TD.UnderlyingType());
+  } break;
+
+  case model::TypeKind::StructType: {
+    const auto &S = llvm::cast<model::StructType>(T);
+    Key.add(S.Size()).add(S.Fields().size());
+    for (const model::StructField &Field : S.Fields()) {
+      Key.add(Field.Offset());
+      addNames(Key, Field);
+      addQualifiedType(Key, Field.Type());
+    }
+  } break;
+
+  case model::TypeKind::UnionType: {
+    const auto &U = llvm::cast<model::UnionType>(T);
+    Key.add(U.Fields().size());
+    for (const model::UnionField &Field : U.Fields()) {
+      Key.add(Field.Index());
+      addNames(Key, Field);
+      addQualifiedType(Key, Field.Type());
+    }
+  } break;
+
+  case model::TypeKind::CABIFunctionType: {
+    const auto &F = llvm::cast<model::CABIFunctionType>(T);
+    Key.add(F.ABI());
+    addQualifiedType(Key, F.ReturnType());
+    addReturnValueComment(Key, F);
+    Key.add(F.Arguments().size());
+    for (const model::Argument &Argument : F.Arguments()) {
+      Key.add(Argument.Index());
+      addNames(Key, Argument);
+      addQualifiedType(Key, Argument.Type());
+    }
+  } break;
+
+  case model::TypeKind::RawFunctionType: {
+    const auto &F = llvm::cast<model::RawFunctionType>(T);
+    Key.add(F.Arguments().size());
+    for (const model::NamedTypedRegister &Argument : F.Arguments()) {
+      Key.add(Argument.Location());
+      addNames(Key, Argument);
+      addQualifiedType(Key, Argument.Type());
+    }
+
+    Key.add(F.ReturnValues().size());
+    for (const model::NamedTypedRegister &ReturnValue : F.ReturnValues()) {
+      Key.add(ReturnValue.Location());
+      addNames(Key, ReturnValue);
+      addQualifiedType(Key, ReturnValue.Type());
+    }
+    addReturnValueComment(Key, F);
+
+    Key.add(F.PreservedRegisters().size());
+    for (const auto &Register : F.PreservedRegisters())
+      Key.add(Register);
+
+    Key.add(F.FinalStackOffset());
+    addReference(Key, F.StackArgumentsType());
+  } break;
+
+  default:
+    break;
+  }
+}
+
+const std::string &TypeFragmentKeys::getKey(const model::Type *T) {
+  // References to elements of an unordered_map survive insertions
+  auto [It, New] = Keys.try_emplace(T);
+  std::string &Result = It->second;
+  if (not New)
+    return Result;
+
+  // Types cannot contain themselves by value, but be robust against models
+  // that do not verify: the key of a type being computed is empty.
+  CacheKeyBuilder Key;
+  addTypeContent(Key, *T);
+  for (const model::QualifiedType &QT : T->edges()) {
+    const model::Type *Used = QT.UnqualifiedType().get();
+    Key.add(TypesToInline.contains(Used));
+
+    auto IsPointer = [](const model::Qualifier &Q) {
+      return model::Qualifier::isPointer(Q);
+    };
+    if (llvm::any_of(QT.Qualifiers(), IsPointer)) {
+      // Only the name of pointees shows up in the header
+      Key.add(Used->ID()).add(Used->Kind()).add(Used->name());
+    } else {
+      Key.add(getKey(Used));
+    }
+  }
+
+  Result = Key.take();
+  return Result;
+}
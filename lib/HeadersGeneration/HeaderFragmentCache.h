@@ -0,0 +1,143 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.mit for details.
+//
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Model/Binary.h"
+#include "revng/Model/Type.h"
+
+#include "revng-c/HeadersGeneration/ModelToHeader.h"
+
+/// A type declaration or definition to be emitted in the model header
+struct HeaderStep {
+  enum Kind {
+    Declaration,
+    Definition
+  };
+
+  model::Type::Key Type;
+  Kind K;
+};
+
+/// The order in which the types are emitted in the model header
+struct HeaderPlan {
+  std::vector<HeaderStep> Steps;
+
+  /// Types whose definition is emitted inline, where they are used
+  std::vector<model::Type::Key> TypesToInline;
+};
+
+/// Builds the key of an entry of the HeaderFragmentCache
+///
+/// Each element is written so that different sequences of elements never
+/// produce the same key.
+class CacheKeyBuilder {
+private:
+  std::string Key;
+  llvm::raw_string_ostream Out{ Key };
+
+public:
+  CacheKeyBuilder &add(llvm::StringRef String) {
+    Out << String.size() << ':' << String;
+    return *this;
+  }
+
+  CacheKeyBuilder &add(uint64_t Value) {
+    Out << Value << ',';
+    return *this;
+  }
+
+  std::string take() {
+    Out.flush();
+    return std::move(Key);
+  }
+};
+
+/// Pieces of the model header, preserved across runs of dumpModelToHeader
+///
+/// Most of the model does not change from a run to the next one. The text of
+/// each declaration, definition and function prototype is cached by a key
+/// encoding everything it depends upon. The order in which types are emitted
+/// only depends on how types refer to each other, and it's cached by a key
+/// encoding that. Keys are stored in full, so entries are only reused if the
+/// model is exactly the same as far as they are concerned.
+///
+/// Entries that have not been used by the last few runs are dropped, as are
+/// all the ones not used by the last run if the cache grows too large.
+class HeaderFragmentCache {
+private:
+  template<typename T>
+  struct Entry {
+    T Value;
+    uint64_t LastUse = 0;
+  };
+
+public:
+  struct Statistics {
+    uint64_t Hits = 0;
+    uint64_t Misses = 0;
+  };
+
+private:
+  std::mutex Mutex;
+  uint64_t Generation = 0;
+  llvm::StringMap<Entry<std::string>> Fragments;
+  llvm::StringMap<Entry<HeaderPlan>> Plans;
+  Statistics FragmentStatistics;
+
+private:
+  HeaderFragmentCache() = default;
+
+public:
+  static HeaderFragmentCache &get();
+
+public:
+  std::optional<std::string> getFragment(llvm::StringRef Key);
+  void setFragment(llvm::StringRef Key, std::string Text);
+
+  std::optional<HeaderPlan> getPlan(llvm::StringRef Key);
+  void setPlan(llvm::StringRef Key, HeaderPlan Plan);
+
+  /// Drop the entries that have not been used recently
+  void endRun();
+
+  /// Drop all the entries, and reset the statistics
+  void clear();
+
+  Statistics getFragmentStatistics();
+};
+
+/// Encode the parts of the model that determine the HeaderPlan
+std::string getTypeGraphKey(const model::Binary &Model,
+                            const ModelToHeaderOptions &Options);
+
+/// Keys of types, as far as their declaration and definition are concerned
+///
+/// The key of a type encodes the fields of the type itself, the names of the
+/// types it points to, and the key of the types it uses by value, since their
+/// size and layout affect how the type is printed.
+class TypeFragmentKeys {
+private:
+  const std::set<const model::Type *> &TypesToInline;
+  std::unordered_map<const model::Type *, std::string> Keys;
+
+public:
+  TypeFragmentKeys(const std::set<const model::Type *> &TypesToInline) :
+    TypesToInline(TypesToInline) {}
+
+public:
+  const std::string &getKey(const model::Type *T);
+};
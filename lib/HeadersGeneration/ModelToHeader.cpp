@@ -2,6 +2,9 @@
 // This file is distributed under the MIT License. See LICENSE.mit for details.
 //
 
+#include <optional>
+#include <set>
+#include <type_traits>
 #include <unordered_map>
 
 #include "llvm/ADT/DepthFirstIterator.h"
@@ -31,6 +34,7 @@
 #include "revng-c/TypeNames/ModelTypeNames.h"
 
 #include "DependencyGraph.h"
+#include "HeaderFragmentCache.h"
 
 using llvm::isa;
 
@@ -61,23 +65,25 @@ static void printSegmentsTypes(const model::Segment &Segment,
   Header << getNamedCInstance(SegmentType, S, B) << ";\n";
 }
 
-/// Print all type definitions for the types in the model
-static void printTypeDefinitions(const model::Binary &Model,
-                                 const TypeInlineHelper &TheTypeInlineHelper,
-                                 ptml::PTMLIndentedOstream &Header,
-                                 ptml::PTMLCBuilder &B,
-                                 QualifiedTypeNameMap &AdditionalTypeNames,
-                                 const ModelToHeaderOptions &Options) {
+/// Compute which type declarations and definitions are emitted, and in which
+/// order
+static HeaderPlan planTypeDefinitions(const model::Binary &Model,
+                                      const ModelToHeaderOptions &Options) {
+  HeaderPlan Plan;
+  auto AddStep = [&Plan](const model::Type *T, HeaderStep::Kind K) {
+    Plan.Steps.push_back({ T->key(), K });
+  };
+
+  TypeInlineHelper TheTypeInlineHelper(Model);
   std::set<const model::Type *> StackTypes, EmptyInlineTypes;
   if (not Options.DisableTypeInlining)
     StackTypes = TheTypeInlineHelper.collectStackTypes(Model);
 
   DependencyGraph Dependencies = buildDependencyGraph(Model.Types());
-  const auto &TypeNodes = Dependencies.TypeNodes();
   auto &ToInline = Options.DisableTypeInlining ?
                      EmptyInlineTypes :
                      TheTypeInlineHelper.getTypesToInline();
-  std::set<const TypeDependencyNode *> Defined;
+  TypeDependencyNodeSet Defined(Dependencies);
 
   for (const auto *Root : Dependencies.nodes()) {
     revng_log(Log, "======== PostOrder " << getNodeLabel(Root));
@@ -114,15 +120,9 @@ static void printTypeDefinitions(const model::Binary &Model,
 
         // When emitting a full definition we also want to emit a forward
         // declaration first, if it wasn't already emitted somewhere else.
-        if (Defined.insert(TypeNodes.at({ NodeT, TypeName })).second
+        if (Defined.insert(Dependencies.getNode(Node, TypeName)).second
             and not ToInline.contains(NodeT)) {
-          printDeclaration(Log,
-                           *NodeT,
-                           Header,
-                           B,
-                           Model,
-                           AdditionalTypeNames,
-                           ToInline);
+          AddStep(NodeT, HeaderStep::Declaration);
         }
 
         if (not declarationIsDefinition(NodeT)
@@ -132,48 +132,29 @@ static void printTypeDefinitions(const model::Binary &Model,
           if ((isa<model::UnionType>(NodeT) or isa<model::StructType>(NodeT))
               and not ToInline.contains(NodeT)) {
             auto TypesToInline = TheTypeInlineHelper
-                                   .getTypesToInlineInTypeTy(Model, NodeT);
+                                   .getTypesToInlineInTypeTy(NodeT);
             for (auto *Type : TypesToInline) {
               revng_assert(isCandidateForInline(Type));
-              printDeclaration(Log,
-                               *Type,
-                               Header,
-                               B,
-                               Model,
-                               AdditionalTypeNames,
-                               ToInline);
+              AddStep(Type, HeaderStep::Declaration);
             }
           }
 
-          printDefinition(Log,
-                          *NodeT,
-                          Header,
-                          B,
-                          Model,
-                          AdditionalTypeNames,
-                          ToInline);
+          AddStep(NodeT, HeaderStep::Definition);
         }
 
         // This is always a full type definition
-        Defined.insert(TypeNodes.at({ NodeT, FullType }));
+        Defined.insert(Dependencies.getNode(Node, FullType));
       } else {
         if (not ToInline.contains(NodeT)) {
-          if (not Options.TypesToOmit.contains(Node->T)) {
-            printDeclaration(Log,
-                             *NodeT,
-                             Header,
-                             B,
-                             Model,
-                             AdditionalTypeNames,
-                             ToInline);
-          }
-          Defined.insert(TypeNodes.at({ NodeT, TypeName }));
+          if (not Options.TypesToOmit.contains(Node->T))
+            AddStep(NodeT, HeaderStep::Declaration);
+          Defined.insert(Dependencies.getNode(Node, TypeName));
         }
 
         // For primitive types the forward declaration we emit is also a full
         // definition, so we need to keep track of this.
         if (isa<model::PrimitiveType>(NodeT))
-          Defined.insert(TypeNodes.at({ NodeT, FullType }));
+          Defined.insert(Dependencies.getNode(Node, FullType));
 
         // For struct, enums and unions the forward declaration is just a
         // forward declaration, without body.
@@ -186,8 +167,161 @@ static void printTypeDefinitions(const model::Binary &Model,
     }
     revng_log(Log, "====== PostOrder DONE");
   }
+
+  for (const model::Type *T : ToInline)
+    Plan.TypesToInline.push_back(T->key());
+
+  return Plan;
+}
+
+/// Get the plan for the type definitions, computing it only if the types
+/// refer to each other differently than in the previous runs
+static HeaderPlan getTypeDefinitionsPlan(const model::Binary &Model,
+                                         const ModelToHeaderOptions &Options,
+                                         HeaderFragmentCache &Cache) {
+  // Compute the plan again when logging, so that the log is complete
+  if (Log.isEnabled())
+    return planTypeDefinitions(Model, Options);
+
+  std::string Key = getTypeGraphKey(Model, Options);
+  if (std::optional<HeaderPlan> Cached = Cache.getPlan(Key))
+    return std::move(*Cached);
+
+  HeaderPlan Plan = planTypeDefinitions(Model, Options);
+  Cache.setPlan(Key, Plan);
+  return Plan;
+}
+
+/// Array wrappers used by a CABIFunctionType are emitted along with the first
+/// function type using them, so the text of such function types depends on
+/// what has been printed before, and they cannot be cached.
+static bool usesArrayWrappers(const model::Type &T) {
+  const auto *CABI = llvm::dyn_cast<model::CABIFunctionType>(&T);
+  if (CABI == nullptr)
+    return false;
+
+  if (CABI->ReturnType().isArray())
+    return true;
+
+  return llvm::any_of(CABI->Arguments(), [](const model::Argument &Argument) {
+    return Argument.Type().isArray();
+  });
 }
 
+namespace {
+
+/// Prints the fragments of the header, taking them from the cache if they
+/// have already been printed by a previous run
+class FragmentPrinter {
+private:
+  enum FragmentKind : uint8_t {
+    TypeFragment,
+    FunctionFragment,
+    DynamicFunctionFragment
+  };
+
+private:
+  const model::Binary &Model;
+  ptml::PTMLIndentedOstream &Header;
+  ptml::PTMLCBuilder &B;
+  QualifiedTypeNameMap &AdditionalTypeNames;
+  const std::set<const model::Type *> &ToInline;
+  HeaderFragmentCache &Cache;
+  TypeFragmentKeys Keys;
+
+  /// Key of what affects all the fragments
+  std::string Prefix;
+
+public:
+  FragmentPrinter(const model::Binary &Model,
+                  ptml::PTMLIndentedOstream &Header,
+                  ptml::PTMLCBuilder &B,
+                  QualifiedTypeNameMap &AdditionalTypeNames,
+                  const std::set<const model::Type *> &ToInline,
+                  HeaderFragmentCache &Cache) :
+    Model(Model),
+    Header(Header),
+    B(B),
+    AdditionalTypeNames(AdditionalTypeNames),
+    ToInline(ToInline),
+    Cache(Cache),
+    Keys(ToInline),
+    Prefix(CacheKeyBuilder()
+             .add(B.isGenerateTagLessPTML())
+             .add(Model.Architecture())
+             .take()) {}
+
+public:
+  void printStep(const HeaderStep &Step) {
+    const model::Type &T = *Model.Types().at(Step.Type);
+
+    std::optional<std::string> Key;
+    if (not usesArrayWrappers(T))
+      Key = CacheKeyBuilder()
+              .add(Prefix)
+              .add(TypeFragment)
+              .add(Step.K)
+              .add(Keys.getKey(&T))
+              .take();
+
+    print(Key, [&](ptml::PTMLIndentedOstream &Out) {
+      if (Step.K == HeaderStep::Declaration)
+        printDeclaration(Log, T, Out, B, Model, AdditionalTypeNames, ToInline);
+      else
+        printDefinition(Log, T, Out, B, Model, AdditionalTypeNames, ToInline);
+    });
+  }
+
+  template<typename FunctionT>
+  void printPrototype(const model::Type &FT, const FunctionT &F) {
+    using model::DynamicFunction;
+    constexpr bool IsDynamic = std::is_same_v<FunctionT, DynamicFunction>;
+    FragmentKind Kind = IsDynamic ? DynamicFunctionFragment : FunctionFragment;
+    CacheKeyBuilder Key;
+    Key.add(Prefix)
+      .add(Kind)
+      .add(getNameFromYAMLScalar(F.key()))
+      .add(F.name())
+      .add(Keys.getKey(&FT))
+      .add(F.Attributes().size());
+    for (const auto &Attribute : F.Attributes())
+      Key.add(Attribute);
+
+    print(Key.take(), [&](ptml::PTMLIndentedOstream &Out) {
+      printFunctionPrototype(FT, F, Out, B, Model, false);
+      Out << ";\n";
+    });
+  }
+
+private:
+  template<typename PrinterT>
+  void print(std::optional<std::string> Key, PrinterT &&Print) {
+    // Log messages are interleaved with the code, don't cache them
+    if (not Key or Log.isEnabled()) {
+      Print(Header);
+      return;
+    }
+
+    if (std::optional<std::string> Cached = Cache.getFragment(*Key)) {
+      Header << *Cached;
+      return;
+    }
+
+    std::string Text;
+    {
+      llvm::raw_string_ostream Stream(Text);
+      ptml::PTMLIndentedOstream Out(Stream, DecompiledCCodeIndentation, true);
+      Print(Out);
+      Out.flush();
+    }
+
+    Header << Text;
+    Cache.setFragment(*Key, std::move(Text));
+  }
+};
+
+} // namespace
+
 bool dumpModelToHeader(const model::Binary &Model,
                        llvm::raw_ostream &Out,
                        const ModelToHeaderOptions &Options) {
@@ -216,6 +350,23 @@ bool dumpModelToHeader(const model::Binary &Model,
            << B.getNullTag() << " (" << B.getZeroTag() << ")\n"
            << B.getDirective(PTMLCBuilder::Directive::EndIf) << "\n";
 
+    auto &Cache = HeaderFragmentCache::get();
+    HeaderPlan Plan;
+    if (not Model.Types().empty())
+      Plan = getTypeDefinitionsPlan(Model, Options, Cache);
+
+    std::set<const model::Type *> ToInline;
+    for (const model::Type::Key &Key : Plan.TypesToInline)
+      ToInline.insert(Model.Types().at(Key).get());
+
+    QualifiedTypeNameMap AdditionalTypeNames;
+    FragmentPrinter Printer(Model,
+                            Header,
+                            B,
+                            AdditionalTypeNames,
+                            ToInline,
+                            Cache);
+
     if (not Model.Types().empty()) {
       auto Foldable = B.getScope(Scopes::TypeDeclarations)
                         .scope(Out,
@@ -225,15 +376,8 @@ bool dumpModelToHeader(const model::Binary &Model,
       Header << B.getLineComment("==== Types ====");
       Header << B.getLineComment("===============");
       Header << '\n';
-      QualifiedTypeNameMap AdditionalTypeNames;
-      TypeInlineHelper TheTypeInlineHelper(Model);
-
-      printTypeDefinitions(Model,
-                           TheTypeInlineHelper,
-                           Header,
-                           B,
-                           AdditionalTypeNames,
-                           Options);
+      for (const HeaderStep &Step : Plan.Steps)
+        Printer.printStep(Step);
     }
 
     if (not Model.Functions().empty()) {
@@ -262,8 +406,7 @@ bool dumpModelToHeader(const model::Binary &Model,
           serialize(Header, *FT);
         }
 
-        printFunctionPrototype(*FT, MF, Header, B, Model, false);
-        Header << ";\n";
+        Printer.printPrototype(*FT, MF);
       }
     }
 
@@ -293,8 +436,7 @@ bool dumpModelToHeader(const model::Binary &Model,
           Header << "Prototype\n";
           serialize(Header, *FT);
         }
-        printFunctionPrototype(*FT, MF, Header, B, Model, false);
-        Header << ";\n";
+        Printer.printPrototype(*FT, MF);
       }
     }
 
@@ -310,6 +452,8 @@ bool dumpModelToHeader(const model::Binary &Model,
         printSegmentsTypes(Segment, Header, B);
       Header << '\n';
     }
+
+    Cache.endRun();
   }
   return true;
 }
@@ -9,6 +9,10 @@
 
 static Logger<> Log{ "model-type-definition" };
 
+bool isModelTypeDefinitionLogEnabled() {
+  return Log.isEnabled();
+}
+
 std::string dumpModelTypeDefinition(const model::Binary &Model,
                                     model::Type::Key Key) {
   std::string Result;
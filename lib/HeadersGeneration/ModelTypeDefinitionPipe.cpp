@@ -2,6 +2,13 @@
 // This file is distributed under the MIT License. See LICENSE.mit for details.
 //
 
+#include <string>
+#include <vector>
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+
 #include "revng/Model/Binary.h"
 #include "revng/Pipeline/AllRegistries.h"
 #include "revng/Pipes/Kinds.h"
@@ -14,6 +21,15 @@
 #include "revng-c/HeadersGeneration/ModelTypeDefinitionPipe.h"
 #include "revng-c/Pipes/Kinds.h"
 
+static llvm::cl::opt<unsigned> Threads("model-type-definition-threads",
+                                       llvm::cl::desc("Number of threads used "
+                                                      "to print type "
+                                                      "definitions. 0 means "
+                                                      "one per hardware "
+                                                      "thread."),
+                                       llvm::cl::Hidden,
+                                       llvm::cl::init(0));
+
 namespace revng::pipes {
 
 using namespace pipeline;
@@ -28,11 +44,31 @@ void GenerateModelTypeDefinition::run(const ExecutionContext &Ctx,
                                       TypeTargetList &TargetList,
                                       Container &ModelTypesContainer) {
   const model::Binary &Model = *getModelFromContext(Ctx);
-  for (const pipeline::Target &Target : TargetList.getTargets()) {
-    Container::KeyType
-      Key = Container::keyFromString(Target.getPathComponents()[0]);
-    ModelTypesContainer[Key] = dumpModelTypeDefinition(Model, Key);
+
+  std::vector<Container::KeyType> Keys;
+  for (const pipeline::Target &Target : TargetList.getTargets())
+    Keys.push_back(Container::keyFromString(Target.getPathComponents()[0]));
+
+  // Each definition only reads the model, print them in parallel, unless they
+  // write to the log
+  std::vector<std::string> Definitions(Keys.size());
+  if (isModelTypeDefinitionLogEnabled()) {
+    for (size_t I = 0; I < Keys.size(); ++I)
+      Definitions[I] = dumpModelTypeDefinition(Model, Keys[I]);
+  } else {
+    llvm::ThreadPool Pool(llvm::hardware_concurrency(Threads));
+    for (size_t I = 0; I < Keys.size(); ++I) {
+      Pool.async([&Model, &Keys, &Definitions, I] {
+        Definitions[I] = dumpModelTypeDefinition(Model, Keys[I]);
+      });
+    }
+    Pool.wait();
   }
+
+  // Fill the container in the order of the targets, independently of the
+  // order in which the definitions have been completed
+  for (size_t I = 0; I < Keys.size(); ++I)
+    ModelTypesContainer[Keys[I]] = std::move(Definitions[I]);
 }
 
 void GenerateModelTypeDefinition::print(const Context &Ctx,
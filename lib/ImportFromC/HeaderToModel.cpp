@@ -2,6 +2,10 @@
 // This file is distributed under the MIT License. See LICENSE.mit for details.
 //
 
+#include <map>
+
+#include "llvm/ADT/DenseMap.h"
+
 #include "clang/AST/RecursiveASTVisitor.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Frontend/TextDiagnostic.h"
@@ -57,12 +61,12 @@ namespace tooling {
 
 class HeaderToModel : public ASTConsumer {
 public:
-  HeaderToModel(TupleTree<model::Binary> &Model,
+  HeaderToModel(ModelEdit &Edit,
                 std::optional<model::Type *> &Type,
                 std::optional<model::Function> &Function,
                 std::optional<ParseCCodeError> &Error,
                 enum ImportFromCOption AnalysisOption) :
-    Model(Model),
+    Edit(Edit),
     Type(Type),
     Function(Function),
     Error(Error),
@@ -75,7 +79,7 @@ public:
   virtual void HandleTranslationUnit(ASTContext &Context) override;
 
 private:
-  TupleTree<model::Binary> &Model;
+  ModelEdit &Edit;
   std::optional<model::Type *> &Type;
   std::optional<model::Function> &Function;
   std::optional<ParseCCodeError> &Error;
@@ -84,6 +88,7 @@ private:
 
 class DeclVisitor : public clang::RecursiveASTVisitor<DeclVisitor> {
 private:
+  ModelEdit &Edit;
   TupleTree<model::Binary> &Model;
   ASTContext &Context;
   std::optional<model::Type *> &Type;
@@ -95,6 +100,20 @@ private:
   unsigned CurrentLineNumber = 0;
   unsigned CurrentColumnNumber = 0;
 
+  // Number of errors reported so far.
+  unsigned ReportedErrors = 0;
+
+  // Types of the model before the import, by kind and name. Used to resolve
+  // references to existing types without scanning the whole model each time.
+  using NamedTypeKey = std::pair<model::TypeKind::Values, std::string>;
+  std::map<NamedTypeKey, model::Type::Key> TypesByName;
+
+  // Types defined by the input, indexed by their canonical declaration.
+  llvm::DenseMap<const clang::Decl *, model::Type::Key> ImportedTypes;
+
+  // Current key of the type being edited, which changes with its kind.
+  model::Type::Key EditedTypeKey;
+
   // Used to remember return values locations when parsing struct representing
   // the multi-reg return value. Represents register ID and mode::Type.
   using ModelType = std::pair<model::TypePath, std::vector<Qualifier>>;
@@ -102,7 +121,7 @@ private:
   std::optional<llvm::SmallVector<RawLocation, 4>> MultiRegisterReturnValue;
 
 public:
-  explicit DeclVisitor(TupleTree<model::Binary> &Model,
+  explicit DeclVisitor(ModelEdit &Edit,
                        ASTContext &Context,
                        std::optional<model::Type *> &Type,
                        std::optional<model::Function> &Function,
@@ -111,12 +130,18 @@ public:
 
   void run(clang::TranslationUnitDecl *TUD);
   bool TraverseDecl(clang::Decl *D);
+  bool VisitDecl(const clang::Decl *D);
+
+  // Visit nested declarations before the enclosing ones, since the latter
+  // might need the size of the former.
+  bool shouldTraversePostOrder() const { return true; }
 
   bool VisitFunctionDecl(const clang::FunctionDecl *FD);
   bool VisitRecordDecl(const clang::RecordDecl *RD);
   bool VisitEnumDecl(const EnumDecl *D);
   bool VisitTypedefDecl(const TypedefDecl *D);
-  bool VisitFunctionPrototype(const FunctionProtoType *FP,
+  bool VisitFunctionPrototype(const TypedefDecl *D,
+                              const FunctionProtoType *FP,
                               std::optional<llvm::StringRef> TheABI);
 
 private:
@@ -130,11 +155,29 @@ private:
   // Set up line and column for the declaratrion.
   void setupLineAndColumn(const clang::Decl *D);
 
+  // Report an error at the current line and column, unless there is one.
+  void reportError(llvm::StringRef Message);
+
+  // Add an empty type for each struct and union defined by the input, so that
+  // declarations can point to those defined later on.
+  void declareRecords(const clang::DeclContext *DC);
+
   // Handle clang's Struct type.
   bool handleStructType(const clang::RecordDecl *RD);
   // Handle clang's Union type.
   bool handleUnionType(const clang::RecordDecl *RD);
 
+  // Get a primitive type, recording it in the edit if it's new.
+  model::TypePath getPrimitiveType(model::PrimitiveTypeKind::Values Kind,
+                                   uint64_t Size);
+
+  // Replace the type being edited or add a new one, depending on the option.
+  void recordType(const clang::Decl *D,
+                  UpcastablePointer<model::Type> &&NewType);
+
+  // Get the type imported from \p D, if any.
+  std::optional<model::TypePath> getImportedType(const clang::Decl *D);
+
   // Convert clang::type to model::type.
   std::optional<model::TypePath>
   getOrCreatePrimitive(const BuiltinType *UnderlyingBuiltin, QualType Type);
@@ -158,18 +201,89 @@ private:
   getEnumUnderlyingType(const std::string &TypeName);
 };
 
-DeclVisitor::DeclVisitor(TupleTree<model::Binary> &Model,
+DeclVisitor::DeclVisitor(ModelEdit &Edit,
                          ASTContext &Context,
                          std::optional<model::Type *> &Type,
                          std::optional<model::Function> &Function,
                          std::optional<ParseCCodeError> &Error,
                          enum ImportFromCOption AnalysisOption) :
-  Model(Model),
+  Edit(Edit),
+  Model(Edit.getModel()),
   Context(Context),
   Type(Type),
   Function(Function),
   Error(Error),
   AnalysisOption(AnalysisOption) {
+  if (AnalysisOption == ImportFromCOption::EditType)
+    EditedTypeKey = (*Type)->key();
+
+  for (const UpcastablePointer<model::Type> &T : Model->Types()) {
+    // In case of duplicates, keep the first one, as a linear lookup would.
+    if (not T->CustomName().empty())
+      TypesByName.try_emplace({ T->Kind(), T->CustomName().str().str() },
+                              T->key());
+  }
+}
+
+model::TypePath
+DeclVisitor::getPrimitiveType(model::PrimitiveTypeKind::Values Kind,
+                              uint64_t Size) {
+  size_t TypesCount = Model->Types().size();
+  model::TypePath Result = Model->getPrimitiveType(Kind, Size);
+  if (Model->Types().size() != TypesCount)
+    Edit.recordAddedType(Result.get()->key());
+
+  return Result;
+}
+
+void DeclVisitor::recordType(const clang::Decl *D,
+                             UpcastablePointer<model::Type> &&NewType) {
+  const clang::Decl *Canonical = D->getCanonicalDecl();
+  if (AnalysisOption == ImportFromCOption::EditType) {
+    // The new type has the same ID of the old one, it replaces it, even if it
+    // has a different kind.
+    model::TypePath Path = Edit.replaceType(EditedTypeKey, std::move(NewType));
+    EditedTypeKey = Path.get()->key();
+    ImportedTypes[Canonical] = EditedTypeKey;
+  } else if (auto It = ImportedTypes.find(Canonical);
+             It != ImportedTypes.end()) {
+    // Fill in the type declared upfront, whatever kind it was declared with.
+    NewType->ID() = std::get<0>(It->second);
+    model::TypePath Path = Edit.replaceType(It->second, std::move(NewType));
+    It->second = Path.get()->key();
+  } else {
+    model::TypePath Path = Edit.addType(std::move(NewType));
+    ImportedTypes[Canonical] = Path.get()->key();
+  }
+}
+
+std::optional<model::TypePath>
+DeclVisitor::getImportedType(const clang::Decl *D) {
+  auto It = ImportedTypes.find(D->getCanonicalDecl());
+  if (It == ImportedTypes.end())
+    return std::nullopt;
+
+  return Model->getTypePath(It->second);
+}
+
+void DeclVisitor::declareRecords(const clang::DeclContext *DC) {
+  for (const clang::Decl *D : DC->decls()) {
+    const auto *RD = dyn_cast<RecordDecl>(D);
+    if (not RD or not comesFromInternalFile(RD))
+      continue;
+
+    // Nested records are part of the enclosing context.
+    declareRecords(RD);
+
+    if (not RD->isThisDeclarationADefinition())
+      continue;
+
+    auto NewType = RD->isUnion() ? makeType<model::UnionType>() :
+                                   makeType<model::StructType>();
+    setCustomName(*NewType, RD->getName());
+    model::TypePath Path = Edit.addType(std::move(NewType));
+    ImportedTypes[RD->getCanonicalDecl()] = Path.get()->key();
+  }
 }
 
 // Parse ABI from the annotate attribute content.
@@ -205,8 +319,8 @@ DeclVisitor::getEnumUnderlyingType(const std::string &TypeName) {
     return std::nullopt;
   }
 
-  return Model->getPrimitiveType(MaybePrimitive->PrimitiveKind(),
-                                 MaybePrimitive->Size());
+  return getPrimitiveType(MaybePrimitive->PrimitiveKind(),
+                          MaybePrimitive->Size());
 }
 
 std::optional<model::TypePath>
@@ -217,11 +331,10 @@ DeclVisitor::getOrCreatePrimitive(const BuiltinType *UnderlyingBuiltin,
   auto AsElaboratedType = Type->getAs<ElaboratedType>();
   if (not AsElaboratedType) {
     PrintingPolicy Policy(Context.getLangOpts());
-    std::string ErrorMessage = "revng: Builtin type `"
-                               + UnderlyingBuiltin->getName(Policy).str()
-                               + "` not allowed, please use a revng "
-                                 "model::PrimitiveType instead";
-    Error = { ErrorMessage, CurrentLineNumber, CurrentColumnNumber };
+    reportError("revng: Builtin type `"
+                + UnderlyingBuiltin->getName(Policy).str()
+                + "` not allowed, please use a revng model::PrimitiveType "
+                  "instead");
 
     return std::nullopt;
   }
@@ -236,11 +349,8 @@ DeclVisitor::getOrCreatePrimitive(const BuiltinType *UnderlyingBuiltin,
   std::string TypeName = AsElaboratedType->getNamedType().getAsString();
   auto MaybePrimitive = model::PrimitiveType::fromName(TypeName);
   if (not MaybePrimitive.has_value()) {
-    std::string ErrorMessage = "revng: `"
-                               + AsElaboratedType->getNamedType().getAsString()
-                               + "`, please use a revng model::PrimitiveType "
-                                 "instead";
-    Error = { ErrorMessage, CurrentLineNumber, CurrentColumnNumber };
+    reportError("revng: `" + AsElaboratedType->getNamedType().getAsString()
+                + "`, please use a revng model::PrimitiveType instead");
 
     return std::nullopt;
   }
@@ -248,61 +358,61 @@ DeclVisitor::getOrCreatePrimitive(const BuiltinType *UnderlyingBuiltin,
   model::TypePath Result;
   switch (UnderlyingBuiltin->getKind()) {
   case BuiltinType::UInt128: {
-    return Model->getPrimitiveType(model::PrimitiveTypeKind::Unsigned, 16);
+    return getPrimitiveType(model::PrimitiveTypeKind::Unsigned, 16);
   }
   case BuiltinType::Int128: {
-    return Model->getPrimitiveType(model::PrimitiveTypeKind::Signed, 16);
+    return getPrimitiveType(model::PrimitiveTypeKind::Signed, 16);
   }
   case BuiltinType::ULongLong:
   case BuiltinType::ULong: {
-    return Model->getPrimitiveType(model::PrimitiveTypeKind::Unsigned, 8);
+    return getPrimitiveType(model::PrimitiveTypeKind::Unsigned, 8);
   }
   case BuiltinType::LongLong:
   case BuiltinType::Long: {
-    return Model->getPrimitiveType(model::PrimitiveTypeKind::Signed, 8);
+    return getPrimitiveType(model::PrimitiveTypeKind::Signed, 8);
   }
   case BuiltinType::WChar_U:
   case BuiltinType::UInt: {
-    return Model->getPrimitiveType(model::PrimitiveTypeKind::Unsigned, 4);
+    return getPrimitiveType(model::PrimitiveTypeKind::Unsigned, 4);
   }
   case BuiltinType::WChar_S:
   case BuiltinType::Char32:
   case BuiltinType::Int: {
-    return Model->getPrimitiveType(model::PrimitiveTypeKind::Signed, 4);
+    return getPrimitiveType(model::PrimitiveTypeKind::Signed, 4);
   }
   case BuiltinType::Char16:
   case BuiltinType::Short: {
-    return Model->getPrimitiveType(model::PrimitiveTypeKind::Signed, 2);
+    return getPrimitiveType(model::PrimitiveTypeKind::Signed, 2);
   }
   case BuiltinType::UShort: {
-    return Model->getPrimitiveType(model::PrimitiveTypeKind::Unsigned, 2);
+    return getPrimitiveType(model::PrimitiveTypeKind::Unsigned, 2);
   }
   case BuiltinType::Char_S:
   case BuiltinType::SChar:
   case BuiltinType::Char8:
   case BuiltinType::Bool: {
-    return Model->getPrimitiveType(model::PrimitiveTypeKind::Signed, 1);
+    return getPrimitiveType(model::PrimitiveTypeKind::Signed, 1);
   }
   case BuiltinType::Char_U:
   case BuiltinType::UChar: {
-    return Model->getPrimitiveType(model::PrimitiveTypeKind::Unsigned, 1);
+    return getPrimitiveType(model::PrimitiveTypeKind::Unsigned, 1);
   }
   case BuiltinType::Void: {
-    return Model->getPrimitiveType(model::PrimitiveTypeKind::Void, 0);
+    return getPrimitiveType(model::PrimitiveTypeKind::Void, 0);
   }
   case BuiltinType::Float16: {
-    return Model->getPrimitiveType(model::PrimitiveTypeKind::Float, 2);
+    return getPrimitiveType(model::PrimitiveTypeKind::Float, 2);
   }
 
   case BuiltinType::Float: {
-    return Model->getPrimitiveType(model::PrimitiveTypeKind::Float, 4);
+    return getPrimitiveType(model::PrimitiveTypeKind::Float, 4);
   }
   case BuiltinType::Double: {
-    return Model->getPrimitiveType(model::PrimitiveTypeKind::Float, 8);
+    return getPrimitiveType(model::PrimitiveTypeKind::Float, 8);
   }
   case BuiltinType::Float128:
   case BuiltinType::LongDouble: {
-    return Model->getPrimitiveType(model::PrimitiveTypeKind::Float, 16);
+    return getPrimitiveType(model::PrimitiveTypeKind::Float, 16);
   }
 
   default: {
@@ -316,32 +426,10 @@ DeclVisitor::getOrCreatePrimitive(const BuiltinType *UnderlyingBuiltin,
 
 std::optional<model::TypePath>
 DeclVisitor::getTypeByNameOrID(llvm::StringRef Name, TypeKind::Values Kind) {
-  const bool IsStruct = Kind == model::TypeKind::StructType;
-  const bool IsUnion = Kind == model::TypeKind::UnionType;
-  const bool IsEnum = Kind == model::TypeKind::EnumType;
-  const bool IsCABIFunction = Kind == model::TypeKind::CABIFunctionType;
-  const bool IsRawFunctionType = Kind == model::TypeKind::RawFunctionType;
-
   // Find by name first.
-  for (auto &Type : Model->Types()) {
-    if (IsStruct and not llvm::isa<model::StructType>(Type.get()))
-      continue;
-
-    if (IsUnion and not llvm::isa<model::UnionType>(Type.get()))
-      continue;
-
-    if (IsEnum and not llvm::isa<model::EnumType>(Type.get()))
-      continue;
-
-    if (IsCABIFunction and not llvm::isa<model::CABIFunctionType>(Type.get()))
-      continue;
-
-    if (IsRawFunctionType and not llvm::isa<model::RawFunctionType>(Type.get()))
-      continue;
-
-    if (Type->CustomName() == Name)
-      return Model->getTypePath(Type.get());
-  }
+  auto It = TypesByName.find({ Kind, Name.str() });
+  if (It != TypesByName.end())
+    return Model->getTypePath(It->second);
 
   size_t LocationOfID = Name.rfind("_");
 
@@ -380,10 +468,13 @@ DeclVisitor::getTypeForRecordType(const clang::RecordType *RecordType,
     auto MaybePrimitive = model::PrimitiveType::fromName(TypeName);
     revng_assert(MaybePrimitive);
 
-    return Model->getPrimitiveType(MaybePrimitive->PrimitiveKind(),
-                                   MaybePrimitive->Size());
+    return getPrimitiveType(MaybePrimitive->PrimitiveKind(),
+                            MaybePrimitive->Size());
   }
 
+  if (auto Imported = getImportedType(RecordType->getDecl()))
+    return *Imported;
+
   auto Name = RecordType->getDecl()->getName();
   if (Name.empty()) {
     revng_log(Log, "Unable to find record type without name");
@@ -409,6 +500,9 @@ DeclVisitor::getTypeForEnumType(const clang::EnumType *EnumType) {
   revng_assert(EnumType);
   revng_assert(AnalysisOption != ImportFromCOption::EditFunctionPrototype);
 
+  if (auto Imported = getImportedType(EnumType->getDecl()))
+    return *Imported;
+
   auto EnumName = EnumType->getDecl()->getName();
   if (EnumName.empty()) {
     revng_log(Log, "Unable to find enum type without name");
@@ -466,6 +560,14 @@ void DeclVisitor::setupLineAndColumn(const clang::Decl *D) {
   CurrentColumnNumber = Loc.getColumn();
 }
 
+void DeclVisitor::reportError(llvm::StringRef Message) {
+  // Only the first error is reported, in the same format as when importing a
+  // single declaration
+  if (not Error)
+    Error = { Message.str(), CurrentLineNumber, CurrentColumnNumber };
+  ++ReportedErrors;
+}
+
 std::optional<model::QualifiedType>
 DeclVisitor::getModelTypeForClangType(const QualType &QT) {
   std::optional<model::TypePath> TheTypePath;
@@ -511,21 +613,25 @@ DeclVisitor::getModelTypeForClangType(const QualType &QT) {
         return std::nullopt;
       }
 
-      auto FunctionName = AsTypedef->getDecl()->getName();
-      auto CABIFunctionTypeKind = model::TypeKind::CABIFunctionType;
-      auto TheCABIFunctionType = getTypeByNameOrID(FunctionName,
-                                                   CABIFunctionTypeKind);
-
-      auto RawFunctionTypeKind = model::TypeKind::RawFunctionType;
-      auto TheRawFunctionType = getTypeByNameOrID(FunctionName,
-                                                  RawFunctionTypeKind);
-
-      if (not TheCABIFunctionType and not TheRawFunctionType) {
-        revng_log(Log, "Did not find function type in the model");
-        return std::nullopt;
+      if (auto Imported = getImportedType(AsTypedef->getDecl())) {
+        TheTypePath = *Imported;
+      } else {
+        auto FunctionName = AsTypedef->getDecl()->getName();
+        auto CABIFunctionTypeKind = model::TypeKind::CABIFunctionType;
+        auto TheCABIFunctionType = getTypeByNameOrID(FunctionName,
+                                                     CABIFunctionTypeKind);
+
+        auto RawFunctionTypeKind = model::TypeKind::RawFunctionType;
+        auto TheRawFunctionType = getTypeByNameOrID(FunctionName,
+                                                    RawFunctionTypeKind);
+
+        if (not TheCABIFunctionType and not TheRawFunctionType) {
+          revng_log(Log, "Did not find function type in the model");
+          return std::nullopt;
+        }
+        TheTypePath = TheCABIFunctionType ? *TheCABIFunctionType :
+                                            *TheRawFunctionType;
       }
-      TheTypePath = TheCABIFunctionType ? *TheCABIFunctionType :
-                                          *TheRawFunctionType;
     } else {
       revng_log(Log, "Unsupported type used as pointer");
       return std::nullopt;
@@ -585,7 +691,17 @@ bool DeclVisitor::VisitFunctionDecl(const clang::FunctionDecl *FD) {
     return true;
 
   revng_assert(FD);
-  revng_assert(AnalysisOption == ImportFromCOption::EditFunctionPrototype);
+
+  // Headers of libraries declare functions along with types, but only types
+  // are imported from them.
+  if (AnalysisOption != ImportFromCOption::EditFunctionPrototype) {
+    revng_log(Log,
+              "Skipping function " << FD->getName().str()
+                                   << ": functions are only imported when "
+                                      "editing a function prototype");
+    return true;
+  }
+
   std::optional<std::string> MaybeABI;
   std::vector<AnnotateAttr *> AnnotateAttrs;
 
@@ -761,7 +877,7 @@ bool DeclVisitor::VisitFunctionDecl(const clang::FunctionDecl *FD) {
   }
 
   // Update the name if in the case it got changed.
-  auto &ModelFunction = Model->Functions()[Function->Entry()];
+  auto &ModelFunction = Edit.editFunction(Function->Entry());
   setCustomName(ModelFunction, FD->getName());
 
   // Clone the other stuff.
@@ -770,7 +886,7 @@ bool DeclVisitor::VisitFunctionDecl(const clang::FunctionDecl *FD) {
 
   // TODO: remember/clone StackFrameType as well.
 
-  auto Prototype = Model->recordNewType(std::move(NewType));
+  auto Prototype = Edit.addType(std::move(NewType));
   ModelFunction.Prototype() = Prototype;
 
   return true;
@@ -807,7 +923,7 @@ bool DeclVisitor::VisitTypedefDecl(const TypedefDecl *D) {
       return false;
     }
 
-    return VisitFunctionPrototype(Fn, TheABI);
+    return VisitFunctionPrototype(D, Fn, TheABI);
   }
 
   // Regular, non-function, typedef.
@@ -824,21 +940,13 @@ bool DeclVisitor::VisitTypedefDecl(const TypedefDecl *D) {
   TheTypeTypeDef->UnderlyingType() = *ModelTypedefType;
   setCustomName(*TheTypeTypeDef, D->getName());
 
-  if (AnalysisOption == ImportFromCOption::EditType) {
-    // Remove old and add new type with the same ID.
-    llvm::erase_if(Model->Types(), [&](UpcastablePointer<model::Type> &P) {
-      return P.get()->ID() == (*Type)->ID();
-    });
-
-    Model->Types().insert(std::move(TypeTypedef));
-  } else {
-    Model->recordNewType(std::move(TypeTypedef));
-  }
+  recordType(D, std::move(TypeTypedef));
 
   return true;
 }
 
-bool DeclVisitor::VisitFunctionPrototype(const FunctionProtoType *FP,
+bool DeclVisitor::VisitFunctionPrototype(const TypedefDecl *D,
+                                         const FunctionProtoType *FP,
                                          std::optional<llvm::StringRef> ABI) {
   revng_assert(AnalysisOption != ImportFromCOption::EditFunctionPrototype);
 
@@ -899,16 +1007,7 @@ bool DeclVisitor::VisitFunctionPrototype(const FunctionProtoType *FP,
     FunctionType->FinalStackOffset() = DefaulRawType->FinalStackOffset();
   }
 
-  if (AnalysisOption == ImportFromCOption::EditType) {
-    // Remove old and add new type with the same ID.
-    llvm::erase_if(Model->Types(), [&](UpcastablePointer<model::Type> &P) {
-      return P.get()->ID() == (*Type)->ID();
-    });
-
-    Model->Types().insert(std::move(NewType));
-  } else {
-    Model->recordNewType(std::move(NewType));
-  }
+  recordType(D, std::move(NewType));
 
   return true;
 }
@@ -930,6 +1029,7 @@ bool DeclVisitor::handleStructType(const clang::RecordDecl *RD) {
   llvm::SmallVector<std::pair<model::Register::Values, ModelType>, 4>
     ReturnValues;
   for (const FieldDecl *Field : Definition->fields()) {
+    setupLineAndColumn(Field);
     if (Field->isInvalidDecl()) {
       revng_log(Log, "Invalid declaration for a struct field");
       return false;
@@ -1020,20 +1120,13 @@ bool DeclVisitor::handleStructType(const clang::RecordDecl *RD) {
 
   switch (AnalysisOption) {
   case ImportFromCOption::EditType:
-    // Remove old and add new type with the same ID.
-    llvm::erase_if(Model->Types(), [&](UpcastablePointer<model::Type> &P) {
-      return P.get()->ID() == (*Type)->ID();
-    });
-    Model->Types().insert(std::move(NewType));
+  case ImportFromCOption::AddType:
+    recordType(RD, std::move(NewType));
     break;
 
   case ImportFromCOption::EditFunctionPrototype:
     MultiRegisterReturnValue = ReturnValues;
     break;
-
-  case ImportFromCOption::AddType:
-    Model->recordNewType(std::move(NewType));
-    break;
   }
 
   return true;
@@ -1052,6 +1145,7 @@ bool DeclVisitor::handleUnionType(const clang::RecordDecl *RD) {
 
   uint64_t CurrentIndex = 0;
   for (const FieldDecl *Field : Definition->fields()) {
+    setupLineAndColumn(Field);
     if (Field->isInvalidDecl()) {
       revng_log(Log, "Invalid declaration for a union field");
       return false;
@@ -1074,15 +1168,7 @@ bool DeclVisitor::handleUnionType(const clang::RecordDecl *RD) {
     ++CurrentIndex;
   }
 
-  if (AnalysisOption == ImportFromCOption::EditType) {
-    // Remove old and add new type with the same ID.
-    llvm::erase_if(Model->Types(), [&](UpcastablePointer<model::Type> &P) {
-      return P.get()->ID() == (*Type)->ID();
-    });
-    Model->Types().insert(std::move(NewType));
-  } else {
-    Model->recordNewType(std::move(NewType));
-  }
+  recordType(RD, std::move(NewType));
 
   return true;
 }
@@ -1091,6 +1177,10 @@ bool DeclVisitor::VisitRecordDecl(const clang::RecordDecl *RD) {
   if (not comesFromInternalFile(RD))
     return true;
 
+  // Forward declarations are imported along with their definition.
+  if (not RD->isThisDeclarationADefinition())
+    return true;
+
   if (AnalysisOption != ImportFromCOption::EditFunctionPrototype
       and not RD->hasAttr<PackedAttr>()) {
     revng_log(Log, "Unions and Structs should have attribute packed");
@@ -1116,6 +1206,9 @@ bool DeclVisitor::VisitEnumDecl(const EnumDecl *D) {
 
   revng_assert(AnalysisOption != ImportFromCOption::EditFunctionPrototype);
 
+  if (not D->isThisDeclarationADefinition())
+    return true;
+
   if (not D->hasAttr<PackedAttr>()) {
     revng_log(Log, "Enums should have attribute packed");
     return false;
@@ -1165,24 +1258,25 @@ bool DeclVisitor::VisitEnumDecl(const EnumDecl *D) {
       EnumEntry.CustomName() = NewName;
   }
 
-  if (AnalysisOption == ImportFromCOption::EditType) {
-    // Remove old and add new type with the same ID.
-    llvm::erase_if(Model->Types(), [&](UpcastablePointer<model::Type> &P) {
-      return P.get()->ID() == (*Type)->ID();
-    });
-
-    Model->Types().insert(std::move(NewType));
-  } else {
-    Model->recordNewType(std::move(NewType));
-  }
+  recordType(D, std::move(NewType));
 
   return true;
 }
 
 void DeclVisitor::run(clang::TranslationUnitDecl *TUD) {
+  // New types can be defined in any order, and refer to each other.
+  if (AnalysisOption == ImportFromCOption::AddType)
+    declareRecords(TUD);
+
   this->TraverseDecl(TUD);
 }
 
+bool DeclVisitor::VisitDecl(const clang::Decl *D) {
+  // This is called before the more specific visitors.
+  setupLineAndColumn(D);
+  return true;
+}
+
 bool DeclVisitor::TraverseDecl(clang::Decl *D) {
   // This can happen due to an error in the code.
   if (!D)
@@ -1190,24 +1284,30 @@ bool DeclVisitor::TraverseDecl(clang::Decl *D) {
 
   setupLineAndColumn(D);
 
-  if (isa<EnumDecl>(D))
-    VisitEnumDecl(cast<EnumDecl>(D));
+  // Each declaration is imported on its own: a failure does not prevent
+  // importing the others, but only the first error is reported.
+  unsigned ErrorsBefore = ReportedErrors;
+  if (not clang::RecursiveASTVisitor<DeclVisitor>::TraverseDecl(D)
+      and ReportedErrors == ErrorsBefore) {
+    std::string Name = "declaration";
+    if (const auto *ND = dyn_cast<NamedDecl>(D); ND and ND->getIdentifier())
+      Name = "`" + ND->getName().str() + "`";
+
+    setupLineAndColumn(D);
+    reportError("revng: unable to import " + Name);
+  }
 
-  clang::RecursiveASTVisitor<DeclVisitor>::TraverseDecl(D);
   return true;
 }
 
 void HeaderToModel::HandleTranslationUnit(ASTContext &Context) {
-  Model->Architecture() = Model->Architecture();
-  Model->DefaultABI() = Model->DefaultABI();
-
   clang::TranslationUnitDecl *TUD = Context.getTranslationUnitDecl();
-  DeclVisitor(Model, Context, Type, Function, Error, AnalysisOption).run(TUD);
+  DeclVisitor(Edit, Context, Type, Function, Error, AnalysisOption).run(TUD);
 }
 
 std::unique_ptr<ASTConsumer> HeaderToModelEditTypeAction::newASTConsumer() {
   std::optional<model::Function> FunctionToBeEdited{ std::nullopt };
-  return std::make_unique<HeaderToModel>(Model,
+  return std::make_unique<HeaderToModel>(Edit,
                                          Type,
                                          FunctionToBeEdited,
                                          Error,
@@ -1216,7 +1316,7 @@ std::unique_ptr<ASTConsumer> HeaderToModelEditTypeAction::newASTConsumer() {
 
 std::unique_ptr<ASTConsumer> HeaderToModelEditFunctionAction::newASTConsumer() {
   std::optional<model::Type *> TypeToBeEdited{ std::nullopt };
-  return std::make_unique<HeaderToModel>(Model,
+  return std::make_unique<HeaderToModel>(Edit,
                                          TypeToBeEdited,
                                          Function,
                                          Error,
@@ -1226,7 +1326,7 @@ std::unique_ptr<ASTConsumer> HeaderToModelEditFunctionAction::newASTConsumer() {
 std::unique_ptr<ASTConsumer> HeaderToModelAddTypeAction::newASTConsumer() {
   std::optional<model::Type *> TypeToBeEdited{ std::nullopt };
   std::optional<model::Function> FunctionToBeEdited{ std::nullopt };
-  return std::make_unique<HeaderToModel>(Model,
+  return std::make_unique<HeaderToModel>(Edit,
                                          TypeToBeEdited,
                                          FunctionToBeEdited,
                                          Error,
@@ -15,6 +15,7 @@
 #include "revng/TupleTree/TupleTree.h"
 
 #include "ImportFromCAnalysis.h"
+#include "ModelEdit.h"
 
 namespace revng {
 struct ParseCCodeError {
@@ -50,10 +51,10 @@ private:
 
 class HeaderToModelAction : public ASTFrontendAction {
 protected:
-  HeaderToModelAction(TupleTree<model::Binary> &Model,
+  HeaderToModelAction(ModelEdit &Edit,
                       enum ImportFromCOption AnalysisOption,
                       std::optional<revng::ParseCCodeError> &Error) :
-    Model(Model), AnalysisOption(AnalysisOption), Error(Error) {}
+    Edit(Edit), AnalysisOption(AnalysisOption), Error(Error) {}
 
 public:
   virtual std::unique_ptr<ASTConsumer> newASTConsumer() = 0;
@@ -66,7 +67,8 @@ public:
   virtual void EndSourceFile() override;
 
 protected:
-  TupleTree<model::Binary> &Model;
+  // Changes to the model, applied as the declarations are parsed.
+  ModelEdit &Edit;
 
   // This indiacates which feature is used (edit/add type, edit function
   // prototype).
@@ -82,10 +84,10 @@ private:
 // Handle Edit Type option.
 class HeaderToModelEditTypeAction : public HeaderToModelAction {
 public:
-  HeaderToModelEditTypeAction(TupleTree<model::Binary> &Model,
+  HeaderToModelEditTypeAction(ModelEdit &Edit,
                               std::optional<revng::ParseCCodeError> &Error,
                               std::optional<model::Type *> &Type) :
-    HeaderToModelAction(Model, ImportFromCOption::EditType, Error),
+    HeaderToModelAction(Edit, ImportFromCOption::EditType, Error),
     Type(Type) {}
 
 private:
@@ -99,10 +101,10 @@ public:
 // Handle Edit Function Prototype option.
 class HeaderToModelEditFunctionAction : public HeaderToModelAction {
 public:
-  HeaderToModelEditFunctionAction(TupleTree<model::Binary> &Model,
+  HeaderToModelEditFunctionAction(ModelEdit &Edit,
                                   std::optional<revng::ParseCCodeError> &Error,
                                   std::optional<model::Function> &Function) :
-    HeaderToModelAction(Model, ImportFromCOption::EditFunctionPrototype, Error),
+    HeaderToModelAction(Edit, ImportFromCOption::EditFunctionPrototype, Error),
     Function(Function) {}
 
 private:
@@ -116,9 +118,9 @@ public:
 // Handle Add Type option.
 class HeaderToModelAddTypeAction : public HeaderToModelAction {
 public:
-  HeaderToModelAddTypeAction(TupleTree<model::Binary> &Model,
+  HeaderToModelAddTypeAction(ModelEdit &Edit,
                              std::optional<revng::ParseCCodeError> &Error) :
-    HeaderToModelAction(Model, ImportFromCOption::AddType, Error) {}
+    HeaderToModelAction(Edit, ImportFromCOption::AddType, Error) {}
 
 public:
   virtual std::unique_ptr<ASTConsumer> newASTConsumer() override;
@@ -13,7 +13,6 @@
 #include "llvm/Support/Error.h"
 #include "llvm/Support/ToolOutputFile.h"
 
-#include "clang/Driver/Driver.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Frontend/FrontendAction.h"
 #include "clang/Lex/PreprocessorOptions.h"
@@ -27,8 +26,6 @@
 #include "revng/Pipeline/Option.h"
 #include "revng/Pipeline/RegisterAnalysis.h"
 #include "revng/Pipes/ModelGlobal.h"
-#include "revng/Support/PathList.h"
-#include "revng/Support/TemporaryFile.h"
 #include "revng/Support/YAMLTraits.h"
 #include "revng/TupleTree/TupleTreeDiff.h"
 
@@ -38,41 +35,13 @@
 #include "HeaderToModel.h"
 #include "ImportFromCAnalysis.h"
 #include "ImportFromCHelpers.h"
+#include "ImportFromCSession.h"
+#include "ModelEdit.h"
 
 using namespace llvm;
 using namespace clang;
 using namespace clang::tooling;
 
-static constexpr std::string_view InputCFile = "revng-input.c";
-
-static std::vector<std::string>
-getOptionsFromCFGFile(llvm::StringRef FilePath) {
-  std::vector<std::string> Result;
-
-  auto MaybeBuffer = llvm::MemoryBuffer::getFile(FilePath);
-  revng_assert(MaybeBuffer);
-
-  llvm::SmallVector<llvm::StringRef, 0> Lines;
-  MaybeBuffer->get()->getBuffer().split(Lines, '\n');
-  for (llvm::StringRef &Line : Lines) {
-    if (Line.size() > 0 and Line[0] == '-')
-      Result.push_back(Line.str());
-  }
-
-  return Result;
-}
-
-static std::optional<std::string> findHeaderFile(const std::string &File) {
-  auto MaybeHeaderPath = revng::ResourceFinder.findFile(File);
-  if (not MaybeHeaderPath)
-    return std::nullopt;
-  auto Index = (*MaybeHeaderPath).rfind('/');
-  if (Index == std::string::npos)
-    return std::nullopt;
-
-  return (*MaybeHeaderPath).substr(0, Index);
-}
-
 struct ImportFromCAnalysis {
   static constexpr auto Name = "import-from-c";
 
@@ -95,7 +64,8 @@ struct ImportFromCAnalysis {
     std::optional<model::Function> FunctionToBeEdited;
 
     if (LocationToEdit.empty()) {
-      // This is the default option of the analysis.
+      // This is the default option of the analysis. Any number of types can
+      // be added at once, e.g., a whole header of a library.
       TheOption = ImportFromCOption::AddType;
     } else {
       if (auto L = pipeline::locationFromString(revng::ranks::Function,
@@ -130,26 +100,6 @@ struct ImportFromCAnalysis {
       }
     }
 
-    auto MaybeFilterModelPath = TemporaryFile::make("filtered-model-header-"
-                                                    "ptml",
-                                                    "h");
-    if (!MaybeFilterModelPath) {
-      std::error_code EC = MaybeFilterModelPath.getError();
-      return llvm::createStringError(EC,
-                                     "Couldn't create temporary file: "
-                                       + EC.message());
-    }
-
-    TemporaryFile &FilterModelPath = MaybeFilterModelPath.get();
-    std::error_code EC;
-    llvm::raw_fd_ostream Header(FilterModelPath.path(), EC);
-    if (EC) {
-      return llvm::createStringError(EC,
-                                     "Couldn't open file for "
-                                     "filtered-model-header-ptml.h: "
-                                       + EC.message());
-    }
-
     ModelToHeaderOptions Options = {
       .GeneratePlainC = true,
       .DisableTypeInlining = true,
@@ -181,78 +131,41 @@ struct ImportFromCAnalysis {
       // We have nothing to ignore
     }
 
-    dumpModelToHeader(*Model, Header, Options);
-
-    Header.close();
+    // The header fragments of the types that did not change since the last
+    // run are cached, so this is cheap for small edits.
+    std::string Header;
+    {
+      llvm::raw_string_ostream HeaderStream(Header);
+      dumpModelToHeader(*Model, HeaderStream, Options);
+    }
 
-    std::string FilteredHeader = std::string("#include \"")
-                                 + FilterModelPath.path().str()
-                                 + std::string("\"");
-    TupleTree<model::Binary> OutModel(Model);
+    // Declarations are imported straight into the model: everything is undone
+    // when Edit goes out of scope, unless it's committed.
+    ModelEdit Edit(Model);
 
     std::optional<revng::ParseCCodeError> Error;
     std::unique_ptr<HeaderToModelAction> Action;
 
     if (TheOption == ImportFromCOption::EditType) {
-      Action = std::make_unique<HeaderToModelEditTypeAction>(OutModel,
+      Action = std::make_unique<HeaderToModelEditTypeAction>(Edit,
                                                              Error,
                                                              TypeToEdit);
     } else if (TheOption == ImportFromCOption::EditFunctionPrototype) {
       using EditFunctionPrototype = HeaderToModelEditFunctionAction;
-      Action = std::make_unique<EditFunctionPrototype>(OutModel,
+      Action = std::make_unique<EditFunctionPrototype>(Edit,
                                                        Error,
                                                        FunctionToBeEdited);
     } else {
-      Action = std::make_unique<HeaderToModelAddTypeAction>(OutModel, Error);
-    }
-
-    // Find compile flags to be applied to clang.
-    StringRef CompileFlagsPath = "share/revng-c/compile-flags.cfg";
-    auto MaybeCompileCFGPath = revng::ResourceFinder.findFile(CompileFlagsPath);
-    if (not MaybeCompileCFGPath) {
-      return llvm::createStringError(llvm::inconvertibleErrorCode(),
-                                     "Couldn't find compile-flags.cfg");
-    }
-
-    // Since the `--config` is just a clang Driver option, we need to parse it
-    // manually.
-    auto FromCFGFile = getOptionsFromCFGFile(*MaybeCompileCFGPath);
-    std::vector<std::string> Compilation(FromCFGFile);
-    Compilation.push_back("-xc");
-
-    SmallString<16> CompilerHeadersPath;
-    {
-      StringRef LLVMLibrary = getLibrariesFullPath().at("libLLVMSupport");
-      using namespace llvm::sys::path;
-      SmallString<16> ClangPath;
-      append(ClangPath, parent_path(parent_path(LLVMLibrary)));
-      append(ClangPath, Twine("bin"));
-      append(ClangPath, Twine("clang"));
-      CompilerHeadersPath = clang::driver::Driver::GetResourcesPath(ClangPath);
-      append(CompilerHeadersPath, Twine("include"));
-    }
-    Compilation.push_back("-I" + CompilerHeadersPath.str().str());
-
-    // Find revng-primitive-types.h and revng-attributes.h.
-    const char *PrimitivesHeader = "share/revng-c/include/"
-                                   "revng-primitive-types.h";
-    auto MaybePrimitiveHeaderPath = findHeaderFile(PrimitivesHeader);
-    if (not MaybePrimitiveHeaderPath) {
-      return llvm::createStringError(llvm::inconvertibleErrorCode(),
-                                     "Couldn't find revng-primitive-types.h");
+      Action = std::make_unique<HeaderToModelAddTypeAction>(Edit, Error);
     }
-    Compilation.push_back("-I" + *MaybePrimitiveHeaderPath);
 
-    FilteredHeader += "\n";
-    FilteredHeader += CCode;
-
-    if (not clang::tooling::runToolOnCodeWithArgs(std::move(Action),
-                                                  FilteredHeader,
-                                                  Compilation,
-                                                  InputCFile)) {
-      return llvm::createStringError(llvm::inconvertibleErrorCode(),
-                                     "Unable to run clang");
-    }
+    // Parse the C code, reusing the model header from the previous run if it
+    // did not change
+    auto &Session = ImportFromCSession::get();
+    if (llvm::Error SessionError = Session.run(std::move(Header),
+                                                CCode,
+                                                *Action))
+      return SessionError;
 
     // Check if an error was reported by clang or revng during parsing of C
     // code.
@@ -261,15 +174,15 @@ struct ImportFromCAnalysis {
                                      (*Error).ErrorMessage);
     }
 
+    // Only what has been touched by the edit can have been broken by it
     model::VerifyHelper VH(false);
-    if (not OutModel->verify(VH)) {
+    if (not Edit.verify(VH)) {
       return llvm::createStringError(llvm::inconvertibleErrorCode(),
                                      "New model does not verify: "
                                        + VH.getReason());
     }
 
-    // Replace the original Model with the OutModel that contains the changes.
-    Model = OutModel;
+    Edit.commit();
 
     return llvm::Error::success();
   }
@@ -0,0 +1,233 @@
+//
+// This file is distributed under the MIT License. See LICENSE.mit for details.
+//
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/Driver/Driver.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/CompilerInvocation.h"
+#include "clang/Frontend/Utils.h"
+#include "clang/Lex/PreprocessorOptions.h"
+
+#include "revng/Support/Debug.h"
+#include "revng/Support/PathList.h"
+
+#include "ImportFromCSession.h"
+
+using namespace llvm;
+using namespace clang;
+
+static Logger<> Log("import-from-c-session");
+
+static constexpr const char *InputCFile = "revng-input.c";
+
+/// Where the model header lives in the in-memory file system
+static constexpr const char *HeaderPath = "/revng-c/filtered-model-header.h";
+
+static std::vector<std::string>
+getOptionsFromCFGFile(llvm::StringRef FilePath) {
+  std::vector<std::string> Result;
+
+  auto MaybeBuffer = llvm::MemoryBuffer::getFile(FilePath);
+  revng_assert(MaybeBuffer);
+
+  llvm::SmallVector<llvm::StringRef, 0> Lines;
+  MaybeBuffer->get()->getBuffer().split(Lines, '\n');
+  for (llvm::StringRef &Line : Lines) {
+    if (Line.size() > 0 and Line[0] == '-')
+      Result.push_back(Line.str());
+  }
+
+  return Result;
+}
+
+static std::optional<std::string> findHeaderFile(const std::string &File) {
+  auto MaybeHeaderPath = revng::ResourceFinder.findFile(File);
+  if (not MaybeHeaderPath)
+    return std::nullopt;
+  auto Index = (*MaybeHeaderPath).rfind('/');
+  if (Index == std::string::npos)
+    return std::nullopt;
+
+  return (*MaybeHeaderPath).substr(0, Index);
+}
+
+ImportFromCSession::ImportFromCSession() :
+  PCHOperations(std::make_shared<PCHContainerOperations>()) {
+}
+
+ImportFromCSession &ImportFromCSession::get() {
+  static ImportFromCSession Session;
+  return Session;
+}
+
+llvm::Error ImportFromCSession::initializeArguments() {
+  if (Arguments)
+    return llvm::Error::success();
+
+  // Find compile flags to be applied to clang.
+  StringRef CompileFlagsPath = "share/revng-c/compile-flags.cfg";
+  auto MaybeCompileCFGPath = revng::ResourceFinder.findFile(CompileFlagsPath);
+  if (not MaybeCompileCFGPath) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Couldn't find compile-flags.cfg");
+  }
+
+  std::vector<std::string> Result = { "clang-tool" };
+
+  // Since the `--config` is just a clang Driver option, we need to parse it
+  // manually.
+  llvm::append_range(Result, getOptionsFromCFGFile(*MaybeCompileCFGPath));
+  Result.push_back("-xc");
+
+  SmallString<16> CompilerHeadersPath;
+  {
+    StringRef LLVMLibrary = getLibrariesFullPath().at("libLLVMSupport");
+    using namespace llvm::sys::path;
+    SmallString<16> ClangPath;
+    append(ClangPath, parent_path(parent_path(LLVMLibrary)));
+    append(ClangPath, Twine("bin"));
+    append(ClangPath, Twine("clang"));
+    CompilerHeadersPath = clang::driver::Driver::GetResourcesPath(ClangPath);
+    append(CompilerHeadersPath, Twine("include"));
+  }
+  Result.push_back("-I" + CompilerHeadersPath.str().str());
+
+  // Find revng-primitive-types.h and revng-attributes.h.
+  const char *PrimitivesHeader = "share/revng-c/include/"
+                                 "revng-primitive-types.h";
+  auto MaybePrimitiveHeaderPath = findHeaderFile(PrimitivesHeader);
+  if (not MaybePrimitiveHeaderPath) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Couldn't find revng-primitive-types.h");
+  }
+  Result.push_back("-I" + *MaybePrimitiveHeaderPath);
+
+  Result.push_back("-fsyntax-only");
+  Result.push_back(InputCFile);
+
+  Arguments = std::move(Result);
+  return llvm::Error::success();
+}
+
+void ImportFromCSession::setHeader(std::string NewHeader) {
+  if (FileSystem and Header == NewHeader)
+    return;
+
+  revng_log(Log, "The model header changed, dropping the preamble");
+  Header = std::move(NewHeader);
+  Preamble.reset();
+  HeaderHasErrors = false;
+
+  auto InMemory = makeIntrusiveRefCnt<vfs::InMemoryFileSystem>();
+  InMemory->addFile(HeaderPath, 0, MemoryBuffer::getMemBufferCopy(*Header));
+  auto RealFileSystem = vfs::getRealFileSystem();
+  auto Overlay = makeIntrusiveRefCnt<vfs::OverlayFileSystem>(RealFileSystem);
+  Overlay->pushOverlay(std::move(InMemory));
+  FileSystem = std::move(Overlay);
+}
+
+llvm::Error ImportFromCSession::run(std::string NewHeader,
+                                    llvm::StringRef Code,
+                                    clang::FrontendAction &Action) {
+  std::lock_guard<std::mutex> Lock(Mutex);
+
+  if (llvm::Error ArgumentsError = initializeArguments())
+    return ArgumentsError;
+
+  setHeader(std::move(NewHeader));
+
+  // The include of the header is the only thing in the preamble of the file
+  std::string Source = std::string("#include \"") + HeaderPath + "\"\n";
+  Source += Code;
+  auto MainBuffer = MemoryBuffer::getMemBufferCopy(Source, InputCFile);
+
+  IntrusiveRefCntPtr<DiagnosticsEngine>
+    Diagnostics = CompilerInstance::createDiagnostics(new DiagnosticOptions);
+
+  std::vector<const char *> ArgumentsPointers;
+  for (const std::string &Argument : *Arguments)
+    ArgumentsPointers.push_back(Argument.c_str());
+
+  CreateInvocationOptions InvocationOptions;
+  InvocationOptions.Diags = Diagnostics;
+  InvocationOptions.VFS = FileSystem;
+  std::shared_ptr<CompilerInvocation>
+    Invocation = createInvocation(ArgumentsPointers, InvocationOptions);
+  if (not Invocation) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Unable to create the clang invocation");
+  }
+
+  auto Bounds = ComputePreambleBounds(Invocation->getLangOpts(),
+                                      MainBuffer->getMemBufferRef(),
+                                      0);
+
+  // The header is the same, but the headers it includes might have changed
+  if (Preamble
+      and not Preamble->CanReuse(*Invocation,
+                                 MainBuffer->getMemBufferRef(),
+                                 Bounds,
+                                 *FileSystem)) {
+    revng_log(Log, "The preamble is out of date");
+    Preamble.reset();
+  }
+
+  if (not Preamble and not HeaderHasErrors) {
+    revng_log(Log, "Building the preamble");
+
+    // Diagnostics in the header are not reported here, but by the action,
+    // which is run on the whole file if the header has errors
+    auto *Options = new DiagnosticOptions;
+    auto *Ignore = new IgnoringDiagConsumer;
+    auto PreambleDiagnostics = CompilerInstance::createDiagnostics(Options,
+                                                                   Ignore);
+
+    PreambleCallbacks Callbacks;
+    auto MaybePreamble = PrecompiledPreamble::Build(*Invocation,
+                                                    MainBuffer.get(),
+                                                    Bounds,
+                                                    *PreambleDiagnostics,
+                                                    FileSystem,
+                                                    PCHOperations,
+                                                    /* StoreInMemory */ true,
+                                                    Callbacks);
+
+    // Without a preamble we can still parse everything from scratch
+    if (PreambleDiagnostics->hasErrorOccurred()) {
+      revng_log(Log, "The model header has errors, not using a preamble");
+      HeaderHasErrors = true;
+    } else if (MaybePreamble) {
+      Preamble.emplace(std::move(*MaybePreamble));
+    } else {
+      revng_log(Log,
+                "Couldn't build the preamble: "
+                  << MaybePreamble.getError().message());
+    }
+  }
+
+  // Remapped buffers are owned by the preprocessor options
+  IntrusiveRefCntPtr<vfs::FileSystem> VFS = FileSystem;
+  if (Preamble) {
+    Preamble->AddImplicitPreamble(*Invocation, VFS, MainBuffer.release());
+  } else {
+    auto &PreprocessorOptions = Invocation->getPreprocessorOpts();
+    PreprocessorOptions.addRemappedFile(InputCFile, MainBuffer.release());
+  }
+
+  CompilerInstance Compiler(PCHOperations);
+  Compiler.setInvocation(std::move(Invocation));
+  Compiler.createDiagnostics();
+  Compiler.createFileManager(std::move(VFS));
+  Compiler.createSourceManager(Compiler.getFileManager());
+  if (not Compiler.ExecuteAction(Action)) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Unable to run clang");
+  }
+
+  return llvm::Error::success();
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.mit for details.
+//
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/VirtualFileSystem.h"
+
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Frontend/PrecompiledPreamble.h"
+#include "clang/Serialization/PCHContainerOperations.h"
+
+/// The clang frontend used by import-from-c, preserved across its runs
+///
+/// Importing a snippet of C requires parsing the whole model header before the
+/// snippet, and the header only changes when the model does. The session keeps
+/// the header in an in-memory file system and precompiled as a clang preamble,
+/// so that, as long as the header is the same as in the previous run, it's not
+/// parsed again: only the snippet is.
+class ImportFromCSession {
+private:
+  std::mutex Mutex;
+
+  /// Arguments for the clang driver, computed on first use
+  std::optional<std::vector<std::string>> Arguments;
+
+  /// The header the file system and the preamble have been built for
+  std::optional<std::string> Header;
+  llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> FileSystem;
+  std::optional<clang::PrecompiledPreamble> Preamble;
+
+  /// Whether the header has errors, in which case it's not precompiled and
+  /// it's parsed along with the snippet, to report them
+  bool HeaderHasErrors = false;
+
+  std::shared_ptr<clang::PCHContainerOperations> PCHOperations;
+
+private:
+  ImportFromCSession();
+
+public:
+  static ImportFromCSession &get();
+
+public:
+  /// Parse \p Code, preceded by the model header, and run \p Action on it
+  ///
+  /// Errors in the C code, including the header, are reported by \p Action,
+  /// the returned error only signals failures to set up or run clang.
+  llvm::Error run(std::string NewHeader,
+                  llvm::StringRef Code,
+                  clang::FrontendAction &Action);
+
+private:
+  llvm::Error initializeArguments();
+  void setHeader(std::string NewHeader);
+};
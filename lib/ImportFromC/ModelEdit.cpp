@@ -0,0 +1,155 @@
+//
+// This file is distributed under the MIT License. See LICENSE.mit for details.
+//
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+
+#include "revng/Model/QualifiedType.h"
+#include "revng/Model/Type.h"
+#include "revng/Support/Assert.h"
+
+#include "ModelEdit.h"
+
+model::TypePath ModelEdit::addType(UpcastablePointer<model::Type> &&NewType) {
+  model::TypePath Result = Model->recordNewType(std::move(NewType));
+  TouchedTypes.insert(Result.get()->key());
+  return Result;
+}
+
+model::TypePath
+ModelEdit::replaceType(const model::Type::Key &OldKey,
+                       UpcastablePointer<model::Type> &&NewType) {
+  model::Type::Key NewKey = NewType->key();
+  revng_assert(std::get<0>(NewKey) == std::get<0>(OldKey));
+
+  auto &Types = Model->Types();
+  auto It = Types.find(OldKey);
+  revng_assert(It != Types.end());
+
+  // Save the original type, unless it was already introduced by this edit.
+  // Moving it out keeps alive the pointers to it held by the caller.
+  if (TouchedTypes.insert(OldKey).second)
+    ReplacedTypes.push_back(std::move(*It));
+
+  Types.erase(It);
+
+  // The original type, if any, is restored on rollback, while the new one
+  // goes away with the other touched types
+  if (NewKey != OldKey) {
+    TouchedTypes.erase(OldKey);
+    TouchedTypes.insert(NewKey);
+    ChangedTypeKinds = true;
+  }
+
+  Types.insert(std::move(NewType));
+
+  return Model->getTypePath(NewKey);
+}
+
+model::Function &ModelEdit::editFunction(const MetaAddress &Entry) {
+  model::Function &Function = Model->Functions().at(Entry);
+  ChangedFunctions.try_emplace(Entry, Function);
+  return Function;
+}
+
+/// Collect the names \p T introduces in the global namespace
+static llvm::SmallVector<llvm::StringRef>
+getGlobalNames(const model::Type &T) {
+  llvm::SmallVector<llvm::StringRef> Result = { T.CustomName() };
+  if (const auto *Enum = llvm::dyn_cast<model::EnumType>(&T))
+    for (const model::EnumEntry &Entry : Enum->Entries())
+      Result.push_back(Entry.CustomName());
+  return Result;
+}
+
+bool ModelEdit::changesGlobalNames() const {
+  std::map<model::Type::Key, const model::Type *> OldTypes;
+  for (const UpcastablePointer<model::Type> &T : ReplacedTypes)
+    OldTypes[T->key()] = T.get();
+
+  for (const model::Type::Key &Key : TouchedTypes) {
+    auto NewNames = getGlobalNames(*Model->Types().at(Key));
+    auto It = OldTypes.find(Key);
+    if (It == OldTypes.end()) {
+      auto IsNotEmpty = [](llvm::StringRef Name) { return not Name.empty(); };
+      if (llvm::any_of(NewNames, IsNotEmpty))
+        return true;
+    } else if (NewNames != getGlobalNames(*It->second)) {
+      return true;
+    }
+  }
+
+  for (const auto &[Entry, OldFunction] : ChangedFunctions)
+    if (Model->Functions().at(Entry).CustomName() != OldFunction.CustomName())
+      return true;
+
+  return false;
+}
+
+bool ModelEdit::verify(model::VerifyHelper &VH) const {
+  if (ChangedTypeKinds or changesGlobalNames())
+    return Model->verify(VH);
+
+  // Collect the types that embed, directly or through typedefs, a replaced
+  // type: their definition might no longer be valid. Pointers only require
+  // the pointee to exist, which is the case since keys are preserved.
+  std::set<const model::Type *> ToVerify;
+  if (not ReplacedTypes.empty()) {
+    llvm::DenseMap<const model::Type *, llvm::SmallVector<const model::Type *>>
+      Users;
+    for (const UpcastablePointer<model::Type> &T : Model->Types())
+      for (const model::QualifiedType &QT : T->edges())
+        if (not QT.isPointer())
+          Users[QT.UnqualifiedType().get()].push_back(T.get());
+
+    llvm::SmallVector<const model::Type *> Worklist;
+    for (const model::Type::Key &Key : TouchedTypes)
+      Worklist.push_back(Model->Types().at(Key).get());
+
+    while (not Worklist.empty()) {
+      const model::Type *T = Worklist.pop_back_val();
+      if (not ToVerify.insert(T).second)
+        continue;
+
+      auto It = Users.find(T);
+      if (It != Users.end())
+        llvm::append_range(Worklist, It->second);
+    }
+  } else {
+    for (const model::Type::Key &Key : TouchedTypes)
+      ToVerify.insert(Model->Types().at(Key).get());
+  }
+
+  for (const model::Type *T : ToVerify)
+    if (not T->verify(VH))
+      return false;
+
+  for (const auto &[Entry, OldFunction] : ChangedFunctions)
+    if (not Model->Functions().at(Entry).verify(VH))
+      return false;
+
+  return true;
+}
+
+void ModelEdit::rollback() {
+  auto &Types = Model->Types();
+  for (const model::Type::Key &Key : TouchedTypes) {
+    auto It = Types.find(Key);
+    if (It != Types.end())
+      Types.erase(It);
+  }
+
+  for (UpcastablePointer<model::Type> &OldType : ReplacedTypes)
+    Types.insert(std::move(OldType));
+
+  for (auto &[Entry, OldFunction] : ChangedFunctions)
+    Model->Functions().at(Entry) = std::move(OldFunction);
+
+  TouchedTypes.clear();
+  ReplacedTypes.clear();
+  ChangedFunctions.clear();
+  ChangedTypeKinds = false;
+}
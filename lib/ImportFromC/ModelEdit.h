@@ -0,0 +1,90 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.mit for details.
+//
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "revng/Model/Binary.h"
+#include "revng/Model/VerifyHelper.h"
+#include "revng/TupleTree/TupleTree.h"
+
+/// Changes made to the model while importing C code
+///
+/// Declarations are imported directly into the model, instead of into a copy
+/// of it. The edit keeps track of what it touched, so that only that needs to
+/// be verified, and of what it overwrote, so that everything can be undone if
+/// the import fails. An edit that has not been committed is undone when
+/// destroyed.
+class ModelEdit {
+private:
+  TupleTree<model::Binary> &Model;
+
+  /// Keys of the types that have been added or replaced
+  std::set<model::Type::Key> TouchedTypes;
+
+  /// Types that have been replaced, as they were before the edit
+  std::vector<UpcastablePointer<model::Type>> ReplacedTypes;
+
+  /// Functions that have been changed, as they were before the edit
+  std::map<MetaAddress, model::Function> ChangedFunctions;
+
+  /// Whether a type has been replaced by one of a different kind, leaving
+  /// dangling the references to its original key
+  bool ChangedTypeKinds = false;
+
+  bool Committed = false;
+
+public:
+  explicit ModelEdit(TupleTree<model::Binary> &Model) : Model(Model) {}
+  ~ModelEdit() {
+    if (not Committed)
+      rollback();
+  }
+
+  ModelEdit(const ModelEdit &) = delete;
+  ModelEdit &operator=(const ModelEdit &) = delete;
+
+public:
+  TupleTree<model::Binary> &getModel() { return Model; }
+
+  /// Add a type with a new ID to the model
+  model::TypePath addType(UpcastablePointer<model::Type> &&NewType);
+
+  /// Replace the type with key \p OldKey with \p NewType
+  ///
+  /// \p NewType must have the same ID, but can be of a different kind.
+  model::TypePath replaceType(const model::Type::Key &OldKey,
+                              UpcastablePointer<model::Type> &&NewType);
+
+  /// Record that \p Key, missing before the edit, has been added to the model
+  /// on the side, e.g., by model::Binary::getPrimitiveType
+  void recordAddedType(const model::Type::Key &Key) {
+    TouchedTypes.insert(Key);
+  }
+
+  /// Get a function to change, remembering how it was
+  model::Function &editFunction(const MetaAddress &Entry);
+
+public:
+  /// Verify the touched types, the types whose definition depends on them and
+  /// the changed functions
+  ///
+  /// If the kind of a type changed, the whole model is verified, since
+  /// anything could refer to the type by its original key. The same goes for
+  /// custom names added or changed in the global namespace, since they must
+  /// not collide with any other name in the model.
+  bool verify(model::VerifyHelper &VH) const;
+
+  /// Make the changes permanent
+  void commit() { Committed = true; }
+
+private:
+  /// Whether the edit added or changed a name in the global namespace
+  bool changesGlobalNames() const;
+
+  void rollback();
+};
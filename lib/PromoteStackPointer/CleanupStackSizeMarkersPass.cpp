@@ -3,12 +3,11 @@
 //
 
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
 
 #include "revng/Support/IRHelpers.h"
 
 #include "revng-c/PromoteStackPointer/CleanupStackSizeMarkersPass.h"
-#include "revng-c/PromoteStackPointer/InstrumentStackAccessesPass.h"
-#include "revng-c/Support/FunctionTags.h"
 
 using namespace llvm;
 
@@ -16,16 +15,6 @@ bool CleanupStackSizeMarkersPass::runOnModule(Module &M) {
   SmallVector<CallInst *, 16> CallsToDelete;
   SmallVector<Function *, 16> FunctionsToDelete;
 
-  for (Function &F : FunctionTags::StackOffsetMarker.functions(&M)) {
-    for (User *U : F.users()) {
-      auto *Call = cast<CallInst>(U);
-      Call->replaceAllUsesWith(Call->getArgOperand(0));
-      CallsToDelete.push_back(Call);
-    }
-
-    FunctionsToDelete.push_back(&F);
-  }
-
   if (auto *SSACS = M.getFunction("stack_size_at_call_site")) {
     for (User *U : SSACS->users()) {
       auto *Call = cast<CallInst>(U);
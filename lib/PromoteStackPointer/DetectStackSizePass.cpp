@@ -3,8 +3,13 @@
 //
 
 #include <optional>
+#include <utility>
+#include <vector>
 
 #include "llvm/IR/Constants.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 
 #include "revng/ABI/FunctionType/Layout.h"
 #include "revng/EarlyFunctionAnalysis/FunctionMetadataCache.h"
@@ -21,16 +26,23 @@
 
 #include "revng-c/Pipes/Kinds.h"
 #include "revng-c/PromoteStackPointer/DetectStackSizePass.h"
-#include "revng-c/PromoteStackPointer/InstrumentStackAccessesPass.h"
 #include "revng-c/Support/FunctionTags.h"
 
 #include "Helpers.h"
+#include "StackAccessesBounds.h"
 
 using namespace llvm;
 using model::RawFunctionType;
 
 static Logger<> Log("detect-stack-size");
 
+static cl::opt<unsigned> Threads("detect-stack-size-threads",
+                                 cl::desc("Number of threads used to scan "
+                                          "functions for stack accesses. 0 "
+                                          "means one per hardware thread."),
+                                 cl::Hidden,
+                                 cl::init(0));
+
 static bool isValidStackSize(uint64_t Size) {
   return 0 < Size and Size < 10 * 1024 * 1024;
 }
@@ -69,11 +81,12 @@ using UpperBoundCollector = BoundCollector<true>;
 using LowerBoundCollector = BoundCollector<false>;
 
 template<bool IsUpper>
-static void setBound(BoundCollector<IsUpper> &BoundCollector, Value *V) {
-  if (isa<UndefValue>(V))
+static void setBound(BoundCollector<IsUpper> &BoundCollector,
+                     const std::optional<APInt> &MaybeBound) {
+  if (not MaybeBound)
     return;
 
-  const APInt &Bound = cast<ConstantInt>(V)->getValue();
+  const APInt &Bound = *MaybeBound;
   if (Bound.isMaxSignedValue() or Bound.isMinSignedValue())
     return;
 
@@ -85,6 +98,51 @@ struct CallSite {
   model::Type::Key CallType{};
 };
 
+/// What the IR of a function tells about its stack, before looking at the
+/// model
+struct FunctionStackAccesses {
+  UpperBoundCollector UpperBound;
+  LowerBoundCollector LowerBound;
+  /// Calls to stack_size_at_call_site, along with the stack size, if known
+  std::vector<std::pair<CallInst *, std::optional<uint64_t>>> CallSites;
+};
+
+/// Collect the extremes of the stack accesses and the call sites of \a F
+///
+/// \note This only reads the IR, so it can run on several functions at once.
+static FunctionStackAccesses collectStackAccesses(Function &F) {
+  FunctionStackAccesses Result;
+
+  StackAccessBounds Bounds = getOverallBounds(computeStackAccessesBounds(F));
+  setBound(Result.LowerBound, Bounds.LowerBound);
+  setBound(Result.UpperBound, Bounds.UpperBound);
+
+  for (llvm::BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      auto *Call = dyn_cast<CallInst>(&I);
+      if (Call == nullptr)
+        continue;
+
+      auto *CalledValue = skipCasts(Call->getCalledOperand());
+      auto *CalledFunction = dyn_cast<llvm::Function>(CalledValue);
+      if (CalledFunction == nullptr)
+        continue;
+
+      if (CalledFunction->getName() == "stack_size_at_call_site") {
+        // Try to get the stack offset
+        std::optional<uint64_t> StackSize;
+        Value *StackOffsetArgument = Call->getArgOperand(0);
+        if (auto *Offset = dyn_cast<ConstantInt>(StackOffsetArgument))
+          StackSize = Offset->getLimitedValue();
+
+        Result.CallSites.emplace_back(Call, StackSize);
+      }
+    }
+  }
+
+  return Result;
+}
+
 class FunctionStackInfo {
 public:
   model::Function &Function;
@@ -102,6 +160,8 @@ private:
   TupleTree<model::Binary> &Binary;
   std::vector<FunctionStackInfo> FunctionsStackInfo;
   std::map<RawFunctionType *, UpperBoundCollector> FunctionTypeStackArguments;
+  /// Size of the stack arguments of each prototype used at a call site
+  std::map<model::Type::Key, uint64_t> StackArgumentsSizes;
   const size_t CallInstructionPushSize = 0;
   /// Helper for fast model::Type size computation
   model::VerifyHelper VH;
@@ -112,10 +172,40 @@ public:
     CallInstructionPushSize(Architecture::getCallPushSize(B->Architecture())) {}
 
 public:
+  /// Elect the missing stack frame and stack arguments sizes
+  //
+  // The sizes are not computed bottom-up over the SCCs of the call graph: the
+  // stack arguments size is elected per prototype, from all the functions
+  // using it, wherever they are in the call graph, and the stack frame size of
+  // a function needs the stack arguments size of the prototypes of all its
+  // call sites. So all the functions are scanned first, then the prototypes
+  // are elected, and only then the stack frames.
+  //
+  // The results are cached in the model: functions and prototypes whose sizes
+  // are already known are skipped, so a rerun only scans the functions whose
+  // sizes are still missing.
   void run(FunctionMetadataCache &Cache, Module &M) {
-    // Collect information about the stack of each function
+    // Find the functions whose stack frame or stack arguments are unknown
+    std::vector<Function *> Functions;
     for (llvm::Function &F : FunctionTags::Isolated.functions(&M))
-      collectStackBounds(Cache, F);
+      if (needsStackBounds(F))
+        Functions.push_back(&F);
+
+    // Scanning the IR is independent for each function, do it in parallel
+    std::vector<FunctionStackAccesses> Accesses(Functions.size());
+    {
+      ThreadPool Pool(hardware_concurrency(Threads));
+      for (size_t I = 0; I < Functions.size(); ++I) {
+        Pool.async([&Functions, &Accesses, I] {
+          Accesses[I] = collectStackAccesses(*Functions[I]);
+        });
+      }
+      Pool.wait();
+    }
+
+    // Collect information about the stack of each function
+    for (size_t I = 0; I < Functions.size(); ++I)
+      collectStackBounds(Cache, *Functions[I], Accesses[I]);
 
     // At this point we have populated two data structures:
     //
@@ -133,33 +223,54 @@ public:
   }
 
 private:
-  void collectStackBounds(FunctionMetadataCache &Cache, Function &F);
+  model::Function &getModelFunction(Function &F) const {
+    MetaAddress Entry = getMetaAddressMetadata(&F, "revng.function.entry");
+    return Binary->Functions().at(Entry);
+  }
+
+  bool needsStackBounds(Function &F) const;
+  void collectStackBounds(FunctionMetadataCache &Cache,
+                          Function &F,
+                          const FunctionStackAccesses &FSA);
   void electStackArgumentsSize(RawFunctionType *Prototype,
                                const UpperBoundCollector &Bound) const;
   void electFunctionStackFrameSize(FunctionStackInfo &FSI);
   std::optional<uint64_t> handleCallSite(const CallSite &CallSite);
+  uint64_t getStackArgumentsSize(const model::Type::Key &Prototype);
 };
 
+static RawFunctionType *getRawPrototype(model::Function &ModelFunction,
+                                        model::Binary &Binary) {
+  // We only upgrade the stack size of RawFunctionType
+  return dyn_cast<RawFunctionType>(ModelFunction.prototype(Binary).get());
+}
+
+bool DetectStackSize::needsStackBounds(Function &F) const {
+  model::Function &ModelFunction = getModelFunction(F);
+
+  // Check if this function already has information about stack
+  // frame/arguments
+  if (ModelFunction.StackFrameType().empty())
+    return true;
+
+  auto *RawPrototype = getRawPrototype(ModelFunction, *Binary);
+  return RawPrototype != nullptr and RawPrototype->StackArgumentsType().empty();
+}
+
 void DetectStackSize::collectStackBounds(FunctionMetadataCache &Cache,
-                                         Function &F) {
+                                         Function &F,
+                                         const FunctionStackAccesses &FSA) {
 
   // Obtain model::Function corresponding to this llvm::Function
-  MetaAddress Entry = getMetaAddressMetadata(&F, "revng.function.entry");
-  model::Function &ModelFunction = Binary->Functions().at(Entry);
+  model::Function &ModelFunction = getModelFunction(F);
   revng_log(Log, "Collecting stack bounds for " << ModelFunction.name().str());
   LoggerIndent<> Indent(Log);
 
-  // Check if this function already has information about stack
-  // frame/arguments
   bool NeedsStackFrame = ModelFunction.StackFrameType().empty();
   bool NeedsStackArguments = false;
-  model::Type *Prototype = ModelFunction.prototype(*Binary).get();
-
-  // We only upgrade the stack size of RawFunctionType
-  RawFunctionType *RawPrototype = nullptr;
-  if ((RawPrototype = dyn_cast<RawFunctionType>(Prototype))) {
+  RawFunctionType *RawPrototype = getRawPrototype(ModelFunction, *Binary);
+  if (RawPrototype != nullptr)
     NeedsStackArguments = RawPrototype->StackArgumentsType().empty();
-  }
 
   revng_log(Log, "NeedsStackFrame: " << NeedsStackFrame);
   revng_log(Log, "NeedsStackArguments: " << NeedsStackArguments);
@@ -169,41 +280,22 @@ void DetectStackSize::collectStackBounds(FunctionMetadataCache &Cache,
 
   FunctionStackInfo FSI(ModelFunction);
 
-  // Go over all stack accesses and record the extremes
-  UpperBoundCollector UpperBound;
-  LowerBoundCollector LowerBound;
-  for (llvm::BasicBlock &BB : F) {
-    for (Instruction &I : BB) {
-      if (auto *Call = dyn_cast<CallInst>(&I)) {
-        auto *CalledValue = skipCasts(Call->getCalledOperand());
-        if (auto *CalledFunction = dyn_cast<llvm::Function>(CalledValue)) {
-          if (FunctionTags::StackOffsetMarker.isTagOf(CalledFunction)) {
-            revng_log(Log, "Considering stack offset marker " << getName(Call));
-            // This is a call to a stack_offset function, let's record the
-            // offset
-            setBound(LowerBound, Call->getArgOperand(1));
-            setBound(UpperBound, Call->getArgOperand(2));
-          } else if (CalledFunction->getName() == "stack_size_at_call_site") {
-            revng_log(Log, "Considering call site " << getName(Call));
-            auto &NewCallSite = FSI.CallSites.emplace_back();
-
-            // Try to get the stack offset
-            Value *StackOffsetArgument = Call->getArgOperand(0);
-            if (auto *Offset = dyn_cast<ConstantInt>(StackOffsetArgument))
-              NewCallSite.StackSize = Offset->getLimitedValue();
-
-            // Get the prototype
-            auto Proto = Cache.getCallSitePrototype(*Binary.get(),
-                                                    findAssociatedCall(Call),
-                                                    &ModelFunction);
-            NewCallSite.CallType = Proto.get()->key();
-          }
-        }
-      }
+  const UpperBoundCollector &UpperBound = FSA.UpperBound;
+  const LowerBoundCollector &LowerBound = FSA.LowerBound;
+  if (NeedsStackFrame) {
+    // Call sites are only needed to elect the stack frame size
+    for (const auto &[Call, StackSize] : FSA.CallSites) {
+      revng_log(Log, "Considering call site " << getName(Call));
+      auto &NewCallSite = FSI.CallSites.emplace_back();
+      NewCallSite.StackSize = StackSize;
+
+      // Get the prototype
+      auto Proto = Cache.getCallSitePrototype(*Binary.get(),
+                                              findAssociatedCall(Call),
+                                              &ModelFunction);
+      NewCallSite.CallType = Proto.get()->key();
     }
-  }
 
-  if (NeedsStackFrame) {
     if (LowerBound.hasValue()) {
       int64_t Size = -LowerBound.value().getLimitedValue();
       if (Size > 0)
@@ -291,16 +383,7 @@ DetectStackSize::handleCallSite(const CallSite &CallSite) {
   if (not CallSite.StackSize)
     return std::nullopt;
 
-  using namespace abi::FunctionType;
-  uint64_t StackArgumentSize = 0;
-  for (Layout::Argument &Argument :
-       Layout::make(*Binary->Types().at(CallSite.CallType).get()).Arguments) {
-    if (Argument.Stack.has_value()) {
-      StackArgumentSize = std::max(StackArgumentSize,
-                                   Argument.Stack->Offset
-                                     + Argument.Stack->Size);
-    }
-  }
+  uint64_t StackArgumentSize = getStackArgumentsSize(CallSite.CallType);
   revng_log(Log, "StackArgumentSize: " << StackArgumentSize);
 
   int64_t Result = (*CallSite.StackSize - StackArgumentSize
@@ -314,6 +397,30 @@ DetectStackSize::handleCallSite(const CallSite &CallSite) {
     return std::nullopt;
 }
 
+uint64_t
+DetectStackSize::getStackArgumentsSize(const model::Type::Key &Prototype) {
+  // Prototypes are shared by many call sites, compute the layout only once.
+  // All the stack arguments have been elected at this point, so the result
+  // can't change anymore.
+  auto It = StackArgumentsSizes.find(Prototype);
+  if (It != StackArgumentsSizes.end())
+    return It->second;
+
+  using namespace abi::FunctionType;
+  uint64_t StackArgumentSize = 0;
+  for (Layout::Argument &Argument :
+       Layout::make(*Binary->Types().at(Prototype).get()).Arguments) {
+    if (Argument.Stack.has_value()) {
+      StackArgumentSize = std::max(StackArgumentSize,
+                                   Argument.Stack->Offset
+                                     + Argument.Stack->Size);
+    }
+  }
+
+  StackArgumentsSizes[Prototype] = StackArgumentSize;
+  return StackArgumentSize;
+}
+
 bool DetectStackSizePass::runOnModule(Module &M) {
   //
   // Overview:
@@ -0,0 +1,77 @@
+//
+// This file is distributed under the MIT License. See LICENSE.mit for details.
+//
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/IRHelpers.h"
+
+#include "StackAccessesBounds.h"
+
+using namespace llvm;
+
+/// Print the result of computeStackAccessesBounds, for testing purposes
+struct PrintStackAccessesBoundsPass : public FunctionPass {
+public:
+  static char ID;
+
+  PrintStackAccessesBoundsPass() : FunctionPass(ID) {}
+
+  bool runOnFunction(Function &F) override;
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+};
+
+static void printBound(raw_ostream &Out, const std::optional<APInt> &Bound) {
+  if (Bound)
+    Out << Bound->getSExtValue();
+  else
+    Out << "unknown";
+}
+
+bool PrintStackAccessesBoundsPass::runOnFunction(Function &F) {
+  StackAccessesBounds Bounds = computeStackAccessesBounds(F);
+
+  // Print in program order, the side table is not ordered
+  raw_ostream &Out = outs();
+  for (const BasicBlock &BB : F) {
+    for (const Instruction &I : BB) {
+      auto It = Bounds.find(&I);
+      if (It == Bounds.end())
+        continue;
+
+      Out << F.getName() << ": access through ";
+      getPointer(&I)->printAsOperand(Out, false);
+      Out << " in [";
+      printBound(Out, It->second.LowerBound);
+      Out << ", ";
+      printBound(Out, It->second.UpperBound);
+      Out << ")\n";
+    }
+  }
+
+  // What DetectStackSize uses to elect the stack frame and arguments sizes
+  if (not Bounds.empty()) {
+    StackAccessBounds Overall = getOverallBounds(Bounds);
+    Out << F.getName() << ": all accesses in [";
+    printBound(Out, Overall.LowerBound);
+    Out << ", ";
+    printBound(Out, Overall.UpperBound);
+    Out << ")\n";
+  }
+
+  return false;
+}
+
+char PrintStackAccessesBoundsPass::ID = 0;
+
+using RegisterPSAB = RegisterPass<PrintStackAccessesBoundsPass>;
+static RegisterPSAB R("print-stack-accesses-bounds",
+                      "Print the bounds of the stack accesses",
+                      true,
+                      true);
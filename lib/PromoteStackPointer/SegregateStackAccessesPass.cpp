@@ -24,13 +24,13 @@
 #include "revng/Support/OverflowSafeInt.h"
 
 #include "revng-c/Pipes/Kinds.h"
-#include "revng-c/PromoteStackPointer/InstrumentStackAccessesPass.h"
 #include "revng-c/PromoteStackPointer/SegregateStackAccessesPass.h"
 #include "revng-c/Support/FunctionTags.h"
 #include "revng-c/Support/IRHelpers.h"
 #include "revng-c/Support/ModelHelpers.h"
 
 #include "Helpers.h"
+#include "StackAccessesBounds.h"
 
 using namespace llvm;
 
@@ -72,35 +72,21 @@ static CallInst *findCallTo(Function *F, Function *ToSearch) {
   return nullptr;
 }
 
-static std::optional<int64_t> getStackOffset(Instruction *I) {
-  auto *Pointer = getPointer(I);
-
-  auto *PointerInstruction = dyn_cast<Instruction>(skipCasts(Pointer));
-  if (PointerInstruction == nullptr)
+static std::optional<int64_t>
+getStackOffset(const StackAccessesBounds &Bounds, Instruction *I) {
+  auto It = Bounds.find(I);
+  if (It == Bounds.end())
     return {};
 
-  if (auto *Call = dyn_cast<CallInst>(PointerInstruction)) {
-    if (auto *Callee = getCallee(Call)) {
-      if (FunctionTags::StackOffsetMarker.isTagOf(Callee)) {
-        // Check if this is a stack access, i.e., targets an exact range
-        unsigned AccessSize = getMemoryAccessSize(I);
-        auto MaybeStart = getSignedConstantArg(Call, 1);
-        auto MaybeEnd = getSignedConstantArg(Call, 2);
-
-        revng_log(Log, "AccessSize: " << AccessSize);
-        revng_log(Log, "MaybeStart: " << (MaybeStart ? *MaybeStart : -1));
-        revng_log(Log, "MaybeEnd: " << (MaybeEnd ? *MaybeEnd : -1));
-
-        if (MaybeStart and MaybeEnd
-            and *MaybeEnd == *MaybeStart + AccessSize + 1) {
-          revng_log(Log, "StackOffset found: " << *MaybeStart);
-          return MaybeStart;
-        }
-      }
-    }
-  }
+  // Check if this is a stack access, i.e., targets an exact range
+  unsigned AccessSize = getMemoryAccessSize(I);
+  revng_log(Log, "AccessSize: " << AccessSize);
+
+  auto MaybeStackOffset = It->second.getExactOffset(AccessSize);
+  if (MaybeStackOffset)
+    revng_log(Log, "StackOffset found: " << *MaybeStackOffset);
 
-  return {};
+  return MaybeStackOffset;
 }
 
 struct StoredByte {
@@ -200,8 +186,10 @@ struct SegregateStackAccessesMFI : public SetUnionLattice<Lattice> {
   using Label = llvm::BasicBlock *;
   using GraphType = llvm::Function *;
 
-  static LatticeElement applyTransferFunction(llvm::BasicBlock *BB,
-                                              const LatticeElement &Value) {
+  const StackAccessesBounds *Bounds = nullptr;
+
+  LatticeElement applyTransferFunction(llvm::BasicBlock *BB,
+                                       const LatticeElement &Value) const {
     using namespace llvm;
     revng_log(Log, "Analyzing block " << getName(BB));
     LoggerIndent<> Indent(Log);
@@ -222,7 +210,7 @@ struct SegregateStackAccessesMFI : public SetUnionLattice<Lattice> {
       LoggerIndent<> Indent(Log);
 
       // Get stack offset, if available
-      auto MaybeStartStackOffset = getStackOffset(&I);
+      auto MaybeStartStackOffset = getStackOffset(*Bounds, &I);
       if (not MaybeStartStackOffset)
         continue;
 
@@ -833,14 +821,19 @@ private:
         I->getParent()->splitBasicBlock(I);
     }
 
+    // Compute the offsets from SP0 targeted by memory accesses
+    StackAccessesBounds Bounds = computeStackAccessesBounds(F);
+
     // Run the analysis
     MFIResult AnalysisResult;
     {
       revng_log(Log, "Running SegregateStackAccessesMFI");
       LoggerIndent<> Indent(Log);
       using SSAMFI = SegregateStackAccessesMFI;
+      SSAMFI Instance;
+      Instance.Bounds = &Bounds;
       BasicBlock *Entry = &F.getEntryBlock();
-      AnalysisResult = MFP::getMaximalFixedPoint<SSAMFI>({},
+      AnalysisResult = MFP::getMaximalFixedPoint<SSAMFI>(Instance,
                                                          &F,
                                                          {},
                                                          {},
@@ -862,7 +855,7 @@ private:
       for (BasicBlock &BB : F)
         for (Instruction &I : BB)
           if (isa<LoadInst>(&I) or isa<StoreInst>(&I))
-            handleMemoryAccess(*Redirector, &I);
+            handleMemoryAccess(Bounds, *Redirector, &I);
 
     //
     // Fix stack frame
@@ -1345,12 +1338,13 @@ private:
     }
   }
 
-  void handleMemoryAccess(const StackAccessRedirector &Redirector,
+  void handleMemoryAccess(const StackAccessesBounds &Bounds,
+                          const StackAccessRedirector &Redirector,
                           Instruction *I) {
     revng_log(Log, "Handling memory access " << getName(I));
     LoggerIndent<> Indent(Log);
 
-    auto MaybeStackOffset = getStackOffset(I);
+    auto MaybeStackOffset = getStackOffset(Bounds, I);
     if (not MaybeStackOffset)
       return;
     int64_t StackOffset = *MaybeStackOffset;
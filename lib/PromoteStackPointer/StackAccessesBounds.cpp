@@ -0,0 +1,469 @@
+//
+// This file is distributed under the MIT License. See LICENSE.mit for details.
+//
+
+#include <deque>
+#include <optional>
+#include <utility>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/ConstantRange.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
+
+#include "revng/Support/Debug.h"
+#include "revng/Support/IRHelpers.h"
+
+#include "revng-c/Support/IRHelpers.h"
+
+#include "StackAccessesBounds.h"
+
+using namespace llvm;
+
+static Logger<> Log("stack-accesses-bounds");
+
+namespace {
+
+/// The values a variable can assume, either as plain integers or as offsets
+/// from SP0
+struct OffsetRange {
+  ConstantRange Range;
+
+  /// Whether the values in Range are offsets from SP0
+  bool FromSP0 = false;
+
+public:
+  static OffsetRange get(ConstantRange Range, bool FromSP0) {
+    // An empty range means the same thing in both cases
+    bool IsEmpty = Range.isEmptySet();
+    return { std::move(Range), FromSP0 and not IsEmpty };
+  }
+
+  static OffsetRange absolute(ConstantRange Range) {
+    return get(std::move(Range), false);
+  }
+
+  static OffsetRange fromSP0(ConstantRange Range) {
+    return get(std::move(Range), true);
+  }
+
+  static OffsetRange unknown(unsigned BitWidth) {
+    return absolute(ConstantRange::getFull(BitWidth));
+  }
+
+public:
+  bool operator==(const OffsetRange &Other) const = default;
+
+  bool isUnknown() const { return not FromSP0 and Range.isFullSet(); }
+
+  /// The values either this or \p Other can assume
+  OffsetRange unionWith(const OffsetRange &Other) const {
+    if (Range.isEmptySet())
+      return Other;
+    if (Other.Range.isEmptySet())
+      return *this;
+    if (FromSP0 != Other.FromSP0)
+      return unknown(Range.getBitWidth());
+    return get(Range.unionWith(Other.Range), FromSP0);
+  }
+
+  /// The values that satisfy both this and \p Other
+  OffsetRange intersectWith(const OffsetRange &Other) const {
+    if (FromSP0 == Other.FromSP0)
+      return get(Range.intersectWith(Other.Range), FromSP0);
+
+    // Ranges with a different base cannot be compared, keep the known one
+    return isUnknown() ? Other : *this;
+  }
+};
+
+/// Propagation of the ranges of the integer and pointer values of a function,
+/// tracking which ones are offsets from SP0
+///
+/// Each value is first given a range holding everything it can evaluate to
+/// anywhere in the function, through a single sparse propagation over the
+/// def-use chains. Queries in a specific block then refine such range with the
+/// conditions of the branches dominating the block, as LazyValueInfo does, but
+/// without solving anything on demand.
+class OffsetRangePropagation {
+private:
+  /// After this many changes the range of a value is widened to the full set,
+  /// so that values defined in loops converge quickly
+  static constexpr unsigned MaxUpdates = 8;
+
+  /// Maximum depth of the expressions that are re-evaluated under the
+  /// conditions holding in a block
+  static constexpr unsigned MaxContextDepth = 6;
+
+  using RangeGetter = function_ref<OffsetRange(const Value *)>;
+  using BlockRange = std::pair<const BasicBlock *, ConstantRange>;
+
+private:
+  const Function &F;
+  const DataLayout &DL;
+  const Function *InitLocalSP = nullptr;
+  DominatorTree DT;
+  DenseMap<const Value *, OffsetRange> Ranges;
+  DenseMap<const Value *, unsigned> NumUpdates;
+
+  /// For each value, the blocks that can only be reached through a branch
+  /// constraining the value, along with the range it's constrained to
+  DenseMap<const Value *, SmallVector<BlockRange, 2>> Conditions;
+
+public:
+  OffsetRangePropagation(Function &F, const Function *InitLocalSP) :
+    F(F), DL(F.getParent()->getDataLayout()), InitLocalSP(InitLocalSP), DT(F) {
+    propagate();
+    collectConditions();
+  }
+
+public:
+  static bool isTracked(const Value *V) {
+    Type *T = V->getType();
+    return T->isIntegerTy() or T->isPointerTy();
+  }
+
+  /// The range of \p V anywhere in the function
+  OffsetRange getRange(const Value *V) const {
+    if (auto *Constant = dyn_cast<ConstantInt>(V))
+      return OffsetRange::absolute(ConstantRange(Constant->getValue()));
+
+    unsigned BitWidth = getBitWidth(V);
+
+    // Instructions that have not been reached by the propagation are dead
+    if (isa<Instruction>(V)) {
+      auto It = Ranges.find(V);
+      if (It == Ranges.end())
+        return OffsetRange::absolute(ConstantRange::getEmpty(BitWidth));
+      return It->second;
+    }
+
+    return OffsetRange::unknown(BitWidth);
+  }
+
+  /// The range of \p V in \p BB
+  OffsetRange
+  getRangeAt(const Value *V, const BasicBlock *BB, unsigned Depth = 0) const {
+    if (isa<ConstantInt>(V))
+      return getRange(V);
+
+    OffsetRange Result = getRange(V);
+
+    // Branch conditions only constrain absolute values
+    auto It = Conditions.find(V);
+    if (not Result.FromSP0 and It != Conditions.end()) {
+      for (const auto &[ConditionBlock, Allowed] : It->second)
+        if (DT.dominates(ConditionBlock, BB))
+          Result = Result.intersectWith(OffsetRange::absolute(Allowed));
+    }
+
+    // The operands of a non-phi instruction hold the same values in BB as
+    // when the instruction was computed, so the conditions holding in BB also
+    // apply to them.
+    auto *I = dyn_cast<Instruction>(V);
+    if (I == nullptr or isa<PHINode>(I) or Depth >= MaxContextDepth)
+      return Result;
+
+    auto GetOperandRange = [this, BB, Depth](const Value *Operand) {
+      return getRangeAt(Operand, BB, Depth + 1);
+    };
+    if (auto Evaluated = evaluate(I, GetOperandRange))
+      Result = Result.intersectWith(*Evaluated);
+
+    return Result;
+  }
+
+private:
+  unsigned getBitWidth(const Value *V) const {
+    Type *T = V->getType();
+    if (T->isPointerTy())
+      return DL.getPointerTypeSizeInBits(T);
+    return T->getIntegerBitWidth();
+  }
+
+  /// Compute the range of \p I from the ranges of its operands
+  /// \return std::nullopt if the instruction is not supported
+  std::optional<OffsetRange> evaluate(const Instruction *I,
+                                      RangeGetter Get) const {
+    unsigned BitWidth = getBitWidth(I);
+
+    if (auto *Call = dyn_cast<CallInst>(I)) {
+      if (InitLocalSP != nullptr and Call->getCalledFunction() == InitLocalSP)
+        return OffsetRange::fromSP0(ConstantRange(APInt(BitWidth, 0)));
+    }
+
+    if (auto *Binary = dyn_cast<BinaryOperator>(I)) {
+      OffsetRange LHS = Get(Binary->getOperand(0));
+      OffsetRange RHS = Get(Binary->getOperand(1));
+      auto Opcode = Binary->getOpcode();
+      if (not LHS.FromSP0 and not RHS.FromSP0)
+        return OffsetRange::absolute(LHS.Range.binaryOp(Opcode, RHS.Range));
+
+      // Only moving by a constant amount keeps a value relative to SP0, and
+      // the distance between two such values is absolute
+      if (Opcode == Instruction::Add and LHS.FromSP0 != RHS.FromSP0)
+        return OffsetRange::fromSP0(LHS.Range.add(RHS.Range));
+
+      if (Opcode == Instruction::Sub and LHS.FromSP0)
+        return OffsetRange::get(LHS.Range.sub(RHS.Range), not RHS.FromSP0);
+
+      return std::nullopt;
+    }
+
+    if (auto *Cast = dyn_cast<CastInst>(I)) {
+      const Value *Operand = Cast->getOperand(0);
+      if (not isTracked(Operand))
+        return std::nullopt;
+
+      OffsetRange Source = Get(Operand);
+      auto Opcode = Cast->getOpcode();
+      switch (Opcode) {
+      case Instruction::PtrToInt:
+      case Instruction::IntToPtr:
+      case Instruction::BitCast:
+        if (getBitWidth(Operand) == BitWidth)
+          return Source;
+        return std::nullopt;
+
+      case Instruction::Trunc:
+      case Instruction::ZExt:
+      case Instruction::SExt:
+        if (Source.FromSP0)
+          return std::nullopt;
+        return OffsetRange::absolute(Source.Range.castOp(Opcode, BitWidth));
+
+      default:
+        return std::nullopt;
+      }
+    }
+
+    if (auto *GEP = dyn_cast<GEPOperator>(I)) {
+      unsigned IndexWidth = DL.getIndexTypeSizeInBits(GEP->getType());
+      MapVector<Value *, APInt> VariableOffsets;
+      APInt ConstantOffset(IndexWidth, 0);
+      if (not GEP->collectOffset(DL,
+                                 IndexWidth,
+                                 VariableOffsets,
+                                 ConstantOffset))
+        return std::nullopt;
+
+      ConstantRange Offset(ConstantOffset);
+      for (const auto &[Index, Scale] : VariableOffsets) {
+        OffsetRange IndexRange = Get(Index);
+        if (IndexRange.FromSP0)
+          return std::nullopt;
+        ConstantRange Scaled = IndexRange.Range.sextOrTrunc(IndexWidth)
+                                 .multiply(ConstantRange(Scale));
+        Offset = Offset.add(Scaled);
+      }
+
+      OffsetRange Base = Get(GEP->getPointerOperand());
+      return OffsetRange::get(Base.Range.add(Offset.sextOrTrunc(BitWidth)),
+                              Base.FromSP0);
+    }
+
+    if (auto *Select = dyn_cast<SelectInst>(I)) {
+      return Get(Select->getTrueValue())
+        .unionWith(Get(Select->getFalseValue()));
+    }
+
+    if (auto *Phi = dyn_cast<PHINode>(I)) {
+      auto Result = OffsetRange::absolute(ConstantRange::getEmpty(BitWidth));
+      for (const Value *Incoming : Phi->incoming_values())
+        Result = Result.unionWith(Get(Incoming));
+      return Result;
+    }
+
+    if (auto *Intrinsic = dyn_cast<IntrinsicInst>(I)) {
+      Intrinsic::ID ID = Intrinsic->getIntrinsicID();
+      if (not ConstantRange::isIntrinsicSupported(ID))
+        return std::nullopt;
+
+      SmallVector<ConstantRange, 2> Operands;
+      for (const Value *Operand : Intrinsic->args()) {
+        if (not isTracked(Operand))
+          return std::nullopt;
+
+        OffsetRange OperandRange = Get(Operand);
+        if (OperandRange.FromSP0)
+          return std::nullopt;
+        Operands.push_back(OperandRange.Range);
+      }
+      return OffsetRange::absolute(ConstantRange::intrinsic(ID, Operands));
+    }
+
+    return std::nullopt;
+  }
+
+  void propagate() {
+    std::deque<const Instruction *> Worklist;
+    DenseSet<const Instruction *> Enqueued;
+
+    // Visit in reverse post-order, so that most operands are already known
+    // when their users are first evaluated
+    ReversePostOrderTraversal<const Function *> RPOT(&F);
+    for (const BasicBlock *BB : RPOT)
+      for (const Instruction &I : *BB)
+        if (isTracked(&I) and Enqueued.insert(&I).second)
+          Worklist.push_back(&I);
+
+    auto Get = [this](const Value *V) { return getRange(V); };
+
+    while (not Worklist.empty()) {
+      const Instruction *I = Worklist.front();
+      Worklist.pop_front();
+      Enqueued.erase(I);
+
+      unsigned BitWidth = getBitWidth(I);
+      OffsetRange Old = getRange(I);
+      OffsetRange New = evaluate(I, Get)
+                          .value_or(OffsetRange::unknown(BitWidth));
+      if (New == Old)
+        continue;
+
+      // Widen, but preserve the base, so that accesses through a pointer
+      // moving in a loop are still known to target the stack
+      if (++NumUpdates[I] > MaxUpdates) {
+        New = OffsetRange::get(ConstantRange::getFull(BitWidth), New.FromSP0);
+        if (New == Old)
+          continue;
+      }
+
+      auto [It, Inserted] = Ranges.try_emplace(I, New);
+      if (not Inserted)
+        It->second = New;
+
+      for (const User *U : I->users())
+        if (auto *UserInstruction = dyn_cast<Instruction>(U))
+          if (isTracked(UserInstruction)
+              and Enqueued.insert(UserInstruction).second)
+            Worklist.push_back(UserInstruction);
+    }
+  }
+
+  void collectConditions() {
+    for (const BasicBlock &BB : F) {
+      auto *Branch = dyn_cast<BranchInst>(BB.getTerminator());
+      if (Branch == nullptr or not Branch->isConditional())
+        continue;
+
+      auto *Compare = dyn_cast<ICmpInst>(Branch->getCondition());
+      if (Compare == nullptr or not isTracked(Compare->getOperand(0)))
+        continue;
+
+      const BasicBlock *TrueSuccessor = Branch->getSuccessor(0);
+      const BasicBlock *FalseSuccessor = Branch->getSuccessor(1);
+      if (TrueSuccessor == FalseSuccessor)
+        continue;
+
+      for (const BasicBlock *Successor : successors(&BB)) {
+        // The condition only holds in the successor if it cannot be reached
+        // from elsewhere
+        if (Successor->getSinglePredecessor() != &BB)
+          continue;
+
+        CmpInst::Predicate Predicate = Compare->getPredicate();
+        if (Successor == FalseSuccessor)
+          Predicate = CmpInst::getInversePredicate(Predicate);
+
+        const Value *LHS = Compare->getOperand(0);
+        const Value *RHS = Compare->getOperand(1);
+        recordCondition(LHS, Successor, Predicate, getRange(RHS));
+        recordCondition(RHS,
+                        Successor,
+                        CmpInst::getSwappedPredicate(Predicate),
+                        getRange(LHS));
+      }
+    }
+  }
+
+  void recordCondition(const Value *V,
+                       const BasicBlock *BB,
+                       CmpInst::Predicate Predicate,
+                       const OffsetRange &Other) {
+    if (isa<Constant>(V) or Other.FromSP0)
+      return;
+
+    auto Allowed = ConstantRange::makeAllowedICmpRegion(Predicate, Other.Range);
+    if (not Allowed.isFullSet())
+      Conditions[V].emplace_back(BB, std::move(Allowed));
+  }
+};
+
+} // namespace
+
+StackAccessesBounds computeStackAccessesBounds(Function &F) {
+  StackAccessesBounds Result;
+
+  const Function *InitLocalSP = F.getParent()->getFunction("_init_local_sp");
+  if (F.isDeclaration() or InitLocalSP == nullptr)
+    return Result;
+
+  OffsetRangePropagation Offsets(F, InitLocalSP);
+
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      if (not isa<LoadInst>(&I) and not isa<StoreInst>(&I))
+        continue;
+
+      // Ignore accesses whose address is not relative to SP0
+      const Value *Pointer = getPointer(&I);
+      if (not Offsets.getRange(Pointer).FromSP0)
+        continue;
+
+      OffsetRange Offset = Offsets.getRangeAt(Pointer, &BB);
+      if (not Offset.FromSP0)
+        continue;
+
+      StackAccessBounds &Bounds = Result[&I];
+      if (Offset.Range.isFullSet())
+        continue;
+
+      unsigned BitWidth = Offset.Range.getBitWidth();
+      APInt AccessSize(BitWidth, getMemoryAccessSize(&I));
+      ConstantRange End = Offset.Range.add(ConstantRange(AccessSize));
+
+      Bounds.LowerBound = Offset.Range.getLower();
+      if (not End.isFullSet())
+        Bounds.UpperBound = End.getUpper();
+    }
+  }
+
+  revng_log(Log,
+            "Found " << Result.size() << " stack accesses in "
+                     << F.getName().str());
+
+  return Result;
+}
+
+StackAccessBounds getOverallBounds(const StackAccessesBounds &Bounds) {
+  auto IsSaturated = [](const APInt &Bound) {
+    return Bound.isMaxSignedValue() or Bound.isMinSignedValue();
+  };
+
+  StackAccessBounds Result;
+  for (const auto &[Access, AccessBounds] : Bounds) {
+    const std::optional<APInt> &Lower = AccessBounds.LowerBound;
+    if (Lower and not IsSaturated(*Lower)
+        and (not Result.LowerBound or Lower->slt(*Result.LowerBound)))
+      Result.LowerBound = *Lower;
+
+    const std::optional<APInt> &Upper = AccessBounds.UpperBound;
+    if (Upper and not IsSaturated(*Upper)
+        and (not Result.UpperBound or Upper->sgt(*Result.UpperBound)))
+      Result.UpperBound = *Upper;
+  }
+
+  return Result;
+}
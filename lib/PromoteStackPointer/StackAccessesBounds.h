@@ -0,0 +1,62 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.mit for details.
+//
+
+#include <cstdint>
+#include <optional>
+
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/DenseMap.h"
+
+namespace llvm {
+class Function;
+class Instruction;
+} // namespace llvm
+
+/// The range of offsets from SP0 a stack access can target
+struct StackAccessBounds {
+  /// The lowest offset the access can start at
+  std::optional<llvm::APInt> LowerBound;
+
+  /// The exclusive upper bound of the offset the access can end at
+  ///
+  /// An access of N bytes at the offset X has an upper bound of X + N + 1.
+  std::optional<llvm::APInt> UpperBound;
+
+  /// \return the offset of the access, if it can only target one
+  std::optional<int64_t> getExactOffset(unsigned AccessSize) const {
+    if (not LowerBound or not UpperBound)
+      return std::nullopt;
+
+    int64_t Start = LowerBound->getSExtValue();
+    int64_t End = UpperBound->getSExtValue();
+    if (End != Start + AccessSize + 1)
+      return std::nullopt;
+
+    return Start;
+  }
+};
+
+/// The bounds of the loads and stores of a function whose address is an
+/// offset from SP0, i.e., the value returned by `_init_local_sp`
+using StackAccessesBounds = llvm::DenseMap<const llvm::Instruction *,
+                                           StackAccessBounds>;
+
+/// Compute the bounds of the stack accesses of \p F
+///
+/// Each value of \p F is associated to the range of values it can assume,
+/// either as a plain integer or as an offset from SP0, and branch conditions
+/// are taken into account to refine the range of an address where it's used.
+///
+/// \note This only reads the IR, so it can run on several functions at once.
+StackAccessesBounds computeStackAccessesBounds(llvm::Function &F);
+
+/// Merge the bounds of all the stack accesses of a function
+///
+/// The result spans from the lowest lower bound to the highest upper bound.
+/// Bounds saturated to the signed extremes carry no information, and are
+/// ignored. DetectStackSize elects the size of the stack frame and of the stack
+/// arguments of a function from these.
+StackAccessBounds getOverallBounds(const StackAccessesBounds &Bounds);
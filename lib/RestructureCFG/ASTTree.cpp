@@ -138,11 +138,13 @@ ASTNode *ASTTree::copyASTNodesFrom(ASTTree &OldAST) {
     ASTSubstitutionMap[Old] = NewASTNode;
   }
 
-  // Clone the conditional expression nodes.
+  // Clone the conditional expression nodes. Since expressions are
+  // hash-consed, the copies of the same condition coming from different
+  // nested ASTs end up sharing a single node.
   for (const expr_unique_ptr &OldExpr : OldAST.expressions()) {
-    CondExprList.emplace_back(new AtomicNode(*cast<AtomicNode>(OldExpr.get())),
-                              expr_destructor());
-    ExprNode *NewExpr = CondExprList.back().get();
+    auto *OldAtomic = cast<AtomicNode>(OldExpr.get());
+    expr_unique_ptr Clone(new AtomicNode(*OldAtomic), expr_destructor());
+    ExprNode *NewExpr = addCondExpr(std::move(Clone));
     CondExprMap[OldExpr.get()] = NewExpr;
   }
 
@@ -205,7 +207,47 @@ void ASTTree::dumpASTOnFile(const std::string &FunctionName,
   dumpASTOnFile(PathName + "/" + FileName);
 }
 
+static ASTTree::expr_key getExprKey(const ExprNode *E) {
+  using NodeKind = ExprNode::NodeKind;
+  switch (E->getKind()) {
+  case NodeKind::NK_ValueCompare:
+  case NodeKind::NK_LoopStateCompare: {
+    const auto *Compare = cast<CompareNode>(E);
+    const void *BB = nullptr;
+    if (auto *ValueCompare = dyn_cast<ValueCompareNode>(Compare))
+      BB = ValueCompare->getBasicBlock();
+
+    // Pack the comparison kind together with the node kind, the constant is
+    // part of the key on its own
+    unsigned Kind = (Compare->getComparison() << 8) | E->getKind();
+    return { Kind, BB, nullptr, Compare->getConstant() };
+  }
+  case NodeKind::NK_Atomic: {
+    const auto *Atomic = cast<AtomicNode>(E);
+    return { E->getKind(), Atomic->getConditionalBasicBlock(), nullptr, 0 };
+  }
+  case NodeKind::NK_Not: {
+    const auto *Not = cast<NotNode>(E);
+    return { E->getKind(), Not->getNegatedNode(), nullptr, 0 };
+  }
+  case NodeKind::NK_And:
+  case NodeKind::NK_Or: {
+    const auto &[LHS, RHS] = cast<BinaryNode>(E)->getInternalNodes();
+    return { E->getKind(), LHS, RHS, 0 };
+  }
+  }
+  revng_abort("Unknown ExprNode kind");
+}
+
 ExprNode *ASTTree::addCondExpr(expr_unique_ptr &&Expr) {
+  expr_key Key = getExprKey(Expr.get());
+
+  // If an identical expression is already present, reuse it and let `Expr` be
+  // destroyed
+  auto [It, New] = UniquedCondExprs.try_emplace(Key, Expr.get());
+  if (not New)
+    return It->second;
+
   CondExprList.emplace_back(std::move(Expr));
   return CondExprList.back().get();
 }
@@ -23,6 +23,26 @@
 
 using namespace llvm;
 
+using ComparisonKind = CompareNode::ComparisonKind;
+
+static ExprNode *getCompareNode(ASTTree &AST,
+                                const CompareNode *Compare,
+                                ComparisonKind Comparison,
+                                size_t Constant) {
+  // `ExprNode`s are hash-consed and shared, so instead of modifying `Compare`
+  // in place we obtain the node representing the new comparison
+  using UniqueExpr = ASTTree::expr_unique_ptr;
+  UniqueExpr NewCompare;
+  if (auto *ValueCompare = llvm::dyn_cast<ValueCompareNode>(Compare)) {
+    BasicBlock *BB = ValueCompare->getBasicBlock();
+    NewCompare.reset(new ValueCompareNode(Comparison, BB, Constant));
+  } else {
+    revng_assert(llvm::isa<LoopStateCompareNode>(Compare));
+    NewCompare.reset(new LoopStateCompareNode(Comparison, Constant));
+  }
+  return AST.addCondExpr(std::move(NewCompare));
+}
+
 RecursiveCoroutine<ASTNode *> simplifyCompareNode(ASTTree &AST, ASTNode *Node) {
   switch (Node->getKind()) {
   case ASTNode::NK_List: {
@@ -68,8 +88,8 @@ RecursiveCoroutine<ASTNode *> simplifyCompareNode(ASTTree &AST, ASTNode *Node) {
       ExprNode *NegatedExpr = Not->getNegatedNode();
       revng_assert(NegatedExpr);
       if (auto *Compare = llvm::dyn_cast<CompareNode>(NegatedExpr)) {
-        Compare->flipComparison();
-        If->replaceCondExpr(Compare);
+        const auto &[Comparison, Constant] = Compare->getFlippedComparison();
+        If->replaceCondExpr(getCompareNode(AST, Compare, Comparison, Constant));
       }
     }
 
@@ -83,17 +103,24 @@ RecursiveCoroutine<ASTNode *> simplifyCompareNode(ASTTree &AST, ASTNode *Node) {
     IfCondExpr = If->getCondExpr();
     if (auto *Compare = llvm::dyn_cast<CompareNode>(IfCondExpr)) {
       if (Compare->getConstant() == 0) {
-        using ComparisonKind = CompareNode::ComparisonKind;
         auto Comparison = Compare->getComparison();
         if (Comparison == ComparisonKind::Comparison_Equal) {
-          Compare->setNotPresentKind();
+          ExprNode *NotPresent = getCompareNode(AST,
+                                                Compare,
+                                                ComparisonKind::
+                                                  Comparison_NotPresent,
+                                                0);
           using UniqueExpr = ASTTree::expr_unique_ptr;
           UniqueExpr Not;
-          Not.reset(new NotNode(Compare));
+          Not.reset(new NotNode(NotPresent));
           ExprNode *NotNode = AST.addCondExpr(std::move(Not));
           If->replaceCondExpr(NotNode);
         } else if (Comparison == ComparisonKind::Comparison_NotEqual) {
-          Compare->setNotPresentKind();
+          If->replaceCondExpr(getCompareNode(AST,
+                                             Compare,
+                                             ComparisonKind::
+                                               Comparison_NotPresent,
+                                             0));
         }
       }
     }
@@ -6,6 +6,8 @@
 // This file is distributed under the MIT License. See LICENSE.mit for details.
 //
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/Support/Casting.h"
@@ -23,48 +25,22 @@
 
 using namespace llvm;
 
+// Number of occurrences of the `AtomicNode` associated to a `BasicBlock` in
+// the conditions of the GHAST, split between the ones appearing directly and
+// the ones appearing under a `NotNode`.
+// Since `ExprNode`s are hash-consed, the same node may be reachable from many
+// conditions, therefore we count occurrences instead of collecting nodes.
 struct AssociatedExprs {
-  llvm::SmallSet<ExprNode **, 1> DirectExprs;
-  llvm::SmallSet<ExprNode **, 1> NegatedExprs;
+  unsigned DirectExprs = 0;
+  unsigned NegatedExprs = 0;
 };
 
 using BBExprsMap = llvm::SmallDenseMap<BasicBlock *, AssociatedExprs>;
 
-enum Direction {
-  Direct,
-  Negated
-};
-
-static void insertInAssociatedExprs(BBExprsMap &BBExprs,
-                                    BasicBlock *BB,
-                                    ExprNode **Node,
-                                    Direction Direction) {
-
-  // Check if the entry in the map is already present
-  BBExprsMap::iterator It = BBExprs.find(BB);
-  if (It == BBExprs.end()) {
-
-    // Insert in the map the corresponding entry if not already present, and
-    // reassign the iterator so we can use it
-    It = BBExprs.insert(std::make_pair(BB, AssociatedExprs())).first;
-  }
-
-  // Insert the pointer to the `ExprNode` in the correct vector
-  if (Direction == Direct) {
-    auto InsertIt = It->second.DirectExprs.insert(Node);
-    revng_assert(InsertIt.second == true);
-  } else if (Direction == Negated) {
-    auto InsertIt = It->second.NegatedExprs.insert(Node);
-    revng_assert(InsertIt.second == true);
-  } else {
-    revng_abort();
-  }
-}
-
-static RecursiveCoroutine<void> collectExprBB(ExprNode **Expr,
+static RecursiveCoroutine<void> collectExprBB(const ExprNode *Expr,
                                               BBExprsMap &BBExprs) {
 
-  switch ((*Expr)->getKind()) {
+  switch (Expr->getKind()) {
   case ExprNode::NodeKind::NK_ValueCompare:
   case ExprNode::NodeKind::NK_LoopStateCompare: {
     // In the `CompareNode` the associated `BasicBlock` does not contain a full
@@ -72,35 +48,34 @@ static RecursiveCoroutine<void> collectExprBB(ExprNode **Expr,
     // IR component for the hybrid simplification, and we do nothing.
   } break;
   case ExprNode::NodeKind::NK_Atomic: {
-    auto *Atomic = llvm::cast<AtomicNode>(*Expr);
+    auto *Atomic = llvm::cast<AtomicNode>(Expr);
     BasicBlock *BB = Atomic->getConditionalBasicBlock();
 
-    // Insert the `ExprNode`
-    insertInAssociatedExprs(BBExprs, BB, Expr, Direct);
+    // Count the direct occurrence
+    BBExprs[BB].DirectExprs += 1;
   } break;
 
   case ExprNode::NodeKind::NK_Not: {
-    auto *Not = llvm::cast<NotNode>(*Expr);
+    auto *Not = llvm::cast<NotNode>(Expr);
 
     if (auto *Contained = llvm::dyn_cast<AtomicNode>(Not->getNegatedNode())) {
       BasicBlock *BB = Contained->getConditionalBasicBlock();
 
-      // The `NotNode` directly contains an `AtomicNode`, we therefore insert
-      // the address to the `NotNode` in the `NegatedExprs` vector
-      insertInAssociatedExprs(BBExprs, BB, Expr, Negated);
+      // The `NotNode` directly contains an `AtomicNode`, we therefore count a
+      // negated occurrence
+      BBExprs[BB].NegatedExprs += 1;
     } else {
 
       // If the `NotNode` does not directly contain an `AtomicNode`, we need to
       // continue with the inspection
-      ExprNode **NegatedNode = Not->getNegatedNodeAddress();
-      rc_recur collectExprBB(NegatedNode, BBExprs);
+      rc_recur collectExprBB(Not->getNegatedNode(), BBExprs);
     }
   } break;
 
   case ExprNode::NodeKind::NK_And:
   case ExprNode::NodeKind::NK_Or: {
-    auto *Binary = llvm::cast<BinaryNode>(*Expr);
-    const auto &[LHS, RHS] = Binary->getInternalNodesAddress();
+    auto *Binary = llvm::cast<BinaryNode>(Expr);
+    const auto &[LHS, RHS] = Binary->getInternalNodes();
     rc_recur collectExprBB(LHS, BBExprs);
     rc_recur collectExprBB(RHS, BBExprs);
   } break;
@@ -111,15 +86,19 @@ static RecursiveCoroutine<void> collectExprBB(ExprNode **Expr,
   rc_return;
 }
 
-static RecursiveCoroutine<void>
-populateAssociatedExprMap(ASTTree &AST, ASTNode *Node, BBExprsMap &BBExprs) {
+using IfVisitor = llvm::function_ref<void(IfNode *)>;
+
+// Invoke `Visitor` on all the `IfNode`s whose condition is emitted, i.e., the
+// ones in the GHAST and the ones representing the condition of a loop
+static RecursiveCoroutine<void> visitConditions(ASTNode *Node,
+                                                IfVisitor Visitor) {
   switch (Node->getKind()) {
   case ASTNode::NK_List: {
     SequenceNode *Seq = llvm::cast<SequenceNode>(Node);
 
     // Recursively call the visit on each element of the `SequenceNode`
     for (ASTNode *&N : Seq->nodes()) {
-      rc_recur populateAssociatedExprMap(AST, N, BBExprs);
+      rc_recur visitConditions(N, Visitor);
     }
   } break;
   case ASTNode::NK_Scs: {
@@ -129,32 +108,29 @@ populateAssociatedExprMap(ASTTree &AST, ASTNode *Node, BBExprsMap &BBExprs) {
     // `dowhile`, we should inspect the related condition containing the
     // `IfNode` associated to the execution of the loop
     if (not Scs->isWhileTrue()) {
-      IfNode *If = Scs->getRelatedCondition();
-      ExprNode **IfExpr = If->getCondExprAddress();
-      collectExprBB(IfExpr, BBExprs);
+      Visitor(Scs->getRelatedCondition());
     }
 
     if (Scs->hasBody()) {
-      rc_recur populateAssociatedExprMap(AST, Scs->getBody(), BBExprs);
+      rc_recur visitConditions(Scs->getBody(), Visitor);
     }
   } break;
   case ASTNode::NK_If: {
     IfNode *If = llvm::cast<IfNode>(Node);
-    ExprNode **IfExpr = If->getCondExprAddress();
-    collectExprBB(IfExpr, BBExprs);
+    Visitor(If);
 
     if (If->hasThen()) {
-      rc_recur populateAssociatedExprMap(AST, If->getThen(), BBExprs);
+      rc_recur visitConditions(If->getThen(), Visitor);
     }
     if (If->hasElse()) {
-      rc_recur populateAssociatedExprMap(AST, If->getElse(), BBExprs);
+      rc_recur visitConditions(If->getElse(), Visitor);
     }
   } break;
   case ASTNode::NK_Switch: {
     auto *Switch = llvm::cast<SwitchNode>(Node);
     for (auto &LabelCasePair : Switch->cases()) {
       ASTNode *Case = LabelCasePair.second;
-      rc_recur populateAssociatedExprMap(AST, Case, BBExprs);
+      rc_recur visitConditions(Case, Visitor);
     }
   } break;
   case ASTNode::NK_Code:
@@ -173,6 +149,12 @@ populateAssociatedExprMap(ASTTree &AST, ASTNode *Node, BBExprsMap &BBExprs) {
   rc_return;
 }
 
+static void populateAssociatedExprMap(ASTNode *Node, BBExprsMap &BBExprs) {
+  visitConditions(Node, [&BBExprs](IfNode *If) {
+    collectExprBB(If->getCondExpr(), BBExprs);
+  });
+}
+
 enum NotKind {
   SimpleIR,
   BooleanNot
@@ -203,8 +185,8 @@ static ConsensusMap computeBBConsensus(BBExprsMap &BBExprs) {
     // transformation
     llvm::Value *Condition = Branch->getCondition();
 
-    auto &DirectExprs = AssociatedExprs.DirectExprs;
-    auto &NegatedExprs = AssociatedExprs.NegatedExprs;
+    unsigned DirectExprs = AssociatedExprs.DirectExprs;
+    unsigned NegatedExprs = AssociatedExprs.NegatedExprs;
 
     // TODO: we currently handle `ICmpInst`s and `BooleanNot`s as conditions for
     //       the branch, explore alternative situations that we may want to
@@ -230,12 +212,12 @@ static ConsensusMap computeBBConsensus(BBExprsMap &BBExprs) {
       auto Predicate = Compare->getPredicate();
 
       if (Predicate == llvm::ICmpInst::Predicate::ICMP_NE) {
-        if (NegatedExprs.size() >= DirectExprs.size()) {
+        if (NegatedExprs >= DirectExprs) {
           ConsensusBB.insert(std::make_pair(BB, NotKind::SimpleIR));
         }
       }
       if (Predicate == llvm::ICmpInst::Predicate::ICMP_EQ) {
-        if (NegatedExprs.size() > DirectExprs.size()) {
+        if (NegatedExprs > DirectExprs) {
           ConsensusBB.insert(std::make_pair(BB, NotKind::SimpleIR));
         }
       }
@@ -243,7 +225,7 @@ static ConsensusMap computeBBConsensus(BBExprsMap &BBExprs) {
 
       // Handle the hybrid simplify starting the analysis from the `BooleanNot`
       // call in the LLVM IR
-      if (NegatedExprs.size() >= DirectExprs.size()) {
+      if (NegatedExprs >= DirectExprs) {
         ConsensusBB.insert(std::make_pair(BB, NotKind::BooleanNot));
       }
     }
@@ -308,45 +290,98 @@ static void flipIRNot(BasicBlock *BB, const NotKind &NotKind) {
   return;
 }
 
-static void
-flipAssociatedExprs(ASTTree &AST, BBExprsMap &BBExprs, BasicBlock *BB) {
-  // Flip the condition on the expressions associated to the BasicBlock under
-  // analysis
-  auto It = BBExprs.find(BB);
-  revng_assert(It != BBExprs.end());
-
-  auto &AssociatedExprs = It->second;
-  auto &DirectExprs = AssociatedExprs.DirectExprs;
-  auto &NegatedExprs = AssociatedExprs.NegatedExprs;
-
-  // Iterate over the sets of the direct and negated associated expressions
-  for (ExprNode **DirectExpr : DirectExprs) {
-    using UniqueExpr = ASTTree::expr_unique_ptr;
-    UniqueExpr Not;
-    Not.reset(new NotNode(*DirectExpr));
-    ExprNode *NotNode = AST.addCondExpr(std::move(Not));
-    *DirectExpr = NotNode;
-  }
+using FlippedExprsMap = llvm::SmallDenseMap<ExprNode *, ExprNode *>;
+
+// Build the expression equivalent to `Expr`, where the direct and negated
+// occurrences of the `BasicBlock`s in `ConsensusBB` are swapped. Since
+// `ExprNode`s are shared, they cannot be modified in place, and we create new
+// ones, caching the result for each visited node.
+static RecursiveCoroutine<ExprNode *> flipExpr(ASTTree &AST,
+                                               ExprNode *Expr,
+                                               const ConsensusMap &ConsensusBB,
+                                               FlippedExprsMap &Flipped) {
+  auto It = Flipped.find(Expr);
+  if (It != Flipped.end())
+    rc_return It->second;
+
+  using UniqueExpr = ASTTree::expr_unique_ptr;
+  ExprNode *Result = Expr;
+  switch (Expr->getKind()) {
+  case ExprNode::NodeKind::NK_ValueCompare:
+  case ExprNode::NodeKind::NK_LoopStateCompare: {
+    // `CompareNode`s do not take part in the hybrid simplification
+  } break;
 
-  for (ExprNode **NegatedExpr : NegatedExprs) {
-    NotNode *ContainedNot = llvm::cast<NotNode>(*NegatedExpr);
-    ExprNode *AtomicNode = ContainedNot->getNegatedNode();
-    *NegatedExpr = AtomicNode;
+  case ExprNode::NodeKind::NK_Atomic: {
+    auto *Atomic = llvm::cast<AtomicNode>(Expr);
+    if (ConsensusBB.count(Atomic->getConditionalBasicBlock())) {
+      UniqueExpr Not;
+      Not.reset(new NotNode(Expr));
+      Result = AST.addCondExpr(std::move(Not));
+    }
+  } break;
+
+  case ExprNode::NodeKind::NK_Not: {
+    auto *Not = llvm::cast<NotNode>(Expr);
+    ExprNode *Negated = Not->getNegatedNode();
+    if (auto *Contained = llvm::dyn_cast<AtomicNode>(Negated)) {
+      if (ConsensusBB.count(Contained->getConditionalBasicBlock()))
+        Result = Contained;
+    } else {
+      ExprNode *NewNegated = rc_recur flipExpr(AST,
+                                               Negated,
+                                               ConsensusBB,
+                                               Flipped);
+      if (NewNegated != Negated) {
+        UniqueExpr NewNot;
+        NewNot.reset(new NotNode(NewNegated));
+        Result = AST.addCondExpr(std::move(NewNot));
+      }
+    }
+  } break;
+
+  case ExprNode::NodeKind::NK_And:
+  case ExprNode::NodeKind::NK_Or: {
+    auto *Binary = llvm::cast<BinaryNode>(Expr);
+    const auto &[LHS, RHS] = Binary->getInternalNodes();
+    ExprNode *NewLHS = rc_recur flipExpr(AST, LHS, ConsensusBB, Flipped);
+    ExprNode *NewRHS = rc_recur flipExpr(AST, RHS, ConsensusBB, Flipped);
+    if (NewLHS != LHS or NewRHS != RHS) {
+      UniqueExpr NewBinary;
+      if (llvm::isa<AndNode>(Binary))
+        NewBinary.reset(new AndNode(NewLHS, NewRHS));
+      else
+        NewBinary.reset(new OrNode(NewLHS, NewRHS));
+      Result = AST.addCondExpr(std::move(NewBinary));
+    }
+  } break;
+
+  default:
+    revng_abort();
   }
+
+  Flipped[Expr] = Result;
+  rc_return Result;
 }
 
 static void simplifyHybridNotImpl(ASTTree &AST,
-                                  BBExprsMap &BBExprs,
+                                  ASTNode *RootNode,
                                   ConsensusMap &ConsensusBB) {
+  if (ConsensusBB.empty())
+    return;
+
   for (const auto &[BB, NotKind] : ConsensusBB) {
 
     // Flip the condition on the LLVMIR
     flipIRNot(BB, NotKind);
-
-    // Flip the condition on the `ExprNode`s
-    flipAssociatedExprs(AST, BBExprs, BB);
   }
 
+  // Flip the condition on the `ExprNode`s
+  FlippedExprsMap Flipped;
+  visitConditions(RootNode, [&](IfNode *If) {
+    If->replaceCondExpr(flipExpr(AST, If->getCondExpr(), ConsensusBB, Flipped));
+  });
+
   return;
 }
 
@@ -360,7 +395,7 @@ ASTNode *simplifyHybridNot(ASTTree &AST, ASTNode *RootNode) {
 
   // Map that contains the correspondence of the `ExprNode`s affected by a
   // BasicBlock
-  populateAssociatedExprMap(AST, RootNode, BBExprs);
+  populateAssociatedExprMap(RootNode, BBExprs);
 
   // Run the analysis which checks if all the references to a single instance of
   // block that is a candidate for flipping, do agree for the flip operation
@@ -368,7 +403,7 @@ ASTNode *simplifyHybridNot(ASTTree &AST, ASTNode *RootNode) {
 
   // Perform the simplification for the BBs for which the consensus computation
   // agrees on the outcome of the transformation
-  simplifyHybridNotImpl(AST, BBExprs, ConsensusBB);
+  simplifyHybridNotImpl(AST, RootNode, ConsensusBB);
 
   return RootNode;
 }
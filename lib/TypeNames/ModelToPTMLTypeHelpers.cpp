@@ -3,6 +3,8 @@
 //
 
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "llvm/ADT/DepthFirstIterator.h"
 #include "llvm/ADT/GraphTraits.h"
@@ -44,6 +46,7 @@ TypeInlineHelper::TypeInlineHelper(const model::Binary &Model) {
   TypeGraph = buildTypeGraph(Model);
   TypeToNumOfRefs = calculateNumOfOccurences(Model);
   TypesToInline = findTypesToInline(Model, TypeGraph);
+  buildInlinedInto();
 }
 
 const GraphInfo &TypeInlineHelper::getTypeGraph() const {
@@ -56,12 +59,92 @@ const TypeToNumOfRefsMap &TypeInlineHelper::getTypeToNumOfRefs() const {
   return TypeToNumOfRefs;
 }
 
+/// Compute the strongly connected components of \p TypeGraph, with Tarjan's
+/// algorithm, and map each node to the index of its component
+static std::unordered_map<const Node *, unsigned>
+computeSCCs(const GraphInfo &TypeGraph) {
+  std::unordered_map<const Node *, unsigned> Result;
+
+  struct Frame {
+    const Node *N;
+    llvm::SmallVector<const Node *, 4> Successors;
+    size_t Next = 0;
+  };
+
+  std::unordered_map<const Node *, unsigned> Index;
+  std::unordered_map<const Node *, unsigned> LowLink;
+  std::vector<const Node *> Stack;
+  std::unordered_set<const Node *> OnStack;
+  std::vector<Frame> Frames;
+  unsigned NextIndex = 0;
+  unsigned NextSCC = 0;
+
+  auto Enter = [&](const Node *N) {
+    Index[N] = LowLink[N] = NextIndex++;
+    Stack.push_back(N);
+    OnStack.insert(N);
+
+    Frame NewFrame{ N, {}, 0 };
+    for (const Node *Successor : N->successors())
+      NewFrame.Successors.push_back(Successor);
+    Frames.push_back(std::move(NewFrame));
+  };
+
+  for (const auto &[T, Root] : TypeGraph.TypeToNode) {
+    if (Index.contains(Root))
+      continue;
+
+    Enter(Root);
+    while (not Frames.empty()) {
+      Frame &Current = Frames.back();
+      const Node *N = Current.N;
+
+      if (Current.Next < Current.Successors.size()) {
+        const Node *Successor = Current.Successors[Current.Next++];
+        if (not Index.contains(Successor))
+          Enter(Successor);
+        else if (OnStack.contains(Successor))
+          LowLink[N] = std::min(LowLink[N], Index[Successor]);
+        continue;
+      }
+
+      // All the successors have been visited, N is done
+      if (LowLink[N] == Index[N]) {
+        const Node *Member = nullptr;
+        do {
+          Member = Stack.back();
+          Stack.pop_back();
+          OnStack.erase(Member);
+          Result[Member] = NextSCC;
+        } while (Member != N);
+        ++NextSCC;
+      }
+
+      Frames.pop_back();
+      if (not Frames.empty()) {
+        const Node *Parent = Frames.back().N;
+        LowLink[Parent] = std::min(LowLink[Parent], LowLink[N]);
+      }
+    }
+  }
+
+  return Result;
+}
+
 /// Collect candidates for emitting inline types.
 TypeSet TypeInlineHelper::findTypesToInline(const model::Binary &Model,
                                             const GraphInfo &TypeGraph) {
   std::unordered_map<const model::Type *, uint64_t> Candidates;
   std::set<const model::Type *> ShouldIgnore;
 
+  // Two types reach each other iff they belong to the same SCC
+  std::unordered_map<const Node *, unsigned> SCCs = computeSCCs(TypeGraph);
+  auto InSameSCC = [&SCCs, &TypeGraph](const model::Type *A,
+                                       const model::Type *B) {
+    return SCCs.at(TypeGraph.TypeToNode.at(A))
+           == SCCs.at(TypeGraph.TypeToNode.at(B));
+  };
+
   // We may find a struct that represents stack type that is being used exactly
   // once somewhere else in Types:, but we do not want to inline it if that is
   // the case.
@@ -92,7 +175,7 @@ TypeSet TypeInlineHelper::findTypesToInline(const model::Binary &Model,
         // pointing to itself.
         if (QT.isPointer() or T.get()->key() == DependantType->key()) {
           ShouldIgnore.insert(DependantType);
-        } else if (isReachableFromRootType(T.get(), DependantType, TypeGraph)) {
+        } else if (InSameSCC(T.get(), DependantType)) {
           // Or the type could point to itself on a nested level.
           ShouldIgnore.insert(T.get());
           ShouldIgnore.insert(DependantType);
@@ -160,7 +243,7 @@ TypeInlineHelper::findStackTypesPerFunction(const model::Binary &Model) const {
 
       revng_assert(StackT->Kind() == model::TypeKind::StructType);
       Result[&Function].insert(StackT);
-      auto AllNestedTypes = getTypesToInlineInTypeTy(Model, StackT);
+      auto AllNestedTypes = getTypesToInlineInTypeTy(StackT);
       Result[&Function].merge(AllNestedTypes);
     }
   }
@@ -183,7 +266,7 @@ TypeSet TypeInlineHelper::collectStackTypes(const model::Binary &Model) const {
 
       revng_assert(StackT != nullptr);
       Result.insert(StackT);
-      auto AllNestedTypes = getTypesToInlineInTypeTy(Model, StackT);
+      auto AllNestedTypes = getTypesToInlineInTypeTy(StackT);
       Result.merge(AllNestedTypes);
     }
   }
@@ -674,70 +757,32 @@ bool isCandidateForInline(const model::Type *T) {
          or llvm::isa<model::EnumType>(T);
 }
 
-bool TypeInlineHelper::isReachableFromRootType(const model::Type *Type,
-                                               const model::Type *RootType,
-                                               const GraphInfo &TypeGraph) {
-  auto TheTypeToNode = TypeGraph.TypeToNode;
-
-  // Visit all the nodes reachable from RootType.
-  llvm::df_iterator_default_set<Node *> Visited;
-  for ([[maybe_unused]] Node *N :
-       depth_first_ext(TheTypeToNode.at(RootType), Visited))
-    ;
+void TypeInlineHelper::buildInlinedInto() {
+  for (const model::Type *T : TypesToInline) {
+    Node *TheNode = TypeGraph.TypeToNode.at(T);
+    if (TheNode->predecessorCount() != 1)
+      continue;
 
-  return Visited.contains(TheTypeToNode.at(Type));
-}
-
-using UPtrTy = UpcastablePointer<model::Type>;
-TypeSet TypeInlineHelper::getNestedTypesToInline(const model::Type *RootType,
-                                                 const UPtrTy &NestedTy) const {
-  model::Type *CurrentTy = NestedTy.get();
-  TypeSet Result;
-  do {
-    Result.insert(CurrentTy);
-    auto
-      ParentNode = TypeGraph.TypeToNode.at(CurrentTy)->predecessors().begin();
-    if ((*ParentNode)->data().T == RootType) {
-      return Result;
-    } else if (TypesToInline.contains((*ParentNode)->data().T)) {
-      CurrentTy = (*ParentNode)->data().T;
-    } else {
-      return {};
-    }
-  } while (CurrentTy);
-
-  return {};
+    const model::Type *User = (*TheNode->predecessors().begin())->data().T;
+    InlinedInto[User].push_back(T);
+  }
 }
 
 TypeSet
-TypeInlineHelper::getTypesToInlineInTypeTy(const model::Binary &Model,
-                                           const model::Type *RootType) const {
+TypeInlineHelper::getTypesToInlineInTypeTy(const model::Type *RootType) const {
+  // Types to inline have a single user and they never form cycles, so they
+  // form a forest rooted in the types that are not inlined. Collect the
+  // subtree of RootType.
   TypeSet Result;
-  auto TheTypeToNode = TypeGraph.TypeToNode;
-
-  // Visit all the nodes reachable from RootType.
-  llvm::df_iterator_default_set<Node *> Visited;
-  for ([[maybe_unused]] Node *N :
-       depth_first_ext(TheTypeToNode.at(RootType), Visited))
-    ;
-
-  for (auto &Type : Model.Types()) {
-    if (Visited.contains(TheTypeToNode.at(Type.get()))
-        and TypesToInline.contains(Type.get())
-        and TheTypeToNode.at(Type.get())->predecessorCount() == 1) {
-      auto ParentNode = TheTypeToNode.at(Type.get())->predecessors().begin();
-      // In the case the parent is stack type itself, just insert the type.
-      if ((*ParentNode)->data().T == RootType) {
-        Result.insert(Type.get());
-      } else if (TypesToInline.contains((*ParentNode)->data().T)) {
-        // In the case the parent type is not the type RootType itself, make
-        // sure that the parent is inlinable into the type RootType. NOTE: This
-        // goes as further as possible in opposite direction in order to find
-        // all types that we should inline into the type RootType.
-        auto NestedTypesToInline = getNestedTypesToInline(RootType, Type);
-        Result.merge(NestedTypesToInline);
-      }
-    }
+  llvm::SmallVector<const model::Type *> Worklist = { RootType };
+  while (not Worklist.empty()) {
+    auto It = InlinedInto.find(Worklist.pop_back_val());
+    if (It == InlinedInto.end())
+      continue;
+
+    for (const model::Type *Nested : It->second)
+      if (Result.insert(Nested).second)
+        Worklist.push_back(Nested);
   }
 
   return Result;
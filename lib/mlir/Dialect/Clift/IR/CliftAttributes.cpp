@@ -332,7 +332,7 @@ mlir::clift::StructType::verify(function_ref<InFlightDiagnostic()> emitError,
                      + first.getType()
                          .cast<mlir::clift::ValueType>()
                          .getByteSize();
-    if (StructEnd >= second.getOffset()) {
+    if (StructEnd > second.getOffset()) {
 
       return emitError() << "Fields of structs must be ordered by offset,  and "
                             "they cannot "
@@ -344,7 +344,7 @@ mlir::clift::StructType::verify(function_ref<InFlightDiagnostic()> emitError,
     mlir::Type FieldType = Field.getType();
     mlir::clift::ValueType Casted = FieldType.cast<mlir::clift::ValueType>();
     if (auto FieldEndPoint = Field.getOffset() + Casted.getByteSize();
-        FieldEndPoint >= Size) {
+        FieldEndPoint > Size) {
       return emitError() << "offset + size of field of struct type is "
                             "greater "
                             "than the struct type size.";
@@ -365,6 +365,18 @@ mlir::clift::StructType::verify(function_ref<InFlightDiagnostic()> emitError,
   return mlir::success();
 }
 
+mlir::LogicalResult mlir::clift::StructType::verifyBody(
+  function_ref<InFlightDiagnostic()> EmitError) {
+  if (not isDefinition() or getImpl()->isBodyVerified())
+    return mlir::success();
+
+  if (failed(verify(EmitError, getId(), getName(), getByteSize(), getFields())))
+    return mlir::failure();
+
+  getImpl()->setBodyVerified();
+  return mlir::success();
+}
+
 mlir::LogicalResult
 mlir::clift::UnionType::verify(function_ref<InFlightDiagnostic()> EmitError,
                                uint64_t ID,
@@ -373,7 +385,7 @@ mlir::clift::UnionType::verify(function_ref<InFlightDiagnostic()> EmitError,
                                llvm::ArrayRef<FieldAttr> Fields) {
   if (Size == 0)
     return EmitError() << "union type cannot have a size of zero";
-  if (Fields.size() != 0) {
+  if (Fields.empty()) {
     return EmitError() << "union types must have at least a field";
   }
   for (auto Field : Fields) {
@@ -393,3 +405,15 @@ mlir::clift::UnionType::verify(function_ref<InFlightDiagnostic()> EmitError,
   }
   return mlir::success();
 }
+
+mlir::LogicalResult mlir::clift::UnionType::verifyBody(
+  function_ref<InFlightDiagnostic()> EmitError) {
+  if (not isDefinition() or getImpl()->isBodyVerified())
+    return mlir::success();
+
+  if (failed(verify(EmitError, getId(), getName(), getByteSize(), getFields())))
+    return mlir::failure();
+
+  getImpl()->setBodyVerified();
+  return mlir::success();
+}
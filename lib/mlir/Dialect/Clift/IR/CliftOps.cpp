@@ -88,6 +88,11 @@ mlir::LogicalResult mlir::clift::LoopOp::verifyRegions() {
 struct ModuleValidator {
   mlir::LogicalResult visitSingleType(mlir::Operation *ContainingOp,
                                       mlir::Type Type) {
+    // The signature of functions, the types it contains are checked on their
+    // own
+    if (Type.isa<mlir::FunctionType>())
+      return mlir::success();
+
     if (checkTypeIsAcceptable(Type, ContainingOp).failed())
       return mlir::failure();
 
@@ -105,53 +110,31 @@ struct ModuleValidator {
     return mlir::success();
   }
 
+  mlir::LogicalResult visitSingleAttr(mlir::Operation *ContainingOp,
+                                      mlir::Attribute Attr) {
+    // Each struct and union is reached once per module, since attributes are
+    // visited once, and its body is verified only the first time it's seen
+    // in the context.
+    const auto EmitError = [ContainingOp]() {
+      return ContainingOp->emitError();
+    };
+    if (auto Struct = Attr.dyn_cast<mlir::clift::StructType>())
+      return Struct.verifyBody(EmitError);
+    if (auto Union = Attr.dyn_cast<mlir::clift::UnionType>())
+      return Union.verifyBody(EmitError);
+    return mlir::success();
+  }
+
   mlir::LogicalResult visitType(mlir::Operation *ContainingOp,
                                 mlir::Type Type) {
-    if (VisistedTypes.contains(Type))
-      return mlir::success();
-    VisistedTypes.insert(Type);
-
-    if (visitSingleType(ContainingOp, Type).failed())
-      return mlir::failure();
-
-    auto Casted = Type.dyn_cast<mlir::SubElementTypeInterface>();
-    if (not Casted) {
-      return mlir::success();
-    }
-    mlir::LogicalResult Result = mlir::success();
-    const auto WalkType = [&, this](mlir::Type Inner) {
-      if (visitType(ContainingOp, Inner).failed())
-        Result = mlir::failure();
-    };
-    const auto WalkAttr = [&, this](mlir::Attribute Attr) {
-      if (visitAttr(ContainingOp, Attr).failed())
-        Result = mlir::failure();
-    };
-    Casted.walkImmediateSubElements(WalkAttr, WalkType);
-    return Result;
+    enqueue(Type);
+    return drainWorklists(ContainingOp);
   }
 
   mlir::LogicalResult visitAttr(mlir::Operation *ContainingOp,
                                 mlir::Attribute Attr) {
-    if (VisitedAttrs.contains(Attr))
-      return mlir::success();
-    VisitedAttrs.insert(Attr);
-
-    auto Casted = Attr.dyn_cast<mlir::SubElementAttrInterface>();
-    if (not Casted) {
-      return mlir::success();
-    }
-    mlir::LogicalResult Result = mlir::success();
-    const auto WalkType = [&, this](mlir::Type Inner) {
-      if (visitType(ContainingOp, Inner).failed())
-        Result = mlir::failure();
-    };
-    const auto WalkAttr = [&, this](mlir::Attribute Attr) {
-      if (visitAttr(ContainingOp, Attr).failed())
-        Result = mlir::failure();
-    };
-    Casted.walkImmediateSubElements(WalkAttr, WalkType);
-    return Result;
+    enqueue(Attr);
+    return drainWorklists(ContainingOp);
   }
 
   mlir::LogicalResult checkTypeIsAcceptable(mlir::Type Type,
@@ -186,9 +169,49 @@ struct ModuleValidator {
     return mlir::success();
   }
 
+private:
+  void enqueue(mlir::Type Type) {
+    if (VisistedTypes.insert(Type).second)
+      TypeWorklist.push_back(Type);
+  }
+
+  void enqueue(mlir::Attribute Attr) {
+    if (VisitedAttrs.insert(Attr).second)
+      AttrWorklist.push_back(Attr);
+  }
+
+  // Types are walked with an explicit worklist: long chains of structs
+  // pointing to each other would otherwise exhaust the stack.
+  mlir::LogicalResult drainWorklists(mlir::Operation *ContainingOp) {
+    const auto WalkType = [this](mlir::Type Inner) { enqueue(Inner); };
+    const auto WalkAttr = [this](mlir::Attribute Inner) { enqueue(Inner); };
+
+    while (not TypeWorklist.empty() or not AttrWorklist.empty()) {
+      if (not TypeWorklist.empty()) {
+        mlir::Type Type = TypeWorklist.pop_back_val();
+        if (visitSingleType(ContainingOp, Type).failed())
+          return mlir::failure();
+
+        if (auto Casted = Type.dyn_cast<mlir::SubElementTypeInterface>())
+          Casted.walkImmediateSubElements(WalkAttr, WalkType);
+      } else {
+        mlir::Attribute Attr = AttrWorklist.pop_back_val();
+        if (visitSingleAttr(ContainingOp, Attr).failed())
+          return mlir::failure();
+
+        if (auto Casted = Attr.dyn_cast<mlir::SubElementAttrInterface>())
+          Casted.walkImmediateSubElements(WalkAttr, WalkType);
+      }
+    }
+
+    return mlir::success();
+  }
+
 private:
   llvm::SmallPtrSet<mlir::Type, 2> VisistedTypes;
   llvm::SmallPtrSet<mlir::Attribute, 2> VisitedAttrs;
+  llvm::SmallVector<mlir::Type> TypeWorklist;
+  llvm::SmallVector<mlir::Attribute> AttrWorklist;
   llvm::DenseMap<size_t, mlir::clift::TypeDefinition> Definitions;
 };
 
@@ -0,0 +1,277 @@
+//
+// This file is distributed under the MIT License. See LICENSE.mit for details.
+//
+
+#include <algorithm>
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/ADT/TypeSwitch.h"
+
+#include "revng/Model/Register.h"
+#include "revng/Support/Assert.h"
+
+#include "revng-c/mlir/Dialect/Clift/Utils/ImportModel.h"
+
+using namespace mlir::clift;
+
+ModelTypeImporter::ModelTypeImporter(mlir::MLIRContext &Context,
+                                     const model::Binary &Model) :
+  Context(Context) {
+  for (const UpcastablePointer<model::Type> &T : Model.Types()) {
+    UsedIDs.insert(T->ID());
+    NextArtificialID = std::max(NextArtificialID, T->ID());
+  }
+}
+
+uint64_t ModelTypeImporter::allocateArtificialID() {
+  // Start right after the largest ID of the model, wrapping around if needed.
+  // There are far fewer types than IDs, so there's always a free one.
+  do {
+    ++NextArtificialID;
+  } while (UsedIDs.contains(NextArtificialID));
+
+  UsedIDs.insert(NextArtificialID);
+  return NextArtificialID;
+}
+
+mlir::BoolAttr ModelTypeImporter::getConst(bool IsConst) {
+  return mlir::BoolAttr::get(&Context, IsConst);
+}
+
+/// Get the const qualified version of \p T
+static ValueType makeConst(ValueType T) {
+  mlir::MLIRContext *Context = T.getContext();
+  auto True = mlir::BoolAttr::get(Context, true);
+  return llvm::TypeSwitch<mlir::Type, ValueType>(T)
+    .Case([&](PrimitiveType P) {
+      return PrimitiveType::get(Context, P.getKind(), P.getSize(), True);
+    })
+    .Case([&](PointerType P) {
+      return PointerType::get(Context,
+                              P.getPointeeType(),
+                              P.getPointerSize(),
+                              True);
+    })
+    .Case([&](ArrayType A) {
+      return ArrayType::get(Context,
+                            A.getElementType(),
+                            A.getElementsCount(),
+                            True);
+    })
+    .Case([&](DefinedType D) {
+      return DefinedType::get(Context, D.getElementType(), True);
+    })
+    .Default([](mlir::Type) -> ValueType {
+      revng_abort("Unexpected Clift value type");
+    });
+}
+
+ValueType ModelTypeImporter::get(const model::QualifiedType &QT) {
+  ValueType Result = get(*QT.UnqualifiedType().getConst());
+
+  // The last qualifier is the one closest to the unqualified type
+  for (const model::Qualifier &Q : llvm::reverse(QT.Qualifiers())) {
+    switch (Q.Kind()) {
+    case model::QualifierKind::Const:
+      Result = makeConst(Result);
+      break;
+
+    case model::QualifierKind::Pointer:
+      Result = PointerType::get(&Context, Result, Q.Size(), getConst(false));
+      break;
+
+    case model::QualifierKind::Array:
+      Result = ArrayType::get(&Context, Result, Q.Size(), getConst(false));
+      break;
+
+    default:
+      revng_abort("Unexpected qualifier");
+    }
+  }
+
+  return Result;
+}
+
+ValueType ModelTypeImporter::get(const model::Type &T) {
+  auto It = Imported.find(&T);
+  if (It != Imported.end())
+    return It->second;
+
+  // Structs and unions are registered before their fields are imported, a
+  // type that is not can only refer to itself through a struct or a union.
+  revng_assert(not InProgress.contains(&T),
+               "Type refers to itself without going through a struct or a "
+               "union");
+  InProgress.insert(&T);
+  ValueType Result = import(T);
+  InProgress.erase(&T);
+
+  Imported[&T] = Result;
+  return Result;
+}
+
+mlir::FunctionType
+ModelTypeImporter::getFunctionType(const model::Type &Prototype) {
+  auto Defined = get(Prototype).cast<DefinedType>();
+  auto Function = Defined.getElementType().cast<FunctionAttr>();
+
+  llvm::SmallVector<mlir::Type> Arguments;
+  for (FunctionArgumentAttr Argument : Function.getArgumentTypes())
+    Arguments.push_back(Argument.getType());
+
+  llvm::SmallVector<mlir::Type, 1> Results;
+  ValueType ReturnType = Function.getReturnType();
+  auto Primitive = ReturnType.dyn_cast<PrimitiveType>();
+  if (not Primitive or Primitive.getKind() != PrimitiveKind::VoidKind)
+    Results.push_back(ReturnType);
+
+  return mlir::FunctionType::get(&Context, Arguments, Results);
+}
+
+ValueType ModelTypeImporter::import(const model::Type &T) {
+  auto Name = T.name();
+
+  switch (T.Kind()) {
+  case model::TypeKind::PrimitiveType: {
+    const auto &P = llvm::cast<model::PrimitiveType>(T);
+    auto Kind = static_cast<PrimitiveKind>(P.PrimitiveKind());
+    return PrimitiveType::get(&Context, Kind, P.Size(), getConst(false));
+  }
+
+  case model::TypeKind::EnumType: {
+    const auto &E = llvm::cast<model::EnumType>(T);
+    llvm::SmallVector<EnumFieldAttr> Fields;
+    for (const model::EnumEntry &Entry : E.Entries())
+      Fields.push_back(EnumFieldAttr::get(&Context,
+                                          Entry.Value(),
+                                          Entry.CustomName()));
+
+    auto Enum = EnumAttr::get(&Context,
+                              E.ID(),
+                              Name,
+                              get(E.UnderlyingType()),
+                              Fields);
+    return DefinedType::get(&Context, Enum, getConst(false));
+  }
+
+  case model::TypeKind::StructType: {
+    const auto &S = llvm::cast<model::StructType>(T);
+
+    // Register the struct before its fields, which might point back to it
+    auto Struct = StructType::get(&Context, S.ID());
+    auto Result = DefinedType::get(&Context, Struct, getConst(false));
+    Imported[&T] = Result;
+
+    llvm::SmallVector<FieldAttr> Fields;
+    for (const model::StructField &Field : S.Fields())
+      Fields.push_back(FieldAttr::get(&Context,
+                                      Field.Offset(),
+                                      get(Field.Type()),
+                                      Field.CustomName()));
+
+    Struct.setBody(Name, S.Size(), Fields);
+    return Result;
+  }
+
+  case model::TypeKind::UnionType: {
+    const auto &U = llvm::cast<model::UnionType>(T);
+
+    // Register the union before its fields, which might point back to it
+    auto Union = UnionType::get(&Context, U.ID());
+    auto Result = DefinedType::get(&Context, Union, getConst(false));
+    Imported[&T] = Result;
+
+    llvm::SmallVector<FieldAttr> Fields;
+    for (const model::UnionField &Field : U.Fields())
+      Fields.push_back(FieldAttr::get(&Context,
+                                      0,
+                                      get(Field.Type()),
+                                      Field.CustomName()));
+
+    Union.setBody(Name, Fields);
+    return Result;
+  }
+
+  case model::TypeKind::TypedefType: {
+    const auto &TD = llvm::cast<model::TypedefType>(T);
+    auto Typedef = TypedefAttr::get(&Context,
+                                    TD.ID(),
+                                    Name,
+                                    get(TD.UnderlyingType()));
+    return DefinedType::get(&Context, Typedef, getConst(false));
+  }
+
+  case model::TypeKind::CABIFunctionType:
+  case model::TypeKind::RawFunctionType: {
+    return DefinedType::get(&Context, importPrototype(T), getConst(false));
+  }
+
+  default:
+    revng_abort("Unexpected model type kind");
+  }
+}
+
+FunctionAttr ModelTypeImporter::importPrototype(const model::Type &T) {
+  auto Name = T.name();
+  llvm::SmallVector<FunctionArgumentAttr> Arguments;
+  ValueType ReturnType;
+
+  if (const auto *CF = llvm::dyn_cast<model::CABIFunctionType>(&T)) {
+    ReturnType = get(CF->ReturnType());
+    for (const model::Argument &Argument : CF->Arguments())
+      Arguments.push_back(FunctionArgumentAttr::get(&Context,
+                                                    get(Argument.Type()),
+                                                    Argument.CustomName()));
+  } else {
+    const auto &RF = llvm::cast<model::RawFunctionType>(T);
+    ReturnType = getRawReturnType(RF);
+    for (const model::NamedTypedRegister &Argument : RF.Arguments())
+      Arguments.push_back(FunctionArgumentAttr::get(&Context,
+                                                    get(Argument.Type()),
+                                                    Argument.CustomName()));
+
+    // Stack arguments are passed as a single struct, by value
+    if (not RF.StackArgumentsType().empty()) {
+      const model::Type &Stack = *RF.StackArgumentsType().getConst();
+      Arguments.push_back(FunctionArgumentAttr::get(&Context,
+                                                    get(Stack),
+                                                    "_stack_arguments"));
+    }
+  }
+
+  return FunctionAttr::get(&Context, T.ID(), Name, ReturnType, Arguments);
+}
+
+ValueType
+ModelTypeImporter::getRawReturnType(const model::RawFunctionType &RF) {
+  const auto &ReturnValues = RF.ReturnValues();
+  if (ReturnValues.empty())
+    return PrimitiveType::getVoid(&Context, 0);
+
+  if (ReturnValues.size() == 1)
+    return get(ReturnValues.begin()->Type());
+
+  // Multiple return values are wrapped into an artificial struct, with a
+  // field for each register, laid out one after the other
+  llvm::SmallVector<FieldAttr> Fields;
+  uint64_t Offset = 0;
+  for (const model::NamedTypedRegister &ReturnValue : ReturnValues) {
+    ValueType FieldType = get(ReturnValue.Type());
+    llvm::StringRef FieldName = model::Register::getName(ReturnValue
+                                                           .Location());
+    Fields.push_back(FieldAttr::get(&Context, Offset, FieldType, FieldName));
+    Offset += FieldType.getByteSize();
+  }
+
+  std::string StructName = (llvm::Twine("_artificial_struct_returned_by_")
+                            + RF.name())
+                             .str();
+  auto Struct = StructType::get(&Context,
+                                allocateArtificialID(),
+                                StructName,
+                                Offset,
+                                Fields);
+  return DefinedType::get(&Context, Struct, getConst(false));
+}
@@ -3,9 +3,13 @@
 //
 #include <string>
 
-#include "llvm/Transforms/Utils/Cloning.h"
-#include "llvm/Transforms/Utils/ValueMapper.h"
+#include "llvm/ADT/ScopeExit.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
 
+#include "mlir/Bytecode/BytecodeWriter.h"
 #include "mlir/Dialect/DLTI/DLTI.h"
 #include "mlir/Dialect/LLVMIR/LLVMDialect.h"
 #include "mlir/IR/BuiltinAttributes.h"
@@ -14,6 +18,7 @@
 #include "mlir/IR/Location.h"
 #include "mlir/IR/MLIRContext.h"
 #include "mlir/IR/Operation.h"
+#include "mlir/IR/OwningOpRef.h"
 #include "mlir/Target/LLVMIR/Dialect/All.h"
 #include "mlir/Target/LLVMIR/Import.h"
 
@@ -21,12 +26,13 @@
 #include "revng/Pipeline/RegisterPipe.h"
 #include "revng/Pipes/FileContainer.h"
 #include "revng/Pipes/Kinds.h"
+#include "revng/Support/Assert.h"
 
 #include "revng-c/Pipes/Kinds.h"
 
 namespace revng::pipes {
 
-static constexpr char MLIRModuleMime[] = "text/mlir";
+static constexpr char MLIRModuleMime[] = "application/x.mlir-bytecode";
 static constexpr char MLIRModuleName[] = "mlir-module";
 static constexpr char MLIRModuleSuffix[] = ".mlir";
 using MLIRFileContainer = FileContainer<&kinds::MLIRLLVMModule,
@@ -65,25 +71,52 @@ public:
     Context.appendDialectRegistry(Registry);
     Context.loadAllAvailableDialects();
 
-    // Let's do the MLIR import on a cloned Module, so we can save the old one
-    // untouched.
-    llvm::ValueToValueMapTy Map;
-    auto ClonedModule = llvm::CloneModule(IRContainer.getModule(), Map);
-
-    // Import LLVM Dialect.
-    auto ModuleOp = translateLLVMIRToModule(std::move(ClonedModule), &Context);
-
+    // The import consumes the module it's given, but the container must be
+    // preserved. Instead of keeping a clone of the module alongside the
+    // original, keep its bitcode, which is much smaller, drop the bodies of
+    // the original and restore it from the bitcode once the import is done.
+    llvm::SmallVector<char, 0> Bitcode;
+    {
+      llvm::raw_svector_ostream BitcodeStream(Bitcode);
+      llvm::cantFail(IRContainer.serialize(BitcodeStream));
+    }
+    llvm::StringRef BitcodeRef(Bitcode.data(), Bitcode.size());
+    auto Buffer = llvm::MemoryBuffer::getMemBuffer(BitcodeRef, "", false);
+
+    mlir::OwningOpRef<mlir::ModuleOp> ModuleOp;
+    std::string Error = "Could not import the module in the LLVM dialect";
+    {
+      // Restore the container whatever the outcome of the import
+      auto RestoreContainer = llvm::make_scope_exit([&]() {
+        llvm::cantFail(IRContainer.deserialize(*Buffer));
+      });
+
+      llvm::Module &Original = IRContainer.getModule();
+      llvm::LLVMContext &LLVMContext = Original.getContext();
+      for (llvm::Function &F : Original)
+        F.deleteBody();
+
+      auto MaybeModule = llvm::parseBitcodeFile(Buffer->getMemBufferRef(),
+                                                 LLVMContext);
+      // Import LLVM Dialect.
+      if (MaybeModule)
+        ModuleOp = translateLLVMIRToModule(std::move(*MaybeModule), &Context);
+      else
+        Error = llvm::toString(MaybeModule.takeError());
+    }
+
+    revng_check(ModuleOp, Error.c_str());
     revng_check(ModuleOp->verify().succeeded());
     std::error_code EC;
     llvm::raw_fd_ostream OS(DecompiledFunctionsContainer.getOrCreatePath(), EC);
     revng_check(not EC);
-    ModuleOp->print(OS, mlir::OpPrintingFlags().enableDebugInfo());
+    mlir::writeBytecodeToFile(ModuleOp->getOperation(), OS);
   }
 
   void print(const pipeline::Context &Ctx,
              llvm::raw_ostream &OS,
              llvm::ArrayRef<std::string> ContainerNames) const {
-    OS << "mlir-translate -import-llvm -mlir-print-debuginfo module.ll -o "
+    OS << "mlir-translate -import-llvm module.ll | mlir-opt -emit-bytecode -o "
           "module.mlir\n";
   }
 };
@@ -201,4 +201,19 @@ BOOST_AUTO_TEST_CASE(CanWalkPointerTypes) {
   BOOST_TEST(Count == 1);
 }
 
+BOOST_AUTO_TEST_CASE(InvalidStructBodiesAreRejectedEveryTime) {
+  auto Int32 = PrimitiveType::get(&context,
+                                  mlir::clift::PrimitiveKind::SignedKind,
+                                  4,
+                                  mlir::BoolAttr::get(&context, false));
+
+  // The field ends past the end of the struct
+  auto Struct = StructType::get(&context, 1);
+  Struct.setBody("s", 4, { FieldAttr::get(&context, 8, Int32, "field") });
+
+  // A failed verification must not be remembered as a successful one
+  BOOST_TEST(Struct.verifyBody(getDiagnosticEmitter()).failed());
+  BOOST_TEST(Struct.verifyBody(getDiagnosticEmitter()).failed());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
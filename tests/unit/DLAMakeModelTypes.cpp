@@ -0,0 +1,124 @@
+//
+// This file is distributed under the MIT License. See LICENSE.mit for details.
+//
+
+#define BOOST_TEST_MODULE DLAMakeModelTypes
+bool init_unit_test();
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Model/Binary.h"
+#include "revng/Support/Assert.h"
+#include "revng/Support/YAMLTraits.h"
+
+#include "revng-c/DataLayoutAnalysis/DLATypeSystem.h"
+
+#include "lib/DataLayoutAnalysis/Backend/DLAMakeModelTypes.h"
+
+using LTSN = dla::LayoutTypeSystemNode;
+
+using namespace dla;
+
+static LTSN *createNode(LayoutTypeSystem &TS, unsigned Size) {
+  LTSN *N = TS.createArtificialLayoutType();
+  N->Size = Size;
+  return N;
+}
+
+static void addInstance(LayoutTypeSystem &TS,
+                        LTSN *Parent,
+                        LTSN *Child,
+                        unsigned Offset) {
+  OffsetExpression OE{};
+  OE.Offset = Offset;
+  TS.addInstanceLink(Parent, Child, std::move(OE));
+}
+
+/// Type system with an Outer struct, containing an Inner struct by value, a
+/// pointer to Inner and a pointer to a pointer to Inner.
+static void buildNestedStructs(LayoutTypeSystem &TS) {
+  LTSN *Inner = createNode(TS, 16);
+  Inner->InterferingInfo = AllChildrenAreNonInterfering;
+  addInstance(TS, Inner, createNode(TS, 8), 0);
+  addInstance(TS, Inner, createNode(TS, 4), 8);
+
+  LTSN *Pointer = createNode(TS, 8);
+  TS.addPointerLink(Pointer, Inner);
+  LTSN *PointerToPointer = createNode(TS, 8);
+  TS.addPointerLink(PointerToPointer, Pointer);
+
+  LTSN *Outer = createNode(TS, 32);
+  Outer->InterferingInfo = AllChildrenAreNonInterfering;
+  addInstance(TS, Outer, Inner, 0);
+  addInstance(TS, Outer, Pointer, 16);
+  addInstance(TS, Outer, PointerToPointer, 24);
+
+  TS.getEqClasses().compress();
+}
+
+static std::string toYAML(const TupleTree<model::Binary> &Model) {
+  std::string Result;
+  llvm::raw_string_ostream OS(Result);
+  serialize(OS, *Model);
+  OS.flush();
+  return Result;
+}
+
+BOOST_AUTO_TEST_CASE(BatchedInsertionMatchesPerTypeInsertion) {
+  LayoutTypeSystem TS;
+  buildNestedStructs(TS);
+
+  TupleTree<model::Binary> Model;
+  Model->Architecture() = model::Architecture::x86_64;
+  ModelChanges Changes;
+  makeModelTypes(TS, {}, Model, Changes);
+  revng_check(Model->verify(true));
+  revng_check(Changes.verify(true));
+
+  // Insert the same types one at a time, in reverse order, so that each of
+  // them is inserted in the sorted Types() before all the others.
+  TupleTree<model::Binary> PerType;
+  PerType->Architecture() = Model->Architecture();
+  for (const UpcastablePointer<model::Type> &T : llvm::reverse(Model->Types()))
+    PerType->Types().insert(UpcastablePointer<model::Type>(T));
+  PerType.initializeReferences();
+  revng_check(PerType->verify(true));
+  revng_check(toYAML(PerType) == toYAML(Model));
+
+  // Only Outer and Inner are new, the leaves are primitive types
+  revng_check(Changes.Types.size() == 2);
+  const model::StructType *Outer = nullptr;
+  const model::StructType *Inner = nullptr;
+  for (const model::Type *T : Changes.Types) {
+    revng_check(Model->Types().count(T->key()) == 1);
+    const auto *Struct = llvm::cast<model::StructType>(T);
+    if (Struct->Size() == 32)
+      Outer = Struct;
+    else
+      Inner = Struct;
+  }
+  revng_check(Outer and Inner and Inner->Size() == 16);
+
+  // The pointer fields have been fixed up before the batch was inserted, and
+  // they point to Inner, through the right number of pointers.
+  const model::StructField &InnerField = Outer->Fields().at(0);
+  revng_check(InnerField.Type().UnqualifiedType().getConst() == Inner);
+  revng_check(InnerField.Type().Qualifiers().empty());
+  auto IsPointer = [](const model::Qualifier &Q) {
+    return model::Qualifier::isPointer(Q);
+  };
+  for (auto [Offset, NumPointers] : { std::pair<uint64_t, size_t>{ 16, 1 },
+                                      std::pair<uint64_t, size_t>{ 24, 2 } }) {
+    const model::QualifiedType &Type = Outer->Fields().at(Offset).Type();
+    revng_check(Type.UnqualifiedType().getConst() == Inner);
+    revng_check(Type.Qualifiers().size() == NumPointers);
+    revng_check(llvm::all_of(Type.Qualifiers(), IsPointer));
+  }
+}
@@ -28,7 +28,9 @@ public:
 
   virtual ~SelfDependentStep() override = default;
 
-  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override { return false; }
+  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) const override {
+    return false;
+  }
 };
 
 const char SelfDependentStep::ID = 0;
@@ -43,7 +45,9 @@ public:
 
   virtual ~SelfInvalidatingStep() override = default;
 
-  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override { return false; }
+  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) const override {
+    return false;
+  }
 };
 
 const char SelfInvalidatingStep::ID = 0;
@@ -58,7 +62,9 @@ public:
 
   virtual ~StepWithNoDeps() override = default;
 
-  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override { return false; }
+  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) const override {
+    return false;
+  }
 };
 
 const char StepWithNoDeps::ID = 0;
@@ -73,7 +79,9 @@ public:
 
   virtual ~SingleDependencyStep() override = default;
 
-  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override { return false; }
+  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) const override {
+    return false;
+  }
 };
 
 const char SingleDependencyStep::ID = 0;
@@ -88,11 +96,52 @@ public:
 
   virtual ~StepInvalidateNoDeps() override = default;
 
-  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) override { return false; }
+  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) const override {
+    return false;
+  }
 };
 
 const char StepInvalidateNoDeps::ID = 0;
 
+class CountingNoOpStep : public Step {
+  static const char ID;
+
+  unsigned &NumRuns;
+
+public:
+  static const constexpr void *getID() { return &ID; }
+
+  CountingNoOpStep(unsigned &Runs) : Step(ID), NumRuns(Runs) {}
+
+  virtual ~CountingNoOpStep() override = default;
+
+  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) const override {
+    ++NumRuns;
+    return false;
+  }
+};
+
+const char CountingNoOpStep::ID = 0;
+
+class AddNodeStep : public Step {
+  static const char ID;
+
+public:
+  static const constexpr void *getID() { return &ID; }
+
+  AddNodeStep() : Step(ID) {}
+
+  virtual ~AddNodeStep() override = default;
+
+  virtual bool runOnTypeSystem(LayoutTypeSystem &TS) const override {
+    // Don't report the change, StepManager should detect it anyway.
+    TS.createArtificialLayoutType();
+    return false;
+  }
+};
+
+const char AddNodeStep::ID = 0;
+
 } // end namespace dla
 
 using namespace dla;
@@ -232,3 +281,90 @@ BOOST_AUTO_TEST_CASE(SimpleInvalidate) {
   BOOST_TEST(SM.getNumSteps() == 5);
   BOOST_TEST(SM.hasValidSchedule());
 }
+
+BOOST_AUTO_TEST_CASE(SkipConvergedSteps) {
+  StepManager SM;
+  unsigned NumRuns = 0;
+
+  BOOST_TEST(SM.addStep<CountingNoOpStep>(NumRuns));
+  // Nothing changed after the first run, so this must be skipped.
+  BOOST_TEST(SM.addStep<CountingNoOpStep>(NumRuns));
+  BOOST_TEST(SM.addStep<AddNodeStep>());
+  // The TypeSystem changed, so this must run again.
+  BOOST_TEST(SM.addStep<CountingNoOpStep>(NumRuns));
+  BOOST_TEST(SM.getNumSteps() == 4);
+  BOOST_TEST(SM.hasValidSchedule());
+
+  LayoutTypeSystem TS;
+  SM.run(TS);
+
+  BOOST_TEST(NumRuns == 2);
+  BOOST_TEST(TS.getNumLayouts() == 1);
+}
+
+static void buildTwoEqualityPairs(LayoutTypeSystem &TS) {
+  auto *A = TS.createArtificialLayoutType();
+  auto *B = TS.createArtificialLayoutType();
+  auto *C = TS.createArtificialLayoutType();
+  auto *D = TS.createArtificialLayoutType();
+  TS.createArtificialLayoutType();
+  TS.addEqualityLink(A, B);
+  TS.addEqualityLink(C, D);
+}
+
+BOOST_AUTO_TEST_CASE(RunOnComponents) {
+  // The components are processed in the same way on a single thread
+  for (unsigned NumThreads : { 1, 2 }) {
+    StepManager SM;
+    BOOST_TEST(SM.addStep<CollapseEqualitySCC>());
+    BOOST_TEST(SM.addStep<AddNodeStep>());
+
+    LayoutTypeSystem TS;
+    buildTwoEqualityPairs(TS);
+
+    // Each of the 3 components is merged and gets a new node
+    SM.run(TS, NumThreads);
+
+    BOOST_TEST(TS.getNumLayouts() == 6);
+    BOOST_TEST(TS.getNID() == 8);
+    BOOST_TEST(TS.verifyConsistency());
+
+    const VectEqClasses &EqClasses = TS.getEqClasses();
+    BOOST_TEST(EqClasses.haveSameEqClass(0, 1));
+    BOOST_TEST(EqClasses.haveSameEqClass(2, 3));
+    BOOST_TEST(not EqClasses.haveSameEqClass(0, 2));
+    BOOST_TEST(not EqClasses.haveSameEqClass(0, 4));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(CollectStatistics) {
+  for (unsigned NumThreads : { 1, 2 }) {
+    StepManager SM;
+    BOOST_TEST(SM.addStep<CollapseEqualitySCC>());
+    BOOST_TEST(SM.addStep<AddNodeStep>());
+    SM.enableStatistics();
+
+    LayoutTypeSystem TS;
+    buildTwoEqualityPairs(TS);
+    SM.run(TS, NumThreads);
+
+    // Each Step runs once for each of the 3 components
+    uint64_t NumComponentRuns = 3;
+    auto Statistics = SM.getStatistics();
+    BOOST_TEST(Statistics.size() == 2);
+
+    const StepStatistics &Collapse = Statistics[0];
+    BOOST_TEST(Collapse.NumRuns == NumComponentRuns);
+    BOOST_TEST(Collapse.NumMergedNodes == 2);
+    BOOST_TEST(Collapse.NumRemovedNodes == 0);
+    BOOST_TEST(Collapse.NumCreatedNodes == 0);
+    BOOST_TEST(Collapse.NumNodes == 3);
+    BOOST_TEST(Collapse.NumEqualityLinks == 0);
+
+    const StepStatistics &AddNode = Statistics[1];
+    BOOST_TEST(AddNode.NumRuns == NumComponentRuns);
+    BOOST_TEST(AddNode.NumCreatedNodes == NumComponentRuns);
+    BOOST_TEST(AddNode.NumNodes == 3 + NumComponentRuns);
+    BOOST_TEST(AddNode.NodeMemory > 0);
+  }
+}
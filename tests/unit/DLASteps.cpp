@@ -807,3 +807,101 @@ BOOST_AUTO_TEST_CASE(DeduplicateFields_commonNodeAsymmetricCollapse) {
   checkNode(TS, NodeC, 10, AllChildrenAreNonInterfering, { 3 });
   checkNode(TS, NodeA1, 8, AllChildrenAreNonInterfering, { 4, 5, 6, 7 });
 }
+
+/// Test that checkpoints preserve nodes, links and equivalence classes
+BOOST_AUTO_TEST_CASE(CheckpointRoundTrip) {
+  dla::LayoutTypeSystem TS;
+
+  // Build TS
+  LTSN *Root = createRoot(TS, 16);
+  LTSN *Node1 = addEquality(TS, Root);
+  LTSN *Field = addInstanceAtOffset(TS, Root, 8, 4);
+  LTSN *Removed = createRoot(TS);
+  TS.addPointerLink(Field, Node1);
+  OffsetExpression OE{ 4 };
+  OE.Strides.push_back(8);
+  OE.TripCounts.push_back(std::nullopt);
+  TS.addInstanceLink(Node1, Field, std::move(OE));
+  Field->NonScalar = true;
+
+  // Checkpoints are taken before the equivalence classes are compressed
+  dla::StepManager SM;
+  revng_check(SM.addStep<dla::CollapseEqualitySCC>());
+  SM.run(TS);
+  TS.removeNode(Removed);
+
+  // Serialize and deserialize TS
+  std::string Buffer;
+  llvm::raw_string_ostream OS(Buffer);
+  TS.serialize(OS);
+  OS.flush();
+  auto MaybeLoaded = LayoutTypeSystem::deserialize(Buffer);
+  revng_check(static_cast<bool>(MaybeLoaded));
+  LayoutTypeSystem &Loaded = **MaybeLoaded;
+
+  // Check that the two type systems are the same
+  revng_check(Loaded.getNID() == TS.getNID());
+  revng_check(Loaded.getNumLayouts() == TS.getNumLayouts());
+  revng_check(Loaded.verifyConsistency());
+  std::vector<LTSN *> Nodes(TS.getLayoutsRange().begin(),
+                            TS.getLayoutsRange().end());
+  std::vector<LTSN *> LoadedNodes(Loaded.getLayoutsRange().begin(),
+                                  Loaded.getLayoutsRange().end());
+  revng_check(Nodes.size() == LoadedNodes.size());
+  for (size_t I = 0; I < Nodes.size(); ++I) {
+    const LTSN *N = Nodes[I];
+    const LTSN *L = LoadedNodes[I];
+    revng_check(N->ID == L->ID);
+    revng_check(N->Size == L->Size);
+    revng_check(N->InterferingInfo == L->InterferingInfo);
+    revng_check(N->NonScalar == L->NonScalar);
+    revng_check(N->Successors.size() == L->Successors.size());
+    for (const auto &[NLink, LLink] : llvm::zip(N->Successors, L->Successors)) {
+      revng_check(NLink.first->ID == LLink.first->ID);
+      revng_check(*NLink.second == *LLink.second);
+    }
+  }
+
+  const dla::VectEqClasses &Eq = TS.getEqClasses();
+  const dla::VectEqClasses &LoadedEq = Loaded.getEqClasses();
+  revng_check(LoadedEq.getNumElements() == Eq.getNumElements());
+  for (unsigned ID = 0; ID < Eq.getNumElements(); ++ID) {
+    revng_check(LoadedEq.isRemoved(ID) == Eq.isRemoved(ID));
+    revng_check(LoadedEq.computeEqClass(ID) == Eq.computeEqClass(ID));
+  }
+
+  // Truncated checkpoints are rejected
+  Buffer.pop_back();
+  auto MaybeTruncated = LayoutTypeSystem::deserialize(Buffer);
+  revng_check(not MaybeTruncated);
+  llvm::consumeError(MaybeTruncated.takeError());
+}
+
+/// Test that VectEqClasses can be queried before and after compression
+BOOST_AUTO_TEST_CASE(VectEqClassesQueries) {
+  dla::VectEqClasses Eq;
+  for (unsigned I = 0; I < 6; ++I)
+    Eq.growBy1();
+
+  Eq.join(4, 1);
+  Eq.join(1, 3);
+  Eq.remove(2);
+  Eq.remove(5);
+
+  revng_check(Eq.getNumClasses() == 0);
+  revng_check(Eq.haveSameEqClass(3, 4));
+  revng_check(not Eq.haveSameEqClass(0, 1));
+  revng_check(Eq.isRemoved(5));
+  revng_check(not Eq.isRemoved(3));
+  revng_check(Eq.computeEqClass(4) == std::vector<unsigned>({ 1, 3, 4 }));
+  revng_check(Eq.computeEqClass(2) == std::vector<unsigned>({ 2, 5 }));
+  revng_check(Eq.computeEqClass(0) == std::vector<unsigned>({ 0 }));
+
+  // Classes are numbered in order of their smallest element
+  Eq.compress();
+  revng_check(Eq.getNumClasses() == 3);
+  revng_check(Eq.getEqClassID(0) == 0U);
+  revng_check(Eq.getEqClassID(3) == 1U);
+  revng_check(not Eq.getEqClassID(5).has_value());
+  revng_check(Eq.computeEqClass(1) == std::vector<unsigned>({ 1, 3, 4 }));
+}
@@ -0,0 +1,112 @@
+//
+// This file is distributed under the MIT License. See LICENSE.mit for details.
+//
+
+#define BOOST_TEST_MODULE HeaderFragmentCache
+bool init_unit_test();
+
+#include <string>
+
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Model/Binary.h"
+#include "revng/Support/Assert.h"
+
+#include "revng-c/HeadersGeneration/ModelToHeader.h"
+
+#include "lib/HeadersGeneration/HeaderFragmentCache.h"
+
+using namespace model;
+
+/// Model with a struct Outer, containing a struct Inner by value
+struct TestModel {
+  TupleTree<Binary> Model;
+  TypePath Inner;
+  TypePath Outer;
+
+  TestModel() {
+    Model->Architecture() = Architecture::x86_64;
+    Model->DefaultABI() = ABI::SystemV_x86_64;
+    TypePath Int = Model->getPrimitiveType(PrimitiveTypeKind::Signed, 4);
+
+    auto NewInner = makeType<StructType>();
+    auto *InnerStruct = llvm::cast<StructType>(NewInner.get());
+    InnerStruct->CustomName() = "Inner";
+    InnerStruct->Fields()[0].CustomName() = "inner_field";
+    InnerStruct->Fields()[0].Type() = QualifiedType(Int, {});
+    InnerStruct->Size() = 4;
+    Inner = Model->recordNewType(std::move(NewInner));
+
+    auto NewOuter = makeType<StructType>();
+    auto *OuterStruct = llvm::cast<StructType>(NewOuter.get());
+    OuterStruct->CustomName() = "Outer";
+    OuterStruct->Fields()[0].CustomName() = "outer_field";
+    OuterStruct->Fields()[0].Type() = QualifiedType(Inner, {});
+    OuterStruct->Size() = 4;
+    Outer = Model->recordNewType(std::move(NewOuter));
+
+    revng_check(Model->verify());
+  }
+
+  StructType &inner() { return *llvm::cast<StructType>(Inner.get()); }
+};
+
+static std::string dump(const TupleTree<Binary> &Model) {
+  std::string Result;
+  llvm::raw_string_ostream Out(Result);
+  ModelToHeaderOptions Options;
+  Options.GeneratePlainC = true;
+  revng_check(dumpModelToHeader(*Model, Out, Options));
+  Out.flush();
+  return Result;
+}
+
+/// Dump the model without using the fragments cached by the previous runs
+static std::string dumpFromScratch(const TupleTree<Binary> &Model) {
+  HeaderFragmentCache::get().clear();
+  return dump(Model);
+}
+
+BOOST_AUTO_TEST_CASE(UnchangedModelHitsTheCache) {
+  TestModel Test;
+  HeaderFragmentCache &Cache = HeaderFragmentCache::get();
+
+  std::string First = dumpFromScratch(Test.Model);
+  HeaderFragmentCache::Statistics AfterFirst = Cache.getFragmentStatistics();
+  revng_check(AfterFirst.Misses > 0);
+
+  std::string Second = dump(Test.Model);
+  HeaderFragmentCache::Statistics AfterSecond = Cache.getFragmentStatistics();
+  revng_check(Second == First);
+  revng_check(AfterSecond.Misses == AfterFirst.Misses);
+  revng_check(AfterSecond.Hits > AfterFirst.Hits);
+}
+
+BOOST_AUTO_TEST_CASE(ChangedTypeIsPrintedAgain) {
+  TestModel Test;
+  std::string Before = dumpFromScratch(Test.Model);
+  revng_check(llvm::StringRef(Before).contains("inner_field"));
+
+  Test.inner().Fields()[0].CustomName() = "renamed_field";
+  std::string After = dump(Test.Model);
+  revng_check(After != Before);
+  revng_check(llvm::StringRef(After).contains("renamed_field"));
+  revng_check(not llvm::StringRef(After).contains("inner_field"));
+  revng_check(After == dumpFromScratch(Test.Model));
+}
+
+BOOST_AUTO_TEST_CASE(ChangedChildIsReflectedInItsParent) {
+  TestModel Test;
+  std::string Before = dumpFromScratch(Test.Model);
+  revng_check(llvm::StringRef(Before).contains("Inner"));
+
+  // Outer itself does not change, but it has to be printed again
+  Test.inner().CustomName() = "Renamed";
+  std::string After = dump(Test.Model);
+  revng_check(llvm::StringRef(After).contains("Renamed"));
+  revng_check(not llvm::StringRef(After).contains("Inner"));
+  revng_check(After == dumpFromScratch(Test.Model));
+}
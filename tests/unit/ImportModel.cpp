@@ -0,0 +1,171 @@
+/// \file ImportModel.cpp
+/// Tests for the import of model types in Clift
+
+//
+// This file is distributed under the MIT License. See LICENSE.mit for details.
+//
+
+#include <cstdint>
+#include <limits>
+
+#define BOOST_TEST_MODULE ImportModel
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/ADT/STLExtras.h"
+
+#include "mlir/IR/Builders.h"
+#include "mlir/IR/BuiltinTypes.h"
+#include "mlir/IR/MLIRContext.h"
+#include "mlir/IR/OwningOpRef.h"
+#include "mlir/IR/Verifier.h"
+
+#include "revng/Model/Binary.h"
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+#include "revng-c/mlir/Dialect/Clift/IR/Clift.h"
+#include "revng-c/mlir/Dialect/Clift/IR/CliftAttributes.h"
+#include "revng-c/mlir/Dialect/Clift/IR/CliftOps.h"
+#include "revng-c/mlir/Dialect/Clift/Utils/ImportModel.h"
+
+using namespace mlir::clift;
+
+static constexpr uint64_t MaxID = std::numeric_limits<uint64_t>::max();
+
+/// Add \p T to \p Model, keeping the ID it has been given
+static model::TypePath addType(TupleTree<model::Binary> &Model,
+                               UpcastablePointer<model::Type> &&T) {
+  model::Type::Key Key = T->key();
+  Model->Types().insert(std::move(T));
+  return Model->getTypePath(Key);
+}
+
+/// A model with:
+///
+/// * a struct Node, pointing to itself, with ID 0;
+/// * a typedef NodeAlias of Node, with the largest possible ID;
+/// * a RawFunctionType with two return values, with ID 1.
+///
+/// All the IDs right after the largest one are taken, so artificial types
+/// need to wrap around and skip them.
+class ImportModelTest {
+public:
+  ImportModelTest() {
+    Model->Architecture() = model::Architecture::x86_64;
+    Model->DefaultABI() = model::ABI::SystemV_x86_64;
+    using model::PrimitiveTypeKind::Signed;
+    model::QualifiedType Int64(Model->getPrimitiveType(Signed, 8), {});
+
+    auto NewNode = model::makeType<model::StructType>();
+    NewNode->ID() = 0;
+    auto *Node = llvm::cast<model::StructType>(NewNode.get());
+    Node->CustomName() = "Node";
+    Node->Size() = 16;
+    NodePath = addType(Model, std::move(NewNode));
+    Node->Fields()[0].CustomName() = "next";
+    Node->Fields()[0].Type() = { NodePath,
+                                 { model::Qualifier::createPointer(8) } };
+    Node->Fields()[8].CustomName() = "value";
+    Node->Fields()[8].Type() = Int64;
+
+    auto NewAlias = model::makeType<model::TypedefType>();
+    NewAlias->ID() = MaxID;
+    auto *Alias = llvm::cast<model::TypedefType>(NewAlias.get());
+    Alias->CustomName() = "NodeAlias";
+    Alias->UnderlyingType() = { NodePath, {} };
+    AliasPath = addType(Model, std::move(NewAlias));
+
+    auto NewPrototype = model::makeType<model::RawFunctionType>();
+    NewPrototype->ID() = 1;
+    auto *Prototype = llvm::cast<model::RawFunctionType>(NewPrototype.get());
+    model::NamedTypedRegister Argument(model::Register::rdi_x86_64);
+    Argument.Type() = { AliasPath, { model::Qualifier::createPointer(8) } };
+    Prototype->Arguments().insert(Argument);
+    for (auto Register : { model::Register::rax_x86_64,
+                           model::Register::rdx_x86_64 }) {
+      model::NamedTypedRegister ReturnValue(Register);
+      ReturnValue.Type() = Int64;
+      Prototype->ReturnValues().insert(ReturnValue);
+    }
+    PrototypePath = addType(Model, std::move(NewPrototype));
+
+    revng_check(Model->verify());
+
+    Context.loadDialect<CliftDialect>();
+  }
+
+  bool isModelID(uint64_t ID) const {
+    return llvm::any_of(Model->Types(), [ID](const auto &T) {
+      return T->ID() == ID;
+    });
+  }
+
+protected:
+  TupleTree<model::Binary> Model;
+  model::TypePath NodePath;
+  model::TypePath AliasPath;
+  model::TypePath PrototypePath;
+  mlir::MLIRContext Context;
+};
+
+BOOST_FIXTURE_TEST_SUITE(ImportModelTestSuite, ImportModelTest)
+
+BOOST_AUTO_TEST_CASE(RecursiveStructPointsToItself) {
+  ModelTypeImporter Importer(Context, *Model);
+  auto Node = Importer.get(*NodePath.getConst()).cast<DefinedType>();
+  auto Struct = Node.getElementType().cast<StructType>();
+  revng_check(Struct.getId() == 0);
+  revng_check(Struct.isDefinition());
+  revng_check(Struct.getName() == "Node");
+  revng_check(Struct.getByteSize() == 16);
+  revng_check(Struct.getFields().size() == 2);
+
+  auto Next = Struct.getFields()[0].getType().cast<PointerType>();
+  revng_check(Next.getPointeeType() == Node);
+}
+
+BOOST_AUTO_TEST_CASE(TypedefRefersToItsUnderlyingType) {
+  ModelTypeImporter Importer(Context, *Model);
+  auto Alias = Importer.get(*AliasPath.getConst()).cast<DefinedType>();
+  auto Typedef = Alias.getElementType().cast<TypedefAttr>();
+  revng_check(Typedef.getId() == MaxID);
+  revng_check(Typedef.getName() == "NodeAlias");
+  revng_check(Typedef.getUnderlyingType()
+              == Importer.get(*NodePath.getConst()));
+}
+
+BOOST_AUTO_TEST_CASE(MultipleReturnValuesUseAFreshID) {
+  ModelTypeImporter Importer(Context, *Model);
+  const model::Type &Prototype = *PrototypePath.getConst();
+  mlir::FunctionType Type = Importer.getFunctionType(Prototype);
+  revng_check(Type.getNumInputs() == 1);
+  revng_check(Type.getNumResults() == 1);
+
+  auto Result = Type.getResult(0).cast<DefinedType>();
+  auto Struct = Result.getElementType().cast<StructType>();
+  revng_check(not isModelID(Struct.getId()));
+  revng_check(Struct.getFields().size() == 2);
+  revng_check(Struct.getByteSize() == 16);
+
+  // The prototype is imported once
+  revng_check(Importer.getFunctionType(Prototype) == Type);
+}
+
+BOOST_AUTO_TEST_CASE(ModuleWithImportedTypesVerifies) {
+  ModelTypeImporter Importer(Context, *Model);
+  mlir::OpBuilder Builder(&Context);
+  mlir::Location Location = Builder.getUnknownLoc();
+  mlir::OwningOpRef<ModuleOp> Module = Builder.create<ModuleOp>(Location);
+  Builder.setInsertionPointToStart(&Module->getBody().emplaceBlock());
+
+  // Two functions sharing the prototype, so the types show up twice
+  const model::Type &Prototype = *PrototypePath.getConst();
+  for (llvm::StringRef Name : { "first", "second" })
+    Builder.create<FunctionOp>(Location,
+                               Name,
+                               Importer.getFunctionType(Prototype));
+
+  revng_check(mlir::verify(*Module).succeeded());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
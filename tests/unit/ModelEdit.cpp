@@ -0,0 +1,146 @@
+//
+// This file is distributed under the MIT License. See LICENSE.mit for details.
+//
+
+#define BOOST_TEST_MODULE ModelEdit
+bool init_unit_test();
+
+#include "boost/test/unit_test.hpp"
+
+#include "revng/Model/Binary.h"
+#include "revng/Model/VerifyHelper.h"
+#include "revng/Support/Assert.h"
+
+#include "lib/ImportFromC/ModelEdit.h"
+
+using namespace model;
+
+static bool hasType(const TupleTree<Binary> &Model, const Type::Key &Key) {
+  return Model->Types().find(Key) != Model->Types().end();
+}
+
+static TupleTree<Binary> makeModel() {
+  TupleTree<Binary> Model;
+  Model->Architecture() = Architecture::x86_64;
+  Model->DefaultABI() = ABI::SystemV_x86_64;
+  return Model;
+}
+
+static TypePath addTypedef(TupleTree<Binary> &Model) {
+  TypePath Int = Model->getPrimitiveType(PrimitiveTypeKind::Signed, 4);
+  auto Typedef = makeType<TypedefType>();
+  auto *TheTypedef = llvm::cast<TypedefType>(Typedef.get());
+  TheTypedef->UnderlyingType() = QualifiedType(Int, {});
+  return Model->recordNewType(std::move(Typedef));
+}
+
+/// A struct with a single int field, with the given ID
+static UpcastablePointer<Type> makeStruct(TupleTree<Binary> &Model,
+                                          uint64_t ID) {
+  TypePath Int = Model->getPrimitiveType(PrimitiveTypeKind::Signed, 4);
+  auto NewType = makeType<StructType>();
+  NewType->ID() = ID;
+  auto *Struct = llvm::cast<StructType>(NewType.get());
+  Struct->Fields()[0].Type() = QualifiedType(Int, {});
+  Struct->Size() = 4;
+  return NewType;
+}
+
+BOOST_AUTO_TEST_CASE(ReplaceWithDifferentKindIsRolledBack) {
+  TupleTree<Binary> Model = makeModel();
+  Type::Key TypedefKey = addTypedef(Model).get()->key();
+  uint64_t ID = std::get<0>(TypedefKey);
+  Type::Key StructKey = { ID, TypeKind::StructType };
+
+  {
+    ModelEdit Edit(Model);
+    TypePath Path = Edit.replaceType(TypedefKey, makeStruct(Model, ID));
+    revng_check(Path.get()->key() == StructKey);
+    revng_check(hasType(Model, StructKey));
+    revng_check(not hasType(Model, TypedefKey));
+
+    VerifyHelper VH(false);
+    revng_check(Edit.verify(VH));
+  }
+
+  // The edit has not been committed
+  revng_check(hasType(Model, TypedefKey));
+  revng_check(not hasType(Model, StructKey));
+  revng_check(Model->verify());
+}
+
+BOOST_AUTO_TEST_CASE(CommittedEditIsKept) {
+  TupleTree<Binary> Model = makeModel();
+  Type::Key TypedefKey = addTypedef(Model).get()->key();
+  uint64_t ID = std::get<0>(TypedefKey);
+  Type::Key StructKey = { ID, TypeKind::StructType };
+
+  Type::Key AddedKey;
+  {
+    ModelEdit Edit(Model);
+    Edit.replaceType(TypedefKey, makeStruct(Model, ID));
+    AddedKey = Edit.addType(makeType<UnionType>()).get()->key();
+    Edit.commit();
+  }
+
+  revng_check(hasType(Model, StructKey));
+  revng_check(hasType(Model, AddedKey));
+  revng_check(not hasType(Model, TypedefKey));
+}
+
+BOOST_AUTO_TEST_CASE(AddedTypesAreRolledBack) {
+  TupleTree<Binary> Model = makeModel();
+  Type::Key TypedefKey = addTypedef(Model).get()->key();
+  size_t TypesCount = Model->Types().size();
+
+  {
+    ModelEdit Edit(Model);
+    Type::Key AddedKey = Edit.addType(makeType<UnionType>()).get()->key();
+
+    // Replace a type introduced by the edit, changing its kind
+    uint64_t ID = std::get<0>(AddedKey);
+    Edit.replaceType(AddedKey, makeStruct(Model, ID));
+    revng_check(hasType(Model, { ID, TypeKind::StructType }));
+    revng_check(not hasType(Model, AddedKey));
+  }
+
+  revng_check(Model->Types().size() == TypesCount);
+  revng_check(hasType(Model, TypedefKey));
+}
+
+BOOST_AUTO_TEST_CASE(DanglingReferencesAreDetected) {
+  TupleTree<Binary> Model = makeModel();
+  TypePath Typedef = addTypedef(Model);
+  Type::Key TypedefKey = Typedef.get()->key();
+
+  // A struct using the typedef by value
+  auto User = makeType<StructType>();
+  auto *UserStruct = llvm::cast<StructType>(User.get());
+  UserStruct->Fields()[0].Type() = QualifiedType(Typedef, {});
+  UserStruct->Size() = 4;
+  Model->recordNewType(std::move(User));
+  revng_check(Model->verify());
+
+  ModelEdit Edit(Model);
+  Edit.replaceType(TypedefKey, makeStruct(Model, std::get<0>(TypedefKey)));
+
+  // The user still refers to the typedef, which is gone
+  VerifyHelper VH(false);
+  revng_check(not Edit.verify(VH));
+}
+
+BOOST_AUTO_TEST_CASE(NameCollisionsAreDetected) {
+  TupleTree<Binary> Model = makeModel();
+  addTypedef(Model).get()->CustomName() = "my_int";
+  Type::Key StructKey = Model->recordNewType(makeStruct(Model, 0)).get()->key();
+  revng_check(Model->verify());
+
+  ModelEdit Edit(Model);
+  auto Renamed = makeStruct(Model, std::get<0>(StructKey));
+  Renamed->CustomName() = "my_int";
+  Edit.replaceType(StructKey, std::move(Renamed));
+
+  // Nothing refers to the struct, but its new name is taken
+  VerifyHelper VH(false);
+  revng_check(not Edit.verify(VH));
+}
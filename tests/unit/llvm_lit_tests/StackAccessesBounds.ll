@@ -0,0 +1,71 @@
+;
+; This file is distributed under the MIT License. See LICENSE.mit for details.
+;
+
+; RUN: %revngopt %s -print-stack-accesses-bounds -o /dev/null | FileCheck %s
+; Test that the bounds of stack accesses take into account the conditions of
+; the branches dominating them, and are dropped when nothing is known. The
+; bounds are the same that the stack_offset markers used to get, and so are the
+; overall bounds from which detect-stack-size elects the stack sizes.
+
+declare i64 @_init_local_sp()
+
+define void @f(i64 %n, i1 %c) {
+entry:
+  %sp0 = call i64 @_init_local_sp()
+  %a.address = add i64 %sp0, -16
+  %a.pointer = inttoptr i64 %a.address to ptr
+  ; CHECK: f: access through %a.pointer in [-16, -7)
+  %a = load i64, ptr %a.pointer
+  br label %header
+
+header:
+  %i = phi i64 [ 0, %entry ], [ %inc, %body ]
+  %cmp = icmp ult i64 %i, 10
+  br i1 %cmp, label %body, label %exit
+
+body:
+  %mul = mul i64 %i, 4
+  %off = add i64 %mul, -64
+  %b.address = add i64 %sp0, %off
+  %b.pointer = inttoptr i64 %b.address to ptr
+  ; CHECK-NEXT: f: access through %b.pointer in [-64, -23)
+  store i32 0, ptr %b.pointer
+  %inc = add i64 %i, 1
+  br label %header
+
+exit:
+  %s = select i1 %c, i64 -32, i64 -24
+  %d.address = add i64 %sp0, %s
+  %d.pointer = inttoptr i64 %d.address to ptr
+  ; CHECK-NEXT: f: access through %d.pointer in [-32, -15)
+  %d = load i64, ptr %d.pointer
+  %x = add i64 %n, -8
+  %z.address = add i64 %sp0, %x
+  %z.pointer = inttoptr i64 %z.address to ptr
+  ; CHECK-NEXT: f: access through %z.pointer in [unknown, unknown)
+  %z = load i64, ptr %z.pointer
+  ; CHECK-NOT: access through
+  %n.pointer = inttoptr i64 %n to ptr
+  %w = load i64, ptr %n.pointer
+  ; The stack frame is 64 bytes, and there are no stack arguments
+  ; CHECK: f: all accesses in [-64, -7)
+  ret void
+}
+
+define void @g() {
+entry:
+  %sp0 = call i64 @_init_local_sp()
+  %arg.address = add i64 %sp0, 8
+  %arg.pointer = inttoptr i64 %arg.address to ptr
+  ; CHECK-NEXT: g: access through %arg.pointer in [8, 17)
+  %arg = load i64, ptr %arg.pointer
+  %local.address = add i64 %sp0, -4
+  %local.pointer = inttoptr i64 %local.address to ptr
+  ; CHECK-NEXT: g: access through %local.pointer in [-4, 1)
+  store i32 0, ptr %local.pointer
+  ; The stack frame is 4 bytes, and the stack arguments are 8 bytes, after the
+  ; return address
+  ; CHECK-NEXT: g: all accesses in [-4, 17)
+  ret void
+}
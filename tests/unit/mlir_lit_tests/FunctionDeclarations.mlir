@@ -0,0 +1,14 @@
+//
+// This file is distributed under the MIT License. See LICENSE.mit for details.
+//
+// RUN: diff <(revng clift-opt %s -o -) <(revng clift-opt %s -o - | revng clift-opt -o -)
+!int32_t = !clift.primitive<SignedKind 4>
+#list = #clift.struct<id = 1, name = "list", size = 16, fields = [<offset = 0, name = "value", type = !int32_t>, <offset = 8, name = "next", type = !clift.pointer<pointee_type = !clift.defined<#clift.struct<id = 1>>, pointer_size = 8>>]>
+!list = !clift.defined<#list>
+!list_pointer = !clift.pointer<pointee_type = !list, pointer_size = 8>
+clift.module {
+  clift.function "length" (!list_pointer) -> !int32_t {
+  }
+  clift.function "append" (!list_pointer, !int32_t) -> () {
+  }
+}
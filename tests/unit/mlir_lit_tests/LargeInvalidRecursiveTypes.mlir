@@ -0,0 +1,6 @@
+//
+// This file is distributed under the MIT License. See LICENSE.mit for details.
+//
+// RUN: python3 %S/generate_recursive_types.py --invalid 20000 > %t.mlir
+// RUN: not revng clift-opt %t.mlir -o /dev/null 2>&1 | FileCheck %s
+// CHECK: offset + size of field of struct type is greater than the struct type size
@@ -0,0 +1,5 @@
+//
+// This file is distributed under the MIT License. See LICENSE.mit for details.
+//
+// RUN: python3 %S/generate_recursive_types.py 20000 > %t.mlir
+// RUN: diff <(revng clift-opt %t.mlir -o -) <(revng clift-opt %t.mlir -o - | revng clift-opt -o -)
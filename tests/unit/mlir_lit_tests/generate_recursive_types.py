@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+
+#
+# This file is distributed under the MIT License. See LICENSE.mit for details.
+#
+
+"""
+Generate a clift module with a long cycle of structs and unions, each one
+pointing to the next, to stress parsing and verification of large models.
+"""
+
+import argparse
+import sys
+
+
+def reference(type_id: int) -> str:
+    kind = "struct" if type_id % 2 == 1 else "union"
+    return f"!clift.defined<#clift.{kind}<id = {type_id}>>"
+
+
+def pointer_to(type_id: int) -> str:
+    return f"!clift.pointer<pointee_type = {reference(type_id)}, pointer_size = 8>"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("count", type=int, help="Number of types to generate")
+    parser.add_argument(
+        "--invalid",
+        action="store_true",
+        help="Make the first struct too small for its fields, and reference it twice",
+    )
+    args = parser.parse_args()
+
+    output = sys.stdout
+    output.write("!int32_t = !clift.primitive<SignedKind 4>\n")
+    for type_id in range(1, args.count + 1):
+        next_id = type_id % args.count + 1
+        value = '<offset = 0, name = "value", type = !int32_t>'
+        if type_id % 2 == 1:
+            next_field = f'<offset = 8, name = "next", type = {pointer_to(next_id)}>'
+            size = 8 if args.invalid and type_id == 1 else 16
+            output.write(
+                f'#t{type_id} = #clift.struct<id = {type_id}, name = "t{type_id}", '
+                f"size = {size}, fields = [{value}, {next_field}]>\n"
+            )
+        else:
+            next_field = f'<offset = 0, name = "next", type = {pointer_to(next_id)}>'
+            output.write(
+                f'#t{type_id} = #clift.union<id = {type_id}, name = "t{type_id}", '
+                f"fields = [{value}, {next_field}]>\n"
+            )
+
+    output.write("clift.module {\n")
+    output.write(f'  clift.function "visit" ({pointer_to(1)}) -> () {{\n')
+    output.write("  }\n")
+    if args.invalid:
+        # A failed verification must not be remembered as a successful one
+        output.write(f'  clift.function "visit_again" ({pointer_to(1)}) -> () {{\n')
+        output.write("  }\n")
+    output.write("}\n")
+
+
+if __name__ == "__main__":
+    main()
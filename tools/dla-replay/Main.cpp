@@ -0,0 +1,153 @@
+//
+// This file is distributed under the MIT License. See LICENSE.mit for details.
+//
+
+#include <chrono>
+#include <memory>
+
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/Assert.h"
+
+#include "revng-c/DataLayoutAnalysis/DLATypeSystem.h"
+
+#include "lib/DataLayoutAnalysis/Middleend/DLAStep.h"
+
+using namespace llvm::cl;
+
+static OptionCategory ThisToolCategory("Tool options", "");
+
+static opt<std::string> InputPath(Positional,
+                                  Required,
+                                  desc("<input checkpoint>"),
+                                  cat(ThisToolCategory));
+
+static opt<std::string> OutputPath("o",
+                                   desc("Write a checkpoint of the resulting "
+                                        "type system to this file"),
+                                   value_desc("filename"),
+                                   cat(ThisToolCategory));
+
+static opt<unsigned> PointerSize("pointer-size",
+                                 desc("Size of pointers in the analyzed "
+                                      "binary"),
+                                 init(8),
+                                 cat(ThisToolCategory));
+
+static opt<unsigned> FirstStep("first-step",
+                               desc("Index of the first Step of the schedule "
+                                    "to run, starting from 1. To resume from "
+                                    "checkpoint N, use N + 1."),
+                               init(1),
+                               cat(ThisToolCategory));
+
+static opt<unsigned> LastStep("last-step",
+                              desc("Index of the last Step of the schedule to "
+                                   "run. 0 means up to the end."),
+                              init(0),
+                              cat(ThisToolCategory));
+
+static opt<unsigned> NumThreads("threads",
+                                desc("Number of threads used to run the Steps "
+                                     "on independent components"),
+                                init(1),
+                                cat(ThisToolCategory));
+
+static opt<std::string> StatisticsPath("statistics",
+                                       desc("Write statistics about each Step "
+                                            "to this file, in JSON"),
+                                       value_desc("filename"),
+                                       cat(ThisToolCategory));
+
+static opt<bool> TimeSteps("time-steps",
+                           desc("Report the time spent in each Step"),
+                           init(true),
+                           cat(ThisToolCategory));
+
+int main(int Argc, char *Argv[]) {
+  llvm::InitLLVM X(Argc, Argv);
+  HideUnrelatedOptions(ThisToolCategory);
+  ParseCommandLineOptions(Argc,
+                          Argv,
+                          "Run the DLA middle-end on a LayoutTypeSystem "
+                          "checkpoint, written by the dla pass with "
+                          "-dla-checkpoint.\n");
+
+  auto MaybeBuffer = llvm::MemoryBuffer::getFile(InputPath);
+  if (not MaybeBuffer) {
+    llvm::errs() << "Cannot open " << InputPath << ": "
+                 << MaybeBuffer.getError().message() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  auto MaybeTS = dla::LayoutTypeSystem::deserialize((*MaybeBuffer)->getBuffer());
+  if (not MaybeTS) {
+    llvm::errs() << InputPath << ": " << llvm::toString(MaybeTS.takeError())
+                 << "\n";
+    return EXIT_FAILURE;
+  }
+  dla::LayoutTypeSystem &TS = **MaybeTS;
+
+  dla::StepManager SM;
+  SM.addDefaultSteps(PointerSize);
+
+  // Keep only the requested subset of the schedule. The Steps before it are
+  // assumed to have already run on the checkpoint, so their dependencies are
+  // still satisfied.
+  size_t NumSteps = SM.getNumSteps();
+  size_t Last = LastStep == 0 ? NumSteps : LastStep;
+  if (FirstStep == 0 or FirstStep > Last or Last > NumSteps) {
+    llvm::errs() << "Invalid range of Steps, the schedule has " << NumSteps
+                 << " Steps\n";
+    return EXIT_FAILURE;
+  }
+  SM.Schedule.erase(SM.Schedule.begin() + Last, SM.Schedule.end());
+  SM.Schedule.erase(SM.Schedule.begin(), SM.Schedule.begin() + FirstStep - 1);
+
+  llvm::errs() << "Running Steps " << FirstStep << " to " << Last << " on "
+               << TS.getNumLayouts() << " nodes\n";
+
+  if (not StatisticsPath.empty())
+    SM.enableStatistics();
+
+  llvm::TimePassesIsEnabled = TimeSteps;
+  auto Start = std::chrono::steady_clock::now();
+  SM.run(TS, NumThreads);
+  std::chrono::duration<double> Elapsed = std::chrono::steady_clock::now()
+                                          - Start;
+
+  llvm::errs() << "Done in " << Elapsed.count() << "s, "
+               << TS.getNumLayouts() << " nodes left\n";
+  if (TimeSteps)
+    llvm::TimerGroup::printAll(llvm::errs());
+
+  if (not StatisticsPath.empty()) {
+    std::error_code EC;
+    llvm::raw_fd_ostream Statistics(StatisticsPath, EC, llvm::sys::fs::OF_Text);
+    if (EC) {
+      llvm::errs() << "Cannot open " << StatisticsPath << ": " << EC.message()
+                   << "\n";
+      return EXIT_FAILURE;
+    }
+    SM.printStatistics(Statistics);
+  }
+
+  if (not OutputPath.empty()) {
+    std::error_code EC;
+    llvm::raw_fd_ostream Output(OutputPath, EC, llvm::sys::fs::OF_None);
+    if (EC) {
+      llvm::errs() << "Cannot open " << OutputPath << ": " << EC.message()
+                   << "\n";
+      return EXIT_FAILURE;
+    }
+    TS.serialize(Output);
+  }
+
+  return EXIT_SUCCESS;
+}